@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Arena allocator
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include "arena.h"
+
+/* strictest alignment of the basic types */
+union arena_align {
+	long double	d;
+	long long	l;
+	void*		p;
+	void		(*f)(void);
+};
+
+#define ARENA_ALIGN	(sizeof(union arena_align))
+
+/* block header size rounded up to the alignment */
+#define ARENA_HEADER	((sizeof(arena_block_t) + ARENA_ALIGN - 1) \
+		& ~(ARENA_ALIGN - 1))
+
+static arena_block_t* new_block(size_t size);
+
+arena_t* new_arena()
+{
+	arena_t*	obj = malloc(sizeof(arena_t));
+	obj->first = NULL;
+	obj->current = NULL;
+	obj->total = 0;
+	return obj;
+}
+
+void free_arena(arena_t** arena)
+{
+	arena_block_t*	p;
+
+	assert(arena != NULL);
+	if (*arena == NULL) return;
+
+	p = (*arena)->first;
+	while (p != NULL) {
+		arena_block_t*	next = p->next;
+		free(p);
+		p = next;
+	}
+	free(*arena);
+	*arena = NULL;
+}
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+	arena_block_t*	p;
+	size_t		block_size;
+
+	assert(arena != NULL);
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	/* use the current block or one kept by arena_reset */
+	p = arena->current;
+	while (p != NULL) {
+		if (p->size - p->used >= size) {
+			void*	obj = (char*)p + ARENA_HEADER + p->used;
+			p->used += size;
+			arena->current = p;
+			return obj;
+		}
+		if (p->next == NULL)
+			break;
+		p = p->next;
+	}
+
+	/* add a new block after the last one */
+	block_size = p != NULL ? p->size * 2 : ARENA_MIN_BLOCK;
+	if (block_size > ARENA_MAX_BLOCK)
+		block_size = ARENA_MAX_BLOCK;
+	if (block_size < size)
+		block_size = size;
+
+	if (p != NULL)
+		p->next = new_block(block_size);
+	else
+		arena->first = new_block(block_size);
+	arena->current = p != NULL ? p->next : arena->first;
+	arena->total += block_size;
+
+	arena->current->used = size;
+	return (char*)arena->current + ARENA_HEADER;
+}
+
+void arena_reset(arena_t* arena)
+{
+	arena_block_t*	p;
+
+	assert(arena != NULL);
+
+	for (p = arena->first; p != NULL; p = p->next)
+		p->used = 0;
+	arena->current = arena->first;
+}
+
+void arena_list_add(arena_t* arena, list_t** list, void* object)
+{
+	list_t*	node = arena_alloc(arena, sizeof(list_t));
+
+	assert(list != NULL);
+
+	node->data = object;
+	if (*list == NULL) {
+		node->succ = node;
+		node->pred = node;
+		*list = node;
+	} else {
+		node->succ = *list;
+		node->pred = (*list)->pred;
+		(*list)->pred = node;
+		node->pred->succ = node;
+	}
+}
+
+static arena_block_t* new_block(size_t size)
+{
+	arena_block_t*	obj = malloc(ARENA_HEADER + size);
+	obj->next = NULL;
+	obj->size = size;
+	obj->used = 0;
+	return obj;
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Arena allocator
+ *
+ * Memory is handed out from large blocks and released all at once.
+ * Resetting an arena keeps its blocks, so repeated use does not go
+ * back to the system allocator once the blocks are large enough.
+ */
+#ifndef CTTF_ARENA_H
+#define CTTF_ARENA_H
+
+#include <stddef.h>
+#include "list.h"
+
+/* size of the first block, later blocks double up to ARENA_MAX_BLOCK */
+#define ARENA_MIN_BLOCK	(4096)
+#define ARENA_MAX_BLOCK	(1 << 20)
+
+typedef struct arena		arena_t;
+typedef struct arena_block	arena_block_t;
+
+arena_t* new_arena();
+void free_arena(arena_t** arena);
+
+/* Returns size bytes aligned for any object type
+ *
+ * The memory stays valid until the arena is reset or freed.
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/* Release all allocations but keep the blocks for reuse */
+void arena_reset(arena_t* arena);
+
+/* Append object to list using a list node from the arena
+ *
+ * Nodes allocated this way must not be removed with list_remove or
+ * free_list, they are released with the arena.
+ */
+void arena_list_add(arena_t* arena, list_t** list, void* object);
+
+struct arena_block {
+	arena_block_t*	next;
+	size_t		size;/* usable bytes following the header */
+	size_t		used;
+};
+
+struct arena {
+	arena_block_t*	first;
+	arena_block_t*	current;
+	size_t		total;/* usable bytes in all blocks */
+};
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/**
+ * cttf-bake - write a glyph mesh pack for a font
+ *
+ * Flattens, simplifies and triangulates the glyphs of a set of
+ * characters and writes them to a pack that font_use_pack serves
+ * without triangulating at run time.
+ *
+ * The characters are given as ranges FIRST-LAST or single codes, in
+ * decimal or 0x hexadecimal, separated by commas. The default is the
+ * printable ASCII and Latin-1 characters.
+ *
+ * With -z the meshes are quantized and delta encoded, which makes the
+ * pack smaller at the cost of decoding each glyph when it is loaded.
+ * With -o the triangles are ordered for the vertex cache of the GPU.
+ * With -r the outlines are snap rounded to a grid, in em units like the
+ * tolerance of -t, e.g. 1/upem to round to font units.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttf.h"
+#include "pack.h"
+
+#define DEFAULT_IPL	(3)
+#define DEFAULT_CHARSET	"0x20-0x7E,0xA0-0xFF"
+
+static void usage(void)
+{
+	printf("usage: cttf-bake [-z] [-o] [-i IPL] [-t TOLERANCE] [-r GRID] "
+			"[-c CHARSET] FONT PACK\n");
+}
+
+/* Parse a charset into chrs, which has room for 0x10000 characters.
+ * Returns the number of characters or -1 if the charset is invalid.
+ */
+static int parse_charset(const char* str, uint16_t* chrs)
+{
+	const char*	p = str;
+	int		n = 0;
+
+	while (*p) {
+		char*	end;
+		long	first;
+		long	last;
+		long	chr;
+
+		first = strtol(p, &end, 0);
+		if (end == p)
+			return -1;
+		last = first;
+		p = end;
+		if (*p == '-') {
+			last = strtol(p+1, &end, 0);
+			if (end == p+1)
+				return -1;
+			p = end;
+		}
+		if (first < 0 || last > 0xFFFF || first > last)
+			return -1;
+		for (chr = first; chr <= last && n < 0x10000; ++chr)
+			chrs[n++] = chr;
+		if (*p == ',')
+			p += 1;
+		else if (*p)
+			return -1;
+	}
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	FILE*		fp;
+	ttf_t*		ttf;
+	uint16_t*	chrs;
+	const char*	charset = DEFAULT_CHARSET;
+	int		ipl = DEFAULT_IPL;
+	float		tolerance = 0;
+	float		snap = 0;
+	int		options = 0;
+	int		nchr;
+	int		nglyphs;
+	int		i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+		if (!strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		} else if (!strcmp(argv[i], "-z")) {
+			options |= PACK_COMPRESS;
+		} else if (!strcmp(argv[i], "-o")) {
+			options |= PACK_OPTIMIZE;
+		} else if (!strcmp(argv[i], "-i") && i+1 < argc) {
+			ipl = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-t") && i+1 < argc) {
+			tolerance = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "-r") && i+1 < argc) {
+			snap = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "-c") && i+1 < argc) {
+			charset = argv[++i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (argc - i != 2) {
+		usage();
+		return 1;
+	}
+
+	chrs = malloc(sizeof(uint16_t) * 0x10000);
+	nchr = parse_charset(charset, chrs);
+	if (nchr < 0) {
+		fprintf(stderr, "invalid charset %s\n", charset);
+		free(chrs);
+		return 1;
+	}
+
+	if (!(fp = fopen(argv[i], "rb"))) {
+		fprintf(stderr, "could not open %s\n", argv[i]);
+		free(chrs);
+		return 1;
+	}
+	ttf = ttf_load(fp);
+	fclose(fp);
+	if (!ttf) {
+		fprintf(stderr, "%s\n", ttf_strerror());
+		free(chrs);
+		return 1;
+	}
+	ttf->interpolation_level = ipl;
+
+	if (!(fp = fopen(argv[i+1], "wb"))) {
+		fprintf(stderr, "could not create %s\n", argv[i+1]);
+		free_ttf(&ttf);
+		free(chrs);
+		return 1;
+	}
+	nglyphs = write_pack(fp, ttf, chrs, nchr, tolerance, snap,
+			options);
+	if (fclose(fp) || nglyphs < 0) {
+		fprintf(stderr, "could not write %s\n", argv[i+1]);
+		free_ttf(&ttf);
+		free(chrs);
+		return 1;
+	}
+	printf("%d glyphs\n", nglyphs);
+
+	free_ttf(&ttf);
+	free(chrs);
+	return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/**
+ * bstbench - scaling benchmark for the sweep line status tree
+ *
+ * Times the tree operations on n random keys and the sweeps of
+ * make_planar and connect_components on a comb with n teeth, which
+ * keeps about 2n segments in the sweep line status. For n log n behaviour the last column stays roughly
+ * constant as n grows.
+ *
+ * The last table times the whole triangulation of a shape with n
+ * separate squares, i.e., n inside faces.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bstree.h"
+#include "shape.h"
+#include "triangulate.h"
+
+#define MIN_N	(1 << 10)
+#define MAX_N	(1 << 18)
+
+static int int_less(void* x, void* y)
+{
+	return *(int*)x < *(int*)y;
+}
+
+static int int_greater(void* x, void* y)
+{
+	return *(int*)x > *(int*)y;
+}
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Returns n log2 n
+ */
+static double nlogn(int n)
+{
+	int	lg = 0;
+	while ((1 << (lg+1)) <= n)
+		lg += 1;
+	return (double)n * lg;
+}
+
+/* Insert n distinct keys in random order, query the neighbours of
+ * each key, then remove them
+ */
+static double bench_tree(int n)
+{
+	int*		keys = malloc(sizeof(int) * n);
+	bstree_t*	tree = NULL;
+	clock_t		start;
+	int		i;
+
+	for (i = 0; i < n; ++i)
+		keys[i] = i;
+	for (i = n-1; i > 0; --i) {
+		int	j = rand() % (i+1);
+		int	tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+
+	start = clock();
+	for (i = 0; i < n; ++i)
+		bstree_insert(&tree, &keys[i], int_less);
+	for (i = 0; i < n; ++i) {
+		list_t*	range = NULL;
+		bstree_find_left(tree, &keys[i], int_less);
+		bstree_find_right(tree, &keys[i], int_greater);
+		bstree_find_range(tree, &keys[i], int_less, int_greater,
+				NULL, &range);
+		free_list(&range);
+	}
+	for (i = 0; i < n; ++i)
+		bstree_remove(&tree, &keys[i], int_less);
+
+	free(keys);
+	return elapsed(start);
+}
+
+/* Run the two sweeps that use the status tree on a comb with n teeth
+ */
+static double bench_comb(int n)
+{
+	shape_t*	shape = new_shape();
+	edge_list_t*	edge_list;
+	clock_t		start;
+	double		t;
+	int		nvec;
+	int		i;
+
+	shape_add_vec(shape, 0, 2);
+	for (i = 0; i < n; ++i) {
+		shape_add_vec(shape, i, 0);
+		shape_add_vec(shape, i + 0.5f, 1);
+	}
+	shape_add_vec(shape, n, 0);
+	shape_add_vec(shape, n, 2);
+	nvec = 2*n + 3;
+	for (i = 0; i < nvec; ++i)
+		shape_add_seg(shape, i, (i+1) % nvec);
+
+	start = clock();
+	edge_list = make_planar(shape);
+	connect_components(edge_list);
+	t = elapsed(start);
+
+	free_edgelist(&edge_list);
+	free_shape(&shape);
+	return t;
+}
+
+/* Triangulate a grid of n squares
+ */
+static double bench_grid(int n)
+{
+	shape_t*	shape = new_shape();
+	edge_list_t*	edge_list;
+	clock_t		start;
+	double		t;
+	int		side = 1;
+	int		i;
+
+	while (side*side < n)
+		side += 1;
+	for (i = 0; i < n; ++i) {
+		float	x = 2 * (i % side);
+		float	y = 2 * (i / side);
+		shape_add_vec(shape, x, y);
+		shape_add_vec(shape, x + 1, y);
+		shape_add_vec(shape, x + 1, y + 1);
+		shape_add_vec(shape, x, y + 1);
+		shape_add_seg(shape, 4*i, 4*i + 1);
+		shape_add_seg(shape, 4*i + 1, 4*i + 2);
+		shape_add_seg(shape, 4*i + 2, 4*i + 3);
+		shape_add_seg(shape, 4*i + 3, 4*i);
+	}
+
+	start = clock();
+	edge_list = triangulate(shape);
+	t = elapsed(start);
+
+	free_edgelist(&edge_list);
+	free_shape(&shape);
+	return t;
+}
+
+int main(int argc, char** argv)
+{
+	int	max_n = MAX_N;
+	int	n;
+
+	if (argc > 1 && !strcmp(argv[1], "-h")) {
+		printf("usage: bstbench [MAX_N]\n");
+		return 0;
+	} else if (argc > 1) {
+		max_n = atoi(argv[1]);
+	}
+
+	srand(1);
+
+	printf("%10s %12s %14s\n", "tree n", "seconds", "ns/(n log n)");
+	for (n = MIN_N; n <= max_n; n *= 2) {
+		double	t = bench_tree(n);
+		printf("%10d %12.4f %14.3f\n", n, t, t * 1e9 / nlogn(n));
+	}
+
+	printf("%10s %12s %14s\n", "comb n", "seconds", "ns/(n log n)");
+	for (n = MIN_N; n <= max_n / 4; n *= 2) {
+		double	t = bench_comb(n);
+		printf("%10d %12.4f %14.3f\n", n, t, t * 1e9 / nlogn(n));
+	}
+
+	printf("%10s %12s %14s\n", "grid n", "seconds", "ns/(n log n)");
+	for (n = MIN_N; n <= max_n / 4; n *= 2) {
+		double	t = bench_grid(n);
+		printf("%10d %12.4f %14.3f\n", n, t, t * 1e9 / nlogn(n));
+	}
+
+	return 0;
+}
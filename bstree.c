@@ -19,14 +19,25 @@
  */
 /*
  * Binary Search Tree
+ *
+ * Red-black tree with one value per node. Values that compare equal
+ * are kept in insertion order: a new value goes to the right of the
+ * values that it is not left of.
  */
 #include <assert.h>
 #include <stdlib.h>
 #include "bstree.h"
 
-static void adjust_left(bstree_t** tree);
-static void adjust_right(bstree_t** tree);
-static int is_leaf(bstree_t* tree);
+static void rotate_left(bstree_t** tree, bstree_t* x);
+static void rotate_right(bstree_t** tree, bstree_t* x);
+static void insert_fixup(bstree_t** tree, bstree_t* x);
+static void transplant(bstree_t** tree, bstree_t* u, bstree_t* v);
+static void delete_node(bstree_t** tree, bstree_t* z);
+static void delete_fixup(bstree_t** tree, bstree_t* x, bstree_t* xp);
+static bstree_t* find_node(bstree_t* tree, void* v, comparator_t cmp);
+static bstree_t* leftmost(bstree_t* p);
+static bstree_t* rightmost(bstree_t* p);
+static int is_red(bstree_t* p);
 
 /* Returns the number of nodes in the binary search tree
  */
@@ -34,11 +45,8 @@ unsigned bstree_size(bstree_t* tree)
 {
 	if (tree == NULL)
 		return 0;
-	else if (is_leaf(tree))
-		return 1;
 	else
-		return bstree_size(tree->left) + bstree_size(tree->right);
-	
+		return 1 + bstree_size(tree->left) + bstree_size(tree->right);
 }
 
 /* Add a node to the tree
@@ -47,106 +55,41 @@ unsigned bstree_size(bstree_t* tree)
  */
 void bstree_insert(bstree_t** tree, void* v, comparator_t cmp)
 {
+	bstree_t*	parent = NULL;
 	bstree_t*	p;
-	assert(tree != NULL);
-	
-	p = *tree;
-	if (p == NULL) {
-		p = malloc(sizeof(bstree_t));
-		p->value = v;
-		p->rvalue = v;
-		p->min = v;
-		p->max = v;
-		p->left = NULL;
-		p->right = NULL;
-		p->parent = NULL;
-		*tree = p;
-
-	} else if (is_leaf(p)) {
-		if (cmp(v, p->value)) {
-			bstree_insert(&p->left, v, cmp);
-			bstree_insert(&p->right, p->value, cmp);
-
-			// adjust tree
-			p->value = v;
-			p->min = v;
-			// rvalue & max unchanged
-		} else {
-			bstree_insert(&p->left, p->value, cmp);
-			bstree_insert(&p->right, v, cmp);
-
-			// adjust tree
-			p->rvalue = v;
-			p->max = v;
-			// value & min unchanged
-		}
-	} else {
-		if (cmp(v, p->value)) {
-			bstree_insert(&p->left, v, cmp);
+	bstree_t*	n;
+	int		left = 0;
 
-			// adjust tree
-			p->value = p->left->max;
-			p->min = p->left->min;
-			// rvalue & max unchanged
-		} else {
-			bstree_insert(&p->right, v, cmp);
+	assert(tree != NULL);
 
-			// adjust tree
-			p->rvalue = p->right->min;
-			p->max = p->right->max;
-			// value & min unchanged
-		}
+	p = *tree;
+	while (p != NULL) {
+		parent = p;
+		left = cmp(v, p->value);
+		p = left ? p->left : p->right;
 	}
-}
 
-/* Adjust the tree after a left leaf has been removed
- */
-static void adjust_left(bstree_t** tree)
-{
-	bstree_t*	p = *tree;
-
-	// adjust tree
-	if (p->left == NULL) {
-		if (p->right != NULL) {
-			p->left = p->right;
-			p->right = NULL;
-			p->value = p->max;
-			p->rvalue = p->max;
-			p->min = p->left->min;
-		} else {
-			// we have no children - remove p
-			free(p);
-			*tree = NULL;
-		}
-	} else {
-		p->value = p->left->max;
-		p->min = p->left->min;
-		if (p->right == NULL) {
-			p->max = p->value;
-			p->rvalue = p->value;
-		} else {
-			p->max = p->right->max;
-			p->rvalue = p->right->min;
-		}
-	}
-}
+	n = malloc(sizeof(bstree_t));
+	n->parent = parent;
+	n->left = NULL;
+	n->right = NULL;
+	n->value = v;
+	n->red = 1;
+
+	if (parent == NULL)
+		*tree = n;
+	else if (left)
+		parent->left = n;
+	else
+		parent->right = n;
 
-/* Adjust the tree after a right leaf has been removed
- */
-static void adjust_right(bstree_t** tree)
-{
-	bstree_t*	p = *tree;
-
-	if (p->right != NULL) {
-		p->rvalue = p->right->min;
-		p->max = p->right->max;
-	} else if (p->left != NULL) {
-		p->max = p->left->max;
-		p->rvalue = p->left->max;
-	}
+	insert_fixup(tree, n);
 }
 
 /* Remove a node from a binary search tree
+ *
+ * The node is identified by the value pointer, cmp is only used to
+ * guide the search.
  *
  * cmp(x, y) must return nonzero if x is left of y
  */
@@ -156,31 +99,28 @@ void bstree_remove(bstree_t** tree, void* v, comparator_t cmp)
 
 	assert(tree != NULL);
 
-	p = *tree;
+	p = find_node(*tree, v, cmp);
+	if (p != NULL)
+		delete_node(tree, p);
+}
+
+/* Remove the leftmost node and return its value
+ *
+ * Returns NULL if the tree is empty
+ */
+void* bstree_pop(bstree_t** tree)
+{
+	bstree_t*	p;
+	void*		v;
 
-	if (p == NULL) return;
+	assert(tree != NULL);
 
-	if (p->value == v) {
-		if (is_leaf(p)) {
-			free(p);
-			*tree = NULL;
-		} else {
-			bstree_remove(&p->left, v, cmp);
-			adjust_left(tree);
-		}
-	} else if (p->rvalue == v) {
-		bstree_remove(&p->right, v, cmp);
-		adjust_right(tree);
-	} else {
-		if (cmp(v, p->value) || cmp(v, p->rvalue)) {
-			bstree_remove(&p->left, v, cmp);
-			adjust_left(tree);
-		} else {
-			bstree_remove(&p->right, v, cmp);
-			adjust_right(tree);
-		}
-	}
+	if (*tree == NULL) return NULL;
 
+	p = leftmost(*tree);
+	v = p->value;
+	delete_node(tree, p);
+	return v;
 }
 
 /* Remove all nodes x for which cmp(v, x) returns nonzero
@@ -191,84 +131,144 @@ void bstree_remove_if(bstree_t** tree, void* v, comparator_t cmp)
 
 	assert(tree != NULL);
 
-	p = *tree;
-
-	if (p == NULL) return;
-
-	if (is_leaf(p)) {
-		if (cmp(v, p->value)) {
-			free(p);
-			*tree = NULL;
-		}
-	} else {
-		bstree_remove_if(&p->right, v, cmp);
-		adjust_right(tree);
-		bstree_remove_if(&p->left, v, cmp);
-		adjust_left(tree);
+	p = bstree_first(*tree);
+	while (p != NULL) {
+		/* deleting a node does not move the other nodes */
+		bstree_t*	next = bstree_next(p);
+		if (cmp(v, p->value))
+			delete_node(tree, p);
+		p = next;
 	}
-
 }
 
 /* Find the node immediately to the left of v
+ *
+ * Returns the rightmost node that v is not left of, or the leftmost
+ * node if v is left of every node.
  *
  * cmp(v, x) must return nonzero if v is left of x
  */
 void* bstree_find_left(bstree_t* tree, void* v, comparator_t cmp)
 {
+	bstree_t*	best = NULL;
+	bstree_t*	p = tree;
+
 	if (tree == NULL) return NULL;
 
-	if (is_leaf(tree))
-		return tree->value;
-	else if (tree->right == NULL)
-		return bstree_find_left(tree->left, v, cmp);
-	else if (tree->left == NULL)
-		return bstree_find_left(tree->right, v, cmp);
-	else if (cmp(v, tree->value) || cmp(v, tree->rvalue))// TODO: can remove first test?
-		return bstree_find_left(tree->left, v, cmp);
-	else
-		return bstree_find_left(tree->right, v, cmp);
+	while (p != NULL) {
+		if (cmp(v, p->value)) {
+			p = p->left;
+		} else {
+			best = p;
+			p = p->right;
+		}
+	}
+	if (best == NULL)
+		best = leftmost(tree);
+	return best->value;
 }
 
 /* Find the node immediately to the right of v
+ *
+ * Returns the leftmost node that v is not right of, or the rightmost
+ * node if v is right of every node.
  *
  * cmp(v, x) must return nonzero if v is right of x
  */
 void* bstree_find_right(bstree_t* tree, void* v, comparator_t cmp)
 {
+	bstree_t*	best = NULL;
+	bstree_t*	p = tree;
+
 	if (tree == NULL) return NULL;
 
-	if (is_leaf(tree))
-		return tree->value;
-	else if (tree->right == NULL)
-		return bstree_find_right(tree->left, v, cmp);
-	else if (tree->left == NULL)
-		return bstree_find_right(tree->right, v, cmp);
-	else if (cmp(v, tree->value) || cmp(v, tree->rvalue))// TODO: can remove second test?
-		return bstree_find_right(tree->right, v, cmp);
-	else
-		return bstree_find_right(tree->left, v, cmp);
+	while (p != NULL) {
+		if (cmp(v, p->value)) {
+			p = p->right;
+		} else {
+			best = p;
+			p = p->left;
+		}
+	}
+	if (best == NULL)
+		best = rightmost(tree);
+	return best->value;
 }
 
 /* Find all the nodes that match the comparator
+ *
+ * The matching nodes are added to the list in order. This visits
+ * every node in the tree, use bstree_find_range when the matching
+ * nodes are known to be adjacent.
  *
  * cmp(v, x) must return nonzero if v matches x
  */
 void bstree_find_all(bstree_t* tree, void* v, comparator_t cmp, list_t** list)
 {
-	if (tree == NULL) return;
+	bstree_t*	p;
+
+	for (p = bstree_first(tree); p != NULL; p = bstree_next(p)) {
+		if (cmp(v, p->value))
+			list_add(list, p->value);
+	}
+}
+
+/* Find the nodes that v is neither left nor right of
+ *
+ * The nodes in the range for which match(v, x) returns nonzero are
+ * added to the list in order. If match is NULL all nodes in the range
+ * are added.
+ *
+ * left_of(v, x) must return nonzero if v is left of x
+ * right_of(v, x) must return nonzero if v is right of x
+ */
+void bstree_find_range(bstree_t* tree, void* v, comparator_t left_of,
+		comparator_t right_of, comparator_t match, list_t** list)
+{
+	bstree_t*	first = NULL;
+	bstree_t*	p = tree;
 
-	if (is_leaf(tree)) {
-		if (cmp(v, tree->value))
-			list_add(list, tree->value);
-	}  else {
-		if (tree->left != NULL)
-			bstree_find_all(tree->left, v, cmp, list);
+	/* find the leftmost node that v is not right of */
+	while (p != NULL) {
+		if (right_of(v, p->value)) {
+			p = p->right;
+		} else {
+			first = p;
+			p = p->left;
+		}
+	}
 
-		if (tree->right != NULL)
-			bstree_find_all(tree->right, v, cmp, list);
+	for (p = first; p != NULL && !left_of(v, p->value); p = bstree_next(p)) {
+		if (match == NULL || match(v, p->value))
+			list_add(list, p->value);
 	}
 }
 
+/* Returns the leftmost node of the tree
+ */
+bstree_t* bstree_first(bstree_t* tree)
+{
+	if (tree == NULL) return NULL;
+	return leftmost(tree);
+}
+
+/* Returns the node following node in order, or NULL
+ */
+bstree_t* bstree_next(bstree_t* node)
+{
+	bstree_t*	p;
+
+	if (node->right != NULL)
+		return leftmost(node->right);
+
+	p = node->parent;
+	while (p != NULL && node == p->right) {
+		node = p;
+		p = p->parent;
+	}
+	return p;
+}
+
 void free_bstree(bstree_t** tree)
 {
 	assert(tree != NULL);
@@ -279,8 +279,246 @@ void free_bstree(bstree_t** tree)
 	*tree = NULL;
 }
 
-static int is_leaf(bstree_t* tree)
+/* Locate the node holding v
+ */
+static bstree_t* find_node(bstree_t* tree, void* v, comparator_t cmp)
+{
+	bstree_t*	p = tree;
+
+	while (p != NULL) {
+		if (p->value == v)
+			return p;
+		p = cmp(v, p->value) ? p->left : p->right;
+	}
+
+	/* values that compare equal may have been rotated to either
+	 * side, fall back to a linear search */
+	for (p = bstree_first(tree); p != NULL; p = bstree_next(p)) {
+		if (p->value == v)
+			return p;
+	}
+	return NULL;
+}
+
+static void rotate_left(bstree_t** tree, bstree_t* x)
+{
+	bstree_t*	y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	if (x->parent == NULL)
+		*tree = y;
+	else if (x == x->parent->left)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+	y->left = x;
+	x->parent = y;
+}
+
+static void rotate_right(bstree_t** tree, bstree_t* x)
+{
+	bstree_t*	y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	if (x->parent == NULL)
+		*tree = y;
+	else if (x == x->parent->right)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+	y->right = x;
+	x->parent = y;
+}
+
+/* Restore the red-black properties after inserting x
+ */
+static void insert_fixup(bstree_t** tree, bstree_t* x)
+{
+	while (is_red(x->parent)) {
+		bstree_t*	p = x->parent;
+		bstree_t*	g = p->parent;/* the root is black */
+		bstree_t*	u;
+
+		if (p == g->left) {
+			u = g->right;
+			if (is_red(u)) {
+				p->red = 0;
+				u->red = 0;
+				g->red = 1;
+				x = g;
+			} else {
+				if (x == p->right) {
+					x = p;
+					rotate_left(tree, x);
+					p = x->parent;
+				}
+				p->red = 0;
+				g->red = 1;
+				rotate_right(tree, g);
+			}
+		} else {
+			u = g->left;
+			if (is_red(u)) {
+				p->red = 0;
+				u->red = 0;
+				g->red = 1;
+				x = g;
+			} else {
+				if (x == p->left) {
+					x = p;
+					rotate_right(tree, x);
+					p = x->parent;
+				}
+				p->red = 0;
+				g->red = 1;
+				rotate_left(tree, g);
+			}
+		}
+	}
+	(*tree)->red = 0;
+}
+
+/* Replace the subtree rooted at u with the subtree rooted at v
+ */
+static void transplant(bstree_t** tree, bstree_t* u, bstree_t* v)
 {
-	return tree->left == NULL && tree->right == NULL;
+	if (u->parent == NULL)
+		*tree = v;
+	else if (u == u->parent->left)
+		u->parent->left = v;
+	else
+		u->parent->right = v;
+	if (v != NULL)
+		v->parent = u->parent;
 }
 
+/* Unlink and free the node z
+ *
+ * Nodes are relinked rather than having their values swapped so that
+ * pointers to the other nodes stay valid.
+ */
+static void delete_node(bstree_t** tree, bstree_t* z)
+{
+	bstree_t*	y = z;
+	bstree_t*	x;
+	bstree_t*	xp;/* parent of x, x may be NULL */
+	int		red = y->red;
+
+	if (z->left == NULL) {
+		x = z->right;
+		xp = z->parent;
+		transplant(tree, z, z->right);
+	} else if (z->right == NULL) {
+		x = z->left;
+		xp = z->parent;
+		transplant(tree, z, z->left);
+	} else {
+		y = leftmost(z->right);
+		red = y->red;
+		x = y->right;
+		if (y->parent == z) {
+			xp = y;
+		} else {
+			xp = y->parent;
+			transplant(tree, y, y->right);
+			y->right = z->right;
+			y->right->parent = y;
+		}
+		transplant(tree, z, y);
+		y->left = z->left;
+		y->left->parent = y;
+		y->red = z->red;
+	}
+	free(z);
+
+	if (!red)
+		delete_fixup(tree, x, xp);
+}
+
+/* Restore the red-black properties after removing a black node
+ */
+static void delete_fixup(bstree_t** tree, bstree_t* x, bstree_t* xp)
+{
+	while (x != *tree && !is_red(x)) {
+		bstree_t*	w;
+
+		if (x == xp->left) {
+			w = xp->right;
+			if (is_red(w)) {
+				w->red = 0;
+				xp->red = 1;
+				rotate_left(tree, xp);
+				w = xp->right;
+			}
+			if (!is_red(w->left) && !is_red(w->right)) {
+				w->red = 1;
+				x = xp;
+				xp = x->parent;
+			} else {
+				if (!is_red(w->right)) {
+					w->left->red = 0;
+					w->red = 1;
+					rotate_right(tree, w);
+					w = xp->right;
+				}
+				w->red = xp->red;
+				xp->red = 0;
+				w->right->red = 0;
+				rotate_left(tree, xp);
+				x = *tree;
+			}
+		} else {
+			w = xp->left;
+			if (is_red(w)) {
+				w->red = 0;
+				xp->red = 1;
+				rotate_right(tree, xp);
+				w = xp->left;
+			}
+			if (!is_red(w->left) && !is_red(w->right)) {
+				w->red = 1;
+				x = xp;
+				xp = x->parent;
+			} else {
+				if (!is_red(w->left)) {
+					w->right->red = 0;
+					w->red = 1;
+					rotate_left(tree, w);
+					w = xp->left;
+				}
+				w->red = xp->red;
+				xp->red = 0;
+				w->left->red = 0;
+				rotate_right(tree, xp);
+				x = *tree;
+			}
+		}
+	}
+	if (x != NULL)
+		x->red = 0;
+}
+
+static bstree_t* leftmost(bstree_t* p)
+{
+	while (p->left != NULL)
+		p = p->left;
+	return p;
+}
+
+static bstree_t* rightmost(bstree_t* p)
+{
+	while (p->right != NULL)
+		p = p->right;
+	return p;
+}
+
+static int is_red(bstree_t* p)
+{
+	return p != NULL && p->red;
+}
@@ -19,6 +19,10 @@
  */
 /*
  * Binary Search Tree
+ *
+ * Red-black tree ordered by a comparator supplied with each operation.
+ * Insertion, removal and the neighbour queries take O(log n) time and
+ * the range query O(k + log n) time for k reported nodes.
  */
 #ifndef CTTF_BSTREE_H
 #define CTTF_BSTREE_H
@@ -35,18 +39,21 @@ void bstree_remove_if(bstree_t** tree, void* v, comparator_t cmp);
 void* bstree_find_left(bstree_t* tree, void* v, comparator_t cmp);
 void* bstree_find_right(bstree_t* tree, void* v, comparator_t cmp);
 void bstree_find_all(bstree_t* tree, void* v, comparator_t cmp, list_t** list);
+void bstree_find_range(bstree_t* tree, void* v, comparator_t left_of,
+		comparator_t right_of, comparator_t match, list_t** list);
+void* bstree_pop(bstree_t** tree);
 unsigned bstree_size(bstree_t* tree);
 
-/* TODO: make red-black tree */
+/* in-order traversal */
+bstree_t* bstree_first(bstree_t* tree);
+bstree_t* bstree_next(bstree_t* node);
+
 struct binary_search_tree {
 	bstree_t*	parent;
-	void*		value;
-	void*		rvalue;
-	void*		min;
-	void*		max;
 	bstree_t*	left;
 	bstree_t*	right;
+	void*		value;
+	int		red;
 };
 
 #endif
-
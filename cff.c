@@ -0,0 +1,1265 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Compact Font Format (CFF) outline loader.
+ *
+ * See the Adobe technical notes #5176 (The Compact Font Format
+ * Specification) and #5177 (The Type 2 Charstring Format).
+ *
+ * Limitations: only Type 2 charstrings are supported, and the load and
+ * store operators of multiple master fonts are not implemented. Seac
+ * style accented characters (endchar with four arguments) are only
+ * composed in fonts with a custom or the ISOAdobe charset.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "cff.h"
+
+#define cff_warn(...) fprintf(stderr, __VA_ARGS__)
+
+#define CFF_MAX_STACK	(48)
+#define CFF_MAX_NESTING	(10)
+#define CFF_MAX_FDS	(256)
+#define CFF_TRANSIENT	(32)
+
+/* DICT operators */
+#define CFF_OP_CHARSET		(15)
+#define CFF_OP_CHARSTRINGS	(17)
+#define CFF_OP_PRIVATE		(18)
+#define CFF_OP_SUBRS		(19)
+#define CFF_OP_CHARSTRINGTYPE	(0x0C06)
+#define CFF_OP_FDARRAY		(0x0C24)
+#define CFF_OP_FDSELECT		(0x0C25)
+
+typedef struct cff_index	cff_index_t;
+typedef struct cff_private	cff_private_t;
+typedef struct cff_decoder	cff_decoder_t;
+
+struct cff_index {
+	const uint8_t*	offsets;
+	const uint8_t*	data;/* one byte before the first object */
+	uint32_t	count;
+	uint32_t	last;/* offset one past the last object */
+	uint32_t	end;/* table offset of the first byte after the index */
+	uint8_t		offsize;
+};
+
+/* local subroutines of a Private DICT */
+struct cff_private {
+	cff_index_t	subrs;
+	int		bias;
+};
+
+/* Type 2 charstring interpreter state */
+struct cff_decoder {
+	cff_index_t*	gsubrs;
+	int		gbias;
+	cff_private_t*	priv;
+	cff_index_t*	charstrings;/* for seac */
+	uint16_t*	charset;/* string ID of each glyph */
+	uint16_t	nglyphs;
+	float		stack[CFF_MAX_STACK];
+	int		sp;
+	float		transient[CFF_TRANSIENT];
+	uint32_t	seed;/* for the random operator */
+	int		nstems;
+	int		have_width;
+	int		done;
+	int		open;/* a contour has been started */
+	float		x;
+	float		y;
+
+	/* the decoded outline */
+	float*		px;
+	float*		py;
+	int*		state;
+	int		npoints;
+	int		maxpoints;
+	uint16_t*	endpoints;
+	int		ncontours;
+	int		maxcontours;
+	int		start;/* first point of the current contour */
+};
+
+static uint32_t cff_read(const uint8_t* p, int n);
+static int cff_read_index(const uint8_t* buf, uint32_t len,
+		uint32_t offset, cff_index_t* idx);
+static const uint8_t* cff_index_get(cff_index_t* idx, uint32_t i,
+		uint32_t* size);
+static int cff_dict_get(const uint8_t* p, uint32_t size, int op,
+		float* operands, int max);
+static int cff_load_private(const uint8_t* buf, uint32_t len,
+		const uint8_t* dict, uint32_t size, cff_private_t* priv);
+static int cff_load_fdselect(const uint8_t* buf, uint32_t len,
+		uint32_t offset, uint8_t* fds, uint16_t nglyphs, int nfds);
+static int cff_load_charset(const uint8_t* buf, uint32_t len,
+		uint32_t offset, uint16_t* charset, uint16_t nglyphs);
+static int cff_subr_bias(uint32_t count);
+static int16_t cff_round(float v);
+static int cff_run(cff_decoder_t* dec, const uint8_t* p, uint32_t size,
+		int depth);
+static int cff_seac(cff_decoder_t* dec, float adx, float ady, int bchar,
+		int achar, int depth);
+static void cff_width(cff_decoder_t* dec, int extra);
+static void cff_add_point(cff_decoder_t* dec, float x, float y, int state);
+static void cff_moveto(cff_decoder_t* dec, float dx, float dy);
+static void cff_lineto(cff_decoder_t* dec, float dx, float dy);
+static void cff_curveto(cff_decoder_t* dec, float dx1, float dy1,
+		float dx2, float dy2, float dx3, float dy3);
+static void cff_close_contour(cff_decoder_t* dec);
+static void cff_store_glyph(ttf_t* ttf, cff_decoder_t* dec,
+		ttf_glyph_data_t* gd, uint16_t i);
+
+/* String IDs of the glyphs in the Standard Encoding, indexed by
+ * character code */
+static const uint8_t cff_std_encoding[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+	17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+	33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+	49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64,
+	65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80,
+	81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110,
+	0, 111, 112, 113, 114, 0, 115, 116, 117, 118, 119, 120, 121, 122, 0, 123,
+	0, 124, 125, 126, 127, 128, 129, 130, 131, 0, 132, 133, 0, 134, 135, 136,
+	137, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 138, 0, 139, 0, 0, 0, 0, 140, 141, 142, 143, 0, 0, 0, 0,
+	0, 144, 0, 0, 0, 145, 0, 0, 146, 147, 148, 149, 0, 0, 0, 0
+};
+
+int cff_load(FILE* file, ttf_t* ttf)
+{
+	uint8_t*	buf;
+	uint32_t	len = ttf->cff->length;
+	cff_index_t	names;
+	cff_index_t	topdicts;
+	cff_index_t	strings;
+	cff_index_t	gsubrs;
+	cff_index_t	charstrings;
+	cff_private_t*	privs = NULL;
+	uint8_t*	fds = NULL;
+	uint16_t*	charset = NULL;
+	int		nfds = 1;
+	cff_decoder_t	dec;
+	const uint8_t*	top;
+	uint32_t	topsize;
+	float		operands[2];
+	int		i;
+
+	if (-1 == fseek(file, ttf->cff->offset, SEEK_SET))
+		return 1;
+
+	buf = malloc(len ? len : 1);
+	if (len < 4 || 1 != fread(buf, len, 1, file)) {
+		free(buf);
+		return 1;
+	}
+
+	if (buf[0] != 1) {
+		cff_warn("Warning: unexpected CFF major version (%d)\n",
+				buf[0]);
+	}
+
+	if (cff_read_index(buf, len, buf[2], &names) ||
+			cff_read_index(buf, len, names.end, &topdicts) ||
+			cff_read_index(buf, len, topdicts.end, &strings) ||
+			cff_read_index(buf, len, strings.end, &gsubrs))
+		goto err;
+
+	top = cff_index_get(&topdicts, 0, &topsize);
+	if (!top)
+		goto err;
+
+	if (cff_dict_get(top, topsize, CFF_OP_CHARSTRINGTYPE, operands, 1)
+			&& operands[0] != 2) {
+		cff_warn("Unsupported charstring type: %d\n",
+				(int) operands[0]);
+		goto err;
+	}
+
+	if (!cff_dict_get(top, topsize, CFF_OP_CHARSTRINGS, operands, 1) ||
+			cff_read_index(buf, len, (uint32_t) operands[0],
+				&charstrings))
+		goto err;
+
+	if (cff_dict_get(top, topsize, CFF_OP_FDARRAY, operands, 1)) {
+		/* CID-keyed font: each glyph selects a Font DICT */
+		cff_index_t	fdarray;
+
+		if (cff_read_index(buf, len, (uint32_t) operands[0], &fdarray)
+				|| fdarray.count == 0)
+			goto err;
+		nfds = fdarray.count < CFF_MAX_FDS ?
+			fdarray.count : CFF_MAX_FDS;
+		privs = malloc(sizeof(cff_private_t) * nfds);
+		for (i = 0; i < nfds; ++i) {
+			uint32_t	size;
+			const uint8_t*	fd = cff_index_get(&fdarray, i, &size);
+			if (!fd || cff_load_private(buf, len, fd, size,
+						&privs[i]))
+				goto err;
+		}
+
+		fds = calloc(ttf->nglyphs + 1, sizeof(uint8_t));
+		if (cff_dict_get(top, topsize, CFF_OP_FDSELECT, operands, 1)
+				&& cff_load_fdselect(buf, len,
+					(uint32_t) operands[0], fds,
+					ttf->nglyphs, nfds))
+			goto err;
+	} else {
+		privs = malloc(sizeof(cff_private_t));
+		if (cff_load_private(buf, len, top, topsize, &privs[0]))
+			goto err;
+
+		/* seac finds its components through the charset, which
+		 * in a CID-keyed font holds CIDs instead of strings */
+		charset = calloc(ttf->nglyphs + 1, sizeof(uint16_t));
+		if (!cff_dict_get(top, topsize, CFF_OP_CHARSET, operands, 1))
+			operands[0] = 0;
+		if (cff_load_charset(buf, len, (uint32_t) operands[0],
+					charset, ttf->nglyphs)) {
+			cff_warn("Warning: invalid CFF charset\n");
+			free(charset);
+			charset = NULL;
+		}
+	}
+
+	if (charstrings.count != ttf->nglyphs) {
+		cff_warn("Warning: CFF glyph count (%d) does not match "
+				"maxp (%d)\n", charstrings.count,
+				ttf->nglyphs);
+	}
+
+	dec.gsubrs = &gsubrs;
+	dec.gbias = cff_subr_bias(gsubrs.count);
+	dec.charstrings = &charstrings;
+	dec.charset = charset;
+	dec.nglyphs = ttf->nglyphs < charstrings.count ?
+		ttf->nglyphs : charstrings.count;
+	dec.seed = 0;
+	dec.maxpoints = 64;
+	dec.px = malloc(sizeof(float) * dec.maxpoints);
+	dec.py = malloc(sizeof(float) * dec.maxpoints);
+	dec.state = malloc(sizeof(int) * dec.maxpoints);
+	dec.maxcontours = 8;
+	dec.endpoints = malloc(sizeof(uint16_t) * dec.maxcontours);
+
+	ttf->glyph_data = malloc(sizeof(ttf_glyph_data_t) * ttf->nglyphs);
+	for (i = 0; i < ttf->nglyphs; ++i) {
+		const uint8_t*	cs;
+		uint32_t	size;
+
+		dec.priv = &privs[fds ? fds[i] : 0];
+		dec.sp = 0;
+		memset(dec.transient, 0, sizeof(dec.transient));
+		dec.nstems = 0;
+		dec.have_width = 0;
+		dec.done = 0;
+		dec.open = 0;
+		dec.x = 0;
+		dec.y = 0;
+		dec.npoints = 0;
+		dec.ncontours = 0;
+		dec.start = 0;
+
+		cs = cff_index_get(&charstrings, i, &size);
+		if (cs && cff_run(&dec, cs, size, 0)) {
+			cff_warn("Warning: invalid charstring for glyph %d\n",
+					i);
+			dec.npoints = 0;
+			dec.ncontours = 0;
+			dec.open = 0;
+		}
+		cff_close_contour(&dec);
+		cff_store_glyph(ttf, &dec, &ttf->glyph_data[i], i);
+	}
+
+	free(dec.px);
+	free(dec.py);
+	free(dec.state);
+	free(dec.endpoints);
+	free(privs);
+	free(fds);
+	free(charset);
+	free(buf);
+	return 0;
+
+err:
+	free(privs);
+	free(fds);
+	free(charset);
+	free(buf);
+	return 1;
+}
+
+/* Read a big endian number of n bytes
+ */
+static uint32_t cff_read(const uint8_t* p, int n)
+{
+	uint32_t	v = 0;
+	int		i;
+
+	for (i = 0; i < n; ++i)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+/* Read the header of an INDEX at the given table offset
+ *
+ * Returns 1 on error
+ */
+static int cff_read_index(const uint8_t* buf, uint32_t len,
+		uint32_t offset, cff_index_t* idx)
+{
+	uint32_t	datastart;
+
+	if (offset > len || len - offset < 2)
+		return 1;
+
+	idx->count = cff_read(buf+offset, 2);
+	if (idx->count == 0) {
+		idx->offsets = NULL;
+		idx->data = NULL;
+		idx->offsize = 0;
+		idx->last = 0;
+		idx->end = offset + 2;
+		return 0;
+	}
+
+	if (len - offset < 3)
+		return 1;
+
+	idx->offsize = buf[offset+2];
+	if (idx->offsize < 1 || idx->offsize > 4)
+		return 1;
+
+	datastart = offset + 3 + (idx->count+1) * idx->offsize;
+	if (datastart > len)
+		return 1;
+
+	idx->offsets = buf + offset + 3;
+	idx->data = buf + datastart - 1;
+	idx->last = cff_read(idx->offsets + idx->count * idx->offsize,
+			idx->offsize);
+	if (idx->last < 1 || idx->last - 1 > len - datastart)
+		return 1;
+
+	idx->end = datastart + idx->last - 1;
+	return 0;
+}
+
+/* Returns object i of an INDEX, or NULL if it does not exist
+ */
+static const uint8_t* cff_index_get(cff_index_t* idx, uint32_t i,
+		uint32_t* size)
+{
+	uint32_t	start;
+	uint32_t	end;
+
+	if (i >= idx->count)
+		return NULL;
+
+	start = cff_read(idx->offsets + i * idx->offsize, idx->offsize);
+	end = cff_read(idx->offsets + (i+1) * idx->offsize, idx->offsize);
+	if (start < 1 || end < start || end > idx->last)
+		return NULL;
+
+	*size = end - start;
+	return idx->data + start;
+}
+
+/* Look up the operands of a DICT operator
+ * Escaped operators are given as 0x0C00 | op
+ *
+ * Returns the number of operands, or 0 if the operator was not found
+ */
+static int cff_dict_get(const uint8_t* p, uint32_t size, int op,
+		float* operands, int max)
+{
+	const uint8_t*	end = p + size;
+	float		stack[CFF_MAX_STACK];
+	int		sp = 0;
+
+	while (p < end) {
+		int	b0 = *p++;
+
+		if (b0 <= 21) {
+			int	i;
+
+			if (b0 == 12) {
+				if (p >= end)
+					return 0;
+				b0 = 0x0C00 | *p++;
+			}
+			if (b0 == op) {
+				for (i = 0; i < sp && i < max; ++i)
+					operands[i] = stack[i];
+				return sp;
+			}
+			sp = 0;
+			continue;
+		}
+
+		if (sp == CFF_MAX_STACK)
+			return 0;
+
+		if (b0 == 28) {
+			if (end - p < 2) return 0;
+			stack[sp++] = (int16_t) cff_read(p, 2);
+			p += 2;
+		} else if (b0 == 29) {
+			if (end - p < 4) return 0;
+			stack[sp++] = (int32_t) cff_read(p, 4);
+			p += 4;
+		} else if (b0 == 30) {
+			/* real number: packed BCD nibbles */
+			char	str[64];
+			int	n = 0;
+			int	stop = 0;
+
+			while (!stop && p < end) {
+				int	k;
+				for (k = 0; k < 2 && !stop; ++k) {
+					int	nib = k ? (*p & 0xF) : (*p >> 4);
+					if (n > (int) sizeof(str) - 3)
+						nib = 0xF;
+					if (nib <= 9) str[n++] = '0' + nib;
+					else if (nib == 0xA) str[n++] = '.';
+					else if (nib == 0xB) str[n++] = 'E';
+					else if (nib == 0xC) {
+						str[n++] = 'E';
+						str[n++] = '-';
+					} else if (nib == 0xE) str[n++] = '-';
+					else if (nib == 0xF) stop = 1;
+				}
+				p += 1;
+			}
+			str[n] = '\0';
+			stack[sp++] = (float) strtod(str, NULL);
+		} else if (b0 >= 32 && b0 <= 246) {
+			stack[sp++] = b0 - 139;
+		} else if (b0 >= 247 && b0 <= 250) {
+			if (p >= end) return 0;
+			stack[sp++] = (b0 - 247) * 256 + *p++ + 108;
+		} else if (b0 >= 251 && b0 <= 254) {
+			if (p >= end) return 0;
+			stack[sp++] = -(b0 - 251) * 256 - *p++ - 108;
+		} else {
+			/* reserved */
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/* Load the local subroutines of the Private DICT referenced
+ * by a Top DICT or Font DICT
+ *
+ * Returns 1 on error
+ */
+static int cff_load_private(const uint8_t* buf, uint32_t len,
+		const uint8_t* dict, uint32_t size, cff_private_t* priv)
+{
+	float		operands[2];
+	uint32_t	psize;
+	uint32_t	poffset;
+
+	priv->subrs.count = 0;
+	priv->bias = 0;
+
+	if (2 != cff_dict_get(dict, size, CFF_OP_PRIVATE, operands, 2))
+		return 0;
+
+	psize = (uint32_t) operands[0];
+	poffset = (uint32_t) operands[1];
+	if (poffset > len || psize > len - poffset)
+		return 1;
+
+	if (cff_dict_get(buf + poffset, psize, CFF_OP_SUBRS, operands, 1)) {
+		if (cff_read_index(buf, len, poffset + (uint32_t) operands[0],
+					&priv->subrs))
+			return 1;
+		priv->bias = cff_subr_bias(priv->subrs.count);
+	}
+	return 0;
+}
+
+/* Read the FDSelect table mapping glyphs to Font DICTs
+ *
+ * Returns 1 on error
+ */
+static int cff_load_fdselect(const uint8_t* buf, uint32_t len,
+		uint32_t offset, uint8_t* fds, uint16_t nglyphs, int nfds)
+{
+	int	i;
+
+	if (offset >= len)
+		return 1;
+
+	if (buf[offset] == 0) {
+		if (len - offset - 1 < nglyphs)
+			return 1;
+		for (i = 0; i < nglyphs; ++i)
+			fds[i] = buf[offset + 1 + i];
+	} else if (buf[offset] == 3) {
+		uint32_t	nranges;
+		uint32_t	r;
+
+		if (len - offset < 3)
+			return 1;
+		nranges = cff_read(buf + offset + 1, 2);
+		if (len - offset - 3 < nranges*3 + 2)
+			return 1;
+		for (r = 0; r < nranges; ++r) {
+			const uint8_t*	range = buf + offset + 3 + r*3;
+			uint32_t	first = cff_read(range, 2);
+			uint32_t	last = cff_read(range + 3, 2);
+			uint32_t	g;
+
+			for (g = first; g < last && g < nglyphs; ++g)
+				fds[g] = range[2];
+		}
+	} else {
+		cff_warn("Warning: unsupported FDSelect format (%d)\n",
+				buf[offset]);
+		return 1;
+	}
+
+	for (i = 0; i < nglyphs; ++i)
+		if (fds[i] >= nfds)
+			fds[i] = 0;
+	return 0;
+}
+
+/* Read the string ID of each glyph from the charset at offset, which
+ * is 0 for the predefined ISOAdobe charset. The predefined expert
+ * charsets (1 and 2) have no glyphs from the Standard Encoding and
+ * are left out.
+ *
+ * Returns 1 on error
+ */
+static int cff_load_charset(const uint8_t* buf, uint32_t len,
+		uint32_t offset, uint16_t* charset, uint16_t nglyphs)
+{
+	uint32_t	pos = offset + 1;
+	uint32_t	gid = 1;
+
+	if (offset == 0) {
+		for (gid = 0; gid < nglyphs; ++gid)
+			charset[gid] = gid;
+		return 0;
+	}
+	if (offset <= 2)
+		return 0;
+	if (offset >= len)
+		return 1;
+
+	switch (buf[offset]) {
+	case 0:
+		for (; gid < nglyphs; ++gid, pos += 2) {
+			if (pos + 2 > len)
+				return 1;
+			charset[gid] = cff_read(buf + pos, 2);
+		}
+		return 0;
+
+	case 1:
+	case 2:
+	{
+		/* ranges of consecutive string IDs */
+		int	size = buf[offset];
+
+		while (gid < nglyphs) {
+			uint32_t	first;
+			uint32_t	left;
+			uint32_t	k;
+
+			if (pos + 2 + size > len)
+				return 1;
+			first = cff_read(buf + pos, 2);
+			left = cff_read(buf + pos + 2, size);
+			pos += 2 + size;
+			for (k = 0; k <= left && gid < nglyphs; ++k)
+				charset[gid++] = first + k;
+		}
+		return 0;
+	}
+
+	default:
+		return 1;
+	}
+}
+
+static int cff_subr_bias(uint32_t count)
+{
+	if (count < 1240)
+		return 107;
+	else if (count < 33900)
+		return 1131;
+	else
+		return 32768;
+}
+
+/* Interpret a Type 2 charstring
+ *
+ * Returns 1 on error
+ */
+static int cff_run(cff_decoder_t* dec, const uint8_t* p, uint32_t size,
+		int depth)
+{
+	const uint8_t*	end = p + size;
+	float*		a = dec->stack;
+
+	if (depth > CFF_MAX_NESTING)
+		return 1;
+
+	while (p < end && !dec->done) {
+		int	b0 = *p++;
+		int	i;
+
+		if (b0 == 28 || b0 >= 32) {
+			float	v;
+
+			if (b0 == 28) {
+				if (end - p < 2) return 1;
+				v = (int16_t) cff_read(p, 2);
+				p += 2;
+			} else if (b0 <= 246) {
+				v = b0 - 139;
+			} else if (b0 <= 250) {
+				if (p >= end) return 1;
+				v = (b0 - 247) * 256 + *p++ + 108;
+			} else if (b0 <= 254) {
+				if (p >= end) return 1;
+				v = -(b0 - 251) * 256 - *p++ - 108;
+			} else {
+				/* 16.16 fixed point */
+				if (end - p < 4) return 1;
+				v = (int32_t) cff_read(p, 4) / 65536.f;
+				p += 4;
+			}
+			if (dec->sp == CFF_MAX_STACK)
+				return 1;
+			a[dec->sp++] = v;
+			continue;
+		}
+
+		switch (b0) {
+		case 1:/* hstem */
+		case 3:/* vstem */
+		case 18:/* hstemhm */
+		case 23:/* vstemhm */
+			cff_width(dec, dec->sp & 1);
+			dec->nstems += dec->sp / 2;
+			break;
+
+		case 19:/* hintmask */
+		case 20:/* cntrmask */
+			/* the arguments are an implicit vstemhm */
+			cff_width(dec, dec->sp & 1);
+			dec->nstems += dec->sp / 2;
+			if (end - p < (dec->nstems + 7) / 8)
+				return 1;
+			p += (dec->nstems + 7) / 8;
+			break;
+
+		case 21:/* rmoveto */
+			cff_width(dec, dec->sp > 2);
+			if (dec->sp < 2) return 1;
+			cff_moveto(dec, a[0], a[1]);
+			break;
+
+		case 22:/* hmoveto */
+			cff_width(dec, dec->sp > 1);
+			if (dec->sp < 1) return 1;
+			cff_moveto(dec, a[0], 0);
+			break;
+
+		case 4:/* vmoveto */
+			cff_width(dec, dec->sp > 1);
+			if (dec->sp < 1) return 1;
+			cff_moveto(dec, 0, a[0]);
+			break;
+
+		case 5:/* rlineto */
+			for (i = 0; i+2 <= dec->sp; i += 2)
+				cff_lineto(dec, a[i], a[i+1]);
+			break;
+
+		case 6:/* hlineto */
+		case 7:/* vlineto */
+			for (i = 0; i < dec->sp; ++i) {
+				if ((i & 1) == (b0 == 7))
+					cff_lineto(dec, a[i], 0);
+				else
+					cff_lineto(dec, 0, a[i]);
+			}
+			break;
+
+		case 8:/* rrcurveto */
+			for (i = 0; i+6 <= dec->sp; i += 6)
+				cff_curveto(dec, a[i], a[i+1], a[i+2],
+						a[i+3], a[i+4], a[i+5]);
+			break;
+
+		case 24:/* rcurveline */
+			for (i = 0; i+6 <= dec->sp-2; i += 6)
+				cff_curveto(dec, a[i], a[i+1], a[i+2],
+						a[i+3], a[i+4], a[i+5]);
+			if (i+2 <= dec->sp)
+				cff_lineto(dec, a[i], a[i+1]);
+			break;
+
+		case 25:/* rlinecurve */
+			for (i = 0; i+2 <= dec->sp-6; i += 2)
+				cff_lineto(dec, a[i], a[i+1]);
+			if (i+6 <= dec->sp)
+				cff_curveto(dec, a[i], a[i+1], a[i+2],
+						a[i+3], a[i+4], a[i+5]);
+			break;
+
+		case 26:/* vvcurveto */
+			i = 0;
+			if (dec->sp & 1) {
+				if (dec->sp < 5) return 1;
+				cff_curveto(dec, a[0], a[1], a[2], a[3],
+						0, a[4]);
+				i = 5;
+			}
+			for (; i+4 <= dec->sp; i += 4)
+				cff_curveto(dec, 0, a[i], a[i+1], a[i+2],
+						0, a[i+3]);
+			break;
+
+		case 27:/* hhcurveto */
+			i = 0;
+			if (dec->sp & 1) {
+				if (dec->sp < 5) return 1;
+				cff_curveto(dec, a[1], a[0], a[2], a[3],
+						a[4], 0);
+				i = 5;
+			}
+			for (; i+4 <= dec->sp; i += 4)
+				cff_curveto(dec, a[i], 0, a[i+1], a[i+2],
+						a[i+3], 0);
+			break;
+
+		case 30:/* vhcurveto */
+		case 31:/* hvcurveto */
+		{
+			/* alternate between starting horizontally
+			 * and vertically */
+			int	horizontal = (b0 == 31);
+
+			for (i = 0; i+4 <= dec->sp; i += 4) {
+				float	last = (i+5 == dec->sp) ? a[i+4] : 0;
+
+				if (horizontal)
+					cff_curveto(dec, a[i], 0, a[i+1],
+							a[i+2], last, a[i+3]);
+				else
+					cff_curveto(dec, 0, a[i], a[i+1],
+							a[i+2], a[i+3], last);
+				horizontal = !horizontal;
+			}
+			break;
+		}
+
+		case 10:/* callsubr */
+		case 29:/* callgsubr */
+		{
+			cff_index_t*	subrs;
+			const uint8_t*	subr;
+			uint32_t	subrsize;
+			int		index;
+
+			if (dec->sp < 1) return 1;
+			if (b0 == 10) {
+				subrs = &dec->priv->subrs;
+				index = (int) a[--dec->sp] + dec->priv->bias;
+			} else {
+				subrs = dec->gsubrs;
+				index = (int) a[--dec->sp] + dec->gbias;
+			}
+			if (index < 0)
+				return 1;
+			subr = cff_index_get(subrs, index, &subrsize);
+			if (!subr || cff_run(dec, subr, subrsize, depth+1))
+				return 1;
+			continue;
+		}
+
+		case 11:/* return */
+			return 0;
+
+		case 14:/* endchar */
+			cff_width(dec, dec->sp == 1 || dec->sp == 5);
+			if (dec->sp == 4 && cff_seac(dec, a[0], a[1],
+						(int) a[2], (int) a[3], depth))
+				return 1;
+			cff_close_contour(dec);
+			dec->done = 1;
+			break;
+
+		case 12:
+		{
+			int	b1;
+
+			if (p >= end) return 1;
+			b1 = *p++;
+			switch (b1) {
+			case 35:/* flex */
+				if (dec->sp < 13) return 1;
+				cff_curveto(dec, a[0], a[1], a[2], a[3],
+						a[4], a[5]);
+				cff_curveto(dec, a[6], a[7], a[8], a[9],
+						a[10], a[11]);
+				break;
+
+			case 34:/* hflex */
+				if (dec->sp < 7) return 1;
+				cff_curveto(dec, a[0], 0, a[1], a[2],
+						a[3], 0);
+				cff_curveto(dec, a[4], 0, a[5], -a[2],
+						a[6], 0);
+				break;
+
+			case 36:/* hflex1 */
+				if (dec->sp < 9) return 1;
+				cff_curveto(dec, a[0], a[1], a[2], a[3],
+						a[4], 0);
+				cff_curveto(dec, a[5], 0, a[6], a[7],
+						a[8], -(a[1] + a[3] + a[7]));
+				break;
+
+			case 37:/* flex1 */
+			{
+				float	dx = 0;
+				float	dy = 0;
+
+				if (dec->sp < 11) return 1;
+				for (i = 0; i < 10; i += 2) {
+					dx += a[i];
+					dy += a[i+1];
+				}
+				cff_curveto(dec, a[0], a[1], a[2], a[3],
+						a[4], a[5]);
+				if ((dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy))
+					cff_curveto(dec, a[6], a[7], a[8],
+							a[9], a[10], -dy);
+				else
+					cff_curveto(dec, a[6], a[7], a[8],
+							a[9], -dx, a[10]);
+				break;
+			}
+
+			case 0:/* dotsection, deprecated and ignored */
+				break;
+
+			/* the arithmetic and storage operators replace
+			 * their arguments and keep the rest of the stack */
+			case 3:/* and */
+			case 4:/* or */
+			case 10:/* add */
+			case 11:/* sub */
+			case 12:/* div */
+			case 15:/* eq */
+			case 24:/* mul */
+			{
+				float	x;
+				float	y;
+
+				if (dec->sp < 2) return 1;
+				x = a[dec->sp-2];
+				y = a[dec->sp-1];
+				switch (b1) {
+				case 3: x = (x != 0 && y != 0); break;
+				case 4: x = (x != 0 || y != 0); break;
+				case 10: x += y; break;
+				case 11: x -= y; break;
+				case 12:
+					if (y == 0) return 1;
+					x /= y;
+					break;
+				case 15: x = (x == y); break;
+				default: x *= y; break;
+				}
+				dec->sp -= 1;
+				a[dec->sp-1] = x;
+				continue;
+			}
+
+			case 5:/* not */
+			case 9:/* abs */
+			case 14:/* neg */
+			case 26:/* sqrt */
+			{
+				float	x;
+
+				if (dec->sp < 1) return 1;
+				x = a[dec->sp-1];
+				switch (b1) {
+				case 5: x = (x == 0); break;
+				case 9: x = x < 0 ? -x : x; break;
+				case 14: x = -x; break;
+				default:
+					if (x < 0) return 1;
+					x = sqrtf(x);
+					break;
+				}
+				a[dec->sp-1] = x;
+				continue;
+			}
+
+			case 18:/* drop */
+				if (dec->sp < 1) return 1;
+				dec->sp -= 1;
+				continue;
+
+			case 27:/* dup */
+				if (dec->sp < 1 || dec->sp == CFF_MAX_STACK)
+					return 1;
+				a[dec->sp] = a[dec->sp-1];
+				dec->sp += 1;
+				continue;
+
+			case 28:/* exch */
+			{
+				float	x;
+
+				if (dec->sp < 2) return 1;
+				x = a[dec->sp-1];
+				a[dec->sp-1] = a[dec->sp-2];
+				a[dec->sp-2] = x;
+				continue;
+			}
+
+			case 29:/* index */
+				if (dec->sp < 2) return 1;
+				/* a negative index copies the top element */
+				i = a[dec->sp-1] < 0 ? 0 : (int) a[dec->sp-1];
+				if (i > dec->sp - 2) return 1;
+				a[dec->sp-1] = a[dec->sp-2-i];
+				continue;
+
+			case 30:/* roll */
+			{
+				float	rolled[CFF_MAX_STACK];
+				int	n;
+				int	j;
+
+				if (dec->sp < 2) return 1;
+				n = (int) a[dec->sp-2];
+				j = (int) a[dec->sp-1];
+				dec->sp -= 2;
+				if (n < 0 || n > dec->sp) return 1;
+				if (n == 0)
+					continue;
+				/* positive amounts move elements up */
+				j %= n;
+				if (j < 0) j += n;
+				for (i = 0; i < n; ++i)
+					rolled[(i + j) % n] = a[dec->sp - n + i];
+				memcpy(a + dec->sp - n, rolled, sizeof(float) * n);
+				continue;
+			}
+
+			case 20:/* put */
+				if (dec->sp < 2) return 1;
+				i = (int) a[dec->sp-1];
+				if (i < 0 || i >= CFF_TRANSIENT) return 1;
+				dec->transient[i] = a[dec->sp-2];
+				dec->sp -= 2;
+				continue;
+
+			case 21:/* get */
+				if (dec->sp < 1) return 1;
+				i = (int) a[dec->sp-1];
+				if (i < 0 || i >= CFF_TRANSIENT) return 1;
+				a[dec->sp-1] = dec->transient[i];
+				continue;
+
+			case 22:/* ifelse */
+				if (dec->sp < 4) return 1;
+				if (a[dec->sp-2] > a[dec->sp-1])
+					a[dec->sp-4] = a[dec->sp-3];
+				dec->sp -= 3;
+				continue;
+
+			case 23:/* random, in (0, 1] */
+				if (dec->sp == CFF_MAX_STACK) return 1;
+				dec->seed = dec->seed * 1103515245 + 12345;
+				a[dec->sp++] = (((dec->seed >> 16) & 0x7FFF) + 1) /
+					32768.f;
+				continue;
+
+			default:
+				cff_warn("Warning: unsupported charstring "
+						"operator 12 %d\n", b1);
+				return 1;
+			}
+			break;
+		}
+
+		default:
+			/* reserved operator */
+			return 1;
+		}
+
+		/* all other operators clear the stack */
+		dec->sp = 0;
+	}
+	return 0;
+}
+
+/* Compose a seac style accented character from a base and an accent
+ * glyph, given by their codes in the Standard Encoding. The accent is
+ * moved by (adx, ady) relative to the origin of the base.
+ *
+ * Returns 1 on error
+ */
+static int cff_seac(cff_decoder_t* dec, float adx, float ady, int bchar,
+		int achar, int depth)
+{
+	int	codes[2];
+	int	k;
+
+	codes[0] = bchar;
+	codes[1] = achar;
+	for (k = 0; k < 2; ++k) {
+		const uint8_t*	cs;
+		uint32_t	size;
+		uint16_t	sid;
+		int		gid;
+
+		if (!dec->charset || codes[k] < 0 || codes[k] > 255)
+			return 1;
+		sid = cff_std_encoding[codes[k]];
+		for (gid = 0; gid < dec->nglyphs; ++gid) {
+			if (dec->charset[gid] == sid)
+				break;
+		}
+		if (sid == 0 || gid == dec->nglyphs)
+			return 1;
+		cs = cff_index_get(dec->charstrings, gid, &size);
+		if (!cs)
+			return 1;
+
+		/* each component has its own width and hints */
+		cff_close_contour(dec);
+		dec->x = k ? adx : 0;
+		dec->y = k ? ady : 0;
+		dec->sp = 0;
+		dec->nstems = 0;
+		dec->have_width = 0;
+		dec->done = 0;
+		if (cff_run(dec, cs, size, depth+1))
+			return 1;
+	}
+	return 0;
+}
+
+/* The advance width is given as an extra first argument to
+ * the first stack clearing operator. It is not needed since the
+ * 'hmtx' table has the same information, so it is just dropped.
+ */
+static void cff_width(cff_decoder_t* dec, int extra)
+{
+	if (dec->have_width)
+		return;
+
+	dec->have_width = 1;
+	if (extra && dec->sp > 0) {
+		memmove(dec->stack, dec->stack+1,
+				sizeof(float) * (dec->sp-1));
+		dec->sp -= 1;
+	}
+}
+
+/* Round to the nearest font unit
+ */
+static int16_t cff_round(float v)
+{
+	if (v < 0)
+		return (int16_t) -(int) (-v + .5f);
+	else
+		return (int16_t) (int) (v + .5f);
+}
+
+static void cff_add_point(cff_decoder_t* dec, float x, float y, int state)
+{
+	if (dec->npoints == dec->maxpoints) {
+		dec->maxpoints *= 2;
+		dec->px = realloc(dec->px, sizeof(float) * dec->maxpoints);
+		dec->py = realloc(dec->py, sizeof(float) * dec->maxpoints);
+		dec->state = realloc(dec->state,
+				sizeof(int) * dec->maxpoints);
+	}
+	dec->px[dec->npoints] = x;
+	dec->py[dec->npoints] = y;
+	dec->state[dec->npoints] = state;
+	dec->npoints += 1;
+}
+
+static void cff_moveto(cff_decoder_t* dec, float dx, float dy)
+{
+	cff_close_contour(dec);
+	dec->x += dx;
+	dec->y += dy;
+	dec->open = 1;
+	cff_add_point(dec, dec->x, dec->y, 1);
+}
+
+static void cff_lineto(cff_decoder_t* dec, float dx, float dy)
+{
+	int	last;
+
+	if (!dec->open)
+		cff_moveto(dec, 0, 0);
+
+	last = dec->npoints - 1;
+	dec->x += dx;
+	dec->y += dy;
+
+	/* skip zero length lines */
+	if (cff_round(dec->x) == cff_round(dec->px[last]) &&
+			cff_round(dec->y) == cff_round(dec->py[last]))
+		return;
+
+	cff_add_point(dec, dec->x, dec->y, 1);
+}
+
+static void cff_curveto(cff_decoder_t* dec, float dx1, float dy1,
+		float dx2, float dy2, float dx3, float dy3)
+{
+	if (!dec->open)
+		cff_moveto(dec, 0, 0);
+
+	dec->x += dx1;
+	dec->y += dy1;
+	cff_add_point(dec, dec->x, dec->y, TTF_CUBIC);
+	dec->x += dx2;
+	dec->y += dy2;
+	cff_add_point(dec, dec->x, dec->y, TTF_CUBIC);
+	dec->x += dx3;
+	dec->y += dy3;
+	cff_add_point(dec, dec->x, dec->y, 1);
+}
+
+/* Contours are closed implicitly. A closing point that coincides
+ * with the first point is removed, and degenerate contours with
+ * less than three points are dropped.
+ */
+static void cff_close_contour(cff_decoder_t* dec)
+{
+	int	first = dec->start;
+	int	last = dec->npoints - 1;
+
+	if (!dec->open)
+		return;
+	dec->open = 0;
+
+	if (last > first && dec->state[last] == 1 &&
+			cff_round(dec->px[last]) ==
+			cff_round(dec->px[first]) &&
+			cff_round(dec->py[last]) ==
+			cff_round(dec->py[first])) {
+		dec->npoints -= 1;
+	}
+
+	if (dec->npoints - first < 3) {
+		dec->npoints = first;
+		return;
+	}
+
+	if (dec->ncontours == dec->maxcontours) {
+		dec->maxcontours *= 2;
+		dec->endpoints = realloc(dec->endpoints,
+				sizeof(uint16_t) * dec->maxcontours);
+	}
+	dec->endpoints[dec->ncontours++] = dec->npoints - 1;
+	dec->start = dec->npoints;
+}
+
+/* Copy the decoded outline to the glyph data structure
+ */
+static void cff_store_glyph(ttf_t* ttf, cff_decoder_t* dec,
+		ttf_glyph_data_t* gd, uint16_t i)
+{
+	ttf_glyph_header_t	gh;
+	int			j;
+
+	gh.number_of_contours = dec->ncontours;
+	gh.xmin = gh.xmax = gh.ymin = gh.ymax = 0;
+
+	if (dec->ncontours == 0 || dec->ncontours > 0xFF ||
+			dec->npoints > 0xFFFF) {
+		gd->npoints = 0;
+		gd->endpoints = NULL;
+		gd->ncontours = 0;
+		gd->px = NULL;
+		gd->py = NULL;
+		gd->state = NULL;
+		gd->composite = 0;
+		gd->components = NULL;
+		gd->ncomponents = 0;
+		gd->instructions = NULL;
+		gd->ninstructions = 0;
+		ttf_set_ls_aw(ttf, &gh, gd, i);
+		gd->lsb = 0;
+		return;
+	}
+
+	gd->npoints = dec->npoints;
+	gd->ncontours = dec->ncontours;
+	gd->composite = 0;
+	gd->components = NULL;
+	gd->ncomponents = 0;
+	gd->instructions = NULL;
+	gd->ninstructions = 0;
+	gd->px = malloc(sizeof(int16_t) * dec->npoints);
+	gd->py = malloc(sizeof(int16_t) * dec->npoints);
+	gd->state = malloc(sizeof(int) * dec->npoints);
+	gd->endpoints = malloc(sizeof(uint16_t) * dec->ncontours);
+	memcpy(gd->state, dec->state, sizeof(int) * dec->npoints);
+	memcpy(gd->endpoints, dec->endpoints,
+			sizeof(uint16_t) * dec->ncontours);
+
+	for (j = 0; j < dec->npoints; ++j) {
+		gd->px[j] = cff_round(dec->px[j]);
+		gd->py[j] = cff_round(dec->py[j]);
+		if (j == 0 || gd->px[j] < gh.xmin) gh.xmin = gd->px[j];
+		if (j == 0 || gd->px[j] > gh.xmax) gh.xmax = gd->px[j];
+		if (j == 0 || gd->py[j] < gh.ymin) gh.ymin = gd->py[j];
+		if (j == 0 || gd->py[j] > gh.ymax) gh.ymax = gd->py[j];
+	}
+
+	ttf_set_ls_aw(ttf, &gh, gd, i);
+	/* the charstring positions the outline relative to
+	 * the glyph origin, so no side bearing correction is needed */
+	gd->lsb = 0;
+}
+
@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CTTF_CFF_H
+#define CTTF_CFF_H
+
+#include <stdio.h>
+#include "ttf.h"
+
+/* Load the 'CFF ' table - Compact Font Format outlines
+ *
+ * All Type 2 charstrings are decoded (with subroutines expanded)
+ * into ttf->glyph_data when the font is loaded, so the charstring
+ * interpreter never runs again after loading.
+ *
+ * Returns 1 on error
+ */
+int cff_load(FILE* file, ttf_t* ttf);
+
+#endif
+
@@ -0,0 +1,383 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <stdlib.h>
+#include "earclip.h"
+#include "predicates.h"
+
+typedef struct earclip	earclip_t;
+typedef struct eseg	eseg_t;
+
+struct earclip {
+	shape_t*	shape;
+	int*		next;/* successor of each vertex on its contour */
+	int*		order;/* vertices of each contour in order */
+	int*		cstart;/* start of each contour in order */
+	int		ncontours;
+};
+
+/* a contour segment */
+struct eseg {
+	int	n;
+	int	m;
+	float	ymin;
+	float	ymax;
+};
+
+static int find_contours(earclip_t* ec);
+static int segs_disjoint(earclip_t* ec);
+static int contours_nested(earclip_t* ec);
+static int inside_contour(earclip_t* ec, vector_t p, int c);
+static void make_ccw(earclip_t* ec, int c);
+static int is_convex(vector_t* vec, int* v, int k);
+static void fan(mesh_t* mesh, int* ntri, int base, int k);
+static int clip_ears(mesh_t* mesh, int* ntri, vector_t* vec, int* v,
+		int base, int k);
+static int compare_eseg(const void* a, const void* b);
+
+mesh_t* earclip_shape(shape_t* shape)
+{
+	earclip_t	ec;
+	mesh_t*		mesh = NULL;
+	int		n = shape->nvec;
+	int		ntri = 0;
+	int		nvert;
+	int		c;
+	int		i;
+
+	if (shape->nseg < 3 || shape->nseg > EARCLIP_MAX_SEGS)
+		return NULL;
+
+	ec.shape = shape;
+	ec.next = malloc(sizeof(int)*(n+1));
+	ec.order = malloc(sizeof(int)*(n+1));
+	ec.cstart = malloc(sizeof(int)*(n+1));
+	ec.ncontours = 0;
+
+	if (find_contours(&ec) && segs_disjoint(&ec) &&
+			!contours_nested(&ec)) {
+
+		nvert = ec.cstart[ec.ncontours];
+		mesh = new_mesh(nvert, nvert - 2*ec.ncontours);
+		for (c = 0; c < ec.ncontours; ++c)
+			make_ccw(&ec, c);
+		for (i = 0; i < nvert; ++i)
+			mesh->vecs[i] = shape->vec[ec.order[i]];
+		mesh->nvec = nvert;
+
+		for (c = 0; c < ec.ncontours; ++c) {
+			int*	v = ec.order + ec.cstart[c];
+			int	k = ec.cstart[c+1] - ec.cstart[c];
+
+			if (is_convex(shape->vec, v, k)) {
+				fan(mesh, &ntri, ec.cstart[c], k);
+			} else if (!clip_ears(mesh, &ntri, shape->vec, v,
+						ec.cstart[c], k)) {
+				/* degenerate contour */
+				free_mesh(&mesh);
+				break;
+			}
+		}
+	}
+
+	free(ec.next);
+	free(ec.order);
+	free(ec.cstart);
+	return mesh;
+}
+
+/* Find the closed contours of the shape. Returns 0 unless every
+ * segment is on a contour where each vertex has exactly one incoming
+ * and one outgoing segment.
+ */
+static int find_contours(earclip_t* ec)
+{
+	shape_t*	shape = ec->shape;
+	int		n = shape->nvec;
+	int*		nin = calloc(n+1, sizeof(int));
+	int*		nout = calloc(n+1, sizeof(int));
+	int*		seen = calloc(n+1, sizeof(int));
+	int		norder = 0;
+	int		ok = 1;
+	int		i;
+
+	for (i = 0; i < shape->nseg; ++i) {
+		int	a = shape->seg[i*2];
+		int	b = shape->seg[i*2+1];
+		nout[a] += 1;
+		nin[b] += 1;
+		ec->next[a] = b;
+	}
+
+	for (i = 0; i < n && ok; ++i) {
+		int	v = i;
+		int	k = 0;
+
+		if (seen[i] || (nin[i] == 0 && nout[i] == 0))
+			continue;
+
+		ec->cstart[ec->ncontours] = norder;
+		do {
+			vector_t	a;
+			vector_t	b;
+
+			if (nin[v] != 1 || nout[v] != 1 || seen[v]) {
+				ok = 0;
+				break;
+			}
+			a = shape->vec[v];
+			b = shape->vec[ec->next[v]];
+			if (a.x == b.x && a.y == b.y) {
+				/* zero length segment */
+				ok = 0;
+				break;
+			}
+			seen[v] = 1;
+			ec->order[norder++] = v;
+			k += 1;
+			v = ec->next[v];
+		} while (v != i);
+
+		if (k < 3)
+			ok = 0;
+		ec->ncontours += 1;
+	}
+	ec->cstart[ec->ncontours] = norder;
+
+	free(nin);
+	free(nout);
+	free(seen);
+	return ok;
+}
+
+/* Returns 1 if no two segments share a point other than the common
+ * endpoint of neighbours on a contour
+ */
+static int segs_disjoint(earclip_t* ec)
+{
+	vector_t*	vec = ec->shape->vec;
+	int		nsegs = ec->cstart[ec->ncontours];
+	eseg_t*		segs = malloc(sizeof(eseg_t)*(nsegs+1));
+	int		disjoint = 1;
+	int		i;
+	int		j;
+
+	for (i = 0; i < nsegs; ++i) {
+		int	a = ec->order[i];
+		int	b = ec->next[a];
+		float	ya = vec[a].y;
+		float	yb = vec[b].y;
+		segs[i].n = a;
+		segs[i].m = b;
+		segs[i].ymin = ya < yb ? ya : yb;
+		segs[i].ymax = ya < yb ? yb : ya;
+	}
+	qsort(segs, nsegs, sizeof(eseg_t), compare_eseg);
+
+	for (i = 0; i < nsegs && disjoint; ++i) {
+		for (j = i+1; j < nsegs && segs[j].ymin <= segs[i].ymax; ++j) {
+			if (seg_touch(&vec[segs[i].n], &vec[segs[i].m],
+					&vec[segs[j].n], &vec[segs[j].m])) {
+				disjoint = 0;
+				break;
+			}
+		}
+	}
+
+	free(segs);
+	return disjoint;
+}
+
+/* Returns 1 if some contour lies inside another one
+ *
+ * The contours are disjoint, so it is enough to test one vertex
+ * of each contour.
+ */
+static int contours_nested(earclip_t* ec)
+{
+	vector_t*	vec = ec->shape->vec;
+	int		c;
+	int		d;
+
+	for (c = 0; c < ec->ncontours; ++c) {
+		vector_t	p = vec[ec->order[ec->cstart[c]]];
+
+		for (d = 0; d < ec->ncontours; ++d) {
+			if (d != c && inside_contour(ec, p, d))
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/* Returns 1 if the point p, which is not on the contour c,
+ * is inside it
+ */
+static int inside_contour(earclip_t* ec, vector_t p, int c)
+{
+	vector_t*	vec = ec->shape->vec;
+	int		inside = 0;
+	int		i;
+
+	/* count the contour edges crossing the ray from p towards +x */
+	for (i = ec->cstart[c]; i < ec->cstart[c+1]; ++i) {
+		vector_t	a = vec[ec->order[i]];
+		vector_t	b = vec[ec->next[ec->order[i]]];
+
+		if (a.y <= p.y && p.y < b.y) {
+			if (orient2d(a, b, p) > 0)
+				inside = !inside;
+		} else if (b.y <= p.y && p.y < a.y) {
+			if (orient2d(a, b, p) < 0)
+				inside = !inside;
+		}
+	}
+	return inside;
+}
+
+/* Reverse the vertex order of contour c if it is clockwise
+ */
+static void make_ccw(earclip_t* ec, int c)
+{
+	vector_t*	vec = ec->shape->vec;
+	int*		v = ec->order + ec->cstart[c];
+	int		k = ec->cstart[c+1] - ec->cstart[c];
+	int		low = 0;
+	int		i;
+
+	/* the turn at the lowest, leftmost vertex is never straight */
+	for (i = 1; i < k; ++i) {
+		vector_t	a = vec[v[i]];
+		vector_t	b = vec[v[low]];
+		if (a.y < b.y || (a.y == b.y && a.x < b.x))
+			low = i;
+	}
+
+	if (orient2d(vec[v[(low+k-1) % k]], vec[v[low]],
+				vec[v[(low+1) % k]]) < 0) {
+		for (i = 0; i < k/2; ++i) {
+			int	tmp = v[i];
+			v[i] = v[k-1-i];
+			v[k-1-i] = tmp;
+		}
+	}
+}
+
+/* Returns 1 if every vertex of the counterclockwise contour v
+ * is a strict left turn
+ */
+static int is_convex(vector_t* vec, int* v, int k)
+{
+	int	i;
+
+	for (i = 0; i < k; ++i) {
+		if (orient2d(vec[v[(i+k-1) % k]], vec[v[i]],
+					vec[v[(i+1) % k]]) <= 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Triangulate a convex contour as a fan around its first vertex
+ */
+static void fan(mesh_t* mesh, int* ntri, int base, int k)
+{
+	int	i;
+
+	for (i = 1; i < k-1; ++i) {
+		mesh_set_index(mesh, 3*(*ntri), base);
+		mesh_set_index(mesh, 3*(*ntri)+1, base+i);
+		mesh_set_index(mesh, 3*(*ntri)+2, base+i+1);
+		*ntri += 1;
+	}
+}
+
+/* Triangulate a simple counterclockwise contour by ear clipping
+ *
+ * A vertex is an ear if it is a strict left turn and no reflex vertex
+ * lies in or on the triangle it makes with its neighbours. Returns 0
+ * if no ear is found, which only happens with collinear vertices.
+ */
+static int clip_ears(mesh_t* mesh, int* ntri, vector_t* vec, int* v,
+		int base, int k)
+{
+	int*	prev = malloc(sizeof(int)*k);
+	int*	next = malloc(sizeof(int)*k);
+	int	remaining = k;
+	int	fails = 0;
+	int	i;
+
+	for (i = 0; i < k; ++i) {
+		prev[i] = (i+k-1) % k;
+		next[i] = (i+1) % k;
+	}
+
+	i = 0;
+	while (remaining >= 3 && fails <= remaining) {
+		int		p = prev[i];
+		int		n = next[i];
+		vector_t	a = vec[v[p]];
+		vector_t	b = vec[v[i]];
+		vector_t	c = vec[v[n]];
+		int		ear = orient2d(a, b, c) > 0;
+		int		r;
+
+		for (r = next[n]; ear && r != p; r = next[r]) {
+			vector_t	x = vec[v[r]];
+
+			if (orient2d(vec[v[prev[r]]], x, vec[v[next[r]]]) > 0)
+				continue;
+			if (orient2d(a, b, x) >= 0 && orient2d(b, c, x) >= 0 &&
+					orient2d(c, a, x) >= 0)
+				ear = 0;
+		}
+
+		if (ear) {
+			mesh_set_index(mesh, 3*(*ntri), base+p);
+			mesh_set_index(mesh, 3*(*ntri)+1, base+i);
+			mesh_set_index(mesh, 3*(*ntri)+2, base+n);
+			*ntri += 1;
+			next[p] = n;
+			prev[n] = p;
+			remaining -= 1;
+			fails = 0;
+			i = p;
+		} else {
+			fails += 1;
+			i = n;
+		}
+	}
+
+	free(prev);
+	free(next);
+	return remaining == 2;
+}
+
+static int compare_eseg(const void* a, const void* b)
+{
+	const eseg_t*	s = a;
+	const eseg_t*	t = b;
+
+	if (s->ymin < t->ymin)
+		return -1;
+	else if (s->ymin > t->ymin)
+		return 1;
+	else
+		return 0;
+}
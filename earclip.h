@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Triangulation of small contours
+ *
+ * Punctuation and many Latin glyphs flatten to a few small contours
+ * that are neither nested nor crossing. For these the monotone
+ * decomposition of triangulate.c is not needed: a convex contour is
+ * split into a triangle fan and any other contour is triangulated by
+ * ear clipping.
+ */
+#ifndef CTTF_EARCLIP_H
+#define CTTF_EARCLIP_H
+
+#include "shape.h"
+#include "mesh.h"
+
+/* largest number of segments handled by earclip_shape */
+#define EARCLIP_MAX_SEGS	(64)
+
+/* Triangulate a shape made of disjoint simple contours without holes
+ *
+ * Returns NULL if the shape has more than EARCLIP_MAX_SEGS segments,
+ * a vertex that is not on exactly one closed contour, intersecting or
+ * touching segments, or a contour inside another one. Such shapes
+ * need the sweep in triangulate.c.
+ *
+ * The triangles are counterclockwise.
+ */
+mesh_t* earclip_shape(shape_t* shape);
+
+#endif
@@ -40,6 +40,8 @@
 #include "bstree.h"
 #include "qsortv.h"
 #include "ttf.h"
+#include "simplify.h"
+#include "snapround.h"
 
 #ifndef M_PI
 #define M_PI		3.14159265358979323846	/* pi */
@@ -77,6 +79,10 @@ static int		g_edge_dir = 0;
 static int		g_debug = 0;
 static int		g_planar = 0;
 static int		g_only_triangulate = 0;
+static int		g_fixed_point = 0;
+static int		g_hinting_ppem = 0;
+static float		g_tolerance = 0;
+static float		g_snap = 0;
 static int		g_outer = 0;
 
 static int		fsel = -1;
@@ -111,6 +117,9 @@ static void render_component(edge_t* edge);
 /*static void render_face(face_t* face);*/
 static void load_resources(const char* fn, const char* chr);
 static void free_resources();
+static void simplify_loaded_shape();
+static void snap_loaded_shape();
+static double triangulated_area(edge_list_t* edge_list);
 
 static float from_screen_x(int x);
 static float from_screen_y(int y);
@@ -187,12 +196,19 @@ void load_resources(const char* fn, const char* chr)
 		else
 			mbtowc(&wc, "a", MB_CUR_MAX);
 		ttf->interpolation_level = 3;
+		ttf->fixed_point = g_fixed_point;
+		if (g_hinting_ppem) {
+			ttf->hinting = 1;
+			ttf->ppem = g_hinting_ppem;
+		}
 		shape = ttf_export_chr_shape(ttf, wc);
 		if (shape == NULL) {
 			free_ttf(&ttf);
 			fprintf(stderr, "character not available: %x\n", wc);
 			exit(1);
 		}
+		simplify_loaded_shape();
+		snap_loaded_shape();
 
 		if (out) {
 			write_shape(out, shape);
@@ -211,11 +227,41 @@ void load_resources(const char* fn, const char* chr)
 			fprintf(stderr, "could not load shape: %s\n", fn);
 			exit(1);
 		}
+		simplify_loaded_shape();
+		snap_loaded_shape();
 		fit_view_to_shape(shape);
 		triangulate_shape(shape);
 	}
 }
 
+static void simplify_loaded_shape()
+{
+	shape_t*	simple;
+
+	if (g_tolerance <= 0)
+		return;
+
+	simple = simplify_shape(shape, g_tolerance);
+	printf("simplified shape: %d -> %d vertices\n",
+			shape->nvec, simple->nvec);
+	free_shape(&shape);
+	shape = simple;
+}
+
+static void snap_loaded_shape()
+{
+	shape_t*	snapped;
+
+	if (g_snap <= 0)
+		return;
+
+	snapped = snap_round(shape, g_snap);
+	printf("snap rounded shape: %d -> %d segments\n",
+			shape->nseg, snapped->nseg);
+	free_shape(&shape);
+	shape = snapped;
+}
+
 static void free_resources()
 {
 	free_shape(&shape);
@@ -240,7 +286,11 @@ static void print_help()
 	printf("    -d            DEBUG mode (single stepped algorithm)\n");
 	printf("    -p            only make planar graph\n");
 	printf("    -o <TARGET>   write the character to shape file TARGET\n");
-	printf("    -t            only triangulate the shape then exit\n");
+	printf("    -t            only triangulate the shape, print its area and exit\n");
+	printf("    -f            flatten the outline with integer arithmetic\n");
+	printf("    -s <TOL>      simplify the outline with tolerance TOL\n");
+	printf("    -r <GRID>     snap round the outline to a grid with spacing GRID\n");
+	printf("    -g <PPEM>     grid-fit the outline at PPEM pixels per em\n");
 }
 
 void parse_args(int argc, const char** argv, const char** font, const char** fn)
@@ -274,6 +324,35 @@ void parse_args(int argc, const char** argv, const char** font, const char** fn)
 				g_planar = 1;
 			} else if (!strcmp(argv[i], "-t")) {
 				g_only_triangulate = 1;
+			} else if (!strcmp(argv[i], "-f")) {
+				g_fixed_point = 1;
+			} else if (!strcmp(argv[i], "-s")) {
+				if (i+1 == argc) {
+					fprintf(stderr, "You must specify "
+							"a tolerance!\n");
+					print_help();
+					exit(1);
+				}
+				g_tolerance = atof(argv[i+1]);
+				i += 1;
+			} else if (!strcmp(argv[i], "-r")) {
+				if (i+1 == argc) {
+					fprintf(stderr, "You must specify "
+							"a grid spacing!\n");
+					print_help();
+					exit(1);
+				}
+				g_snap = atof(argv[i+1]);
+				i += 1;
+			} else if (!strcmp(argv[i], "-g")) {
+				if (i+1 == argc) {
+					fprintf(stderr, "You must specify "
+							"a size!\n");
+					print_help();
+					exit(1);
+				}
+				g_hinting_ppem = atoi(argv[i+1]);
+				i += 1;
 			} else {
 				fprintf(stderr, "Illegal command-line "
 						"option: %s\n",
@@ -336,22 +415,18 @@ int main(int argc, const char** argv)
 
 static int render_tree(bstree_t* tree, int i)
 {
-	if (tree == NULL) return i;
+	bstree_t*	p;
 
-	if (tree->left == NULL && tree->right == NULL) {
+	for (p = bstree_first(tree); p != NULL; p = bstree_next(p)) {
+		edge_t*	e = p->value;
 		glColor3f(colors[i][0], colors[i][1], colors[i][2]);
 		glBegin(GL_LINES);
-		glVertex3f(((edge_t*)tree->value)->origin->vec.x,
-				((edge_t*)tree->value)->origin->vec.y, 0);
-		glVertex3f(((edge_t*)tree->value)->twin->origin->vec.x,
-				((edge_t*)tree->value)->twin->origin->vec.y, 0);
+		glVertex3f(e->origin->vec.x, e->origin->vec.y, 0);
+		glVertex3f(e->twin->origin->vec.x, e->twin->origin->vec.y, 0);
 		glEnd();
-		return (i+1)%NCOLORS;
-	} else {
-		i = render_tree(tree->left, i);
-		i = render_tree(tree->right, i);
-		return i;
+		i = (i+1)%NCOLORS;
 	}
+	return i;
 }
 
 void render_edge(edge_t* e)
@@ -808,6 +883,31 @@ static void* work(void* data)
 	return NULL;
 }
 
+/* Area of the inside faces
+ */
+static double triangulated_area(edge_list_t* edge_list)
+{
+	list_t*	p = edge_list->faces;
+	double	area = 0;
+
+	if (p) do {
+		face_t*	face = p->data;
+		if (face->is_inside && face->outer_component) {
+			edge_t*	e = face->outer_component;
+			double	a = 0;
+			do {
+				vector_t	u = e->origin->vec;
+				vector_t	v = e->succ->origin->vec;
+				a += (double) u.x * v.y - (double) v.x * u.y;
+				e = e->succ;
+			} while (e != face->outer_component);
+			area += fabs(a) / 2;
+		}
+		p = p->succ;
+	} while (p != edge_list->faces);
+	return area;
+}
+
 static void triangulate_shape(shape_t* shape)
 {
 	pthread_t	thread;
@@ -820,6 +920,9 @@ static void triangulate_shape(shape_t* shape)
 	} else {
 		work(shape);
 		if (g_only_triangulate) {
+			if (!g_planar && edge_list)
+				printf("triangulated area: %g\n",
+					triangulated_area(edge_list));
 			free_resources();
 			exit(0);
 		}
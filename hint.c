@@ -0,0 +1,2296 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * TrueType instruction interpreter.
+ *
+ * Runs the font program ('fpgm'), the control value program ('prep')
+ * and the glyph programs to grid-fit outlines at a given size. The
+ * behaviour follows the classic (non-subpixel) Windows rasterizer,
+ * including its undocumented twilight zone quirks.
+ *
+ * All coordinates inside the interpreter are 26.6 fixed point pixels
+ * and all vectors are 2.14 fixed point.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "hint.h"
+#include "var.h"
+
+#define hint_warn(...) fprintf(stderr, __VA_ARGS__)
+
+/* round states, numbered like the instructions that select them */
+#define HINT_ROUND_HALF_GRID	(0)
+#define HINT_ROUND_GRID		(1)
+#define HINT_ROUND_DOUBLE_GRID	(2)
+#define HINT_ROUND_DOWN		(3)
+#define HINT_ROUND_UP		(4)
+#define HINT_ROUND_OFF		(5)
+#define HINT_ROUND_SUPER	(6)
+#define HINT_ROUND_SUPER45	(7)
+
+/* point flags */
+#define HINT_ON_CURVE		(0x01)
+#define HINT_TOUCH_X		(0x02)
+#define HINT_TOUCH_Y		(0x04)
+
+/* number of phantom points after the outline points */
+#define HINT_PHANTOM_POINTS	(4)
+/* maximum depth of nested function calls */
+#define HINT_MAX_DEPTH		(64)
+/* maximum nesting of composite glyphs */
+#define HINT_MAX_COMPONENT_DEPTH	(8)
+/* instructions executed per program before it is considered hung */
+#define HINT_MAX_INSTRUCTIONS	(1000000)
+/* extra stack space, some fonts underestimate maxStackElements */
+#define HINT_STACK_SLACK	(32)
+
+#define HINT_POP(v)							\
+	do {								\
+		if (e->sp < 1) return 1;				\
+		(v) = e->stack[--e->sp];				\
+	} while (0)
+
+#define HINT_PUSH(v)							\
+	do {								\
+		int32_t	hint_v_ = (v);					\
+		if (e->sp >= e->stack_size) return 1;			\
+		e->stack[e->sp++] = hint_v_;				\
+	} while (0)
+
+typedef struct hint_zone	hint_zone_t;
+typedef struct hint_exec	hint_exec_t;
+
+struct hint_zone {
+	ttf_point_t*	org;
+	ttf_point_t*	cur;
+	ttf_point_t*	orus;/* unscaled, glyph zone only */
+	uint8_t*	flags;
+	uint16_t*	endpoints;
+	int		npoints;
+	int		ncontours;
+};
+
+/* execution context */
+struct hint_exec {
+	ttf_t*		ttf;
+	ttf_hint_t*	hint;
+	ttf_hint_gs_t	gs;
+	hint_zone_t	zones[2];/* twilight zone and glyph zone */
+	hint_zone_t*	zp0;
+	hint_zone_t*	zp1;
+	hint_zone_t*	zp2;
+	int32_t*	stack;
+	int		sp;
+	int		stack_size;
+	int32_t*	cvt;
+	int		ncvt;
+	int32_t*	storage;
+	int32_t		scale;
+	int32_t		orus_scale;/* glyph zone orus to 26.6 */
+	uint16_t	ppem;
+	int32_t		fdotp;/* projection of the freedom vector */
+	int		is_prep;
+	int		depth;
+	long		budget;
+};
+
+static uint8_t* hint_read_table(FILE* file, ttf_table_header_t* table);
+static uint16_t hint_rd16(const uint8_t* p);
+static uint32_t hint_rd32(const uint8_t* p);
+static int32_t hint_abs(int32_t a);
+static int32_t hint_muldiv(int32_t a, int32_t b, int32_t c);
+static int32_t hint_muldiv_no_round(int32_t a, int32_t b, int32_t c);
+static int32_t hint_mulfix(int32_t a, int32_t b);
+static int32_t hint_divfix(int32_t a, int32_t b);
+static int32_t hint_mul14(int32_t a, int32_t b);
+static int32_t hint_dot14(int32_t ax, int32_t ay, int32_t bx, int32_t by);
+static void hint_normalize(int32_t x, int32_t y, int32_t* vx, int32_t* vy);
+static void hint_line_vector(int32_t dx, int32_t dy, int perpendicular,
+		int32_t* vx, int32_t* vy);
+static void hint_default_gs(ttf_hint_gs_t* gs);
+static void hint_reset_gs(ttf_hint_gs_t* gs);
+static void hint_compute_funcs(hint_exec_t* e);
+static int32_t hint_project(hint_exec_t* e, int32_t dx, int32_t dy);
+static int32_t hint_dualproj(hint_exec_t* e, int32_t dx, int32_t dy);
+static int32_t hint_org_dist(hint_exec_t* e, hint_zone_t* z1, int p1,
+		hint_zone_t* z2, int p2);
+static void hint_move(hint_exec_t* e, hint_zone_t* z, int p, int32_t d);
+static void hint_move_orig(hint_exec_t* e, hint_zone_t* z, int p,
+		int32_t d);
+static void hint_shift(hint_exec_t* e, hint_zone_t* z, int p,
+		int32_t dx, int32_t dy, int touch);
+static int32_t hint_round(hint_exec_t* e, int32_t d);
+static void hint_set_super(hint_exec_t* e, int32_t grid_period,
+		int32_t selector);
+static int hint_valid(hint_zone_t* z, int32_t p);
+static int hint_set_zone(hint_exec_t* e, int which, int32_t zone);
+static uint32_t hint_ins_len(const uint8_t* code, uint32_t size,
+		uint32_t ip);
+static int hint_skip_if(const uint8_t* code, uint32_t size, uint32_t* ip,
+		int stop_at_else);
+static int hint_skip_def(const uint8_t* code, uint32_t size, uint32_t* ip);
+static int hint_call(hint_exec_t* e, ttf_hint_func_t* f);
+static int hint_displacement(hint_exec_t* e, uint8_t op,
+		int32_t* dx, int32_t* dy, hint_zone_t** zone, int32_t* ref);
+static int hint_ins_isect(hint_exec_t* e);
+static int hint_ins_shift(hint_exec_t* e, uint8_t op);
+static int hint_ins_ip(hint_exec_t* e);
+static int hint_ins_iup(hint_exec_t* e, int axis);
+static void hint_iup_shift(hint_zone_t* z, int axis, int p1, int p2,
+		int ref);
+static void hint_iup_interp(hint_zone_t* z, int axis, int p1, int p2,
+		int ref1, int ref2);
+static int hint_ins_delta(hint_exec_t* e, uint8_t op);
+static int hint_ins_mdrp(hint_exec_t* e, uint8_t op);
+static int hint_ins_mirp(hint_exec_t* e, uint8_t op);
+static int hint_run(hint_exec_t* e, const uint8_t* code, uint32_t size,
+		uint32_t ip, int in_function);
+static void hint_exec_init(hint_exec_t* e, ttf_t* ttf, uint16_t ppem,
+		int32_t scale);
+static void hint_exec_free(hint_exec_t* e);
+static ttf_hint_size_t* hint_get_size(ttf_t* ttf, uint16_t ppem);
+static ttf_glyph_data_t* hint_glyph_data(ttf_t* ttf, uint16_t i);
+static void hint_outline(ttf_t* ttf, ttf_hint_size_t* size, uint16_t i,
+		int depth, ttf_point_t* cur, uint8_t* flags);
+static void hint_compose(ttf_t* ttf, ttf_hint_size_t* size, uint16_t i,
+		int depth, ttf_point_t* cur, uint8_t* flags);
+static void hint_orus(ttf_hint_t* hint, ttf_glyph_data_t* glyph,
+		ttf_point_t* orus);
+static void hint_scaled(ttf_hint_t* hint, ttf_hint_size_t* size,
+		ttf_glyph_data_t* glyph, ttf_point_t* org);
+static void hint_program(ttf_t* ttf, ttf_hint_size_t* size,
+		ttf_glyph_data_t* glyph, int composite, ttf_point_t* org,
+		ttf_point_t* cur, uint8_t* flags);
+
+int ttf_hint_load(FILE* file, ttf_t* ttf)
+{
+	ttf_hint_t*	hint;
+	uint8_t		maxp[32];
+	uint8_t		hhea[8];
+	uint8_t*	cvt;
+	int		i;
+
+	/* the interpreter limits are only in version 1.0 of 'maxp' */
+	if (ttf->maxp->length < 32 ||
+			-1 == fseek(file, ttf->maxp->offset, SEEK_SET) ||
+			1 != fread(maxp, 32, 1, file) ||
+			hint_rd32(maxp) != 0x00010000)
+		return 1;
+
+	if (-1 == fseek(file, ttf->hhea->offset, SEEK_SET) ||
+			1 != fread(hhea, 8, 1, file))
+		return 1;
+
+	hint = calloc(1, sizeof(ttf_hint_t));
+	hint->max_twilight = hint_rd16(maxp+16);
+	hint->max_storage = hint_rd16(maxp+18);
+	hint->max_functions = hint_rd16(maxp+20);
+	hint->max_stack = hint_rd16(maxp+24);
+	hint->ascender = (int16_t) hint_rd16(hhea+4);
+	hint->descender = (int16_t) hint_rd16(hhea+6);
+	hint->functions = calloc(hint->max_functions + 1,
+			sizeof(ttf_hint_func_t));
+
+	if (ttf->fpgm) {
+		hint->fpgm = hint_read_table(file, ttf->fpgm);
+		hint->fpgm_len = hint->fpgm ? ttf->fpgm->length : 0;
+	}
+	if (ttf->prep) {
+		hint->prep = hint_read_table(file, ttf->prep);
+		hint->prep_len = hint->prep ? ttf->prep->length : 0;
+	}
+	if (ttf->cvt && (cvt = hint_read_table(file, ttf->cvt))) {
+		hint->ncvt = ttf->cvt->length / 2;
+		hint->cvt = malloc(sizeof(int16_t) * (hint->ncvt + 1));
+		for (i = 0; i < hint->ncvt; ++i)
+			hint->cvt[i] = (int16_t) hint_rd16(cvt + i*2);
+		free(cvt);
+	}
+
+	ttf->hint = hint;
+	return 0;
+}
+
+void free_ttf_hint(ttf_hint_t** hint)
+{
+	ttf_hint_t*	p;
+	int		i;
+
+	assert(hint != NULL);
+
+	p = *hint;
+	if (!p) return;
+
+	for (i = 0; i < TTF_HINT_SIZES; ++i) {
+		free(p->sizes[i].cvt);
+		free(p->sizes[i].storage);
+		free(p->sizes[i].twilight);
+	}
+	for (i = 0; i < TTF_HINT_CACHE_SIZE; ++i) {
+		free(p->cache[i].points);
+		free(p->cache[i].state);
+	}
+	free(p->fpgm);
+	free(p->prep);
+	free(p->cvt);
+	free(p->functions);
+	free(p);
+	*hint = NULL;
+}
+
+ttf_hinted_t* ttf_hint_glyph(ttf_t* ttf, uint16_t i, uint16_t ppem)
+{
+	ttf_hint_t*		hint = ttf->hint;
+	ttf_glyph_data_t*	glyph;
+	ttf_hint_size_t*	size;
+	ttf_hinted_t*		entry;
+	ttf_point_t*		cur;
+	uint8_t*		flags;
+	uint32_t		instance = ttf->var ? ttf->var->instance : 0;
+	int			np;
+	int			n;
+	int			j;
+
+	if (!hint || i >= ttf->nglyphs || ppem == 0)
+		return NULL;
+
+	entry = &hint->cache[(i * 31 + ppem * 7 + instance * 131) &
+		(TTF_HINT_CACHE_SIZE - 1)];
+	if (entry->points && entry->glyph == i && entry->ppem == ppem &&
+			entry->instance == instance)
+		return entry;
+
+	size = hint_get_size(ttf, ppem);
+	glyph = hint_glyph_data(ttf, i);
+	np = glyph->npoints;
+	n = np + HINT_PHANTOM_POINTS;
+	cur = malloc(sizeof(ttf_point_t) * n);
+	flags = calloc(n, 1);
+	hint_outline(ttf, size, i, 0, cur, flags);
+
+	/* hinting the components may have replaced the outline */
+	glyph = hint_glyph_data(ttf, i);
+
+	free(entry->points);
+	free(entry->state);
+	entry->glyph = i;
+	entry->ppem = ppem;
+	entry->instance = instance;
+	entry->npoints = n;
+	entry->points = cur;
+	entry->state = malloc(sizeof(int) * n);
+	for (j = 0; j < n; ++j)
+		entry->state[j] = (j < np && glyph->state[j] > 1) ?
+			glyph->state[j] : (flags[j] & HINT_ON_CURVE);
+	free(flags);
+	return entry;
+}
+
+static uint8_t* hint_read_table(FILE* file, ttf_table_header_t* table)
+{
+	uint8_t*	buf;
+
+	if (-1 == fseek(file, table->offset, SEEK_SET))
+		return NULL;
+
+	buf = malloc(table->length ? table->length : 1);
+	if (table->length && 1 != fread(buf, table->length, 1, file)) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static uint16_t hint_rd16(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t hint_rd32(const uint8_t* p)
+{
+	return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static int32_t hint_abs(int32_t a)
+{
+	return a < 0 ? -a : a;
+}
+
+/* a*b/c rounded to nearest
+ */
+static int32_t hint_muldiv(int32_t a, int32_t b, int32_t c)
+{
+	int64_t	p = (int64_t) a * b;
+	int64_t	d = c;
+	int	neg = (p < 0) != (d < 0);
+
+	if (c == 0)
+		return neg ? -0x7FFFFFFF : 0x7FFFFFFF;
+
+	if (p < 0) p = -p;
+	if (d < 0) d = -d;
+	p = (p + d/2) / d;
+	return (int32_t) (neg ? -p : p);
+}
+
+/* a*b/c rounded towards zero
+ */
+static int32_t hint_muldiv_no_round(int32_t a, int32_t b, int32_t c)
+{
+	int64_t	p = (int64_t) a * b;
+
+	if (c == 0)
+		return ((p < 0) != (c < 0)) ? -0x7FFFFFFF : 0x7FFFFFFF;
+	return (int32_t) (p / c);
+}
+
+/* a*b with b in 16.16 fixed point
+ */
+static int32_t hint_mulfix(int32_t a, int32_t b)
+{
+	return hint_muldiv(a, b, 0x10000);
+}
+
+/* a/b in 16.16 fixed point
+ */
+static int32_t hint_divfix(int32_t a, int32_t b)
+{
+	int64_t	p = (int64_t) a * 0x10000;
+	int64_t	d = b;
+	int	neg = (p < 0) != (d < 0);
+
+	if (b == 0)
+		return 0x7FFFFFFF;
+
+	if (p < 0) p = -p;
+	if (d < 0) d = -d;
+	p = (p + d/2) / d;
+	return (int32_t) (neg ? -p : p);
+}
+
+/* a*b with b in 2.14 fixed point
+ */
+static int32_t hint_mul14(int32_t a, int32_t b)
+{
+	return hint_muldiv(a, b, 0x4000);
+}
+
+/* dot product of a vector and a 2.14 unit vector
+ */
+static int32_t hint_dot14(int32_t ax, int32_t ay, int32_t bx, int32_t by)
+{
+	int64_t	l = (int64_t) ax * bx + (int64_t) ay * by;
+	int	neg = l < 0;
+
+	if (neg) l = -l;
+	l = (l + 0x2000) >> 14;
+	return (int32_t) (neg ? -l : l);
+}
+
+/* Scale (x, y) to a 2.14 unit vector
+ */
+static void hint_normalize(int32_t x, int32_t y, int32_t* vx, int32_t* vy)
+{
+	int64_t		ax = x;
+	int64_t		ay = y;
+	uint64_t	l2;
+	uint64_t	len;
+	uint64_t	next;
+
+	if (x == 0 && y == 0) {
+		*vx = 0x4000;
+		*vy = 0;
+		return;
+	}
+
+	/* bring the vector to a length of about 2^20 so that the
+	 * integer square root is precise enough */
+	while ((ax < 0 ? -ax : ax) < (1 << 20) &&
+			(ay < 0 ? -ay : ay) < (1 << 20)) {
+		ax *= 2;
+		ay *= 2;
+	}
+	while ((ax < 0 ? -ax : ax) >= (1 << 24) ||
+			(ay < 0 ? -ay : ay) >= (1 << 24)) {
+		ax /= 2;
+		ay /= 2;
+	}
+
+	l2 = (uint64_t) (ax*ax + ay*ay);
+	len = l2 >> 20;
+	if (len == 0) len = 1;
+	for (;;) {
+		next = (len + l2 / len) / 2;
+		if (next >= len)
+			break;
+		len = next;
+	}
+	while (len * len > l2) --len;
+	while ((len+1) * (len+1) <= l2) ++len;
+
+	*vx = (int32_t) ((ax * 0x4000 + (ax < 0 ? -(int64_t) len/2 :
+					(int64_t) len/2)) / (int64_t) len);
+	*vy = (int32_t) ((ay * 0x4000 + (ay < 0 ? -(int64_t) len/2 :
+					(int64_t) len/2)) / (int64_t) len);
+}
+
+/* Unit vector parallel or perpendicular to a line
+ */
+static void hint_line_vector(int32_t dx, int32_t dy, int perpendicular,
+		int32_t* vx, int32_t* vy)
+{
+	if (dx == 0 && dy == 0) {
+		*vx = 0x4000;
+		*vy = 0;
+		return;
+	}
+	if (perpendicular) {
+		/* rotate counter-clockwise */
+		int32_t	t = dx;
+		dx = -dy;
+		dy = t;
+	}
+	hint_normalize(dx, dy, vx, vy);
+}
+
+static void hint_default_gs(ttf_hint_gs_t* gs)
+{
+	memset(gs, 0, sizeof(ttf_hint_gs_t));
+	gs->min_distance = 64;
+	gs->cvt_cutin = 68;/* 17/16 pixels */
+	gs->sw_cutin = 0;
+	gs->sw_value = 0;
+	gs->delta_base = 9;
+	gs->delta_shift = 3;
+	gs->auto_flip = 1;
+	gs->period = 64;
+	gs->phase = 0;
+	gs->threshold = 32;
+	hint_reset_gs(gs);
+}
+
+/* Reset the part of the graphics state that does not carry over from
+ * the cvt program to the glyph programs
+ */
+static void hint_reset_gs(ttf_hint_gs_t* gs)
+{
+	gs->proj_x = gs->dual_x = gs->free_x = 0x4000;
+	gs->proj_y = gs->dual_y = gs->free_y = 0;
+	gs->round_state = HINT_ROUND_GRID;
+	gs->loop = 1;
+	gs->rp0 = gs->rp1 = gs->rp2 = 0;
+	gs->gep0 = gs->gep1 = gs->gep2 = 1;
+}
+
+static void hint_compute_funcs(hint_exec_t* e)
+{
+	e->fdotp = ((int64_t) e->gs.proj_x * e->gs.free_x +
+			(int64_t) e->gs.proj_y * e->gs.free_y) >> 14;
+	if (hint_abs(e->fdotp) < 0x400)
+		e->fdotp = 0x4000;
+}
+
+static int32_t hint_project(hint_exec_t* e, int32_t dx, int32_t dy)
+{
+	return hint_dot14(dx, dy, e->gs.proj_x, e->gs.proj_y);
+}
+
+static int32_t hint_dualproj(hint_exec_t* e, int32_t dx, int32_t dy)
+{
+	return hint_dot14(dx, dy, e->gs.dual_x, e->gs.dual_y);
+}
+
+/* Distance between two points in the original outline along the dual
+ * projection vector. Glyph zone distances are measured in font units
+ * and then scaled to avoid accumulating rounding errors.
+ */
+static int32_t hint_org_dist(hint_exec_t* e, hint_zone_t* z1, int p1,
+		hint_zone_t* z2, int p2)
+{
+	if (!z1->orus || !z2->orus)
+		return hint_dualproj(e, z1->org[p1].x - z2->org[p2].x,
+				z1->org[p1].y - z2->org[p2].y);
+
+	return hint_mulfix(hint_dualproj(e,
+				z1->orus[p1].x - z2->orus[p2].x,
+				z1->orus[p1].y - z2->orus[p2].y), e->orus_scale);
+}
+
+/* Move a point along the freedom vector so that its projection
+ * changes by d
+ */
+static void hint_move(hint_exec_t* e, hint_zone_t* z, int p, int32_t d)
+{
+	if (e->gs.free_x) {
+		z->cur[p].x += hint_muldiv(d, e->gs.free_x, e->fdotp);
+		z->flags[p] |= HINT_TOUCH_X;
+	}
+	if (e->gs.free_y) {
+		z->cur[p].y += hint_muldiv(d, e->gs.free_y, e->fdotp);
+		z->flags[p] |= HINT_TOUCH_Y;
+	}
+}
+
+static void hint_move_orig(hint_exec_t* e, hint_zone_t* z, int p,
+		int32_t d)
+{
+	if (e->gs.free_x)
+		z->org[p].x += hint_muldiv(d, e->gs.free_x, e->fdotp);
+	if (e->gs.free_y)
+		z->org[p].y += hint_muldiv(d, e->gs.free_y, e->fdotp);
+}
+
+static void hint_shift(hint_exec_t* e, hint_zone_t* z, int p,
+		int32_t dx, int32_t dy, int touch)
+{
+	if (e->gs.free_x) {
+		z->cur[p].x += dx;
+		if (touch) z->flags[p] |= HINT_TOUCH_X;
+	}
+	if (e->gs.free_y) {
+		z->cur[p].y += dy;
+		if (touch) z->flags[p] |= HINT_TOUCH_Y;
+	}
+}
+
+/* Round a distance according to the round state
+ */
+static int32_t hint_round(hint_exec_t* e, int32_t d)
+{
+	int32_t	v;
+
+	switch (e->gs.round_state) {
+		case HINT_ROUND_HALF_GRID:
+			if (d >= 0) {
+				v = (d & -64) + 32;
+			} else {
+				v = -(((-d) & -64) + 32);
+			}
+			return v;
+		case HINT_ROUND_GRID:
+			if (d >= 0) {
+				v = (d + 32) & -64;
+			} else {
+				v = -((32 - d) & -64);
+			}
+			return v;
+		case HINT_ROUND_DOUBLE_GRID:
+			if (d >= 0) {
+				v = (d + 16) & -32;
+			} else {
+				v = -((16 - d) & -32);
+			}
+			return v;
+		case HINT_ROUND_DOWN:
+			if (d >= 0) {
+				v = d & -64;
+			} else {
+				v = -((-d) & -64);
+			}
+			return v;
+		case HINT_ROUND_UP:
+			if (d >= 0) {
+				v = (d + 63) & -64;
+			} else {
+				v = -((63 - d) & -64);
+			}
+			return v;
+		case HINT_ROUND_SUPER:
+			if (d >= 0) {
+				v = ((d - e->gs.phase + e->gs.threshold) &
+						-e->gs.period) + e->gs.phase;
+				if (v < 0) v = e->gs.phase;
+			} else {
+				v = -(((e->gs.threshold - e->gs.phase - d) &
+						-e->gs.period) + e->gs.phase);
+				if (v > 0) v = -e->gs.phase;
+			}
+			return v;
+		case HINT_ROUND_SUPER45:
+			if (d >= 0) {
+				v = ((d - e->gs.phase + e->gs.threshold) /
+						e->gs.period) * e->gs.period +
+					e->gs.phase;
+				if (v < 0) v = e->gs.phase;
+			} else {
+				v = -(((e->gs.threshold - e->gs.phase - d) /
+						e->gs.period) * e->gs.period +
+						e->gs.phase);
+				if (v > 0) v = -e->gs.phase;
+			}
+			return v;
+		default:
+			return d;
+	}
+}
+
+/* Set the super rounding parameters (SROUND and S45ROUND)
+ */
+static void hint_set_super(hint_exec_t* e, int32_t grid_period,
+		int32_t selector)
+{
+	int32_t	period;
+	int32_t	phase;
+	int32_t	threshold;
+
+	switch (selector & 0xC0) {
+		case 0x00:
+			period = grid_period / 2;
+			break;
+		case 0x80:
+			period = grid_period * 2;
+			break;
+		default:
+			period = grid_period;
+	}
+
+	switch (selector & 0x30) {
+		case 0x00:
+			phase = 0;
+			break;
+		case 0x10:
+			phase = period / 4;
+			break;
+		case 0x20:
+			phase = period / 2;
+			break;
+		default:
+			phase = period * 3 / 4;
+	}
+
+	if ((selector & 0x0F) == 0)
+		threshold = period - 1;
+	else
+		threshold = ((selector & 0x0F) - 4) * period / 8;
+
+	/* 2.14 to 26.6 */
+	e->gs.period = period >> 8;
+	e->gs.phase = phase >> 8;
+	e->gs.threshold = threshold >> 8;
+	if (e->gs.period == 0)
+		e->gs.period = 1;
+}
+
+static int hint_valid(hint_zone_t* z, int32_t p)
+{
+	return p >= 0 && p < z->npoints;
+}
+
+/* SZP0, SZP1, SZP2
+ *
+ * Returns 1 on error
+ */
+static int hint_set_zone(hint_exec_t* e, int which, int32_t zone)
+{
+	if (zone != 0 && zone != 1)
+		return 1;
+
+	switch (which) {
+		case 0:
+			e->gs.gep0 = zone;
+			e->zp0 = &e->zones[zone];
+			break;
+		case 1:
+			e->gs.gep1 = zone;
+			e->zp1 = &e->zones[zone];
+			break;
+		default:
+			e->gs.gep2 = zone;
+			e->zp2 = &e->zones[zone];
+	}
+	return 0;
+}
+
+/* Returns the length of the instruction at ip, or 0 if it is truncated
+ */
+static uint32_t hint_ins_len(const uint8_t* code, uint32_t size,
+		uint32_t ip)
+{
+	uint8_t		op = code[ip];
+	uint32_t	len = 1;
+
+	if (op == 0x40 || op == 0x41) {
+		if (ip + 1 >= size)
+			return 0;
+		len = 2 + code[ip+1] * (op == 0x41 ? 2 : 1);
+	} else if (op >= 0xB0 && op <= 0xB7) {
+		len = 1 + (op - 0xAF);
+	} else if (op >= 0xB8 && op <= 0xBF) {
+		len = 1 + 2 * (op - 0xB7);
+	}
+	return (ip + len <= size) ? len : 0;
+}
+
+/* Skip to after the ELSE or EIF matching an IF
+ *
+ * Returns 1 on error
+ */
+static int hint_skip_if(const uint8_t* code, uint32_t size, uint32_t* ip,
+		int stop_at_else)
+{
+	uint32_t	p = *ip;
+	int		nest = 0;
+
+	while (p < size) {
+		uint32_t	len = hint_ins_len(code, size, p);
+
+		if (!len)
+			return 1;
+
+		switch (code[p]) {
+			case 0x58:/* IF */
+				++nest;
+				break;
+			case 0x1B:/* ELSE */
+				if (!nest && stop_at_else) {
+					*ip = p + 1;
+					return 0;
+				}
+				break;
+			case 0x59:/* EIF */
+				if (!nest) {
+					*ip = p + 1;
+					return 0;
+				}
+				--nest;
+				break;
+		}
+		p += len;
+	}
+	return 1;
+}
+
+/* Skip to after the ENDF of a function or instruction definition
+ *
+ * Returns 1 on error
+ */
+static int hint_skip_def(const uint8_t* code, uint32_t size, uint32_t* ip)
+{
+	uint32_t	p = *ip;
+
+	while (p < size) {
+		uint32_t	len = hint_ins_len(code, size, p);
+
+		if (!len || code[p] == 0x2C || code[p] == 0x89)
+			return 1;
+		if (code[p] == 0x2D) {
+			*ip = p + 1;
+			return 0;
+		}
+		p += len;
+	}
+	return 1;
+}
+
+static int hint_call(hint_exec_t* e, ttf_hint_func_t* f)
+{
+	int	err;
+
+	if (!f->defined || e->depth >= HINT_MAX_DEPTH)
+		return 1;
+
+	++e->depth;
+	err = hint_run(e, f->code, f->size, f->start, 1);
+	--e->depth;
+	return err;
+}
+
+/* Displacement of the reference point used by SHP, SHC and SHZ
+ *
+ * Returns 1 on error
+ */
+static int hint_displacement(hint_exec_t* e, uint8_t op,
+		int32_t* dx, int32_t* dy, hint_zone_t** zone, int32_t* ref)
+{
+	hint_zone_t*	z;
+	int32_t		p;
+	int32_t		d;
+
+	if (op & 1) {
+		z = e->zp0;
+		p = e->gs.rp1;
+	} else {
+		z = e->zp1;
+		p = e->gs.rp2;
+	}
+
+	if (!hint_valid(z, p))
+		return 1;
+
+	d = hint_project(e, z->cur[p].x - z->org[p].x,
+			z->cur[p].y - z->org[p].y);
+	*dx = hint_muldiv(d, e->gs.free_x, e->fdotp);
+	*dy = hint_muldiv(d, e->gs.free_y, e->fdotp);
+	*zone = z;
+	*ref = p;
+	return 0;
+}
+
+/* ISECT - move a point to the intersection of two lines
+ */
+static int hint_ins_isect(hint_exec_t* e)
+{
+	int32_t		p, a0, a1, b0, b1;
+	int32_t		dax, day, dbx, dby, dx, dy;
+	int32_t		disc, dot;
+
+	HINT_POP(b1);
+	HINT_POP(b0);
+	HINT_POP(a1);
+	HINT_POP(a0);
+	HINT_POP(p);
+
+	if (!hint_valid(e->zp0, b0) || !hint_valid(e->zp0, b1) ||
+			!hint_valid(e->zp1, a0) || !hint_valid(e->zp1, a1) ||
+			!hint_valid(e->zp2, p))
+		return 1;
+
+	dbx = e->zp0->cur[b1].x - e->zp0->cur[b0].x;
+	dby = e->zp0->cur[b1].y - e->zp0->cur[b0].y;
+	dax = e->zp1->cur[a1].x - e->zp1->cur[a0].x;
+	day = e->zp1->cur[a1].y - e->zp1->cur[a0].y;
+	dx = e->zp0->cur[b0].x - e->zp1->cur[a0].x;
+	dy = e->zp0->cur[b0].y - e->zp1->cur[a0].y;
+
+	disc = hint_muldiv(dax, -dby, 64) + hint_muldiv(day, dbx, 64);
+	dot = hint_muldiv(dax, dbx, 64) + hint_muldiv(day, dby, 64);
+
+	/* the lines are considered parallel if they are within
+	 * about three degrees of each other */
+	if (19 * (int64_t) hint_abs(disc) > hint_abs(dot)) {
+		int32_t	v = hint_muldiv(dx, -dby, 64) +
+			hint_muldiv(dy, dbx, 64);
+
+		e->zp2->cur[p].x = e->zp1->cur[a0].x +
+			hint_muldiv(v, dax, disc);
+		e->zp2->cur[p].y = e->zp1->cur[a0].y +
+			hint_muldiv(v, day, disc);
+	} else {
+		e->zp2->cur[p].x = (e->zp1->cur[a0].x + e->zp1->cur[a1].x +
+				e->zp0->cur[b0].x + e->zp0->cur[b1].x) / 4;
+		e->zp2->cur[p].y = (e->zp1->cur[a0].y + e->zp1->cur[a1].y +
+				e->zp0->cur[b0].y + e->zp0->cur[b1].y) / 4;
+	}
+	e->zp2->flags[p] |= HINT_TOUCH_X | HINT_TOUCH_Y;
+	return 0;
+}
+
+/* SHP, SHC, SHZ and SHPIX
+ */
+static int hint_ins_shift(hint_exec_t* e, uint8_t op)
+{
+	hint_zone_t*	z = NULL;
+	int32_t		ref = -1;
+	int32_t		dx;
+	int32_t		dy;
+	int32_t		a;
+	int32_t		i;
+
+	if (op == 0x38) {
+		/* SHPIX */
+		HINT_POP(a);
+		dx = hint_mul14(a, e->gs.free_x);
+		dy = hint_mul14(a, e->gs.free_y);
+	} else if (hint_displacement(e, op, &dx, &dy, &z, &ref)) {
+		return 1;
+	}
+
+	switch (op) {
+		case 0x32: case 0x33:/* SHP */
+		case 0x38:/* SHPIX */
+			while (e->gs.loop-- > 0) {
+				HINT_POP(a);
+				if (!hint_valid(e->zp2, a))
+					return 1;
+				hint_shift(e, e->zp2, a, dx, dy, 1);
+			}
+			e->gs.loop = 1;
+			break;
+		case 0x34: case 0x35:/* SHC */
+			{
+				int32_t	start;
+				int32_t	end;
+
+				HINT_POP(a);
+				if (a < 0 || a >= e->zp2->ncontours)
+					return 1;
+				start = a ? e->zp2->endpoints[a-1] + 1 : 0;
+				end = e->zp2->endpoints[a];
+				for (i = start; i <= end &&
+						i < e->zp2->npoints; ++i) {
+					if (z != e->zp2 || ref != i)
+						hint_shift(e, e->zp2, i,
+								dx, dy, 1);
+				}
+			}
+			break;
+		default:/* SHZ */
+			{
+				int32_t	limit;
+
+				HINT_POP(a);
+				if (a != 0 && a != 1)
+					return 1;
+
+				/* the phantom points are not moved */
+				if (e->gs.gep2 == 0)
+					limit = e->zp2->npoints;
+				else if (e->zp2->ncontours > 0)
+					limit = e->zp2->endpoints[
+						e->zp2->ncontours-1] + 1;
+				else
+					limit = 0;
+
+				for (i = 0; i < limit; ++i) {
+					if (z != e->zp2 || ref != i)
+						hint_shift(e, e->zp2, i,
+								dx, dy, 0);
+				}
+			}
+	}
+	return 0;
+}
+
+/* IP - interpolate points between rp1 and rp2
+ */
+static int hint_ins_ip(hint_exec_t* e)
+{
+	int32_t		rp1 = e->gs.rp1;
+	int32_t		rp2 = e->gs.rp2;
+	int32_t		old_range;
+	int32_t		cur_range;
+	ttf_point_t	cur_base;
+	int32_t		p;
+
+	if (!hint_valid(e->zp0, rp1) || !hint_valid(e->zp1, rp2)) {
+		e->gs.loop = 1;
+		return 1;
+	}
+
+	cur_base = e->zp0->cur[rp1];
+	old_range = hint_org_dist(e, e->zp1, rp2, e->zp0, rp1);
+	cur_range = hint_project(e, e->zp1->cur[rp2].x - cur_base.x,
+			e->zp1->cur[rp2].y - cur_base.y);
+
+	while (e->gs.loop-- > 0) {
+		int32_t	org_dist;
+		int32_t	cur_dist;
+		int32_t	new_dist = 0;
+
+		HINT_POP(p);
+		if (!hint_valid(e->zp2, p))
+			return 1;
+
+		org_dist = hint_org_dist(e, e->zp2, p, e->zp0, rp1);
+		cur_dist = hint_project(e, e->zp2->cur[p].x - cur_base.x,
+				e->zp2->cur[p].y - cur_base.y);
+
+		if (org_dist) {
+			if (old_range)
+				new_dist = hint_muldiv(org_dist, cur_range,
+						old_range);
+			else
+				new_dist = org_dist;
+		}
+		hint_move(e, e->zp2, p, new_dist - cur_dist);
+	}
+	e->gs.loop = 1;
+	return 0;
+}
+
+/* IUP - interpolate untouched points in the glyph zone
+ */
+static int hint_ins_iup(hint_exec_t* e, int axis)
+{
+	hint_zone_t*	z = &e->zones[1];
+	uint8_t		mask = axis ? HINT_TOUCH_Y : HINT_TOUCH_X;
+	int		point = 0;
+	int		c;
+
+	for (c = 0; c < z->ncontours; ++c) {
+		int	first_point = point;
+		int	end_point = z->endpoints[c];
+		int	first_touched;
+		int	cur_touched;
+
+		if (end_point >= z->npoints)
+			end_point = z->npoints - 1;
+
+		while (point <= end_point && !(z->flags[point] & mask))
+			++point;
+
+		if (point <= end_point) {
+			first_touched = cur_touched = point;
+			++point;
+
+			while (point <= end_point) {
+				if (z->flags[point] & mask) {
+					hint_iup_interp(z, axis,
+							cur_touched + 1,
+							point - 1,
+							cur_touched, point);
+					cur_touched = point;
+				}
+				++point;
+			}
+
+			if (cur_touched == first_touched) {
+				hint_iup_shift(z, axis, first_point,
+						end_point, cur_touched);
+			} else {
+				hint_iup_interp(z, axis, cur_touched + 1,
+						end_point, cur_touched,
+						first_touched);
+				if (first_touched > first_point)
+					hint_iup_interp(z, axis, first_point,
+							first_touched - 1,
+							cur_touched,
+							first_touched);
+			}
+		}
+		point = end_point + 1;
+	}
+	return 0;
+}
+
+#define HINT_AXIS(pt, axis)	(*((axis) ? &(pt).y : &(pt).x))
+
+static void hint_iup_shift(hint_zone_t* z, int axis, int p1, int p2,
+		int ref)
+{
+	int32_t	delta = HINT_AXIS(z->cur[ref], axis) -
+		HINT_AXIS(z->org[ref], axis);
+	int	i;
+
+	for (i = p1; i <= p2; ++i) {
+		if (i != ref)
+			HINT_AXIS(z->cur[i], axis) += delta;
+	}
+}
+
+/* Interpolate the points p1..p2 between the touched points
+ * ref1 and ref2
+ */
+static void hint_iup_interp(hint_zone_t* z, int axis, int p1, int p2,
+		int ref1, int ref2)
+{
+	int32_t	orus1, orus2;
+	int32_t	org1, org2;
+	int32_t	cur1, cur2;
+	int32_t	delta1, delta2;
+	int32_t	scale = 0;
+	int	i;
+
+	if (p1 > p2)
+		return;
+
+	if (HINT_AXIS(z->orus[ref1], axis) > HINT_AXIS(z->orus[ref2], axis)) {
+		int	t = ref1;
+		ref1 = ref2;
+		ref2 = t;
+	}
+
+	orus1 = HINT_AXIS(z->orus[ref1], axis);
+	orus2 = HINT_AXIS(z->orus[ref2], axis);
+	org1 = HINT_AXIS(z->org[ref1], axis);
+	org2 = HINT_AXIS(z->org[ref2], axis);
+	cur1 = HINT_AXIS(z->cur[ref1], axis);
+	cur2 = HINT_AXIS(z->cur[ref2], axis);
+	delta1 = cur1 - org1;
+	delta2 = cur2 - org2;
+
+	if (cur1 != cur2 && orus1 != orus2)
+		scale = hint_divfix(cur2 - cur1, orus2 - orus1);
+
+	for (i = p1; i <= p2; ++i) {
+		int32_t	x = HINT_AXIS(z->org[i], axis);
+
+		if (x <= org1)
+			x += delta1;
+		else if (x >= org2)
+			x += delta2;
+		else if (scale)
+			x = cur1 + hint_mulfix(HINT_AXIS(z->orus[i], axis) -
+					orus1, scale);
+		else
+			x = cur1;
+
+		HINT_AXIS(z->cur[i], axis) = x;
+	}
+}
+
+/* DELTAP1-3 and DELTAC1-3
+ */
+static int hint_ins_delta(hint_exec_t* e, uint8_t op)
+{
+	int32_t	n;
+	int32_t	base;
+	int	is_cvt = (op >= 0x73 && op <= 0x75);
+
+	switch (op) {
+		case 0x71: case 0x74:
+			base = 16;
+			break;
+		case 0x72: case 0x75:
+			base = 32;
+			break;
+		default:
+			base = 0;
+	}
+
+	HINT_POP(n);
+	if (n < 0 || n > e->sp / 2)
+		return 1;
+
+	while (n-- > 0) {
+		int32_t	a;
+		int32_t	b;
+		int32_t	c;
+
+		HINT_POP(a);
+		HINT_POP(b);
+
+		c = ((b & 0xF0) >> 4) + base + e->gs.delta_base;
+		if (c != e->ppem)
+			continue;
+
+		b = (b & 0xF) - 8;
+		if (b >= 0)
+			b++;
+		b *= 1 << (6 - e->gs.delta_shift);
+
+		if (is_cvt) {
+			if (a >= 0 && a < e->ncvt)
+				e->cvt[a] += b;
+		} else if (hint_valid(e->zp0, a)) {
+			hint_move(e, e->zp0, a, b);
+		}
+	}
+	return 0;
+}
+
+/* MDRP - move direct relative point
+ */
+static int hint_ins_mdrp(hint_exec_t* e, uint8_t op)
+{
+	int32_t	p;
+	int32_t	rp0 = e->gs.rp0;
+	int32_t	org_dist;
+	int32_t	cur_dist;
+	int32_t	distance;
+
+	HINT_POP(p);
+	if (!hint_valid(e->zp1, p) || !hint_valid(e->zp0, rp0))
+		return 1;
+
+	org_dist = hint_org_dist(e, e->zp1, p, e->zp0, rp0);
+
+	if (hint_abs(org_dist - e->gs.sw_value) < e->gs.sw_cutin)
+		org_dist = (org_dist >= 0) ? e->gs.sw_value :
+			-e->gs.sw_value;
+
+	distance = (op & 4) ? hint_round(e, org_dist) : org_dist;
+
+	if (op & 8) {
+		if (org_dist >= 0) {
+			if (distance < e->gs.min_distance)
+				distance = e->gs.min_distance;
+		} else {
+			if (distance > -e->gs.min_distance)
+				distance = -e->gs.min_distance;
+		}
+	}
+
+	cur_dist = hint_project(e, e->zp1->cur[p].x - e->zp0->cur[rp0].x,
+			e->zp1->cur[p].y - e->zp0->cur[rp0].y);
+	hint_move(e, e->zp1, p, distance - cur_dist);
+
+	e->gs.rp1 = rp0;
+	e->gs.rp2 = p;
+	if (op & 16)
+		e->gs.rp0 = p;
+	return 0;
+}
+
+/* MIRP - move indirect relative point
+ */
+static int hint_ins_mirp(hint_exec_t* e, uint8_t op)
+{
+	int32_t	p;
+	int32_t	idx;
+	int32_t	rp0 = e->gs.rp0;
+	int32_t	cvt_dist;
+	int32_t	org_dist;
+	int32_t	cur_dist;
+	int32_t	distance;
+
+	HINT_POP(idx);
+	HINT_POP(p);
+	if (!hint_valid(e->zp1, p) || !hint_valid(e->zp0, rp0) ||
+			idx < -1 || idx >= e->ncvt)
+		return 1;
+
+	cvt_dist = (idx == -1) ? 0 : e->cvt[idx];
+
+	if (hint_abs(cvt_dist - e->gs.sw_value) < e->gs.sw_cutin)
+		cvt_dist = (cvt_dist >= 0) ? e->gs.sw_value :
+			-e->gs.sw_value;
+
+	/* twilight points are placed relative to rp0 */
+	if (e->gs.gep1 == 0) {
+		e->zp1->org[p].x = e->zp0->org[rp0].x +
+			hint_mul14(cvt_dist, e->gs.free_x);
+		e->zp1->org[p].y = e->zp0->org[rp0].y +
+			hint_mul14(cvt_dist, e->gs.free_y);
+		e->zp1->cur[p] = e->zp1->org[p];
+	}
+
+	org_dist = hint_dualproj(e, e->zp1->org[p].x - e->zp0->org[rp0].x,
+			e->zp1->org[p].y - e->zp0->org[rp0].y);
+	cur_dist = hint_project(e, e->zp1->cur[p].x - e->zp0->cur[rp0].x,
+			e->zp1->cur[p].y - e->zp0->cur[rp0].y);
+
+	if (e->gs.auto_flip && (org_dist ^ cvt_dist) < 0)
+		cvt_dist = -cvt_dist;
+
+	if (op & 4) {
+		/* the cut-in test only applies within one zone */
+		if (e->gs.gep0 == e->gs.gep1 &&
+				hint_abs(cvt_dist - org_dist) >
+				e->gs.cvt_cutin)
+			cvt_dist = org_dist;
+		distance = hint_round(e, cvt_dist);
+	} else {
+		distance = cvt_dist;
+	}
+
+	if (op & 8) {
+		if (org_dist >= 0) {
+			if (distance < e->gs.min_distance)
+				distance = e->gs.min_distance;
+		} else {
+			if (distance > -e->gs.min_distance)
+				distance = -e->gs.min_distance;
+		}
+	}
+
+	hint_move(e, e->zp1, p, distance - cur_dist);
+
+	e->gs.rp1 = rp0;
+	e->gs.rp2 = p;
+	if (op & 16)
+		e->gs.rp0 = p;
+	return 0;
+}
+
+/* Execute instructions from ip until the end of the program, or
+ * until ENDF when running a function
+ *
+ * Returns 1 on error
+ */
+static int hint_run(hint_exec_t* e, const uint8_t* code, uint32_t size,
+		uint32_t ip, int in_function)
+{
+	while (ip < size) {
+		uint8_t		op = code[ip];
+		uint32_t	next;
+		uint32_t	len;
+		int32_t		a;
+		int32_t		b;
+		int32_t		i;
+
+		len = hint_ins_len(code, size, ip);
+		if (!len || --e->budget < 0)
+			return 1;
+		next = ip + len;
+
+		switch (op) {
+		case 0x00: case 0x01:/* SVTCA */
+		case 0x02: case 0x03:/* SPVTCA */
+		case 0x04: case 0x05:/* SFVTCA */
+			a = (op & 1) ? 0x4000 : 0;
+			b = (op & 1) ? 0 : 0x4000;
+			if (op < 0x04) {
+				e->gs.proj_x = e->gs.dual_x = a;
+				e->gs.proj_y = e->gs.dual_y = b;
+			}
+			if (op < 0x02 || op >= 0x04) {
+				e->gs.free_x = a;
+				e->gs.free_y = b;
+			}
+			hint_compute_funcs(e);
+			break;
+		case 0x06: case 0x07:/* SPVTL */
+		case 0x08: case 0x09:/* SFVTL */
+			HINT_POP(a);
+			HINT_POP(b);
+			if (!hint_valid(e->zp2, a) || !hint_valid(e->zp1, b))
+				return 1;
+			if (op < 0x08) {
+				hint_line_vector(
+					e->zp1->cur[b].x - e->zp2->cur[a].x,
+					e->zp1->cur[b].y - e->zp2->cur[a].y,
+					op & 1, &e->gs.proj_x, &e->gs.proj_y);
+				e->gs.dual_x = e->gs.proj_x;
+				e->gs.dual_y = e->gs.proj_y;
+			} else {
+				hint_line_vector(
+					e->zp1->cur[b].x - e->zp2->cur[a].x,
+					e->zp1->cur[b].y - e->zp2->cur[a].y,
+					op & 1, &e->gs.free_x, &e->gs.free_y);
+			}
+			hint_compute_funcs(e);
+			break;
+		case 0x0A:/* SPVFS */
+			HINT_POP(b);
+			HINT_POP(a);
+			hint_normalize(a, b, &e->gs.proj_x, &e->gs.proj_y);
+			e->gs.dual_x = e->gs.proj_x;
+			e->gs.dual_y = e->gs.proj_y;
+			hint_compute_funcs(e);
+			break;
+		case 0x0B:/* SFVFS */
+			HINT_POP(b);
+			HINT_POP(a);
+			hint_normalize(a, b, &e->gs.free_x, &e->gs.free_y);
+			hint_compute_funcs(e);
+			break;
+		case 0x0C:/* GPV */
+			HINT_PUSH(e->gs.proj_x);
+			HINT_PUSH(e->gs.proj_y);
+			break;
+		case 0x0D:/* GFV */
+			HINT_PUSH(e->gs.free_x);
+			HINT_PUSH(e->gs.free_y);
+			break;
+		case 0x0E:/* SFVTPV */
+			e->gs.free_x = e->gs.proj_x;
+			e->gs.free_y = e->gs.proj_y;
+			hint_compute_funcs(e);
+			break;
+		case 0x0F:/* ISECT */
+			if (hint_ins_isect(e))
+				return 1;
+			break;
+		case 0x10:/* SRP0 */
+			HINT_POP(e->gs.rp0);
+			break;
+		case 0x11:/* SRP1 */
+			HINT_POP(e->gs.rp1);
+			break;
+		case 0x12:/* SRP2 */
+			HINT_POP(e->gs.rp2);
+			break;
+		case 0x13: case 0x14: case 0x15:/* SZP0, SZP1, SZP2 */
+			HINT_POP(a);
+			if (hint_set_zone(e, op - 0x13, a))
+				return 1;
+			break;
+		case 0x16:/* SZPS */
+			HINT_POP(a);
+			if (hint_set_zone(e, 0, a) || hint_set_zone(e, 1, a) ||
+					hint_set_zone(e, 2, a))
+				return 1;
+			break;
+		case 0x17:/* SLOOP */
+			HINT_POP(a);
+			if (a < 0)
+				return 1;
+			e->gs.loop = (a > 0xFFFF) ? 0xFFFF : a;
+			break;
+		case 0x18:/* RTG */
+			e->gs.round_state = HINT_ROUND_GRID;
+			break;
+		case 0x19:/* RTHG */
+			e->gs.round_state = HINT_ROUND_HALF_GRID;
+			break;
+		case 0x1A:/* SMD */
+			HINT_POP(e->gs.min_distance);
+			break;
+		case 0x1B:/* ELSE */
+			if (hint_skip_if(code, size, &next, 0))
+				return 1;
+			break;
+		case 0x1C:/* JMPR */
+			HINT_POP(a);
+			if (a == 0 || (int64_t) ip + a < 0 ||
+					(int64_t) ip + a > size)
+				return 1;
+			next = ip + a;
+			break;
+		case 0x1D:/* SCVTCI */
+			HINT_POP(e->gs.cvt_cutin);
+			break;
+		case 0x1E:/* SSWCI */
+			HINT_POP(e->gs.sw_cutin);
+			break;
+		case 0x1F:/* SSW */
+			HINT_POP(a);
+			e->gs.sw_value = hint_mulfix(a, e->scale);
+			break;
+		case 0x20:/* DUP */
+			if (e->sp < 1)
+				return 1;
+			HINT_PUSH(e->stack[e->sp-1]);
+			break;
+		case 0x21:/* POP */
+			HINT_POP(a);
+			break;
+		case 0x22:/* CLEAR */
+			e->sp = 0;
+			break;
+		case 0x23:/* SWAP */
+			if (e->sp < 2)
+				return 1;
+			a = e->stack[e->sp-1];
+			e->stack[e->sp-1] = e->stack[e->sp-2];
+			e->stack[e->sp-2] = a;
+			break;
+		case 0x24:/* DEPTH */
+			HINT_PUSH(e->sp);
+			break;
+		case 0x25:/* CINDEX */
+			HINT_POP(a);
+			if (a <= 0 || a > e->sp)
+				return 1;
+			HINT_PUSH(e->stack[e->sp-a]);
+			break;
+		case 0x26:/* MINDEX */
+			HINT_POP(a);
+			if (a <= 0 || a > e->sp)
+				return 1;
+			b = e->stack[e->sp-a];
+			memmove(e->stack + e->sp - a, e->stack + e->sp - a + 1,
+					sizeof(int32_t) * (a - 1));
+			e->stack[e->sp-1] = b;
+			break;
+		case 0x27:/* ALIGNPTS */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(e->zp1, a) || !hint_valid(e->zp0, b))
+				return 1;
+			i = hint_project(e,
+					e->zp0->cur[b].x - e->zp1->cur[a].x,
+					e->zp0->cur[b].y - e->zp1->cur[a].y) / 2;
+			hint_move(e, e->zp1, a, i);
+			hint_move(e, e->zp0, b, -i);
+			break;
+		case 0x29:/* UTP */
+			HINT_POP(a);
+			if (!hint_valid(e->zp0, a))
+				return 1;
+			if (e->gs.free_x)
+				e->zp0->flags[a] &= ~HINT_TOUCH_X;
+			if (e->gs.free_y)
+				e->zp0->flags[a] &= ~HINT_TOUCH_Y;
+			break;
+		case 0x2A:/* LOOPCALL */
+			HINT_POP(a);
+			HINT_POP(b);
+			if (a < 0 || a >= e->hint->max_functions)
+				return 1;
+			while (b-- > 0) {
+				if (hint_call(e, &e->hint->functions[a]))
+					return 1;
+			}
+			break;
+		case 0x2B:/* CALL */
+			HINT_POP(a);
+			if (a < 0 || a >= e->hint->max_functions ||
+					hint_call(e, &e->hint->functions[a]))
+				return 1;
+			break;
+		case 0x2C:/* FDEF */
+			HINT_POP(a);
+			if (a < 0 || a >= e->hint->max_functions)
+				return 1;
+			e->hint->functions[a].code = code;
+			e->hint->functions[a].size = size;
+			e->hint->functions[a].start = next;
+			e->hint->functions[a].defined = 1;
+			if (hint_skip_def(code, size, &next))
+				return 1;
+			break;
+		case 0x2D:/* ENDF */
+			return in_function ? 0 : 1;
+		case 0x2E: case 0x2F:/* MDAP */
+			HINT_POP(a);
+			if (!hint_valid(e->zp0, a))
+				return 1;
+			b = 0;
+			if (op & 1) {
+				b = hint_project(e, e->zp0->cur[a].x,
+						e->zp0->cur[a].y);
+				b = hint_round(e, b) - b;
+			}
+			hint_move(e, e->zp0, a, b);
+			e->gs.rp0 = e->gs.rp1 = a;
+			break;
+		case 0x30: case 0x31:/* IUP */
+			if (hint_ins_iup(e, !(op & 1)))
+				return 1;
+			break;
+		case 0x32: case 0x33:/* SHP */
+		case 0x34: case 0x35:/* SHC */
+		case 0x36: case 0x37:/* SHZ */
+		case 0x38:/* SHPIX */
+			if (hint_ins_shift(e, op))
+				return 1;
+			break;
+		case 0x39:/* IP */
+			if (hint_ins_ip(e))
+				return 1;
+			break;
+		case 0x3A: case 0x3B:/* MSIRP */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(e->zp1, a) ||
+					!hint_valid(e->zp0, e->gs.rp0))
+				return 1;
+			if (e->gs.gep1 == 0) {
+				e->zp1->org[a] = e->zp0->org[e->gs.rp0];
+				hint_move_orig(e, e->zp1, a, b);
+				e->zp1->cur[a] = e->zp1->org[a];
+			}
+			i = hint_project(e,
+				e->zp1->cur[a].x - e->zp0->cur[e->gs.rp0].x,
+				e->zp1->cur[a].y - e->zp0->cur[e->gs.rp0].y);
+			hint_move(e, e->zp1, a, b - i);
+			e->gs.rp1 = e->gs.rp0;
+			e->gs.rp2 = a;
+			if (op & 1)
+				e->gs.rp0 = a;
+			break;
+		case 0x3C:/* ALIGNRP */
+			if (!hint_valid(e->zp0, e->gs.rp0)) {
+				e->gs.loop = 1;
+				return 1;
+			}
+			while (e->gs.loop-- > 0) {
+				HINT_POP(a);
+				if (!hint_valid(e->zp1, a))
+					return 1;
+				i = hint_project(e,
+					e->zp1->cur[a].x -
+					e->zp0->cur[e->gs.rp0].x,
+					e->zp1->cur[a].y -
+					e->zp0->cur[e->gs.rp0].y);
+				hint_move(e, e->zp1, a, -i);
+			}
+			e->gs.loop = 1;
+			break;
+		case 0x3D:/* RTDG */
+			e->gs.round_state = HINT_ROUND_DOUBLE_GRID;
+			break;
+		case 0x3E: case 0x3F:/* MIAP */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(e->zp0, a) || b < 0 || b >= e->ncvt)
+				return 1;
+			b = e->cvt[b];
+			if (e->gs.gep0 == 0) {
+				e->zp0->org[a].x = hint_mul14(b, e->gs.free_x);
+				e->zp0->org[a].y = hint_mul14(b, e->gs.free_y);
+				e->zp0->cur[a] = e->zp0->org[a];
+			}
+			i = hint_project(e, e->zp0->cur[a].x,
+					e->zp0->cur[a].y);
+			if (op & 1) {
+				if (hint_abs(b - i) > e->gs.cvt_cutin)
+					b = i;
+				b = hint_round(e, b);
+			}
+			hint_move(e, e->zp0, a, b - i);
+			e->gs.rp0 = e->gs.rp1 = a;
+			break;
+		case 0x40:/* NPUSHB */
+			for (i = 0; i < code[ip+1]; ++i)
+				HINT_PUSH(code[ip+2+i]);
+			break;
+		case 0x41:/* NPUSHW */
+			for (i = 0; i < code[ip+1]; ++i)
+				HINT_PUSH((int16_t) hint_rd16(code+ip+2+i*2));
+			break;
+		case 0x42:/* WS */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (a < 0 || a >= e->hint->max_storage)
+				return 1;
+			e->storage[a] = b;
+			break;
+		case 0x43:/* RS */
+			HINT_POP(a);
+			if (a < 0 || a >= e->hint->max_storage)
+				return 1;
+			HINT_PUSH(e->storage[a]);
+			break;
+		case 0x44:/* WCVTP */
+		case 0x70:/* WCVTF */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (a < 0 || a >= e->ncvt)
+				return 1;
+			e->cvt[a] = (op == 0x70) ? hint_mulfix(b, e->scale) : b;
+			break;
+		case 0x45:/* RCVT */
+			HINT_POP(a);
+			if (a < 0 || a >= e->ncvt)
+				return 1;
+			HINT_PUSH(e->cvt[a]);
+			break;
+		case 0x46: case 0x47:/* GC */
+			HINT_POP(a);
+			if (!hint_valid(e->zp2, a))
+				return 1;
+			if (op & 1)
+				b = hint_dualproj(e, e->zp2->org[a].x,
+						e->zp2->org[a].y);
+			else
+				b = hint_project(e, e->zp2->cur[a].x,
+						e->zp2->cur[a].y);
+			HINT_PUSH(b);
+			break;
+		case 0x48:/* SCFS */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(e->zp2, a))
+				return 1;
+			i = hint_project(e, e->zp2->cur[a].x,
+					e->zp2->cur[a].y);
+			hint_move(e, e->zp2, a, b - i);
+			if (e->gs.gep2 == 0)
+				e->zp2->org[a] = e->zp2->cur[a];
+			break;
+		case 0x49: case 0x4A:/* MD */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(e->zp0, a) || !hint_valid(e->zp1, b))
+				return 1;
+			if (op & 1)
+				i = hint_project(e,
+					e->zp0->cur[a].x - e->zp1->cur[b].x,
+					e->zp0->cur[a].y - e->zp1->cur[b].y);
+			else
+				i = hint_org_dist(e, e->zp0, a, e->zp1, b);
+			HINT_PUSH(i);
+			break;
+		case 0x4B:/* MPPEM */
+		case 0x4C:/* MPS */
+			HINT_PUSH(e->ppem);
+			break;
+		case 0x4D:/* FLIPON */
+			e->gs.auto_flip = 1;
+			break;
+		case 0x4E:/* FLIPOFF */
+			e->gs.auto_flip = 0;
+			break;
+		case 0x4F:/* DEBUG */
+			HINT_POP(a);
+			break;
+		case 0x50: case 0x51: case 0x52:/* LT, LTEQ, GT */
+		case 0x53: case 0x54: case 0x55:/* GTEQ, EQ, NEQ */
+		case 0x5A: case 0x5B:/* AND, OR */
+		case 0x60: case 0x61:/* ADD, SUB */
+		case 0x62: case 0x63:/* DIV, MUL */
+		case 0x8B: case 0x8C:/* MAX, MIN */
+			HINT_POP(b);
+			HINT_POP(a);
+			switch (op) {
+				case 0x50: a = a < b; break;
+				case 0x51: a = a <= b; break;
+				case 0x52: a = a > b; break;
+				case 0x53: a = a >= b; break;
+				case 0x54: a = a == b; break;
+				case 0x55: a = a != b; break;
+				case 0x5A: a = a && b; break;
+				case 0x5B: a = a || b; break;
+				case 0x60: a = a + b; break;
+				case 0x61: a = a - b; break;
+				case 0x62:
+					if (b == 0)
+						return 1;
+					a = hint_muldiv_no_round(a, 64, b);
+					break;
+				case 0x63: a = hint_muldiv(a, b, 64); break;
+				case 0x8B: a = (a > b) ? a : b; break;
+				default: a = (a < b) ? a : b;
+			}
+			HINT_PUSH(a);
+			break;
+		case 0x56:/* ODD */
+		case 0x57:/* EVEN */
+			HINT_POP(a);
+			a = hint_round(e, a) & 127;
+			HINT_PUSH((op == 0x56) ? (a == 64) : (a == 0));
+			break;
+		case 0x58:/* IF */
+			HINT_POP(a);
+			if (!a && hint_skip_if(code, size, &next, 1))
+				return 1;
+			break;
+		case 0x59:/* EIF */
+			break;
+		case 0x5C:/* NOT */
+			HINT_POP(a);
+			HINT_PUSH(!a);
+			break;
+		case 0x5D: case 0x71: case 0x72:/* DELTAP1-3 */
+		case 0x73: case 0x74: case 0x75:/* DELTAC1-3 */
+			if (hint_ins_delta(e, op))
+				return 1;
+			break;
+		case 0x5E:/* SDB */
+			HINT_POP(e->gs.delta_base);
+			break;
+		case 0x5F:/* SDS */
+			HINT_POP(a);
+			if (a < 0 || a > 6)
+				return 1;
+			e->gs.delta_shift = a;
+			break;
+		case 0x64:/* ABS */
+			HINT_POP(a);
+			HINT_PUSH(hint_abs(a));
+			break;
+		case 0x65:/* NEG */
+			HINT_POP(a);
+			HINT_PUSH(-a);
+			break;
+		case 0x66:/* FLOOR */
+			HINT_POP(a);
+			HINT_PUSH(a & -64);
+			break;
+		case 0x67:/* CEILING */
+			HINT_POP(a);
+			HINT_PUSH((a + 63) & -64);
+			break;
+		case 0x68: case 0x69: case 0x6A: case 0x6B:/* ROUND */
+			HINT_POP(a);
+			HINT_PUSH(hint_round(e, a));
+			break;
+		case 0x6C: case 0x6D: case 0x6E: case 0x6F:/* NROUND */
+			/* no engine compensation */
+			break;
+		case 0x76:/* SROUND */
+			HINT_POP(a);
+			hint_set_super(e, 0x4000, a);
+			e->gs.round_state = HINT_ROUND_SUPER;
+			break;
+		case 0x77:/* S45ROUND */
+			HINT_POP(a);
+			hint_set_super(e, 0x2D41, a);
+			e->gs.round_state = HINT_ROUND_SUPER45;
+			break;
+		case 0x78: case 0x79:/* JROT, JROF */
+			HINT_POP(b);
+			HINT_POP(a);
+			if ((op == 0x78) == (b != 0)) {
+				if (a == 0 || (int64_t) ip + a < 0 ||
+						(int64_t) ip + a > size)
+					return 1;
+				next = ip + a;
+			}
+			break;
+		case 0x7A:/* ROFF */
+			e->gs.round_state = HINT_ROUND_OFF;
+			break;
+		case 0x7C:/* RUTG */
+			e->gs.round_state = HINT_ROUND_UP;
+			break;
+		case 0x7D:/* RDTG */
+			e->gs.round_state = HINT_ROUND_DOWN;
+			break;
+		case 0x7E:/* SANGW */
+		case 0x7F:/* AA */
+			HINT_POP(a);
+			break;
+		case 0x80:/* FLIPPT */
+			while (e->gs.loop-- > 0) {
+				HINT_POP(a);
+				if (!hint_valid(&e->zones[1], a))
+					return 1;
+				e->zones[1].flags[a] ^= HINT_ON_CURVE;
+			}
+			e->gs.loop = 1;
+			break;
+		case 0x81: case 0x82:/* FLIPRGON, FLIPRGOFF */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (!hint_valid(&e->zones[1], a) ||
+					!hint_valid(&e->zones[1], b) || a > b)
+				return 1;
+			for (i = a; i <= b; ++i) {
+				if (op == 0x81)
+					e->zones[1].flags[i] |= HINT_ON_CURVE;
+				else
+					e->zones[1].flags[i] &= ~HINT_ON_CURVE;
+			}
+			break;
+		case 0x85:/* SCANCTRL */
+			HINT_POP(e->gs.scan_control);
+			break;
+		case 0x86: case 0x87:/* SDPVTL */
+			HINT_POP(a);
+			HINT_POP(b);
+			if (!hint_valid(e->zp2, a) || !hint_valid(e->zp1, b))
+				return 1;
+			hint_line_vector(
+				e->zp1->org[b].x - e->zp2->org[a].x,
+				e->zp1->org[b].y - e->zp2->org[a].y,
+				op & 1, &e->gs.dual_x, &e->gs.dual_y);
+			hint_line_vector(
+				e->zp1->cur[b].x - e->zp2->cur[a].x,
+				e->zp1->cur[b].y - e->zp2->cur[a].y,
+				op & 1, &e->gs.proj_x, &e->gs.proj_y);
+			hint_compute_funcs(e);
+			break;
+		case 0x88:/* GETINFO */
+			HINT_POP(a);
+			b = 0;
+			if (a & 1)
+				b = 35;/* rasterizer version */
+			if ((a & 8) && e->ttf->var)
+				b |= 1 << 10;/* font variations */
+			HINT_PUSH(b);
+			break;
+		case 0x89:/* IDEF */
+			HINT_POP(a);
+			if (a < 0 || a > 0xFF)
+				return 1;
+			e->hint->idefs[a].code = code;
+			e->hint->idefs[a].size = size;
+			e->hint->idefs[a].start = next;
+			e->hint->idefs[a].defined = 1;
+			if (hint_skip_def(code, size, &next))
+				return 1;
+			break;
+		case 0x8A:/* ROLL */
+			if (e->sp < 3)
+				return 1;
+			a = e->stack[e->sp-3];
+			e->stack[e->sp-3] = e->stack[e->sp-2];
+			e->stack[e->sp-2] = e->stack[e->sp-1];
+			e->stack[e->sp-1] = a;
+			break;
+		case 0x8D:/* SCANTYPE */
+			HINT_POP(e->gs.scan_type);
+			break;
+		case 0x8E:/* INSTCTRL */
+			HINT_POP(b);
+			HINT_POP(a);
+			if (e->is_prep && b >= 1 && b <= 3) {
+				b = 1 << (b - 1);
+				e->gs.instruct_control &= ~b;
+				if (a)
+					e->gs.instruct_control |= b;
+			}
+			break;
+		case 0x91:/* GETVARIATION */
+			if (!e->ttf->var)
+				return 1;
+			for (i = 0; i < e->ttf->var->naxes; ++i)
+				HINT_PUSH((int32_t) (e->ttf->var->coords[i] *
+							16384.f));
+			break;
+		default:
+			if (op >= 0xB0 && op <= 0xB7) {
+				/* PUSHB */
+				for (i = 0; i <= op - 0xB0; ++i)
+					HINT_PUSH(code[ip+1+i]);
+			} else if (op >= 0xB8 && op <= 0xBF) {
+				/* PUSHW */
+				for (i = 0; i <= op - 0xB8; ++i)
+					HINT_PUSH((int16_t)
+						hint_rd16(code+ip+1+i*2));
+			} else if (op >= 0xE0) {
+				if (hint_ins_mirp(e, op))
+					return 1;
+			} else if (op >= 0xC0) {
+				if (hint_ins_mdrp(e, op))
+					return 1;
+			} else if (e->hint->idefs[op].defined) {
+				if (hint_call(e, &e->hint->idefs[op]))
+					return 1;
+			} else {
+				return 1;
+			}
+		}
+		ip = next;
+	}
+	return in_function;
+}
+
+/* Set up an execution context with a stack and scratch copies of the
+ * control values, storage area and twilight zone
+ */
+static void hint_exec_init(hint_exec_t* e, ttf_t* ttf, uint16_t ppem,
+		int32_t scale)
+{
+	ttf_hint_t*	hint = ttf->hint;
+
+	memset(e, 0, sizeof(hint_exec_t));
+	e->ttf = ttf;
+	e->hint = hint;
+	e->ppem = ppem;
+	e->scale = scale;
+	e->orus_scale = scale;
+	e->budget = HINT_MAX_INSTRUCTIONS;
+	e->stack_size = hint->max_stack + HINT_STACK_SLACK;
+	e->stack = malloc(sizeof(int32_t) * e->stack_size);
+	e->ncvt = hint->ncvt;
+	e->cvt = calloc(hint->ncvt + 1, sizeof(int32_t));
+	e->storage = calloc(hint->max_storage + 1, sizeof(int32_t));
+	e->zones[0].npoints = hint->max_twilight;
+	e->zones[0].org = calloc(hint->max_twilight + 1,
+			sizeof(ttf_point_t));
+	e->zones[0].cur = calloc(hint->max_twilight + 1,
+			sizeof(ttf_point_t));
+	e->zones[0].flags = calloc(hint->max_twilight + 1, 1);
+	e->zp0 = e->zp1 = e->zp2 = &e->zones[1];
+	hint_default_gs(&e->gs);
+	hint_compute_funcs(e);
+}
+
+static void hint_exec_free(hint_exec_t* e)
+{
+	free(e->stack);
+	free(e->cvt);
+	free(e->storage);
+	free(e->zones[0].org);
+	free(e->zones[0].cur);
+	free(e->zones[0].flags);
+}
+
+/* Returns the state at a size, running the font program and the
+ * control value program if the size is not known yet
+ */
+static ttf_hint_size_t* hint_get_size(ttf_t* ttf, uint16_t ppem)
+{
+	ttf_hint_t*		hint = ttf->hint;
+	ttf_hint_size_t*	s;
+	hint_exec_t		e;
+	int			i;
+
+	for (i = 0; i < TTF_HINT_SIZES; ++i) {
+		if (hint->sizes[i].ppem == ppem)
+			return &hint->sizes[i];
+	}
+
+	s = &hint->sizes[hint->next_size];
+	hint->next_size = (hint->next_size + 1) % TTF_HINT_SIZES;
+
+	s->ppem = ppem;
+	s->scale = hint_divfix(ppem * 64, ttf->upem);
+
+	hint_exec_init(&e, ttf, ppem, s->scale);
+	/* control values are scaled from 26.6 at reduced precision, the
+	 * same way FreeType does it, so that rounding decisions in the
+	 * cvt program come out the same */
+	for (i = 0; i < hint->ncvt; ++i)
+		e.cvt[i] = hint_mulfix(hint->cvt[i] * 64, s->scale >> 6);
+
+	if (hint->fpgm && hint_run(&e, hint->fpgm, hint->fpgm_len, 0, 0)) {
+		hint_warn("Warning: error in font program, "
+				"hinting disabled\n");
+		e.gs.instruct_control |= 1;
+	} else if (hint->prep) {
+		e.sp = 0;
+		e.is_prep = 1;
+		e.budget = HINT_MAX_INSTRUCTIONS;
+		hint_default_gs(&e.gs);
+		hint_compute_funcs(&e);
+		e.zp0 = e.zp1 = e.zp2 = &e.zones[1];
+
+		/* like other rasterizers, carry on with whatever state the
+		 * control value program left if it fails */
+		hint_run(&e, hint->prep, hint->prep_len, 0, 0);
+	}
+
+	/* the glyph programs get a fresh copy of this state */
+	free(s->cvt);
+	free(s->storage);
+	free(s->twilight);
+	s->cvt = e.cvt;
+	s->storage = e.storage;
+	s->twilight = malloc(sizeof(ttf_point_t) *
+			(hint->max_twilight * 2 + 1));
+	memcpy(s->twilight, e.zones[0].org,
+			sizeof(ttf_point_t) * hint->max_twilight);
+	memcpy(s->twilight + hint->max_twilight, e.zones[0].cur,
+			sizeof(ttf_point_t) * hint->max_twilight);
+	s->gs = e.gs;
+	hint_reset_gs(&s->gs);
+
+	e.cvt = NULL;
+	e.storage = NULL;
+	hint_exec_free(&e);
+	return s;
+}
+
+
+/* Returns the outline of glyph i at the current variation instance */
+static ttf_glyph_data_t* hint_glyph_data(ttf_t* ttf, uint16_t i)
+{
+	return ttf->var ? ttf_var_glyph(ttf, i) : &ttf->glyph_data[i];
+}
+
+/* Grid-fit glyph i into cur and flags, which have room for the points
+ * of the glyph and the phantom points
+ */
+static void hint_outline(ttf_t* ttf, ttf_hint_size_t* size, uint16_t i,
+		int depth, ttf_point_t* cur, uint8_t* flags)
+{
+	ttf_glyph_data_t*	glyph = hint_glyph_data(ttf, i);
+	ttf_point_t*		org;
+	int			np = glyph->npoints;
+	int			n = np + HINT_PHANTOM_POINTS;
+	int			j;
+
+	if (glyph->composite && glyph->components &&
+			depth < HINT_MAX_COMPONENT_DEPTH) {
+		hint_compose(ttf, size, i, depth, cur, flags);
+		return;
+	}
+
+	org = malloc(sizeof(ttf_point_t) * n);
+	hint_scaled(ttf->hint, size, glyph, org);
+	memcpy(cur, org, sizeof(ttf_point_t) * n);
+	cur[np+1].x = (cur[np+1].x + 32) & -64;
+	cur[np+2].y = (cur[np+2].y + 32) & -64;
+	cur[np+3].y = (cur[np+3].y + 32) & -64;
+	for (j = 0; j < n; ++j)
+		flags[j] = (j < np && glyph->state[j] == 1) ?
+			HINT_ON_CURVE : 0;
+
+	hint_program(ttf, size, glyph, 0, org, cur, flags);
+	free(org);
+}
+
+/* Grid-fit the components of composite glyph i with their own
+ * programs, place them like ttf_add_component does and run the
+ * program of the composite on the result
+ */
+static void hint_compose(ttf_t* ttf, ttf_hint_size_t* size, uint16_t i,
+		int depth, ttf_point_t* cur, uint8_t* flags)
+{
+	ttf_glyph_data_t*	glyph = hint_glyph_data(ttf, i);
+	ttf_component_t*	components;
+	ttf_point_t*		org;
+	int			ncomponents = glyph->ncomponents;
+	int			np = glyph->npoints;
+	int			n = np + HINT_PHANTOM_POINTS;
+	int32_t			lsb = hint_mulfix(glyph->lsb, size->scale);
+	int			metrics = 0;
+	int			m = 0;
+	int			k;
+	int			j;
+
+	/* requesting the components may replace the outline of
+	 * the composite, so its component records are copied */
+	components = malloc(sizeof(ttf_component_t) * (ncomponents + 1));
+	memcpy(components, glyph->components,
+			sizeof(ttf_component_t) * ncomponents);
+
+	for (k = 0; k < ncomponents; ++k) {
+		ttf_component_t*	c = &components[k];
+		ttf_glyph_data_t*	cg = hint_glyph_data(ttf, c->glyph);
+		ttf_point_t*		pts;
+		uint8_t*		pflags;
+		int			cn = cg->npoints;
+		int32_t			clsb = hint_mulfix(cg->lsb, size->scale);
+		int32_t			xx, xy, yx, yy;
+		int32_t			dx = 0;
+		int32_t			dy = 0;
+
+		if (cn == 0 || m + cn > np)
+			continue;
+
+		pts = malloc(sizeof(ttf_point_t) * (cn + HINT_PHANTOM_POINTS));
+		pflags = calloc(cn + HINT_PHANTOM_POINTS, 1);
+		hint_outline(ttf, size, c->glyph, depth + 1, pts, pflags);
+
+		/* back to the origin of the glyph table, then through
+		 * the transform of the component in 16.16 */
+		xx = (int32_t) (c->xx * 65536);
+		xy = (int32_t) (c->xy * 65536);
+		yx = (int32_t) (c->yx * 65536);
+		yy = (int32_t) (c->yy * 65536);
+		for (j = 0; j < cn; ++j) {
+			int32_t	x = pts[j].x + clsb;
+			int32_t	y = pts[j].y;
+			pts[j].x = hint_mulfix(x, xx) + hint_mulfix(y, yx);
+			pts[j].y = hint_mulfix(x, xy) + hint_mulfix(y, yy);
+		}
+
+		if (c->flags & TTF_ARGUMENTS_ARE_XY) {
+			float	ox = c->dx;
+			float	oy = c->dy;
+			if ((c->flags & TTF_SCALED_COMPONENT_OFFSET) &&
+					!(c->flags & TTF_UNSCALED_COMPONENT_OFFSET)) {
+				ox = c->xx * c->dx + c->yx * c->dy;
+				oy = c->xy * c->dx + c->yy * c->dy;
+			}
+			dx = hint_mulfix((int32_t) floor(ox + .5f), size->scale);
+			dy = hint_mulfix((int32_t) floor(oy + .5f), size->scale);
+			if (c->flags & TTF_ROUND_XY_TO_GRID) {
+				dx = (dx + 32) & -64;
+				dy = (dy + 32) & -64;
+			}
+		} else if (c->dx < m && c->dy < cn) {
+			/* match the grid-fitted points */
+			dx = cur[c->dx].x + lsb - pts[c->dy].x;
+			dy = cur[c->dx].y - pts[c->dy].y;
+		}
+
+		for (j = 0; j < cn; ++j) {
+			cur[m+j].x = pts[j].x + dx - lsb;
+			cur[m+j].y = pts[j].y + dy;
+			flags[m+j] = pflags[j] & HINT_ON_CURVE;
+		}
+		if (c->flags & TTF_USE_THESE_METRICS) {
+			metrics = 1;
+			memcpy(cur + np, pts + cn,
+				sizeof(ttf_point_t) * HINT_PHANTOM_POINTS);
+		}
+		m += cn;
+		free(pts);
+		free(pflags);
+	}
+	free(components);
+
+	glyph = hint_glyph_data(ttf, i);
+	org = malloc(sizeof(ttf_point_t) * n);
+	hint_scaled(ttf->hint, size, glyph, org);
+	for (j = m; j < np; ++j) {
+		cur[j] = org[j];
+		flags[j] = glyph->state[j] == 1 ? HINT_ON_CURVE : 0;
+	}
+	if (!metrics) {
+		memcpy(cur + np, org + np,
+			sizeof(ttf_point_t) * HINT_PHANTOM_POINTS);
+		cur[np+1].x = (cur[np+1].x + 32) & -64;
+		cur[np+2].y = (cur[np+2].y + 32) & -64;
+		cur[np+3].y = (cur[np+3].y + 32) & -64;
+	}
+	for (j = np; j < n; ++j)
+		flags[j] = 0;
+
+	/* the program of the composite starts out from the
+	 * grid-fitted components */
+	memcpy(org, cur, sizeof(ttf_point_t) * n);
+	hint_program(ttf, size, glyph, 1, org, cur, flags);
+	free(org);
+}
+
+/* Copy the points of a glyph and its phantom points, in font units
+ * with the origin at (0, 0)
+ */
+static void hint_orus(ttf_hint_t* hint, ttf_glyph_data_t* glyph,
+		ttf_point_t* orus)
+{
+	int	np = glyph->npoints;
+	int	j;
+
+	for (j = 0; j < np; ++j) {
+		orus[j].x = glyph->px[j] - glyph->lsb;
+		orus[j].y = glyph->py[j];
+	}
+	orus[np].x = 0;
+	orus[np].y = 0;
+	orus[np+1].x = glyph->aw;
+	orus[np+1].y = 0;
+	orus[np+2].x = 0;
+	orus[np+2].y = hint->ascender;
+	orus[np+3].x = 0;
+	orus[np+3].y = hint->descender;
+}
+
+/* Same as hint_orus, scaled to 26.6 */
+static void hint_scaled(ttf_hint_t* hint, ttf_hint_size_t* size,
+		ttf_glyph_data_t* glyph, ttf_point_t* org)
+{
+	int	j;
+
+	hint_orus(hint, glyph, org);
+	for (j = 0; j < glyph->npoints + HINT_PHANTOM_POINTS; ++j) {
+		org[j].x = hint_mulfix(org[j].x, size->scale);
+		org[j].y = hint_mulfix(org[j].y, size->scale);
+	}
+}
+
+/* Run the program of a glyph on its points, which are at org before
+ * grid-fitting and at cur as grid-fitted so far
+ *
+ * The program of a composite glyph measures the original outline on
+ * the grid-fitted components rather than in font units, which is
+ * undocumented but what the Windows rasterizer and FreeType do.
+ */
+static void hint_program(ttf_t* ttf, ttf_hint_size_t* size,
+		ttf_glyph_data_t* glyph, int composite, ttf_point_t* org,
+		ttf_point_t* cur, uint8_t* flags)
+{
+	ttf_hint_t*	hint = ttf->hint;
+	hint_exec_t	e;
+	hint_zone_t*	z;
+	int		n = glyph->npoints + HINT_PHANTOM_POINTS;
+
+	if (!glyph->ninstructions || (size->gs.instruct_control & 1))
+		return;
+
+	hint_exec_init(&e, ttf, size->ppem, size->scale);
+	memcpy(e.cvt, size->cvt, sizeof(int32_t) * e.ncvt);
+	memcpy(e.storage, size->storage, sizeof(int32_t) * hint->max_storage);
+	memcpy(e.zones[0].org, size->twilight,
+			sizeof(ttf_point_t) * hint->max_twilight);
+	memcpy(e.zones[0].cur, size->twilight + hint->max_twilight,
+			sizeof(ttf_point_t) * hint->max_twilight);
+
+	z = &e.zones[1];
+	z->npoints = n;
+	z->ncontours = glyph->ncontours;
+	z->endpoints = glyph->endpoints;
+	z->orus = malloc(sizeof(ttf_point_t) * n);
+	z->org = org;
+	z->cur = cur;
+	z->flags = flags;
+	if (composite) {
+		memcpy(z->orus, cur, sizeof(ttf_point_t) * n);
+		e.orus_scale = 1 << 16;
+	} else {
+		hint_orus(hint, glyph, z->orus);
+	}
+
+	if (size->gs.instruct_control & 2)
+		hint_default_gs(&e.gs);
+	else
+		e.gs = size->gs;
+	hint_reset_gs(&e.gs);
+	hint_compute_funcs(&e);
+	e.zp0 = e.zp1 = e.zp2 = &e.zones[1];
+
+	/* errors in glyph programs are ignored, like other
+	 * rasterizers do, and the partially hinted outline used */
+	hint_run(&e, glyph->instructions, glyph->ninstructions, 0, 0);
+
+	free(z->orus);
+	hint_exec_free(&e);
+}
@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CTTF_HINT_H
+#define CTTF_HINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ttf.h"
+
+/* number of cached hinted glyphs (must be a power of two) */
+#define TTF_HINT_CACHE_SIZE	(256)
+/* number of sizes (ppem) for which the cvt program result is kept */
+#define TTF_HINT_SIZES		(4)
+
+typedef struct ttf_hint_gs	ttf_hint_gs_t;
+typedef struct ttf_hint_func	ttf_hint_func_t;
+typedef struct ttf_hint_size	ttf_hint_size_t;
+typedef struct ttf_hinted	ttf_hinted_t;
+
+/* graphics state of the instruction interpreter */
+struct ttf_hint_gs {
+	/* unit vectors in 2.14 fixed point */
+	int32_t		proj_x, proj_y;
+	int32_t		dual_x, dual_y;
+	int32_t		free_x, free_y;
+
+	int		round_state;
+	int32_t		period;/* super rounding */
+	int32_t		phase;
+	int32_t		threshold;
+
+	int32_t		loop;
+	int32_t		min_distance;
+	int32_t		cvt_cutin;
+	int32_t		sw_cutin;
+	int32_t		sw_value;
+	int32_t		delta_base;
+	int32_t		delta_shift;
+	int		auto_flip;
+	int		instruct_control;
+	int32_t		scan_control;
+	int32_t		scan_type;
+
+	int32_t		rp0, rp1, rp2;
+	int		gep0, gep1, gep2;
+};
+
+/* function or instruction definition */
+struct ttf_hint_func {
+	const uint8_t*	code;
+	uint32_t	size;
+	uint32_t	start;
+	int		defined;
+};
+
+/* state left by the font and cvt programs at one size */
+struct ttf_hint_size {
+	uint16_t	ppem;
+	int32_t		scale;/* font units to 26.6, in 16.16 */
+	int32_t*	cvt;
+	int32_t*	storage;
+	ttf_point_t*	twilight;
+	ttf_hint_gs_t	gs;
+};
+
+/* a glyph outline grid-fitted at some size */
+struct ttf_hinted {
+	uint16_t	glyph;
+	uint16_t	ppem;
+	uint32_t	instance;/* variation instance */
+	int		npoints;/* including the four phantom points */
+	ttf_point_t*	points;/* 26.6 pixels, origin at (0, 0) */
+	int*		state;
+};
+
+struct ttf_hint {
+	/* font program, cvt program and control values */
+	uint8_t*	fpgm;
+	uint32_t	fpgm_len;
+	uint8_t*	prep;
+	uint32_t	prep_len;
+	int16_t*	cvt;
+	int		ncvt;
+
+	/* limits from the 'maxp' table */
+	int		max_twilight;
+	int		max_storage;
+	int		max_functions;
+	int		max_stack;
+
+	int16_t		ascender;
+	int16_t		descender;
+
+	ttf_hint_func_t*	functions;
+	ttf_hint_func_t		idefs[256];
+
+	ttf_hint_size_t	sizes[TTF_HINT_SIZES];
+	int		next_size;
+
+	ttf_hinted_t	cache[TTF_HINT_CACHE_SIZE];
+};
+
+/* Load the 'fpgm', 'prep' and 'cvt ' tables
+ *
+ * Returns 1 on error
+ */
+int ttf_hint_load(FILE* file, ttf_t* ttf);
+void free_ttf_hint(ttf_hint_t** hint);
+
+/* Returns glyph i grid-fitted at ppem pixels per em
+ *
+ * The glyph program runs the first time a glyph is requested at a
+ * size, later requests are served from a cache keyed by (glyph,
+ * ppem, variation instance). The returned glyph stays valid until
+ * another glyph is requested.
+ *
+ * The components of a composite glyph are grid-fitted with their own
+ * programs before the program of the composite runs. Glyphs without
+ * instructions are only scaled.
+ */
+ttf_hinted_t* ttf_hint_glyph(ttf_t* ttf, uint16_t i, uint16_t ppem);
+
+#endif
+
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Indexed triangle mesh
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include "mesh.h"
+
+mesh_t* new_mesh(int nvec, int ntri)
+{
+	mesh_t*	obj = malloc(sizeof(mesh_t));
+	obj->vecs = malloc(sizeof(vector_t) * (nvec > 0 ? nvec : 1));
+	obj->nvec = 0;
+	obj->ntri = ntri;
+	obj->idx16 = NULL;
+	obj->idx32 = NULL;
+	/* never ask for zero bytes, a NULL idx16 selects idx32 */
+	if (ntri < 1)
+		ntri = 1;
+	if (nvec <= MESH_MAX_IDX16)
+		obj->idx16 = malloc(sizeof(uint16_t) * 3 * ntri);
+	else
+		obj->idx32 = malloc(sizeof(uint32_t) * 3 * ntri);
+	return obj;
+}
+
+void free_mesh(mesh_t** mesh)
+{
+	assert(mesh != NULL);
+	if (*mesh == NULL) return;
+	free((*mesh)->vecs);
+	free((*mesh)->idx16);
+	free((*mesh)->idx32);
+	free(*mesh);
+	*mesh = NULL;
+}
+
+uint32_t mesh_index(mesh_t* mesh, int i)
+{
+	if (mesh->idx16 != NULL)
+		return mesh->idx16[i];
+	else
+		return mesh->idx32[i];
+}
+
+void mesh_set_index(mesh_t* mesh, int i, uint32_t index)
+{
+	if (mesh->idx16 != NULL)
+		mesh->idx16[i] = (uint16_t) index;
+	else
+		mesh->idx32[i] = index;
+}
@@ -17,16 +17,40 @@
  * along with cTTF; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+/*
+ * Indexed triangle mesh
+ */
 #ifndef CTTF_MESH_H
 #define CTTF_MESH_H
 
+#include <stdint.h>
 #include "vector.h"
 
+/* largest vertex count that uses 16 bit indices */
+#define MESH_MAX_IDX16	(0x10000)
+
 typedef struct mesh	mesh_t;
 
+/* Allocate a mesh with room for nvec vertices and ntri triangles
+ *
+ * Vertices are added by the caller, nvec starts at zero.
+ */
+mesh_t* new_mesh(int nvec, int ntri);
+void free_mesh(mesh_t** mesh);
+
+/* Returns index i of the index array */
+uint32_t mesh_index(mesh_t* mesh, int i);
+void mesh_set_index(mesh_t* mesh, int i, uint32_t index);
+
 struct mesh {
 	vector_t*	vecs;
+	int		nvec;
+	int		ntri;
+
+	/* three vertex indices per triangle, idx16 is used if the mesh
+	 * has at most MESH_MAX_IDX16 vertices and idx32 otherwise */
+	uint16_t*	idx16;
+	uint32_t*	idx32;
 };
 
 #endif
-
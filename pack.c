@@ -0,0 +1,529 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Glyph mesh pack
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "pack.h"
+#include "var.h"
+#include "simplify.h"
+#include "snapround.h"
+#include "triangulate.h"
+#include "vcache.h"
+
+/* Round a byte count up to a multiple of four */
+static uint32_t align4(uint32_t n)
+{
+	return (n + 3) & ~(uint32_t)3;
+}
+
+static uint32_t pack_flags(ttf_t* ttf)
+{
+	uint32_t	flags = 0;
+	if (ttf->fixed_point)
+		flags |= PACK_FIXED_POINT;
+	if (ttf->hinting)
+		flags |= PACK_HINTING;
+	return flags;
+}
+
+/* Combine the checksums and lengths of the tables that hold the
+ * outlines, as given in the table directory
+ */
+static uint32_t outline_checksum(ttf_t* ttf)
+{
+	ttf_table_header_t*	tables[4];
+	uint32_t		sum = 0;
+	int			i;
+
+	tables[0] = ttf->glyf;
+	tables[1] = ttf->cff;
+	tables[2] = ttf->fvar;
+	tables[3] = ttf->gvar;
+	for (i = 0; i < 4; ++i) {
+		sum = (sum << 7 | sum >> 25);
+		if (tables[i])
+			sum ^= tables[i]->checksum + tables[i]->length;
+	}
+	return sum;
+}
+
+static int cmp_chr(const void* a, const void* b)
+{
+	return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b;
+}
+
+static int write_padded(FILE* fp, const void* data, uint32_t size)
+{
+	static const uint8_t	zero[4];
+	uint32_t		pad = align4(size) - size;
+
+	if (size && fwrite(data, size, 1, fp) != 1)
+		return -1;
+	if (pad && fwrite(zero, pad, 1, fp) != 1)
+		return -1;
+	return 0;
+}
+
+static uint32_t index_size(uint32_t nvec)
+{
+	return nvec <= MESH_MAX_IDX16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+int write_pack(FILE* fp, ttf_t* ttf, const uint16_t* chrs, int n,
+		float tolerance, float snap, int options)
+{
+	pack_header_t	header;
+	pack_glyph_t*	glyphs;
+	shape_t**	shapes;
+	mesh_t**	meshes;
+	qmesh_t**	qmeshes;
+	uint16_t*	sorted;
+	triangulator_t*	triangulator = new_triangulator();
+	int		compress = options & PACK_COMPRESS;
+	uint32_t	offset;
+	int		nglyphs = 0;
+	int		result = 0;
+	int		i;
+
+	assert(fp != NULL);
+	assert(ttf != NULL);
+
+	sorted = malloc(sizeof(uint16_t) * (n > 0 ? n : 1));
+	glyphs = malloc(sizeof(pack_glyph_t) * (n > 0 ? n : 1));
+	shapes = malloc(sizeof(shape_t*) * (n > 0 ? n : 1));
+	meshes = malloc(sizeof(mesh_t*) * (n > 0 ? n : 1));
+	qmeshes = malloc(sizeof(qmesh_t*) * (n > 0 ? n : 1));
+	if (n > 0)
+		memcpy(sorted, chrs, sizeof(uint16_t) * n);
+	qsort(sorted, n, sizeof(uint16_t), cmp_chr);
+
+	for (i = 0; i < n; ++i) {
+		uint16_t	chr = sorted[i];
+		shape_t*	shape;
+		mesh_t*		mesh;
+
+		if (i > 0 && chr == sorted[i-1])
+			continue;
+		if (!ttf->glyph_table[chr])
+			continue;
+		shape = ttf_export_chr_shape(ttf, chr);
+		if (!shape)
+			continue;
+		if (tolerance > 0) {
+			shape_t*	simple;
+			simple = simplify_shape(shape, tolerance);
+			free_shape(&shape);
+			shape = simple;
+		}
+		if (snap > 0) {
+			shape_t*	snapped;
+			snapped = snap_round(shape, snap);
+			free_shape(&shape);
+			shape = snapped;
+		}
+		mesh = triangulator_mesh(triangulator, shape);
+		if (!mesh) {
+			free_shape(&shape);
+			continue;
+		}
+		if (options & PACK_OPTIMIZE)
+			optimize_vertex_cache(mesh);
+
+		glyphs[nglyphs].chr = chr;
+		glyphs[nglyphs].advance = ttf_char_width(ttf, chr);
+		glyphs[nglyphs].nvec = mesh->nvec;
+		glyphs[nglyphs].ntri = mesh->ntri;
+		glyphs[nglyphs].nsvec = shape->nvec;
+		glyphs[nglyphs].nseg = shape->nseg;
+		glyphs[nglyphs].mesh_size = 0;
+		qmeshes[nglyphs] = NULL;
+		if (compress) {
+			qmeshes[nglyphs] = quantize_mesh(mesh);
+			glyphs[nglyphs].mesh_size =
+				qmesh_encode(qmeshes[nglyphs], NULL);
+		}
+		shapes[nglyphs] = shape;
+		meshes[nglyphs] = mesh;
+		nglyphs += 1;
+	}
+
+	/* lay out the glyph data after the records */
+	offset = sizeof(pack_header_t) + sizeof(pack_glyph_t) * nglyphs;
+	for (i = 0; i < nglyphs; ++i) {
+		pack_glyph_t*	glyph = &glyphs[i];
+
+		glyph->vecs = offset;
+		if (compress) {
+			glyph->idx = 0;
+			offset += align4(glyph->mesh_size);
+		} else {
+			offset += sizeof(vector_t) * glyph->nvec;
+			glyph->idx = offset;
+			offset += align4(index_size(glyph->nvec) * 3 *
+					glyph->ntri);
+		}
+		glyph->svecs = offset;
+		offset += sizeof(vector_t) * glyph->nsvec;
+		glyph->segs = offset;
+		offset += sizeof(uint32_t) * 2 * glyph->nseg;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+	header.version = PACK_VERSION;
+	header.byte_order = PACK_BYTE_ORDER;
+	header.size = offset;
+	header.nglyphs = nglyphs;
+	header.font_checksum = ttf->fh->checksumAdjust;
+	header.outline_checksum = outline_checksum(ttf);
+	header.font_glyphs = ttf->nglyphs;
+	header.upem = ttf->upem;
+	header.ppem = ttf->hinting ? ttf->ppem : 0;
+	header.flags = pack_flags(ttf);
+	header.interpolation_level = ttf->interpolation_level;
+	header.tolerance = tolerance > 0 ? tolerance : 0;
+	header.snap = snap > 0 ? snap : 0;
+	header.compressed = compress ? 1 : 0;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1)
+		result = -1;
+	if (!result && nglyphs &&
+			fwrite(glyphs, sizeof(pack_glyph_t), nglyphs, fp) != nglyphs)
+		result = -1;
+	for (i = 0; !result && i < nglyphs; ++i) {
+		pack_glyph_t*	glyph = &glyphs[i];
+		mesh_t*		mesh = meshes[i];
+		shape_t*	shape = shapes[i];
+		uint32_t*	segs;
+		int		j;
+
+		if (compress) {
+			uint8_t*	buf = malloc(glyph->mesh_size);
+			qmesh_encode(qmeshes[i], buf);
+			result = write_padded(fp, buf, glyph->mesh_size);
+			free(buf);
+		} else if (write_padded(fp, mesh->vecs,
+					sizeof(vector_t) * glyph->nvec)) {
+			result = -1;
+		} else if (mesh->idx16)
+			result = write_padded(fp, mesh->idx16,
+					sizeof(uint16_t) * 3 * glyph->ntri);
+		else
+			result = write_padded(fp, mesh->idx32,
+					sizeof(uint32_t) * 3 * glyph->ntri);
+		if (result)
+			break;
+		if (write_padded(fp, shape->vec,
+					sizeof(vector_t) * glyph->nsvec)) {
+			result = -1;
+			break;
+		}
+		segs = malloc(sizeof(uint32_t) * 2 * (glyph->nseg + 1));
+		for (j = 0; j < 2 * glyph->nseg; ++j)
+			segs[j] = shape->seg[j];
+		result = write_padded(fp, segs,
+				sizeof(uint32_t) * 2 * glyph->nseg);
+		free(segs);
+	}
+
+	for (i = 0; i < nglyphs; ++i) {
+		free_shape(&shapes[i]);
+		free_mesh(&meshes[i]);
+		free_qmesh(&qmeshes[i]);
+	}
+	free(sorted);
+	free(glyphs);
+	free(shapes);
+	free(meshes);
+	free(qmeshes);
+	free_triangulator(&triangulator);
+	return result ? -1 : nglyphs;
+}
+
+/* Returns non-zero if the array of count items of size bytes at offset
+ * lies within the pack and is aligned
+ */
+static int in_pack(size_t size, uint32_t offset, uint32_t count,
+		uint32_t item)
+{
+	uint64_t	end = (uint64_t)offset + (uint64_t)count * item;
+	return offset % 4 == 0 && end <= size;
+}
+
+/* Check the header and the glyph records of a pack
+ */
+static int validate_pack(pack_t* pack)
+{
+	const pack_header_t*	header;
+	uint32_t		i;
+
+	if (pack->size < sizeof(pack_header_t))
+		return 0;
+	header = (const pack_header_t*)pack->data;
+	if (memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) ||
+			header->version != PACK_VERSION ||
+			header->byte_order != PACK_BYTE_ORDER ||
+			header->size != pack->size)
+		return 0;
+	if (!(header->tolerance >= 0) || !(header->snap >= 0))
+		return 0;
+	if (!in_pack(pack->size, sizeof(pack_header_t), header->nglyphs,
+				sizeof(pack_glyph_t)))
+		return 0;
+
+	pack->header = header;
+	pack->glyphs = (const pack_glyph_t*)
+		(pack->data + sizeof(pack_header_t));
+	for (i = 0; i < header->nglyphs; ++i) {
+		const pack_glyph_t*	glyph = &pack->glyphs[i];
+
+		if (glyph->chr > 0xFFFF)
+			return 0;
+		if (i > 0 && glyph->chr <= pack->glyphs[i-1].chr)
+			return 0;
+		if (header->compressed) {
+			if (!in_pack(pack->size, glyph->vecs,
+						glyph->mesh_size, 1))
+				return 0;
+		} else if (!in_pack(pack->size, glyph->vecs, glyph->nvec,
+					sizeof(vector_t)) ||
+				!in_pack(pack->size, glyph->idx, glyph->ntri,
+					3 * index_size(glyph->nvec))) {
+			return 0;
+		}
+		if (!in_pack(pack->size, glyph->svecs, glyph->nsvec,
+					sizeof(vector_t)) ||
+				!in_pack(pack->size, glyph->segs, glyph->nseg,
+					2 * sizeof(uint32_t)))
+			return 0;
+	}
+	return 1;
+}
+
+pack_t* load_pack(const char* path)
+{
+	pack_t*		pack;
+#ifdef _WIN32
+	FILE*		fp;
+	long		size;
+#else
+	struct stat	st;
+	void*		data;
+	int		fd;
+#endif
+
+	assert(path != NULL);
+
+	pack = malloc(sizeof(pack_t));
+	pack->data = NULL;
+	pack->size = 0;
+	pack->mapped = 0;
+	pack->header = NULL;
+	pack->glyphs = NULL;
+
+#ifdef _WIN32
+	fp = fopen(path, "rb");
+	if (!fp) {
+		free(pack);
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (size > 0) {
+		pack->data = malloc(size);
+		pack->size = size;
+		if (fread(pack->data, size, 1, fp) != 1)
+			pack->size = 0;
+	}
+	fclose(fp);
+#else
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		free(pack);
+		return NULL;
+	}
+	if (!fstat(fd, &st) && st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			pack->data = data;
+			pack->size = st.st_size;
+			pack->mapped = 1;
+		}
+	}
+	close(fd);
+#endif
+
+	if (!validate_pack(pack)) {
+		fprintf(stderr, "Invalid glyph pack \"%s\"\n", path);
+		free_pack(&pack);
+		return NULL;
+	}
+	return pack;
+}
+
+void free_pack(pack_t** pack)
+{
+	pack_t*	p;
+	assert(pack != NULL);
+	p = *pack;
+	if (!p) return;
+#ifndef _WIN32
+	if (p->mapped)
+		munmap(p->data, p->size);
+	else
+#endif
+		free(p->data);
+	free(p);
+	*pack = NULL;
+}
+
+int pack_matches(pack_t* pack, ttf_t* ttf)
+{
+	const pack_header_t*	header;
+
+	assert(pack != NULL);
+	assert(ttf != NULL);
+
+	header = pack->header;
+	/* only the default instance of a variable font is baked */
+	if (ttf->var && ttf->var->instance != 0)
+		return 0;
+	return header->font_checksum == ttf->fh->checksumAdjust &&
+		header->outline_checksum == outline_checksum(ttf) &&
+		header->font_glyphs == ttf->nglyphs &&
+		header->upem == ttf->upem &&
+		header->flags == pack_flags(ttf) &&
+		header->ppem == (ttf->hinting ? ttf->ppem : 0) &&
+		header->interpolation_level == ttf->interpolation_level;
+}
+
+const pack_glyph_t* pack_find(pack_t* pack, uint16_t chr)
+{
+	int	lo = 0;
+	int	hi;
+
+	assert(pack != NULL);
+
+	hi = pack->header->nglyphs;
+	while (lo < hi) {
+		int	mid = lo + (hi - lo) / 2;
+		if (pack->glyphs[mid].chr < chr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < pack->header->nglyphs && pack->glyphs[lo].chr == chr)
+		return &pack->glyphs[lo];
+	return NULL;
+}
+
+mesh_t* pack_mesh(pack_t* pack, const pack_glyph_t* glyph)
+{
+	mesh_t*		mesh;
+	uint32_t	nidx = 3 * glyph->ntri;
+	uint32_t	i;
+
+	assert(pack != NULL);
+	assert(glyph != NULL);
+
+	if (pack->header->compressed) {
+		qmesh_t*	qmesh = pack_qmesh(pack, glyph);
+		if (!qmesh)
+			return NULL;
+		mesh = dequantize_mesh(qmesh);
+		free_qmesh(&qmesh);
+		return mesh;
+	}
+
+	mesh = new_mesh(glyph->nvec, glyph->ntri);
+	memcpy(mesh->vecs, pack->data + glyph->vecs,
+			sizeof(vector_t) * glyph->nvec);
+	mesh->nvec = glyph->nvec;
+	if (mesh->idx16) {
+		memcpy(mesh->idx16, pack->data + glyph->idx,
+				sizeof(uint16_t) * nidx);
+		for (i = 0; i < nidx; ++i)
+			if (mesh->idx16[i] >= glyph->nvec)
+				break;
+	} else {
+		memcpy(mesh->idx32, pack->data + glyph->idx,
+				sizeof(uint32_t) * nidx);
+		for (i = 0; i < nidx; ++i)
+			if (mesh->idx32[i] >= glyph->nvec)
+				break;
+	}
+	if (i < nidx)
+		free_mesh(&mesh);
+	return mesh;
+}
+
+qmesh_t* pack_qmesh(pack_t* pack, const pack_glyph_t* glyph)
+{
+	qmesh_t*	qmesh;
+	mesh_t*		mesh;
+
+	assert(pack != NULL);
+	assert(glyph != NULL);
+
+	if (pack->header->compressed)
+		return qmesh_decode(pack->data + glyph->vecs,
+				glyph->mesh_size);
+	mesh = pack_mesh(pack, glyph);
+	if (!mesh)
+		return NULL;
+	qmesh = quantize_mesh(mesh);
+	free_mesh(&mesh);
+	return qmesh;
+}
+
+shape_t* pack_shape(pack_t* pack, const pack_glyph_t* glyph)
+{
+	shape_t*		shape;
+	const vector_t*		vecs;
+	const uint32_t*		segs;
+	uint32_t		i;
+
+	assert(pack != NULL);
+	assert(glyph != NULL);
+
+	vecs = (const vector_t*)(pack->data + glyph->svecs);
+	segs = (const uint32_t*)(pack->data + glyph->segs);
+	for (i = 0; i < 2 * glyph->nseg; ++i)
+		if (segs[i] >= glyph->nsvec)
+			return NULL;
+
+	shape = new_shape();
+	for (i = 0; i < glyph->nsvec; ++i)
+		shape_add_vec(shape, vecs[i].x, vecs[i].y);
+	for (i = 0; i < glyph->nseg; ++i)
+		shape_add_seg(shape, segs[i*2], segs[i*2+1]);
+	return shape;
+}
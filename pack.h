@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Glyph mesh pack
+ *
+ * A pack holds the outlines and triangle meshes of the glyphs of a
+ * font for a set of characters. It is written offline by cttf-bake and
+ * mapped into memory at run time, so the glyphs can be drawn without
+ * flattening and triangulating them.
+ *
+ * The file is in native byte order. It starts with a pack_header_t
+ * followed by nglyphs pack_glyph_t records sorted by character. The
+ * vertex, index and segment arrays of the glyphs follow, each at a
+ * byte offset from the start of the file that is a multiple of four.
+ *
+ * In a compressed pack the mesh of a glyph is instead stored as the
+ * qmesh_encode data of its quantized mesh.
+ */
+#ifndef CTTF_PACK_H
+#define CTTF_PACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ttf.h"
+#include "shape.h"
+#include "mesh.h"
+#include "qmesh.h"
+
+#define PACK_MAGIC	"CTTFPACK"
+#define PACK_VERSION	(4)
+#define PACK_BYTE_ORDER	(0x01020304)
+
+/* flags of the outline settings a pack was baked with */
+#define PACK_FIXED_POINT	(1)
+#define PACK_HINTING		(2)
+
+/* options of write_pack */
+#define PACK_COMPRESS		(1)/* quantize and delta encode meshes */
+#define PACK_OPTIMIZE		(2)/* order triangles for vertex caches */
+
+typedef struct pack		pack_t;
+typedef struct pack_header	pack_header_t;
+typedef struct pack_glyph	pack_glyph_t;
+
+/* Write a pack of the characters in chrs, flattened at the current
+ * interpolation level of the font, simplified with tolerance and snap
+ * rounded to a grid with spacing snap (0 to disable either, see
+ * font_t). Characters without a glyph are left out. options is a
+ * combination of PACK_COMPRESS and PACK_OPTIMIZE.
+ *
+ * Returns the number of glyphs written, or -1 if writing failed.
+ */
+int write_pack(FILE* fp, ttf_t* ttf, const uint16_t* chrs, int n,
+		float tolerance, float snap, int options);
+
+/* Map a pack file, returns NULL if it can not be read or is invalid */
+pack_t* load_pack(const char* path);
+void free_pack(pack_t** pack);
+
+/* Returns non-zero if the pack was baked from the same font as ttf,
+ * with the same outline settings. The font is identified by the
+ * checksum adjustment of its head table and the checksums of its
+ * outline and variation tables.
+ */
+int pack_matches(pack_t* pack, ttf_t* ttf);
+
+/* Returns the record of a character, or NULL if it is not in the pack */
+const pack_glyph_t* pack_find(pack_t* pack, uint16_t chr);
+
+/* Copy the mesh or outline of a glyph out of the pack, returns NULL if
+ * the glyph data is corrupt
+ */
+mesh_t* pack_mesh(pack_t* pack, const pack_glyph_t* glyph);
+qmesh_t* pack_qmesh(pack_t* pack, const pack_glyph_t* glyph);
+shape_t* pack_shape(pack_t* pack, const pack_glyph_t* glyph);
+
+struct pack_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	byte_order;/* PACK_BYTE_ORDER as written */
+	uint32_t	size;/* file size in bytes */
+	uint32_t	nglyphs;
+
+	/* the font and outline settings */
+	uint32_t	font_checksum;/* head checksum adjustment, as stored */
+	uint32_t	outline_checksum;/* glyf, CFF, fvar and gvar tables */
+	uint32_t	font_glyphs;/* number of glyphs in the font */
+	uint32_t	upem;
+	uint32_t	ppem;
+	uint32_t	flags;
+	uint32_t	interpolation_level;
+	float		tolerance;
+	float		snap;/* snap rounding grid */
+	uint32_t	compressed;/* the meshes are encoded qmeshes */
+};
+
+struct pack_glyph {
+	uint32_t	chr;
+	float		advance;/* ttf_char_width */
+
+	/* the triangle mesh, three 16 bit indices per triangle if nvec
+	 * is at most MESH_MAX_IDX16 and 32 bit indices otherwise */
+	uint32_t	nvec;
+	uint32_t	ntri;
+	uint32_t	vecs;
+	uint32_t	idx;
+	uint32_t	mesh_size;/* size of the encoded mesh at vecs */
+
+	/* the outline, used for the sides of extruded glyphs */
+	uint32_t	nsvec;
+	uint32_t	nseg;
+	uint32_t	svecs;
+	uint32_t	segs;/* two 32 bit indices per segment */
+};
+
+struct pack {
+	uint8_t*		data;
+	size_t			size;
+	int			mapped;/* data is mapped, otherwise allocated */
+	const pack_header_t*	header;
+	const pack_glyph_t*	glyphs;
+};
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/* Take items from the current job until there are none left.
+ * Called with the mutex held and returns with it held.
+ */
+static void work(pool_t* pool, int thread)
+{
+	while (pool->next < pool->n) {
+		int	index = pool->next++;
+
+		pthread_mutex_unlock(&pool->mutex);
+		pool->fn(pool->arg, index, thread);
+		pthread_mutex_lock(&pool->mutex);
+	}
+}
+
+static void* worker(void* arg)
+{
+	pool_worker_t*	self = arg;
+	pool_t*		pool = self->pool;
+	unsigned	generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->quit)
+			break;
+
+		generation = pool->generation;
+		pool->busy += 1;
+		work(pool, self->id);
+		pool->busy -= 1;
+		if (pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+pool_t* new_pool(int nthreads)
+{
+	pool_t*	pool = malloc(sizeof(pool_t));
+	int	i;
+
+	if (nthreads <= 0) {
+		long	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpu > 0 ? (int) ncpu : 1;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->fn = NULL;
+	pool->arg = NULL;
+	pool->n = 0;
+	pool->next = 0;
+	pool->busy = 0;
+	pool->generation = 0;
+	pool->quit = 0;
+
+	/* the thread calling pool_run is one of the workers */
+	pool->nthreads = 0;
+	pool->workers = malloc(sizeof(pool_worker_t) * nthreads);
+	for (i = 0; i < nthreads - 1; ++i) {
+		pool_worker_t*	w = &pool->workers[pool->nthreads];
+
+		w->pool = pool;
+		w->id = pool->nthreads + 1;
+		if (pthread_create(&w->thread, NULL, worker, w))
+			break;
+		pool->nthreads += 1;
+	}
+	return pool;
+}
+
+void free_pool(pool_t** pool)
+{
+	pool_t*	p;
+	int	i;
+
+	assert(pool != NULL);
+
+	p = *pool;
+	if (!p) return;
+
+	pthread_mutex_lock(&p->mutex);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->mutex);
+	for (i = 0; i < p->nthreads; ++i)
+		pthread_join(p->workers[i].thread, NULL);
+
+	pthread_mutex_destroy(&p->mutex);
+	pthread_cond_destroy(&p->start);
+	pthread_cond_destroy(&p->done);
+	free(p->workers);
+	free(p);
+	*pool = NULL;
+}
+
+int pool_threads(pool_t* pool)
+{
+	return pool->nthreads + 1;
+}
+
+void pool_run(pool_t* pool, pool_fn_t fn, void* arg, int n)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->n = n;
+	pool->next = 0;
+	pool->generation += 1;
+	if (n > 1)
+		pthread_cond_broadcast(&pool->start);
+
+	work(pool, 0);
+
+	/* wait for the items still running on other threads */
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
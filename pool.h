@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Worker pool
+ *
+ * A fixed set of threads that run the items of a job in parallel. The
+ * items are handed out one at a time from a shared counter, so threads
+ * that finish cheap items early keep taking new ones.
+ */
+#ifndef CTTF_POOL_H
+#define CTTF_POOL_H
+
+#include <pthread.h>
+
+typedef struct pool		pool_t;
+typedef struct pool_worker	pool_worker_t;
+
+/* A job item, called with the job argument, the item index and the
+ * index of the thread running it. The calling thread of pool_run is
+ * thread 0, so per-thread scratch data can be kept in an array of
+ * pool_threads(pool) entries.
+ */
+typedef void (*pool_fn_t)(void* arg, int index, int thread);
+
+/* Create a pool with nthreads worker threads. If nthreads is zero or
+ * negative the number of online processors is used.
+ */
+pool_t* new_pool(int nthreads);
+void free_pool(pool_t** pool);
+
+/* Returns the number of threads that run a job, including the caller */
+int pool_threads(pool_t* pool);
+
+/* Run fn(arg, i) for each i in [0, n) and return when all are done.
+ *
+ * The calling thread works on the job too. A pool runs one job at a
+ * time, so fn must not call pool_run on the same pool.
+ */
+void pool_run(pool_t* pool, pool_fn_t fn, void* arg, int n);
+
+struct pool {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	start;/* signalled when a job is posted */
+	pthread_cond_t	done;/* signalled when the last worker leaves a job */
+	pool_worker_t*	workers;
+	int		nthreads;/* threads besides the caller */
+
+	/* the current job */
+	pool_fn_t	fn;
+	void*		arg;
+	int		n;
+	int		next;/* next item to hand out */
+	int		busy;/* workers inside the job */
+	unsigned	generation;/* incremented for each job */
+	int		quit;
+};
+
+struct pool_worker {
+	pool_t*		pool;
+	pthread_t	thread;
+	int		id;
+};
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Robust geometric predicates
+ *
+ * A value x is represented exactly by an expansion: an array of
+ * doubles sorted by increasing magnitude whose sum is x and whose
+ * components do not overlap. The determinant is first evaluated in
+ * plain double precision and only refined when the result is smaller
+ * than the worst case rounding error.
+ */
+#include "predicates.h"
+
+/* 2^-53, half the distance between 1 and the next double */
+#define PRED_EPSILON	(1.1102230246251565e-16)
+/* 2^27 + 1, splits a double into two 26 bit halves */
+#define PRED_SPLITTER	(134217729.0)
+
+/* error bounds, see Shewchuk section 4.3 */
+static const double resulterrbound = (3.0 + 8.0*PRED_EPSILON)*PRED_EPSILON;
+static const double ccwerrbound_a = (3.0 + 16.0*PRED_EPSILON)*PRED_EPSILON;
+static const double ccwerrbound_b = (2.0 + 12.0*PRED_EPSILON)*PRED_EPSILON;
+static const double ccwerrbound_c = (9.0 + 64.0*PRED_EPSILON)
+		*PRED_EPSILON*PRED_EPSILON;
+
+/* x + y = a + b exactly, requires |a| >= |b|
+ */
+static void fast_two_sum(double a, double b, double* x, double* y)
+{
+	double	bvirt;
+	*x = a + b;
+	bvirt = *x - a;
+	*y = b - bvirt;
+}
+
+/* x + y = a + b exactly
+ */
+static void two_sum(double a, double b, double* x, double* y)
+{
+	double	bvirt;
+	double	avirt;
+	*x = a + b;
+	bvirt = *x - a;
+	avirt = *x - bvirt;
+	*y = (a - avirt) + (b - bvirt);
+}
+
+/* Rounding error y of x = a - b
+ */
+static double two_diff_tail(double a, double b, double x)
+{
+	double	bvirt = a - x;
+	double	avirt = x + bvirt;
+	return (a - avirt) + (bvirt - b);
+}
+
+/* x + y = a - b exactly
+ */
+static void two_diff(double a, double b, double* x, double* y)
+{
+	*x = a - b;
+	*y = two_diff_tail(a, b, *x);
+}
+
+/* a = hi + lo where both halves have at most 26 significant bits
+ */
+static void split(double a, double* hi, double* lo)
+{
+	double	c = PRED_SPLITTER * a;
+	double	abig = c - a;
+	*hi = c - abig;
+	*lo = a - *hi;
+}
+
+/* x + y = a * b exactly
+ */
+static void two_product(double a, double b, double* x, double* y)
+{
+	double	ahi, alo;
+	double	bhi, blo;
+	double	err1, err2, err3;
+
+	*x = a * b;
+	split(a, &ahi, &alo);
+	split(b, &bhi, &blo);
+	err1 = *x - (ahi * bhi);
+	err2 = err1 - (alo * bhi);
+	err3 = err2 - (ahi * blo);
+	*y = (alo * blo) - err3;
+}
+
+/* x = (a1 + a0) - (b1 + b0) as a four component expansion
+ */
+static void two_two_diff(double a1, double a0, double b1, double b0,
+		double* x)
+{
+	double	i, j, k;
+
+	two_diff(a0, b0, &i, &x[0]);
+	two_sum(a1, i, &j, &k);
+	two_diff(k, b1, &i, &x[1]);
+	two_sum(j, i, &x[3], &x[2]);
+}
+
+/* h = e + f, returns the length of h
+ *
+ * Zero components are removed from the result. h must have room for
+ * elen + flen components.
+ */
+static int expansion_sum(int elen, const double* e, int flen,
+		const double* f, double* h)
+{
+	double	q, qnew, hh;
+	int	ei = 0;
+	int	fi = 0;
+	int	hi = 0;
+
+	/* merge the components by increasing magnitude */
+	if ((f[0] > e[0]) == (f[0] > -e[0]))
+		q = e[ei++];
+	else
+		q = f[fi++];
+
+	if (ei < elen && fi < flen) {
+		if ((f[fi] > e[ei]) == (f[fi] > -e[ei]))
+			fast_two_sum(e[ei++], q, &qnew, &hh);
+		else
+			fast_two_sum(f[fi++], q, &qnew, &hh);
+		q = qnew;
+		if (hh != 0.0)
+			h[hi++] = hh;
+
+		while (ei < elen && fi < flen) {
+			if ((f[fi] > e[ei]) == (f[fi] > -e[ei]))
+				two_sum(q, e[ei++], &qnew, &hh);
+			else
+				two_sum(q, f[fi++], &qnew, &hh);
+			q = qnew;
+			if (hh != 0.0)
+				h[hi++] = hh;
+		}
+	}
+	while (ei < elen) {
+		two_sum(q, e[ei++], &qnew, &hh);
+		q = qnew;
+		if (hh != 0.0)
+			h[hi++] = hh;
+	}
+	while (fi < flen) {
+		two_sum(q, f[fi++], &qnew, &hh);
+		q = qnew;
+		if (hh != 0.0)
+			h[hi++] = hh;
+	}
+	if (q != 0.0 || hi == 0)
+		h[hi++] = q;
+	return hi;
+}
+
+/* Approximate value of an expansion
+ */
+static double estimate(int elen, const double* e)
+{
+	double	sum = e[0];
+	int	i;
+	for (i = 1; i < elen; ++i)
+		sum += e[i];
+	return sum;
+}
+
+/* Exact orientation when the fast test is inconclusive
+ */
+static double orient2d_adapt(double ax, double ay, double bx, double by,
+		double cx, double cy, double detsum)
+{
+	double	acx = ax - cx;
+	double	bcx = bx - cx;
+	double	acy = ay - cy;
+	double	bcy = by - cy;
+	double	acxtail, acytail, bcxtail, bcytail;
+	double	detleft, detlefttail;
+	double	detright, detrighttail;
+	double	s1, s0, t1, t0;
+	double	det, errbound;
+	double	b[4], u[4];
+	double	c1[8], c2[12], d[16];
+	int	c1len, c2len, dlen;
+
+	two_product(acx, bcy, &detleft, &detlefttail);
+	two_product(acy, bcx, &detright, &detrighttail);
+	two_two_diff(detleft, detlefttail, detright, detrighttail, b);
+
+	det = estimate(4, b);
+	errbound = ccwerrbound_b * detsum;
+	if (det >= errbound || -det >= errbound)
+		return det;
+
+	acxtail = two_diff_tail(ax, cx, acx);
+	bcxtail = two_diff_tail(bx, cx, bcx);
+	acytail = two_diff_tail(ay, cy, acy);
+	bcytail = two_diff_tail(by, cy, bcy);
+
+	if (acxtail == 0.0 && acytail == 0.0 &&
+			bcxtail == 0.0 && bcytail == 0.0)
+		return det;
+
+	errbound = ccwerrbound_c * detsum + resulterrbound *
+		(det >= 0.0 ? det : -det);
+	det += (acx * bcytail + bcy * acxtail) -
+		(acy * bcxtail + bcx * acytail);
+	if (det >= errbound || -det >= errbound)
+		return det;
+
+	two_product(acxtail, bcy, &s1, &s0);
+	two_product(acytail, bcx, &t1, &t0);
+	two_two_diff(s1, s0, t1, t0, u);
+	c1len = expansion_sum(4, b, 4, u, c1);
+
+	two_product(acx, bcytail, &s1, &s0);
+	two_product(acy, bcxtail, &t1, &t0);
+	two_two_diff(s1, s0, t1, t0, u);
+	c2len = expansion_sum(c1len, c1, 4, u, c2);
+
+	two_product(acxtail, bcytail, &s1, &s0);
+	two_product(acytail, bcxtail, &t1, &t0);
+	two_two_diff(s1, s0, t1, t0, u);
+	dlen = expansion_sum(c2len, c2, 4, u, d);
+
+	return d[dlen - 1];
+}
+
+double orient2d(vector_t a, vector_t b, vector_t c)
+{
+	double	detleft = ((double) a.x - c.x) * ((double) b.y - c.y);
+	double	detright = ((double) a.y - c.y) * ((double) b.x - c.x);
+	double	det = detleft - detright;
+	double	detsum;
+
+	if (detleft > 0.0) {
+		if (detright <= 0.0)
+			return det;
+		detsum = detleft + detright;
+	} else if (detleft < 0.0) {
+		if (detright >= 0.0)
+			return det;
+		detsum = -detleft - detright;
+	} else {
+		return det;
+	}
+
+	if (det >= ccwerrbound_a * detsum || -det >= ccwerrbound_a * detsum)
+		return det;
+
+	return orient2d_adapt(a.x, a.y, b.x, b.y, c.x, c.y, detsum);
+}
+
+/* Returns 1 if x and y have strictly opposite signs
+ */
+static int opposite(double x, double y)
+{
+	return (x > 0 && y < 0) || (x < 0 && y > 0);
+}
+
+int seg_cross(vector_t a1, vector_t a2, vector_t b1, vector_t b2)
+{
+	return opposite(orient2d(a1, a2, b1), orient2d(a1, a2, b2)) &&
+		opposite(orient2d(b1, b2, a1), orient2d(b1, b2, a2));
+}
+
+/* Returns 1 if the point p, collinear with a and b, lies on the
+ * segment a-b
+ */
+static int on_seg(vector_t p, vector_t a, vector_t b)
+{
+	return ((a.x <= p.x && p.x <= b.x) || (b.x <= p.x && p.x <= a.x)) &&
+		((a.y <= p.y && p.y <= b.y) || (b.y <= p.y && p.y <= a.y));
+}
+
+int seg_touch(const vector_t* a1, const vector_t* a2,
+		const vector_t* b1, const vector_t* b2)
+{
+	double	o1;
+	double	o2;
+	double	o3;
+	double	o4;
+
+	if ((a1 == b1 && a2 == b2) || (a1 == b2 && a2 == b1))
+		return 1;
+	else if (a1 == b1)
+		return vec_same_dir(*a1, *a2, *b2);
+	else if (a2 == b2)
+		return vec_same_dir(*a2, *a1, *b1);
+	else if (a1 == b2)
+		return vec_same_dir(*a1, *a2, *b1);
+	else if (a2 == b1)
+		return vec_same_dir(*a2, *a1, *b2);
+
+	o1 = orient2d(*a1, *a2, *b1);
+	o2 = orient2d(*a1, *a2, *b2);
+	o3 = orient2d(*b1, *b2, *a1);
+	o4 = orient2d(*b1, *b2, *a2);
+
+	if ((o1 == 0 && on_seg(*b1, *a1, *a2)) ||
+			(o2 == 0 && on_seg(*b2, *a1, *a2)) ||
+			(o3 == 0 && on_seg(*a1, *b1, *b2)) ||
+			(o4 == 0 && on_seg(*a2, *b1, *b2)))
+		return 1;
+
+	return opposite(o1, o2) && opposite(o3, o4);
+}
+
+int vec_same_dir(vector_t o, vector_t a, vector_t b)
+{
+	return orient2d(o, a, b) == 0 &&
+		(a.x > o.x) == (b.x > o.x) && (a.x < o.x) == (b.x < o.x) &&
+		(a.y > o.y) == (b.y > o.y) && (a.y < o.y) == (b.y < o.y);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Robust geometric predicates
+ *
+ * Adaptive precision orientation test after J. R. Shewchuk, "Adaptive
+ * Precision Floating-Point Arithmetic and Fast Robust Geometric
+ * Predicates", 1997. The sign of the result is exact; in the common
+ * case it costs a few floating point operations more than the naive
+ * determinant.
+ *
+ * Requires IEEE 754 double arithmetic with round-to-nearest and no
+ * extended precision intermediates (e.g. SSE2, not x87).
+ */
+#ifndef CTTF_PREDICATES_H
+#define CTTF_PREDICATES_H
+
+#include "vector.h"
+
+/* Orientation of the points a, b, c:
+ * positive if they make a left turn, negative for a right turn
+ * and zero if they are collinear.
+ *
+ * The magnitude approximates twice the signed area of the triangle.
+ */
+double orient2d(vector_t a, vector_t b, vector_t c);
+
+/* Returns 1 if the segments a1-a2 and b1-b2 cross at a single point
+ * that is interior to both segments
+ */
+int seg_cross(vector_t a1, vector_t a2, vector_t b1, vector_t b2);
+
+/* Returns 1 if the segments a1-a2 and b1-b2 have a point in common
+ * other than a shared endpoint
+ *
+ * Endpoints are shared if they are the same object, so distinct points
+ * at the same position do touch. Segments that share an endpoint touch
+ * only if they leave it in the same direction.
+ */
+int seg_touch(const vector_t* a1, const vector_t* a2,
+		const vector_t* b1, const vector_t* b2);
+
+/* Returns 1 if the points o, a, b are collinear and the directions
+ * o->a and o->b are the same
+ */
+int vec_same_dir(vector_t o, vector_t a, vector_t b);
+
+#endif
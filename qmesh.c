@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Quantized triangle mesh
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qmesh.h"
+
+/* Allocate a qmesh with its vertex and index arrays in the same block
+ */
+static qmesh_t* alloc_qmesh(int nvec, int ntri)
+{
+	size_t		nidx = 3 * (size_t)ntri;
+	size_t		size = sizeof(qmesh_t) + sizeof(uint16_t) * 2 * nvec;
+	int		wide = nvec > MESH_MAX_IDX16;
+	qmesh_t*	obj;
+	uint8_t*	p;
+
+	size += nidx * (wide ? sizeof(uint32_t) : sizeof(uint16_t));
+	obj = malloc(size);
+	obj->x0 = obj->y0 = 0;
+	obj->sx = obj->sy = 0;
+	obj->nvec = nvec;
+	obj->ntri = ntri;
+	obj->idx16 = NULL;
+	obj->idx32 = NULL;
+
+	/* the 32 bit indices go first to keep them aligned */
+	p = (uint8_t*)(obj + 1);
+	if (wide) {
+		obj->idx32 = (uint32_t*)p;
+		p += sizeof(uint32_t) * nidx;
+	}
+	obj->vecs = (uint16_t*)p;
+	p += sizeof(uint16_t) * 2 * nvec;
+	if (!wide)
+		obj->idx16 = (uint16_t*)p;
+	return obj;
+}
+
+/* Returns the number of steps from v0 to v, rounded to nearest
+ */
+static uint16_t quantize(float v, float v0, float step)
+{
+	double	q;
+
+	if (step <= 0)
+		return 0;
+	q = floor((v - v0) / (double)step + 0.5);
+	if (q < 0)
+		return 0;
+	if (q > QMESH_STEPS)
+		return QMESH_STEPS;
+	return (uint16_t)q;
+}
+
+qmesh_t* quantize_mesh(mesh_t* mesh)
+{
+	qmesh_t*	obj;
+	float		x1, y1;
+	int		i;
+
+	assert(mesh != NULL);
+
+	obj = alloc_qmesh(mesh->nvec, mesh->ntri);
+	if (mesh->nvec > 0) {
+		obj->x0 = x1 = mesh->vecs[0].x;
+		obj->y0 = y1 = mesh->vecs[0].y;
+		for (i = 1; i < mesh->nvec; ++i) {
+			vector_t	v = mesh->vecs[i];
+			if (v.x < obj->x0) obj->x0 = v.x;
+			if (v.x > x1) x1 = v.x;
+			if (v.y < obj->y0) obj->y0 = v.y;
+			if (v.y > y1) y1 = v.y;
+		}
+		obj->sx = (x1 - obj->x0) / QMESH_STEPS;
+		obj->sy = (y1 - obj->y0) / QMESH_STEPS;
+	}
+	for (i = 0; i < mesh->nvec; ++i) {
+		obj->vecs[i*2] = quantize(mesh->vecs[i].x, obj->x0, obj->sx);
+		obj->vecs[i*2+1] = quantize(mesh->vecs[i].y, obj->y0, obj->sy);
+	}
+	if (obj->idx16)
+		for (i = 0; i < 3 * mesh->ntri; ++i)
+			obj->idx16[i] = mesh_index(mesh, i);
+	else
+		for (i = 0; i < 3 * mesh->ntri; ++i)
+			obj->idx32[i] = mesh_index(mesh, i);
+	return obj;
+}
+
+mesh_t* dequantize_mesh(qmesh_t* qmesh)
+{
+	mesh_t*	mesh;
+	int	i;
+
+	assert(qmesh != NULL);
+
+	mesh = new_mesh(qmesh->nvec, qmesh->ntri);
+	qmesh_decode_vecs(qmesh, mesh->vecs);
+	mesh->nvec = qmesh->nvec;
+	for (i = 0; i < 3 * qmesh->ntri; ++i)
+		mesh_set_index(mesh, i, qmesh_index(qmesh, i));
+	return mesh;
+}
+
+void free_qmesh(qmesh_t** qmesh)
+{
+	assert(qmesh != NULL);
+	free(*qmesh);
+	*qmesh = NULL;
+}
+
+vector_t qmesh_vec(qmesh_t* qmesh, int i)
+{
+	vector_t	v;
+	v.x = qmesh->x0 + qmesh->sx * qmesh->vecs[i*2];
+	v.y = qmesh->y0 + qmesh->sy * qmesh->vecs[i*2+1];
+	return v;
+}
+
+uint32_t qmesh_index(qmesh_t* qmesh, int i)
+{
+	if (qmesh->idx16 != NULL)
+		return qmesh->idx16[i];
+	else
+		return qmesh->idx32[i];
+}
+
+/* A branch-free loop over the interleaved coordinates that compilers
+ * vectorize into widening loads and multiply-adds.
+ */
+void qmesh_decode_vecs(qmesh_t* qmesh, vector_t* out)
+{
+	const uint16_t*	q = qmesh->vecs;
+	const float	x0 = qmesh->x0;
+	const float	y0 = qmesh->y0;
+	const float	sx = qmesh->sx;
+	const float	sy = qmesh->sy;
+	const int	n = qmesh->nvec;
+	int		i;
+
+	for (i = 0; i < n; ++i) {
+		out[i].x = x0 + sx * q[i*2];
+		out[i].y = y0 + sy * q[i*2+1];
+	}
+}
+
+/* Maps small signed deltas to small unsigned numbers */
+static uint64_t zigzag(int64_t v)
+{
+	return v < 0 ? ((uint64_t)-(v + 1) << 1) | 1 : (uint64_t)v << 1;
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return v & 1 ? -(int64_t)(v >> 1) - 1 : (int64_t)(v >> 1);
+}
+
+/* Write v in groups of seven bits, least significant first. Returns
+ * the position after the last byte.
+ */
+static size_t put_varint(uint8_t* buf, size_t pos, uint64_t v)
+{
+	while (v >= 0x80) {
+		if (buf)
+			buf[pos] = (uint8_t)(v & 0x7F) | 0x80;
+		pos += 1;
+		v >>= 7;
+	}
+	if (buf)
+		buf[pos] = (uint8_t)v;
+	return pos + 1;
+}
+
+/* Returns zero if the varint runs past the end of the buffer */
+static int get_varint(const uint8_t* buf, size_t size, size_t* pos,
+		uint64_t* v)
+{
+	int	shift = 0;
+
+	*v = 0;
+	while (*pos < size && shift < 64) {
+		uint8_t	b = buf[*pos];
+		*pos += 1;
+		*v |= (uint64_t)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return 1;
+		shift += 7;
+	}
+	return 0;
+}
+
+/* The encoding is nvec and ntri, the bounding box and step floats, the
+ * deltas of the vertex coordinates, then the deltas of the indices.
+ */
+size_t qmesh_encode(qmesh_t* qmesh, uint8_t* buf)
+{
+	float		box[4];
+	int64_t		x = 0;
+	int64_t		y = 0;
+	int64_t		index = 0;
+	size_t		pos = 0;
+	int		i;
+
+	assert(qmesh != NULL);
+
+	pos = put_varint(buf, pos, qmesh->nvec);
+	pos = put_varint(buf, pos, qmesh->ntri);
+	box[0] = qmesh->x0;
+	box[1] = qmesh->y0;
+	box[2] = qmesh->sx;
+	box[3] = qmesh->sy;
+	if (buf)
+		memcpy(buf + pos, box, sizeof(box));
+	pos += sizeof(box);
+
+	for (i = 0; i < qmesh->nvec; ++i) {
+		pos = put_varint(buf, pos, zigzag(qmesh->vecs[i*2] - x));
+		pos = put_varint(buf, pos, zigzag(qmesh->vecs[i*2+1] - y));
+		x = qmesh->vecs[i*2];
+		y = qmesh->vecs[i*2+1];
+	}
+	for (i = 0; i < 3 * qmesh->ntri; ++i) {
+		int64_t	next = qmesh_index(qmesh, i);
+		pos = put_varint(buf, pos, zigzag(next - index));
+		index = next;
+	}
+	return pos;
+}
+
+qmesh_t* qmesh_decode(const uint8_t* buf, size_t size)
+{
+	qmesh_t*	obj;
+	float		box[4];
+	uint64_t	nvec;
+	uint64_t	ntri;
+	uint64_t	v;
+	int64_t		x = 0;
+	int64_t		y = 0;
+	int64_t		index = 0;
+	size_t		pos = 0;
+	int		i;
+
+	assert(buf != NULL || size == 0);
+
+	if (!get_varint(buf, size, &pos, &nvec) ||
+			!get_varint(buf, size, &pos, &ntri))
+		return NULL;
+	/* every coordinate and index takes at least one byte */
+	if (nvec > size / 2 || ntri > size / 3 ||
+			size - pos < sizeof(box))
+		return NULL;
+	memcpy(box, buf + pos, sizeof(box));
+	pos += sizeof(box);
+
+	obj = alloc_qmesh((int)nvec, (int)ntri);
+	obj->x0 = box[0];
+	obj->y0 = box[1];
+	obj->sx = box[2];
+	obj->sy = box[3];
+	for (i = 0; i < obj->nvec; ++i) {
+		if (!get_varint(buf, size, &pos, &v))
+			break;
+		x += unzigzag(v);
+		if (!get_varint(buf, size, &pos, &v))
+			break;
+		y += unzigzag(v);
+		if (x < 0 || x > QMESH_STEPS || y < 0 || y > QMESH_STEPS)
+			break;
+		obj->vecs[i*2] = (uint16_t)x;
+		obj->vecs[i*2+1] = (uint16_t)y;
+	}
+	if (i < obj->nvec) {
+		free_qmesh(&obj);
+		return NULL;
+	}
+	for (i = 0; i < 3 * obj->ntri; ++i) {
+		if (!get_varint(buf, size, &pos, &v))
+			break;
+		index += unzigzag(v);
+		if (index < 0 || index >= obj->nvec)
+			break;
+		if (obj->idx16)
+			obj->idx16[i] = (uint16_t)index;
+		else
+			obj->idx32[i] = (uint32_t)index;
+	}
+	if (i < 3 * obj->ntri || pos != size)
+		free_qmesh(&obj);
+	return obj;
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Quantized triangle mesh
+ *
+ * A compact copy of a mesh_t for caching many glyphs. The vertices are
+ * stored as 16 bit steps within the bounding box of the mesh, which
+ * halves their size, and the mesh is kept in a single allocation.
+ * Quantizing moves a vertex by about half a step, 1/131070 of the
+ * bounding box.
+ *
+ * For storage a qmesh can be encoded as deltas between consecutive
+ * coordinates and indices, written as variable length integers.
+ */
+#ifndef CTTF_QMESH_H
+#define CTTF_QMESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vector.h"
+#include "mesh.h"
+
+/* number of quantization steps across the bounding box */
+#define QMESH_STEPS	(0xFFFF)
+
+typedef struct qmesh	qmesh_t;
+
+qmesh_t* quantize_mesh(mesh_t* mesh);
+mesh_t* dequantize_mesh(qmesh_t* qmesh);
+void free_qmesh(qmesh_t** qmesh);
+
+/* Returns vertex i or index i of the index array */
+vector_t qmesh_vec(qmesh_t* qmesh, int i);
+uint32_t qmesh_index(qmesh_t* qmesh, int i);
+
+/* Decode all vertices to out, which must have room for nvec vectors */
+void qmesh_decode_vecs(qmesh_t* qmesh, vector_t* out);
+
+/* Write the delta encoding of a qmesh to buf and return its size in
+ * bytes. If buf is NULL only the size is returned.
+ */
+size_t qmesh_encode(qmesh_t* qmesh, uint8_t* buf);
+
+/* Decode a qmesh written by qmesh_encode, returns NULL if the data is
+ * truncated or invalid
+ */
+qmesh_t* qmesh_decode(const uint8_t* buf, size_t size);
+
+struct qmesh {
+	float		x0, y0;/* bounding box minimum */
+	float		sx, sy;/* size of a quantization step */
+	int		nvec;
+	int		ntri;
+
+	/* x and y of each vertex, in steps from x0 and y0 */
+	uint16_t*	vecs;
+
+	/* three vertex indices per triangle, as in mesh_t */
+	uint16_t*	idx16;
+	uint32_t*	idx32;
+};
+
+#endif
@@ -17,70 +17,151 @@
  * along with cTTF; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
+#include <stdlib.h>
+#include <string.h>
+
 #include "qsortv.h"
 
-/* Quicksort utility function
-*/
-static void qsort_swap(vertex_t** a, unsigned x, unsigned y)
+/* Below this size an insertion sort beats the radix passes
+ */
+#define SORT_SMALL	(24)
+
+#define RADIX_BITS	(8)
+#define RADIX_SIZE	(1 << RADIX_BITS)
+#define RADIX_PASSES	(64 / RADIX_BITS)
+
+/* Map the bits of a float to an unsigned integer with the same order
+ */
+static uint32_t float_key(float f)
 {
-	if (x != y) {
-		vertex_t* z = a[x];
-		a[x] = a[y];
-		a[y] = z;
+	uint32_t	u;
+
+	f += 0.0f;/* -0 compares equal to +0 */
+	memcpy(&u, &f, sizeof(u));
+	if (u & 0x80000000u)
+		return ~u;
+	else
+		return u | 0x80000000u;
+}
+
+uint64_t vec_sort_key(vector_t v)
+{
+	return ((uint64_t) ~float_key(v.y) << 32) | float_key(v.x);
+}
+
+static void insertion_sort(void** items, uint64_t* keys, unsigned n)
+{
+	unsigned	i;
+
+	for (i = 1; i < n; ++i) {
+		uint64_t	key = keys[i];
+		void*		item = items[i];
+		unsigned	j = i;
+
+		while (j > 0 && keys[j-1] > key) {
+			keys[j] = keys[j-1];
+			items[j] = items[j-1];
+			j -= 1;
+		}
+		keys[j] = key;
+		items[j] = item;
 	}
 }
 
-/* Main vertex Quicksort function.
- * A vertex p is below a vertex q if
- * py < qy or py == qy and px > qx
- * The vertices are sorted in order of
- * decreasing height.
+/* Sort with temporary arrays, short arrays need none
  */
-static void qsort_work(vertex_t** a, unsigned start, unsigned end)
+void sort_keyed(void** items, uint64_t* keys, unsigned n)
 {
-	unsigned	pivot;
-	unsigned	i;
-	vector_t	pv;
-	unsigned	store;
+	uint64_t*	key_buf;
+	void**		item_buf;
 
-	if (start >= end)
-		return;
-	else if (start == end - 1) {
-		if (!vec_above(a[start]->vec, a[end]->vec))
-			qsort_swap(a, start, end);
+	if (n < SORT_SMALL) {
+		insertion_sort(items, keys, n);
 		return;
 	}
 
-	// select pivot
-	pivot = (start + end) / 2;
-	pv = a[pivot]->vec;
-	qsort_swap(a, pivot, end);
-	store = start;
+	key_buf = malloc(sizeof(uint64_t) * n);
+	item_buf = malloc(sizeof(void*) * n);
+	sort_keyed_buf(items, keys, n, key_buf, item_buf);
+	free(key_buf);
+	free(item_buf);
+}
 
-	for (i = start; i < end; ++i) {
+/* Least significant digit radix sort. The histograms of all digits are
+ * built in one pass, and digits that are the same for every key (such
+ * as the exponent bits of nearby points) are skipped.
+ */
+void sort_keyed_buf(void** items, uint64_t* keys, unsigned n,
+		uint64_t* key_buf, void** item_buf)
+{
+	unsigned	count[RADIX_PASSES][RADIX_SIZE];
+	uint64_t*	key_src = keys;
+	void**		item_src = items;
+	unsigned	pass;
+	unsigned	i;
+
+	if (n < SORT_SMALL) {
+		insertion_sort(items, keys, n);
+		return;
+	}
 
-		if (vec_above(a[i]->vec, pv)) {
-			qsort_swap(a, i, store);
-			store++;
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < n; ++i) {
+		uint64_t	key = keys[i];
+		for (pass = 0; pass < RADIX_PASSES; ++pass) {
+			count[pass][key & (RADIX_SIZE-1)] += 1;
+			key >>= RADIX_BITS;
 		}
 	}
 
-	qsort_swap(a, store, end);
+	for (pass = 0; pass < RADIX_PASSES; ++pass) {
+		unsigned	shift = pass * RADIX_BITS;
+		unsigned	digit = (keys[0] >> shift) & (RADIX_SIZE-1);
+		unsigned	offset = 0;
+		uint64_t*	key_dst;
+		void**		item_dst;
 
-	if (start < store)
-		qsort_work(a, start, store-1);
+		if (count[pass][digit] == n)
+			continue;
 
-	if (store < end)
-		qsort_work(a, store+1, end);
+		/* prefix sums give the first slot of each digit */
+		for (i = 0; i < RADIX_SIZE; ++i) {
+			unsigned	c = count[pass][i];
+			count[pass][i] = offset;
+			offset += c;
+		}
 
+		key_dst = key_src == keys ? key_buf : keys;
+		item_dst = item_src == items ? item_buf : items;
+		for (i = 0; i < n; ++i) {
+			unsigned	d = (key_src[i] >> shift) & (RADIX_SIZE-1);
+			unsigned	slot = count[pass][d]++;
+			key_dst[slot] = key_src[i];
+			item_dst[slot] = item_src[i];
+		}
+		key_src = key_dst;
+		item_src = item_dst;
+	}
 
+	if (key_src != keys) {
+		memcpy(keys, key_src, sizeof(uint64_t) * n);
+		memcpy(items, item_src, sizeof(void*) * n);
+	}
 }
 
-/* Vertex Quicksort for polygon triangulation
+/* Vertex sort for polygon triangulation
 */
 void qsort_verts(vertex_t** verts, unsigned n)
 {
-	qsort_work(verts, 0, n-1);
-}
+	uint64_t*	keys;
+	unsigned	i;
 
+	if (n < 2)
+		return;
 
+	keys = malloc(sizeof(uint64_t) * n);
+	for (i = 0; i < n; ++i)
+		keys[i] = vec_sort_key(verts[i]->vec);
+	sort_keyed((void**) verts, keys, n);
+	free(keys);
+}
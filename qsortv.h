@@ -20,9 +20,29 @@
 #ifndef CTTF_QSORTV_H
 #define CTTF_QSORTV_H
 
+#include <stdint.h>
+
 #include "vector.h"
 #include "triangulate.h"
 
+/* Returns an integer key that orders points the same way as vec_above:
+ * by decreasing y coordinate, then by increasing x coordinate.
+ */
+uint64_t vec_sort_key(vector_t v);
+
+/* Sort items by ascending key. The keys array is sorted along with the
+ * items, and items with equal keys keep their relative order.
+ */
+void sort_keyed(void** items, uint64_t* keys, unsigned n);
+
+/* Same as sort_keyed, using key_buf and item_buf, each with room for n
+ * entries, instead of allocating temporary arrays
+ */
+void sort_keyed_buf(void** items, uint64_t* keys, unsigned n,
+		uint64_t* key_buf, void** item_buf);
+
+/* Sort vertices in order of decreasing height, see vec_above
+ */
 void qsort_verts(vertex_t** verts, unsigned n);
 
 #endif
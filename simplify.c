@@ -0,0 +1,453 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include "simplify.h"
+#include "predicates.h"
+
+typedef struct simplify	simplify_t;
+typedef struct sseg	sseg_t;
+
+struct simplify {
+	shape_t*	shape;
+	int*		next;/* successor of each vertex on its contour */
+	int*		cycle;/* contour index or -1 if not simplified */
+	int*		keep;
+	int*		order;/* vertices of each contour in order */
+	int*		cstart;/* start of each contour in order */
+	int*		reverted;/* contours restored to the original */
+	int		ncycles;
+	float		tolerance;
+};
+
+/* a segment of the simplified shape */
+struct sseg {
+	int	n;
+	int	m;
+	int	cycle;
+	float	ymin;
+	float	ymax;
+};
+
+static void find_cycles(simplify_t* s);
+static void simplify_cycle(simplify_t* s, int c);
+static void dp_simplify(simplify_t* s, int* v, int k, int i, int j);
+static float seg_distance(vector_t p, vector_t a, vector_t b);
+static int next_kept(simplify_t* s, int v);
+static int collect_segs(simplify_t* s, sseg_t* segs);
+static int check_intersections(simplify_t* s, sseg_t* segs);
+static int check_containment(simplify_t* s);
+static int containment_changed(simplify_t* s, int c, vector_t p);
+static int inside_cycle(simplify_t* s, int c, vector_t p, int simplified);
+static void revert_cycle(simplify_t* s, int c);
+static int compare_sseg(const void* a, const void* b);
+
+shape_t* simplify_shape(shape_t* shape, float tolerance)
+{
+	simplify_t	s;
+	sseg_t*		segs;
+	shape_t*	result;
+	int*		remap;
+	int		n = shape->nvec;
+	int		i;
+	int		c;
+
+	s.shape = shape;
+	s.tolerance = tolerance;
+	s.next = malloc(sizeof(int)*n);
+	s.cycle = malloc(sizeof(int)*n);
+	s.keep = malloc(sizeof(int)*n);
+	s.order = malloc(sizeof(int)*n);
+	s.cstart = malloc(sizeof(int)*(n+1));
+	s.reverted = calloc(n+1, sizeof(int));
+	s.ncycles = 0;
+
+	find_cycles(&s);
+	for (c = 0; c < s.ncycles; ++c)
+		simplify_cycle(&s, c);
+
+	/* revert contours until no new intersections or changes in
+	 * containment are found */
+	segs = malloc(sizeof(sseg_t)*(shape->nseg+1));
+	while (check_intersections(&s, segs) || check_containment(&s));
+	free(segs);
+
+	result = new_shape();
+	remap = malloc(sizeof(int)*(n+1));
+	for (i = 0; i < n; ++i) {
+		if (s.keep[i]) {
+			remap[i] = result->nvec;
+			shape_add_vec(result, shape->vec[i].x,
+					shape->vec[i].y);
+		}
+	}
+	for (i = 0; i < shape->nseg; ++i) {
+		int	a = shape->seg[i*2];
+		int	b = shape->seg[i*2+1];
+
+		if (s.cycle[a] == -1) {
+			shape_add_seg(result, remap[a], remap[b]);
+		} else if (s.keep[a]) {
+			shape_add_seg(result, remap[a],
+					remap[next_kept(&s, a)]);
+		}
+	}
+
+	free(remap);
+	free(s.next);
+	free(s.cycle);
+	free(s.keep);
+	free(s.order);
+	free(s.cstart);
+	free(s.reverted);
+	return result;
+}
+
+/* Find the simple cycles of the shape, i.e. contours where
+ * every vertex has exactly one incoming and one outgoing segment.
+ */
+static void find_cycles(simplify_t* s)
+{
+	shape_t*	shape = s->shape;
+	int		n = shape->nvec;
+	int*		nin = calloc(n+1, sizeof(int));
+	int*		nout = calloc(n+1, sizeof(int));
+	int		norder = 0;
+	int		i;
+
+	for (i = 0; i < n; ++i) {
+		s->next[i] = -1;
+		s->cycle[i] = -1;
+		s->keep[i] = 1;
+	}
+	for (i = 0; i < shape->nseg; ++i) {
+		int	a = shape->seg[i*2];
+		int	b = shape->seg[i*2+1];
+		nout[a] += 1;
+		nin[b] += 1;
+		s->next[a] = b;
+	}
+
+	for (i = 0; i < n; ++i) {
+		int	v = i;
+		int	k = 0;
+
+		if (s->cycle[i] != -1 || nin[i] != 1 || nout[i] != 1)
+			continue;
+
+		/* follow the contour until we get back to i */
+		do {
+			if (nin[v] != 1 || nout[v] != 1 || s->cycle[v] != -1
+					|| s->next[v] == v)
+				break;
+			s->cycle[v] = s->ncycles;
+			s->order[norder+k] = v;
+			k += 1;
+			v = s->next[v];
+		} while (v != i);
+
+		if (v != i) {
+			/* not a simple cycle */
+			int	j;
+			for (j = 0; j < k; ++j)
+				s->cycle[s->order[norder+j]] = -1;
+			continue;
+		}
+
+		s->cstart[s->ncycles] = norder;
+		s->ncycles += 1;
+		norder += k;
+	}
+	s->cstart[s->ncycles] = norder;
+
+	free(nin);
+	free(nout);
+}
+
+static void simplify_cycle(simplify_t* s, int c)
+{
+	vector_t*	vec = s->shape->vec;
+	int*		v = s->order + s->cstart[c];
+	int		k = s->cstart[c+1] - s->cstart[c];
+	int		far = 0;
+	int		nkept = 0;
+	float		dmax = 0;
+	int		i;
+
+	if (k <= 3)
+		return;
+
+	/* the point farthest from the first point
+	 * splits the contour into two open chains */
+	for (i = 1; i < k; ++i) {
+		float	dx = vec[v[i]].x - vec[v[0]].x;
+		float	dy = vec[v[i]].y - vec[v[0]].y;
+		float	d = dx*dx + dy*dy;
+		if (d > dmax) {
+			dmax = d;
+			far = i;
+		}
+	}
+	if (far == 0)
+		return;
+
+	for (i = 1; i < k; ++i)
+		s->keep[v[i]] = 0;
+	s->keep[v[far]] = 1;
+	dp_simplify(s, v, k, 0, far);
+	dp_simplify(s, v, k, far, k);
+
+	for (i = 0; i < k; ++i)
+		nkept += s->keep[v[i]];
+
+	if (nkept < 3)
+		revert_cycle(s, c);
+}
+
+/* Douglas-Peucker simplification of the chain v[i]..v[j]
+ * where v[k] is v[0]
+ */
+static void dp_simplify(simplify_t* s, int* v, int k, int i, int j)
+{
+	vector_t*	vec = s->shape->vec;
+	vector_t	a = vec[v[i]];
+	vector_t	b = vec[v[j % k]];
+	float		dmax = 0;
+	int		index = -1;
+	int		l;
+
+	for (l = i+1; l < j; ++l) {
+		float	d = seg_distance(vec[v[l]], a, b);
+		if (d > dmax) {
+			dmax = d;
+			index = l;
+		}
+	}
+
+	if (index != -1 && dmax > s->tolerance) {
+		s->keep[v[index]] = 1;
+		dp_simplify(s, v, k, i, index);
+		dp_simplify(s, v, k, index, j);
+	}
+}
+
+/* Distance from the point p to the segment a-b
+ */
+static float seg_distance(vector_t p, vector_t a, vector_t b)
+{
+	double	dx = (double) b.x - a.x;
+	double	dy = (double) b.y - a.y;
+	double	px = (double) p.x - a.x;
+	double	py = (double) p.y - a.y;
+	double	len = dx*dx + dy*dy;
+	double	t;
+
+	if (len > 0) {
+		t = (px*dx + py*dy) / len;
+		if (t < 0) t = 0;
+		else if (t > 1) t = 1;
+		px -= t*dx;
+		py -= t*dy;
+	}
+	return (float) sqrt(px*px + py*py);
+}
+
+static int next_kept(simplify_t* s, int v)
+{
+	do {
+		v = s->next[v];
+	} while (!s->keep[v]);
+	return v;
+}
+
+static void revert_cycle(simplify_t* s, int c)
+{
+	int	i;
+	for (i = s->cstart[c]; i < s->cstart[c+1]; ++i)
+		s->keep[s->order[i]] = 1;
+	s->reverted[c] = 1;
+}
+
+/* Gather the segments of the current simplified shape,
+ * sorted by their lowest y coordinate
+ */
+static int collect_segs(simplify_t* s, sseg_t* segs)
+{
+	shape_t*	shape = s->shape;
+	int		nsegs = 0;
+	int		i;
+
+	for (i = 0; i < shape->nseg; ++i) {
+		int	a = shape->seg[i*2];
+		int	b = shape->seg[i*2+1];
+		int	c = s->cycle[a];
+		float	ya;
+		float	yb;
+
+		if (c != -1) {
+			if (!s->keep[a])
+				continue;
+			b = next_kept(s, a);
+		}
+
+		ya = shape->vec[a].y;
+		yb = shape->vec[b].y;
+		segs[nsegs].n = a;
+		segs[nsegs].m = b;
+		segs[nsegs].cycle = c;
+		segs[nsegs].ymin = ya < yb ? ya : yb;
+		segs[nsegs].ymax = ya < yb ? yb : ya;
+		nsegs += 1;
+	}
+	qsort(segs, nsegs, sizeof(sseg_t), compare_sseg);
+	return nsegs;
+}
+
+/* Reverts every simplified contour that intersects another segment.
+ * Returns the number of reverted contours.
+ */
+static int check_intersections(simplify_t* s, sseg_t* segs)
+{
+	vector_t*	vec = s->shape->vec;
+	int		nsegs = collect_segs(s, segs);
+	int		nreverted = 0;
+	int		i;
+	int		j;
+
+	for (i = 0; i < nsegs; ++i) {
+		for (j = i+1; j < nsegs && segs[j].ymin <= segs[i].ymax; ++j) {
+			int	ci = segs[i].cycle;
+			int	cj = segs[j].cycle;
+			int	si = ci != -1 && !s->reverted[ci];
+			int	sj = cj != -1 && !s->reverted[cj];
+
+			/* intersections between original segments
+			 * are left for the triangulator */
+			if (!si && !sj)
+				continue;
+
+			if (seg_touch(&vec[segs[i].n], &vec[segs[i].m],
+					&vec[segs[j].n], &vec[segs[j].m])) {
+				if (si) {
+					revert_cycle(s, ci);
+					nreverted += 1;
+				}
+				if (sj && cj != ci) {
+					revert_cycle(s, cj);
+					nreverted += 1;
+				}
+			}
+		}
+	}
+	return nreverted;
+}
+
+/* Reverts every simplified contour that moved across a vertex of
+ * another contour. A contour lying between the original chain and the
+ * simplified chord changes from outside to inside, or the other way
+ * round, without any segments crossing.
+ * Returns the number of reverted contours.
+ */
+static int check_containment(simplify_t* s)
+{
+	shape_t*	shape = s->shape;
+	int		nreverted = 0;
+	int		c;
+	int		d;
+	int		i;
+
+	for (c = 0; c < s->ncycles; ++c) {
+		int	changed = 0;
+
+		if (s->reverted[c])
+			continue;
+
+		/* the first vertex of a contour is always kept */
+		for (d = 0; d < s->ncycles && !changed; ++d) {
+			if (d != c)
+				changed = containment_changed(s, c,
+					shape->vec[s->order[s->cstart[d]]]);
+		}
+		for (i = 0; i < shape->nseg && !changed; ++i) {
+			int	a = shape->seg[i*2];
+			if (s->cycle[a] == -1)
+				changed = containment_changed(s, c,
+						shape->vec[a]);
+		}
+
+		if (changed) {
+			revert_cycle(s, c);
+			nreverted += 1;
+		}
+	}
+	return nreverted;
+}
+
+/* Returns 1 if the point p is inside the original contour c but not
+ * inside the simplified contour, or the other way round
+ */
+static int containment_changed(simplify_t* s, int c, vector_t p)
+{
+	return inside_cycle(s, c, p, 0) != inside_cycle(s, c, p, 1);
+}
+
+/* Even-odd test of the point p against the original or the
+ * simplified contour c
+ */
+static int inside_cycle(simplify_t* s, int c, vector_t p, int simplified)
+{
+	vector_t*	vec = s->shape->vec;
+	int		inside = 0;
+	int		i;
+
+	for (i = s->cstart[c]; i < s->cstart[c+1]; ++i) {
+		int		v = s->order[i];
+		vector_t	a;
+		vector_t	b;
+
+		if (simplified && !s->keep[v])
+			continue;
+		a = vec[v];
+		b = vec[simplified ? next_kept(s, v) : s->next[v]];
+		if ((a.y > p.y) != (b.y > p.y)) {
+			/* the ray from p towards +x crosses a-b if p
+			 * is to the left of the upward edge */
+			double	o = orient2d(a, b, p);
+			if (o != 0 && (o > 0) == (b.y > a.y))
+				inside ^= 1;
+		}
+	}
+	return inside;
+}
+
+static int compare_sseg(const void* a, const void* b)
+{
+	const sseg_t*	s = a;
+	const sseg_t*	t = b;
+
+	if (s->ymin < t->ymin)
+		return -1;
+	else if (s->ymin > t->ymin)
+		return 1;
+	else
+		return 0;
+}
+
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CTTF_SIMPLIFY_H
+#define CTTF_SIMPLIFY_H
+
+#include "shape.h"
+
+/* Simplify the closed contours of a shape using the Douglas-Peucker
+ * algorithm. Points within tolerance of the simplified contour are
+ * removed.
+ *
+ * Only simple cycles (every vertex has one incoming and one outgoing
+ * segment) are simplified, other parts of the shape are copied as-is.
+ * A contour is left unsimplified if simplifying it would introduce an
+ * intersection with any other segment, or would move it across a
+ * vertex of another contour so that the other contour changes from
+ * inside to outside or the other way round.
+ *
+ * Returns a new shape
+ */
+shape_t* simplify_shape(shape_t* shape, float tolerance);
+
+#endif
+
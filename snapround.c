@@ -0,0 +1,425 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Snap rounding
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "snapround.h"
+#include "predicates.h"
+
+struct pixel {
+	int64_t		x;
+	int64_t		y;
+};
+
+/* A segment in the order of the sweep for crossings */
+struct span {
+	double		min_x;
+	int		seg;
+};
+
+/* A pixel passed by a segment, in the order the segment enters them */
+struct pass {
+	double		t0;
+	double		t1;
+	int		pixel;
+};
+
+struct snap {
+	shape_t*	shape;
+	double		scale;/* 1/grid */
+
+	struct pixel*	hot;
+	int		nhot;
+	int		maxhot;
+};
+
+static int64_t round_px(double v)
+{
+	return (int64_t)floor(v + 0.5);
+}
+
+static void add_hot(struct snap* s, struct pixel p)
+{
+	if (s->nhot == s->maxhot) {
+		s->maxhot = s->maxhot ? s->maxhot * 2 : 64;
+		s->hot = realloc(s->hot, sizeof(struct pixel) * s->maxhot);
+	}
+	s->hot[s->nhot++] = p;
+}
+
+static void add_hot_point(struct snap* s, double x, double y)
+{
+	struct pixel	p;
+
+	p.x = round_px(x);
+	p.y = round_px(y);
+	add_hot(s, p);
+}
+
+static int compare_pixel(const void* a, const void* b)
+{
+	const struct pixel*	pa = a;
+	const struct pixel*	pb = b;
+
+	if (pa->x != pb->x)
+		return pa->x < pb->x ? -1 : 1;
+	if (pa->y != pb->y)
+		return pa->y < pb->y ? -1 : 1;
+	return 0;
+}
+
+static int compare_pass(const void* a, const void* b)
+{
+	const struct pass*	pa = a;
+	const struct pass*	pb = b;
+
+	if (pa->t0 != pb->t0)
+		return pa->t0 < pb->t0 ? -1 : 1;
+	if (pa->t1 != pb->t1)
+		return pa->t1 < pb->t1 ? -1 : 1;
+	return pa->pixel - pb->pixel;
+}
+
+static int compare_key(const void* a, const void* b)
+{
+	uint64_t	ka = *(const uint64_t*)a;
+	uint64_t	kb = *(const uint64_t*)b;
+	return ka < kb ? -1 : ka > kb;
+}
+
+/* Clip the segment to one side of the pixel, see seg_enters
+ */
+static int clip(double p, double q, double* t0, double* t1)
+{
+	double	t;
+
+	if (p == 0)
+		return q >= 0;
+	t = q / p;
+	if (p < 0) {
+		if (t > *t1)
+			return 0;
+		if (t > *t0)
+			*t0 = t;
+	} else {
+		if (t < *t0)
+			return 0;
+		if (t < *t1)
+			*t1 = t;
+	}
+	return 1;
+}
+
+/* Returns 1 if the segment passes through the pixel, and where along
+ * the segment it enters and leaves the pixel in t0 and t1. The pixels
+ * are half open, like round_px, so that each point is in one pixel.
+ */
+static int seg_enters(double x1, double y1, double x2, double y2,
+		struct pixel* p, double* t0, double* t1)
+{
+	double	dx = x2 - x1;
+	double	dy = y2 - y1;
+	double	right = p->x + 0.5;
+	double	top = p->y + 0.5;
+
+	*t0 = 0;
+	*t1 = 1;
+	if (!clip(-dx, x1 - (p->x - 0.5), t0, t1)
+			|| !clip(dx, right - x1, t0, t1)
+			|| !clip(-dy, y1 - (p->y - 0.5), t0, t1)
+			|| !clip(dy, top - y1, t0, t1))
+		return 0;
+
+	/* leave out the right and top sides */
+	if (*t0 == *t1)
+		return x1 + *t0 * dx < right && y1 + *t0 * dy < top;
+	return !(dx == 0 && x1 == right) && !(dy == 0 && y1 == top);
+}
+
+/* Segment endpoints in grid units */
+static void seg_ends(struct snap* s, int seg, double* x1, double* y1,
+		double* x2, double* y2)
+{
+	vector_t	a = s->shape->vec[s->shape->seg[seg*2]];
+	vector_t	b = s->shape->vec[s->shape->seg[seg*2+1]];
+
+	*x1 = a.x * s->scale;
+	*y1 = a.y * s->scale;
+	*x2 = b.x * s->scale;
+	*y2 = b.y * s->scale;
+}
+
+static int compare_span(const void* a, const void* b)
+{
+	const struct span*	sa = a;
+	const struct span*	sb = b;
+
+	if (sa->min_x != sb->min_x)
+		return sa->min_x < sb->min_x ? -1 : 1;
+	return sa->seg - sb->seg;
+}
+
+static int both_enter(struct snap* s, int a, int b, struct pixel* p)
+{
+	double	x1, y1, x2, y2;
+	double	t0, t1;
+
+	seg_ends(s, a, &x1, &y1, &x2, &y2);
+	if (!seg_enters(x1, y1, x2, y2, p, &t0, &t1))
+		return 0;
+	seg_ends(s, b, &x1, &y1, &x2, &y2);
+	return seg_enters(x1, y1, x2, y2, p, &t0, &t1);
+}
+
+/* Make the pixel of the crossing of segments a and b hot. The crossing
+ * point is rounded off, so if it lands next to the pixels the segments
+ * share, the neighbouring pixels that both segments pass are used.
+ */
+static void add_crossing(struct snap* s, int a, int b, double x, double y)
+{
+	struct pixel	p;
+	struct pixel	q;
+
+	p.x = round_px(x);
+	p.y = round_px(y);
+	if (both_enter(s, a, b, &p)) {
+		add_hot(s, p);
+		return;
+	}
+	for (q.y = p.y - 1; q.y <= p.y + 1; ++q.y) {
+		for (q.x = p.x - 1; q.x <= p.x + 1; ++q.x) {
+			if (both_enter(s, a, b, &q))
+				add_hot(s, q);
+		}
+	}
+}
+
+/* Make the endpoints and the crossings of the segments hot. Crossings
+ * are decided exactly on the input, only the crossing point is rounded.
+ */
+static void find_hot_pixels(struct snap* s)
+{
+	shape_t*	shape = s->shape;
+	struct span*	order = malloc(sizeof(struct span) * (shape->nseg + 1));
+	int		i;
+	int		j;
+
+	for (i = 0; i < shape->nseg; ++i) {
+		double	x1, y1, x2, y2;
+
+		seg_ends(s, i, &x1, &y1, &x2, &y2);
+		add_hot_point(s, x1, y1);
+		add_hot_point(s, x2, y2);
+		order[i].min_x = x1 < x2 ? x1 : x2;
+		order[i].seg = i;
+	}
+
+	/* only segments that overlap in x can cross */
+	qsort(order, shape->nseg, sizeof(struct span), compare_span);
+	for (i = 0; i < shape->nseg; ++i) {
+		int		a = order[i].seg;
+		vector_t	a1 = shape->vec[shape->seg[a*2]];
+		vector_t	a2 = shape->vec[shape->seg[a*2+1]];
+		double		max_x = (a1.x > a2.x ? a1.x : a2.x) * s->scale;
+
+		for (j = i+1; j < shape->nseg; ++j) {
+			int		b = order[j].seg;
+			vector_t	b1 = shape->vec[shape->seg[b*2]];
+			vector_t	b2 = shape->vec[shape->seg[b*2+1]];
+			double		px, py, rx, ry, qx, qy, sx, sy;
+			double		d, t;
+
+			if (order[j].min_x > max_x)
+				break;
+			if (!seg_cross(a1, a2, b1, b2))
+				continue;
+
+			seg_ends(s, a, &px, &py, &rx, &ry);
+			seg_ends(s, b, &qx, &qy, &sx, &sy);
+			rx -= px;
+			ry -= py;
+			sx -= qx;
+			sy -= qy;
+			d = rx*sy - ry*sx;
+			if (d == 0)
+				continue;
+			t = ((qx - px)*sy - (qy - py)*sx) / d;
+			add_crossing(s, a, b, px + t*rx, py + t*ry);
+		}
+	}
+	free(order);
+
+	/* sort by x for the lookups, and drop duplicates */
+	qsort(s->hot, s->nhot, sizeof(struct pixel), compare_pixel);
+	j = 0;
+	for (i = 0; i < s->nhot; ++i) {
+		if (j == 0 || compare_pixel(&s->hot[j-1], &s->hot[i]))
+			s->hot[j++] = s->hot[i];
+	}
+	s->nhot = j;
+}
+
+/* Returns the first hot pixel with x >= px */
+static int first_hot_column(struct snap* s, int64_t px)
+{
+	int	lo = 0;
+	int	hi = s->nhot;
+
+	while (lo < hi) {
+		int	mid = lo + (hi - lo) / 2;
+		if (s->hot[mid].x < px)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Append the pieces of the rounded segment to keys. A key holds the
+ * lower and higher hot pixel index of a piece, and in its lowest bit
+ * whether the piece goes from the higher to the lower one. Returns the
+ * new number of keys.
+ */
+static int round_segment(struct snap* s, int seg, struct pass** passes,
+		int* maxpass, uint64_t** keys, int* maxkeys, int nkeys)
+{
+	double	x1, y1, x2, y2;
+	int64_t	last_x;
+	int	npass = 0;
+	int	prev = -1;
+	int	i;
+
+	seg_ends(s, seg, &x1, &y1, &x2, &y2);
+	last_x = round_px(x1 > x2 ? x1 : x2);
+
+	for (i = first_hot_column(s, round_px(x1 < x2 ? x1 : x2));
+			i < s->nhot && s->hot[i].x <= last_x; ++i) {
+		double	t0;
+		double	t1;
+
+		if (!seg_enters(x1, y1, x2, y2, &s->hot[i], &t0, &t1))
+			continue;
+		if (npass == *maxpass) {
+			*maxpass *= 2;
+			*passes = realloc(*passes,
+					sizeof(struct pass) * *maxpass);
+		}
+		(*passes)[npass].t0 = t0;
+		(*passes)[npass].t1 = t1;
+		(*passes)[npass].pixel = i;
+		npass += 1;
+	}
+	qsort(*passes, npass, sizeof(struct pass), compare_pass);
+
+	for (i = 0; i < npass; ++i) {
+		int		pixel = (*passes)[i].pixel;
+		uint32_t	a, b;
+
+		if (prev >= 0 && prev != pixel) {
+			a = prev < pixel ? prev : pixel;
+			b = prev < pixel ? pixel : prev;
+			if (nkeys == *maxkeys) {
+				*maxkeys *= 2;
+				*keys = realloc(*keys,
+						sizeof(uint64_t) * *maxkeys);
+			}
+			(*keys)[nkeys++] = (uint64_t)a << 32 |
+				(uint64_t)b << 1 | (prev > pixel);
+		}
+		prev = pixel;
+	}
+	return nkeys;
+}
+
+shape_t* snap_round(shape_t* shape, float grid)
+{
+	struct snap	s;
+	shape_t*	result = new_shape();
+	struct pass*	passes;
+	uint64_t*	keys;
+	int*		index;/* output vertex of each hot pixel */
+	int		maxpass = 16;
+	int		maxkeys = 64;
+	int		nkeys = 0;
+	int		i;
+
+	assert(shape != NULL);
+	assert(grid > 0);
+
+	s.shape = shape;
+	s.scale = 1.0 / grid;
+	s.hot = NULL;
+	s.nhot = 0;
+	s.maxhot = 0;
+	find_hot_pixels(&s);
+
+	passes = malloc(sizeof(struct pass) * maxpass);
+	keys = malloc(sizeof(uint64_t) * maxkeys);
+	for (i = 0; i < shape->nseg; ++i)
+		nkeys = round_segment(&s, i, &passes, &maxpass,
+				&keys, &maxkeys, nkeys);
+	free(passes);
+
+	/* overlapping pieces cancel in pairs, the remaining piece goes the
+	 * way most of them go */
+	qsort(keys, nkeys, sizeof(uint64_t), compare_key);
+	index = malloc(sizeof(int) * (s.nhot + 1));
+	for (i = 0; i < s.nhot; ++i)
+		index[i] = -1;
+	for (i = 0; i < nkeys; ) {
+		uint64_t	key = keys[i] >> 1;
+		int		count = 0;
+		int		dir = 0;
+		int		ends[2];
+		int		k;
+
+		while (i < nkeys && keys[i] >> 1 == key) {
+			dir += (keys[i] & 1) ? -1 : 1;
+			count += 1;
+			i += 1;
+		}
+		if (count % 2 == 0)
+			continue;
+
+		ends[0] = (int)(key >> 31);
+		ends[1] = (int)(key & 0x7FFFFFFF);
+		for (k = 0; k < 2; ++k) {
+			struct pixel*	p = &s.hot[ends[k]];
+			if (index[ends[k]] < 0) {
+				index[ends[k]] = result->nvec;
+				shape_add_vec(result, (float)(p->x * (double)grid),
+						(float)(p->y * (double)grid));
+			}
+		}
+		if (dir > 0)
+			shape_add_seg(result, index[ends[0]], index[ends[1]]);
+		else
+			shape_add_seg(result, index[ends[1]], index[ends[0]]);
+	}
+
+	free(index);
+	free(keys);
+	free(s.hot);
+	return result;
+}
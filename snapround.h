@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Snap rounding
+ *
+ * Rounds the segments of a shape to a grid so that no two of them
+ * cross, after J. D. Hobby, "Practical segment intersection with finite
+ * precision output", 1999.
+ *
+ * Each grid point is the center of a pixel. A pixel that holds a
+ * segment endpoint or a crossing of two segments is hot, and every
+ * segment is replaced by the chain of the centers of the hot pixels it
+ * passes through. The rounded segments only meet at grid points or
+ * overlap, so the sweep in make_planar has no intersections to compute,
+ * and every point moves by at most half a pixel in each coordinate.
+ */
+#ifndef CTTF_SNAPROUND_H
+#define CTTF_SNAPROUND_H
+
+#include "shape.h"
+
+/* Returns a copy of the shape snap rounded to a grid with the given
+ * spacing, e.g. 1/upem for font units or 1/(64 upem) for 26.6 fixed
+ * point. A power of two spacing makes the grid points exact floats.
+ *
+ * The triangulator fills with the even-odd rule, so where rounded
+ * segments overlap a piece covered an even number of times is left out.
+ * A piece that is kept goes the way most of the overlapping pieces go,
+ * so contours keep their direction.
+ */
+shape_t* snap_round(shape_t* shape, float grid);
+
+#endif
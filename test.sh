@@ -15,4 +15,11 @@ for test in test/bug* test/test*; do
 	(( runs += 1 ))
 done
 
+# simplifying must not flatten the dip above the small square
+echo "test/test16 -s 1"
+if ./ftest test/test16.shape -s 1 -t | grep -q "^triangulated area: 96.375$"; then
+	(( passed += 1 ))
+fi
+(( runs += 1 ))
+
 echo "$passed/$runs"
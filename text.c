@@ -23,6 +23,8 @@
 #include <assert.h>
 #include <wchar.h>
 #include "text.h"
+#include "simplify.h"
+#include "snapround.h"
 
 /* Returns null if ttf is null
  */
@@ -35,11 +37,16 @@ font_t* new_font(ttf_t* ttf, int ipl)
 	obj = malloc(sizeof(font_t));
 	obj->ttf = ttf;
 	ttf->interpolation_level = ipl;
+	obj->tolerance = 0;
+	obj->snap = 0;
+	obj->pack = NULL;
 	obj->cshape = malloc(sizeof(shape_t*)*0x10000);
-	obj->cedges = malloc(sizeof(edge_list_t*)*0x10000);
+	obj->cmesh = malloc(sizeof(mesh_t*)*0x10000);
+	obj->cqmesh = NULL;
+	obj->triangulator = new_triangulator();
 	for (i = 0; i < 0x10000; ++i) {
 		obj->cshape[i] = NULL;
-		obj->cedges[i] = NULL;
+		obj->cmesh[i] = NULL;
 	}
 	return obj;
 }
@@ -98,30 +105,379 @@ void free_font(font_t** font)
 	free_ttf(&p->ttf);
 	for (i = 0; i < 0x10000; ++i) {
 		free_shape(&p->cshape[i]);
-		free_edgelist(&p->cedges[i]);
+		free_mesh(&p->cmesh[i]);
+		if (p->cqmesh)
+			free_qmesh(&p->cqmesh[i]);
 	}
 	free(p->cshape);
-	free(p->cedges);
+	free(p->cmesh);
+	free(p->cqmesh);
+	free_triangulator(&p->triangulator);
+	free_pack(&p->pack);
 	free(p);
 	*font = NULL;
 }
 
+/* Returns the (simplified, snap rounded) outline of a character
+ */
+static shape_t* export_shape(font_t* font, uint16_t chr)
+{
+	shape_t*	shape = ttf_export_chr_shape(font->ttf, chr);
+
+	if (shape && font->tolerance > 0) {
+		shape_t*	simple;
+		simple = simplify_shape(shape, font->tolerance);
+		free_shape(&shape);
+		shape = simple;
+	}
+	if (shape && font->snap > 0) {
+		shape_t*	snapped;
+		snapped = snap_round(shape, font->snap);
+		free_shape(&shape);
+		shape = snapped;
+	}
+	return shape;
+}
+
+void font_quantize(font_t* font)
+{
+	int	i;
+
+	assert(font != NULL);
+	if (font->cqmesh)
+		return;
+
+	font->cqmesh = malloc(sizeof(qmesh_t*)*0x10000);
+	for (i = 0; i < 0x10000; ++i) {
+		font->cqmesh[i] = NULL;
+		if (font->cmesh[i]) {
+			font->cqmesh[i] = quantize_mesh(font->cmesh[i]);
+			free_mesh(&font->cmesh[i]);
+		}
+	}
+}
+
+/* Returns non-zero if the font has a mesh for a character
+ */
+static int has_mesh(font_t* font, uint16_t chr)
+{
+	return font->cmesh[chr] || (font->cqmesh && font->cqmesh[chr]);
+}
+
+/* Quantize a new mesh if the font is quantized
+ */
+static qmesh_t* quantize_new_mesh(font_t* font, mesh_t** mesh)
+{
+	qmesh_t*	qmesh = NULL;
+
+	if (font->cqmesh && *mesh) {
+		qmesh = quantize_mesh(*mesh);
+		free_mesh(mesh);
+	}
+	return qmesh;
+}
+
+int font_use_pack(font_t* font, const char* path)
+{
+	pack_t*	pack;
+
+	assert(font != NULL);
+	assert(font->ttf != NULL);
+
+	pack = load_pack(path);
+	if (!pack)
+		return -1;
+	if (!pack_matches(pack, font->ttf)) {
+		fprintf(stderr, "Glyph pack \"%s\" does not match the font\n",
+				path);
+		free_pack(&pack);
+		return -1;
+	}
+	free_pack(&font->pack);
+	font->pack = pack;
+	font->tolerance = pack->header->tolerance;
+	font->snap = pack->header->snap;
+	return 0;
+}
+
 void font_prepare_chr(font_t* font, uint16_t chr, int triangulated)
 {
+	const pack_glyph_t*	glyph = NULL;
+
 	assert(font != NULL);
 	assert(font->ttf != NULL);
 
+	if (font->pack)
+		glyph = pack_find(font->pack, chr);
+	if (glyph && !font->cshape[chr])
+		font->cshape[chr] = pack_shape(font->pack, glyph);
+	if (glyph && triangulated && !has_mesh(font, chr)) {
+		if (font->cqmesh)
+			font->cqmesh[chr] = pack_qmesh(font->pack, glyph);
+		else
+			font->cmesh[chr] = pack_mesh(font->pack, glyph);
+	}
+
 	if (!font->cshape[chr]) {
-		font->cshape[chr] = ttf_export_chr_shape(font->ttf, chr);
+		font->cshape[chr] = export_shape(font, chr);
+	}
+	if (font->cshape[chr] && triangulated && !has_mesh(font, chr)) {
+		font->cmesh[chr] = triangulator_mesh(font->triangulator,
+				font->cshape[chr]);
+		if (font->cqmesh)
+			font->cqmesh[chr] = quantize_new_mesh(font,
+					&font->cmesh[chr]);
+	}
+}
+
+struct prepare_job {
+	font_t*		font;
+	uint16_t*	chrs;/* in order of decreasing outline size */
+	shape_t**	shapes;/* new outlines, by position in chrs */
+	mesh_t**	meshes;/* new meshes, by position in chrs */
+	qmesh_t**	qmeshes;/* new meshes if the font is quantized */
+	int		n;
+	int		triangulated;
+	triangulator_t**	triangulators;/* one for each pool thread */
+
+	/* glyph variations and hinting cache data in the ttf object,
+	 * exporting outlines must then be serialized */
+	int		lock_export;
+	pthread_mutex_t	export_lock;
+
+	pthread_mutex_t	progress_lock;
+	font_progress_t	progress;
+	void*		data;
+	int		done;
+	int		cancel;
+};
+
+static void prepare_item(void* arg, int index, int thread)
+{
+	struct prepare_job*	job = arg;
+	font_t*			font = job->font;
+	uint16_t		chr = job->chrs[index];
+	shape_t*		shape = font->cshape[chr];
+	const pack_glyph_t*	glyph = NULL;
+	int			cancel;
+
+	pthread_mutex_lock(&job->progress_lock);
+	cancel = job->cancel;
+	pthread_mutex_unlock(&job->progress_lock);
+	if (cancel)
+		return;
+
+	/* the pack is read-only, no locking needed */
+	if (font->pack)
+		glyph = pack_find(font->pack, chr);
+	if (glyph && !shape)
+		shape = job->shapes[index] = pack_shape(font->pack, glyph);
+	if (glyph && job->triangulated && !has_mesh(font, chr)) {
+		if (font->cqmesh)
+			job->qmeshes[index] = pack_qmesh(font->pack, glyph);
+		else
+			job->meshes[index] = pack_mesh(font->pack, glyph);
+	}
+
+	if (!shape) {
+		if (job->lock_export)
+			pthread_mutex_lock(&job->export_lock);
+		shape = job->shapes[index] = export_shape(font, chr);
+		if (job->lock_export)
+			pthread_mutex_unlock(&job->export_lock);
+	}
+	if (shape && job->triangulated && !has_mesh(font, chr) &&
+			!job->meshes[index] && !job->qmeshes[index]) {
+		job->meshes[index] = triangulator_mesh(
+				job->triangulators[thread], shape);
+		job->qmeshes[index] = quantize_new_mesh(font,
+				&job->meshes[index]);
+	}
+
+	pthread_mutex_lock(&job->progress_lock);
+	job->done += 1;
+	if (job->progress && !job->cancel &&
+			job->progress(job->data, job->done, job->n))
+		job->cancel = 1;
+	pthread_mutex_unlock(&job->progress_lock);
+}
+
+struct sized_chr {
+	int		size;
+	uint16_t	chr;
+};
+
+/* Returns the number of outline points of the glyph of a character,
+ * used as an estimate of the work needed to prepare it
+ */
+static int chr_size(ttf_t* ttf, uint16_t chr)
+{
+	uint16_t	glyph = ttf->glyph_table[chr];
+
+	if (glyph >= ttf->nglyphs)
+		return 0;
+	return ttf->glyph_data[glyph].npoints;
+}
+
+static int compare_size(const void* a, const void* b)
+{
+	const struct sized_chr*	sa = a;
+	const struct sized_chr*	sb = b;
+
+	if (sa->size != sb->size)
+		return sb->size - sa->size;
+	return (int) sa->chr - (int) sb->chr;
+}
+
+int font_prepare_set(font_t* font, const uint16_t* chrs, int n,
+		int triangulated, pool_t* pool,
+		font_progress_t progress, void* data)
+{
+	struct prepare_job	job;
+	struct sized_chr*	order;
+	int			nthreads = pool ? pool_threads(pool) : 1;
+	int			count = 0;
+	int			i;
+
+	assert(font != NULL);
+	assert(font->ttf != NULL);
+
+	if (n <= 0)
+		return 0;
+
+	job.font = font;
+	job.n = n;
+	job.triangulated = triangulated;
+	job.chrs = malloc(sizeof(uint16_t) * n);
+	job.shapes = calloc(n, sizeof(shape_t*));
+	job.meshes = calloc(n, sizeof(mesh_t*));
+	job.qmeshes = calloc(n, sizeof(qmesh_t*));
+	job.triangulators = malloc(sizeof(triangulator_t*) * nthreads);
+	job.lock_export = font->ttf->var != NULL || font->ttf->hinting;
+	job.progress = progress;
+	job.data = data;
+	job.done = 0;
+	job.cancel = 0;
+	pthread_mutex_init(&job.export_lock, NULL);
+	pthread_mutex_init(&job.progress_lock, NULL);
+
+	/* start with the largest glyphs so the small ones fill the gaps
+	 * at the end */
+	order = malloc(sizeof(struct sized_chr) * n);
+	for (i = 0; i < n; ++i) {
+		order[i].size = chr_size(font->ttf, chrs[i]);
+		order[i].chr = chrs[i];
+	}
+	qsort(order, n, sizeof(struct sized_chr), compare_size);
+	for (i = 0; i < n; ++i)
+		job.chrs[i] = order[i].chr;
+	free(order);
+
+	job.triangulators[0] = font->triangulator;
+	for (i = 1; i < nthreads; ++i)
+		job.triangulators[i] = new_triangulator();
+
+	if (pool) {
+		pool_run(pool, prepare_item, &job, n);
+	} else {
+		for (i = 0; i < n; ++i)
+			prepare_item(&job, i, 0);
+	}
+
+	/* publish the results, a character may be listed more than once */
+	for (i = 0; i < n; ++i) {
+		uint16_t	chr = job.chrs[i];
+
+		if (job.shapes[i] && !font->cshape[chr])
+			font->cshape[chr] = job.shapes[i];
+		else
+			free_shape(&job.shapes[i]);
+		if (job.meshes[i] && !has_mesh(font, chr))
+			font->cmesh[chr] = job.meshes[i];
+		else
+			free_mesh(&job.meshes[i]);
+		if (job.qmeshes[i] && !has_mesh(font, chr))
+			font->cqmesh[chr] = job.qmeshes[i];
+		else
+			free_qmesh(&job.qmeshes[i]);
 	}
-	if (font->cshape[chr] && triangulated && !font->cedges[chr]) {
-		font->cedges[chr] = triangulate(font->cshape[chr]);
+	for (i = 0; i < n; ++i) {
+		uint16_t	chr = job.chrs[i];
+
+		if (font->cshape[chr] &&
+				(!triangulated || has_mesh(font, chr)))
+			count += 1;
+	}
+
+	for (i = 1; i < nthreads; ++i)
+		free_triangulator(&job.triangulators[i]);
+	pthread_mutex_destroy(&job.export_lock);
+	pthread_mutex_destroy(&job.progress_lock);
+	free(job.chrs);
+	free(job.shapes);
+	free(job.meshes);
+	free(job.qmeshes);
+	free(job.triangulators);
+	return count;
+}
+
+int font_prepare_range(font_t* font, uint16_t first, uint16_t last,
+		int triangulated, pool_t* pool,
+		font_progress_t progress, void* data)
+{
+	uint16_t*	chrs;
+	int		n = 0;
+	int		count;
+	uint32_t	chr;
+
+	assert(font != NULL);
+	assert(font->ttf != NULL);
+
+	if (last < first)
+		return 0;
+
+	chrs = malloc(sizeof(uint16_t) * (last - first + 1));
+	for (chr = first; chr <= last; ++chr) {
+		/* skip characters without a glyph */
+		if (font->ttf->glyph_table[chr] >= font->ttf->nglyphs)
+			continue;
+		chrs[n++] = (uint16_t) chr;
 	}
+	count = font_prepare_set(font, chrs, n, triangulated, pool,
+			progress, data);
+	free(chrs);
+	return count;
+}
+
+float char_width(font_t* font, uint16_t chr)
+{
+	const pack_glyph_t*	glyph;
+
+	assert(font != NULL);
+
+	if (font->pack && (glyph = pack_find(font->pack, chr)))
+		return glyph->advance;
+	return ttf_char_width(font->ttf, chr);
 }
 
 float line_width(font_t* font, const char* str)
 {
-	return ttf_line_width(font->ttf, str);
+	const char*	p = str;
+	float		width = 0;
+
+	assert(font != NULL);
+
+	while (*p != '\0') {
+		wchar_t	wc;
+		int	n;
+
+		n = mbtowc(&wc, p, MB_CUR_MAX);
+		if (n == -1) break;
+		else p += n;
+
+		width += char_width(font, wc);
+	}
+	return width;
 }
 
 float line_height(font_t* font)
@@ -164,10 +520,42 @@ void draw_hollow_word(font_t* font, const char* str)
 		}
 		glEnd();
 		// offset to next character
-		glTranslatef(ttf_char_width(font->ttf, wc), 0, 0);
+		glTranslatef(char_width(font, wc), 0, 0);
+	}
+}
+
+/* Emit the vertices of the mesh triangles at depth z
+ */
+static void draw_mesh(mesh_t* mesh, float z)
+{
+	int	i;
+
+	for (i = 0; i < mesh->ntri*3; ++i) {
+		vector_t	v = mesh->vecs[mesh_index(mesh, i)];
+		glVertex3f(v.x, v.y, z);
+	}
+}
+
+static void draw_qmesh(qmesh_t* qmesh, float z)
+{
+	int	i;
+
+	for (i = 0; i < qmesh->ntri*3; ++i) {
+		vector_t	v = qmesh_vec(qmesh, qmesh_index(qmesh, i));
+		glVertex3f(v.x, v.y, z);
 	}
 }
 
+/* Emit the triangles of the mesh of a character at depth z
+ */
+static void draw_chr_mesh(font_t* font, uint16_t chr, float z)
+{
+	if (font->cmesh[chr])
+		draw_mesh(font->cmesh[chr], z);
+	else if (font->cqmesh && font->cqmesh[chr])
+		draw_qmesh(font->cqmesh[chr], z);
+}
+
 void draw_filled_word(font_t* font, const char* str)
 {
 	const char* s;
@@ -177,47 +565,21 @@ void draw_filled_word(font_t* font, const char* str)
 	while (*s != '\0') {
 		wchar_t 	wc;
 		int		n;
-		edge_list_t*	edge_list;
-		list_t*	p;
-		list_t*	h;
 
 		n = mbtowc(&wc, s, MB_CUR_MAX);
 		if (n == -1) break;
 		else s += n;
 
 		font_prepare_chr(font, wc, 1);
-		edge_list = font->cedges[wc];
-		if (!edge_list) continue;
+		if (!has_mesh(font, wc)) continue;
 
 		glBegin(GL_TRIANGLES);
-		p = h = edge_list->faces;
-		if (p)
-		do {
-			face_t*	face = p->data;
-			edge_t*	edge = face->outer_component;
-			p = p->succ;
-
-			if (!face->is_inside || edge == NULL)
-				continue;
-
-			if (edge->succ->succ->succ == edge) {
-
-				edge_t*	e = edge;
-				glNormal3d(0, 0, 1);
-				
-				do {
-					glVertex3f(e->origin->vec.x,
-							e->origin->vec.y, 0);
-					e = e->succ;
-
-				} while (e != edge);
-			}
-
-		} while (p != h);
+		glNormal3d(0, 0, 1);
+		draw_chr_mesh(font, wc, 0);
 		glEnd();
 
 		// offset to next character
-		glTranslatef(ttf_char_width(font->ttf, wc), 0, 0);
+		glTranslatef(char_width(font, wc), 0, 0);
 	}
 }
 
@@ -230,9 +592,6 @@ void draw_3d_word(font_t* font, const char* str, float depth)
 	while (*s != '\0') {
 		wchar_t 	wc;
 		int		n;
-		list_t*	p;
-		list_t*	h;
-		edge_list_t*	edge_list;
 		shape_t*	shape;
 		int i;
 
@@ -241,32 +600,12 @@ void draw_3d_word(font_t* font, const char* str, float depth)
 		else s += n;
 
 		font_prepare_chr(font, wc, 1);
-		edge_list = font->cedges[wc];
 		shape = font->cshape[wc];
-		if (!edge_list) continue;
+		if (!has_mesh(font, wc)) continue;
 
 		glBegin(GL_TRIANGLES);
-		p = h = edge_list->faces;
-		if (p)
-		do {
-			face_t*	face = p->data;
-			edge_t*	edge = face->outer_component;
-			edge_t*	e;
-			p = p->succ;
-
-			if (!face->is_inside || edge == NULL)
-				continue;
-
-			glNormal3d(0, 0, 1);
-			e = edge;
-			do {
-				glVertex3f(e->origin->vec.x,
-						e->origin->vec.y, 0);
-				e = e->succ;
-
-			} while (e != edge);
-
-		} while (p != h);
+		glNormal3d(0, 0, 1);
+		draw_chr_mesh(font, wc, 0);
 		glEnd();
 
 		glBegin(GL_QUADS);
@@ -286,7 +625,7 @@ void draw_3d_word(font_t* font, const char* str, float depth)
 		glEnd();
 
 		// offset to next character
-		glTranslatef(ttf_char_width(font->ttf, wc), 0, 0);
+		glTranslatef(char_width(font, wc), 0, 0);
 	}
 }
 
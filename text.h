@@ -25,6 +25,8 @@
 #include "ttf.h"
 #include "triangulate.h"
 #include "typeset.h"
+#include "pack.h"
+#include "qmesh.h"
 
 typedef struct font	font_t;
 
@@ -32,7 +34,12 @@ typedef struct font	font_t;
 struct font {
 	ttf_t*		ttf;
 	shape_t**	cshape;
-	edge_list_t**	cedges;
+	mesh_t**	cmesh;/* triangulated glyphs */
+	qmesh_t**	cqmesh;/* quantized glyphs, NULL unless quantized */
+	triangulator_t*	triangulator;/* scratch memory for triangulation */
+	float		tolerance;/* outline simplification, 0 to disable */
+	float		snap;/* snap rounding grid, e.g. 1/upem, 0 to disable */
+	pack_t*		pack;/* baked glyphs, may be NULL */
 };
 
 // returns non-NULL on success
@@ -41,9 +48,47 @@ font_t* load_font(const char* name, int ipl);
 font_t* load_font_file(FILE* fp, int ipl);
 void free_font(font_t** font);
 
+// serve glyphs from a pack written by cttf-bake, glyphs that are not in
+// the pack are still triangulated when they are prepared
+//
+// The pack must be baked from the same font at the interpolation level
+// of the font. Sets the tolerance and snap grid of the font to those of
+// the pack, so that glyphs outside the pack are prepared the same way.
+// Returns zero on success.
+int font_use_pack(font_t* font, const char* path);
+
+// keep the triangulated glyphs of the font quantized, which halves the
+// size of their vertices, see qmesh.h
+//
+// Meshes already prepared are quantized now and later ones as they are
+// prepared, cmesh is then left empty and cqmesh holds the meshes.
+void font_quantize(font_t* font);
+
 // prepare a character for rendering
 void font_prepare_chr(font_t* font, uint16_t chr, int triangulated);
 
+// progress of a batch prepare, return nonzero to cancel the rest
+typedef int (*font_progress_t)(void* data, int done, int total);
+
+// prepare a set of characters, in parallel on the pool if not NULL
+//
+// The progress callback (may be NULL) is called from the pool threads,
+// one call at a time, after each character. The prepared outlines and
+// meshes are put in the font when all characters are done or the job
+// was cancelled. Returns the number of characters of the set that are
+// prepared.
+int font_prepare_set(font_t* font, const uint16_t* chrs, int n,
+		int triangulated, pool_t* pool,
+		font_progress_t progress, void* data);
+
+// prepare the characters first to last that have a glyph
+int font_prepare_range(font_t* font, uint16_t first, uint16_t last,
+		int triangulated, pool_t* pool,
+		font_progress_t progress, void* data);
+
+// advance of a character, from the pack if the glyph is in it
+float char_width(font_t* font, uint16_t chr);
+
 float line_width(font_t* font, const char* str);
 
 float line_height(font_t* font);
@@ -26,25 +26,25 @@
  * Note that this algorithm can not handle polygons with intersecting
  * segments although simple polygons with holes are supported.
  *
- * The only thing in the current implementation of this algorithm which
- * does not follow the book, is the search tree which is used to find
- * the seg directly left of a point. It is not a balanced search tree
- * and so may have worse running time than log(n). However, for most
- * kinds of polygons there will seldom be more than 3 or 4 edges in
- * this data structure at a time so it's not a biggie.
+ * The search tree used to find the seg directly left of a point is a
+ * red-black tree (see bstree.c).
  *
- * TODO: make the search tree a red-black tree
+ * The vertices, edges and faces of an edge list, and the list nodes
+ * that link them, are allocated from an arena so that the whole edge
+ * list is released at once.
  */
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
 #include <math.h>
 #include <stdio.h>
 #include "triangulate.h"
+#include "earclip.h"
 #include "list.h"
+#include "predicates.h"
 #include "qsortv.h"
-#include "stack.h"
-#include "treeset.h"
+#include "weld.h"
 
 /* Vertex status flags */
 #define VERTEX_FLAG1	(1)
@@ -52,6 +52,45 @@
 #define VERTEX_UP	(4)
 #define VERTEX_DOWN	(8)
 
+/* Smallest edge list for which the monotone faces are triangulated
+ * in parallel when a pool is given */
+#define PARALLEL_MIN_VERTS	(2048)
+
+/* The temporary arrays of the triangulation passes */
+enum scratch {
+	SCRATCH_EVENTS,		/* make_planar */
+	SCRATCH_WELD,
+	SCRATCH_KEYS,		/* sorting */
+	SCRATCH_KEY_BUF,
+	SCRATCH_ITEM_BUF,
+	SCRATCH_INCIDENT,	/* connect_components */
+	SCRATCH_SPLITS,
+	SCRATCH_WALK,
+	SCRATCH_FIRST,
+	SCRATCH_CYCLES,
+	SCRATCH_IS_INNER,
+	SCRATCH_PARENT,
+	SCRATCH_SIZE,
+	SCRATCH_TO_OUTER,
+	SCRATCH_LEFTMOST,
+	SCRATCH_NEXT,
+	SCRATCH_PINCHED,
+	SCRATCH_FACES,
+	SCRATCH_FACE_VERTICES,	/* monotone partition */
+	SCRATCH_CHAIN,		/* triangulation of monotone faces */
+	SCRATCH_ORDER,
+	SCRATCH_STACK,
+	SCRATCH_DIAG,
+	SCRATCH_MAP,		/* edgelist_to_mesh */
+	NSCRATCH
+};
+
+struct triangulator {
+	arena_t*	arena;/* the edge list */
+	void*		scratch[NSCRATCH];
+	size_t		size[NSCRATCH];/* bytes in each scratch array */
+};
+
 #if 0
 #define USE_SHARED
 #endif
@@ -74,8 +113,6 @@
 #endif
 
 static void set_left_face(edge_t* component, face_t* face);
-static double angle(vector_t v1, vector_t v2);
-static double angle_between(double a1, double a2);
 static void handle_start_vertex(edge_list_t* edge_list, vertex_t* v);
 static void handle_end_vertex(edge_list_t* edge_list, vertex_t* v);
 static void handle_split_vertex(edge_list_t* edge_list, vertex_t* v);
@@ -86,12 +123,22 @@ static vertex_t* helper(edge_t* e);
 static void set_helper(edge_t* e, vertex_t* v);
 static void align_vertices(edge_t* start);
 static void align_face_vertices(face_t* face);
+static void triangulate_monotone(triangulator_t* t, edge_list_t* edge_list,
+		pool_t* pool);
+static edge_list_t* make_planar_in(triangulator_t* t, shape_t* shape);
+static edge_list_t* triangulate_in(triangulator_t* t, shape_t* shape,
+		pool_t* pool);
+static mesh_t* edgelist_to_mesh_in(triangulator_t* t, edge_list_t* edge_list);
 
 /* Tree comparators */
 static int edge_left_of_edge(void* a, void* b);
 static int vertex_left_of_edge(void* v, void* b);
+static int vertex_right_of_edge(void* v, void* b);
 
 /* Free resources used by the given edge list
+ *
+ * If the edge list was built in an arena supplied by the caller its
+ * memory is released when the arena is reset or freed.
  */
 void free_edgelist(edge_list_t** edge_list)
 {
@@ -101,37 +148,14 @@ void free_edgelist(edge_list_t** edge_list)
 	p = *edge_list;
 	if (!p) return;
 
-	/* free vertices */
-	if (p->vertices) {
-		int i;
-		for (i = 0; i < p->nvert; ++i)
-			free(p->vertices[i]);
-		free(p->vertices);
-	}
-
-	/* free faces */
-	while (p->faces) {
-		face_t*	face = p->faces->data;
-
-		while (face->inner_components)
-			list_remove(&face->inner_components);
-		free(face);
-		list_remove(&p->faces);
-	}
-
-	/* free edges */
-	while (p->edges) {
-		free(p->edges->data);
-		list_remove(&p->edges);
-	}
-
-	/* free cycle list */
-	free_list(&p->cycles);
-
 	/* free edge tree */
 	free_bstree(&p->etree);
 
-	free(*edge_list);
+	/* everything else lives in the arena */
+	if (p->owns_arena) {
+		arena_t*	arena = p->arena;
+		free_arena(&arena);
+	}
 	*edge_list = NULL;
 }
 
@@ -144,13 +168,10 @@ static void print_edge(edge_t* edge)
 /* debug func */
 void print_edge_tree(bstree_t* tree)
 {
-	if (!tree) return;
-	if (tree->left == NULL && tree->right == NULL) {
-		print_edge(tree->value);
-	} else {
-		print_edge_tree(tree->left);
-		print_edge_tree(tree->right);
-	}
+	bstree_t*	p;
+
+	for (p = bstree_first(tree); p != NULL; p = bstree_next(p))
+		print_edge(p->value);
 }
 
 /* Returns 1 if a is above b
@@ -179,28 +200,133 @@ static int vec_close(vector_t a, vector_t b)
 	return diff.x < DIST_EPS && diff.y < DIST_EPS;
 }
 
-static int event_above(const void* a, const void* b)
+/* Points of a shape closer than WELD_EPS times the size of the shape
+ * are welded together before the sweep
+ */
+#define WELD_EPS (1E-06)
+
+/* Returns the welding tolerance of a shape
+ */
+static float weld_tolerance(shape_t* shape)
+{
+	float	x0, y0, x1, y1;
+	float	eps;
+	int	i;
+
+	if (shape->nvec == 0)
+		return DIST_EPS;
+	x0 = x1 = shape->vec[0].x;
+	y0 = y1 = shape->vec[0].y;
+	for (i = 1; i < shape->nvec; ++i) {
+		vector_t	v = shape->vec[i];
+		if (v.x < x0) x0 = v.x;
+		if (v.x > x1) x1 = v.x;
+		if (v.y < y0) y0 = v.y;
+		if (v.y > y1) y1 = v.y;
+	}
+	eps = WELD_EPS * (x1-x0 > y1-y0 ? x1-x0 : y1-y0);
+	return eps > DIST_EPS ? eps : DIST_EPS;
+}
+
+/* Returns 1 if the point a is strictly left of the line through b1 and b2
+ *
+ * Left means to the left as seen when following the line downward
+ * in sweep order (see vec_above). For a horizontal line a point on
+ * the line is not left of it.
+ */
+static int vec_left_of(vector_t a, vector_t b1, vector_t b2)
 {
-	const struct event*	ea = *(struct event**)a;
-	const struct event*	eb = *(struct event**)b;
-	if (vec_above(ea->vec, eb->vec))
-		return -1;
-	else if (vec_eq(ea->vec, eb->vec))
-		return 0;
+	if (vec_above(b1, b2))
+		return orient2d(b1, b2, a) < 0;
 	else
-		return 1;
+		return orient2d(b2, b1, a) < 0;
 }
 
-static int vertex_above(const void* a, const void* b)
+/* Returns 1 if the point a is strictly right of the line through b1 and b2
+ */
+static int vec_right_of(vector_t a, vector_t b1, vector_t b2)
 {
-	const vertex_t*	va = *(vertex_t**)a;
-	const vertex_t*	vb = *(vertex_t**)b;
-	if (vec_above(va->vec, vb->vec))
-		return -1;
-	else if (vec_eq(va->vec, vb->vec))
-		return 0;
+	if (vec_above(b1, b2))
+		return orient2d(b1, b2, a) > 0;
 	else
-		return 1;
+		return orient2d(b2, b1, a) > 0;
+}
+
+/* Build the edge list in the arena, without scratch arrays so far
+ */
+static void init_triangulator(triangulator_t* t, arena_t* arena)
+{
+	int	i;
+
+	t->arena = arena;
+	for (i = 0; i < NSCRATCH; ++i) {
+		t->scratch[i] = NULL;
+		t->size[i] = 0;
+	}
+}
+
+static void free_scratch(triangulator_t* t)
+{
+	int	i;
+
+	for (i = 0; i < NSCRATCH; ++i) {
+		free(t->scratch[i]);
+		t->scratch[i] = NULL;
+		t->size[i] = 0;
+	}
+}
+
+/* Returns the scratch array id with room for at least size bytes
+ *
+ * The arrays only grow, so a triangulator that is reused stops
+ * allocating once it has seen its largest shape. The contents are kept
+ * when an array grows.
+ */
+static void* scratch(triangulator_t* t, enum scratch id, size_t size)
+{
+	if (size > t->size[id]) {
+		size_t	n = 2 * t->size[id];
+		if (n < size)
+			n = size;
+		t->scratch[id] = realloc(t->scratch[id], n);
+		t->size[id] = n;
+	}
+	return t->scratch[id];
+}
+
+/* Sort items by ascending key, see sort_keyed
+ */
+static void sort_scratch(triangulator_t* t, void** items, uint64_t* keys,
+		unsigned n)
+{
+	sort_keyed_buf(items, keys, n,
+			scratch(t, SCRATCH_KEY_BUF, sizeof(uint64_t) * n),
+			scratch(t, SCRATCH_ITEM_BUF, sizeof(void*) * n));
+}
+
+/* Sort events in order of decreasing height, see vec_above
+ */
+static void sort_events(triangulator_t* t, struct event** events,
+		unsigned n)
+{
+	uint64_t*	keys = scratch(t, SCRATCH_KEYS, sizeof(uint64_t) * n);
+	unsigned	i;
+
+	for (i = 0; i < n; ++i)
+		keys[i] = vec_sort_key(events[i]->vec);
+	sort_scratch(t, (void**) events, keys, n);
+}
+
+/* Sort vertices in order of decreasing height, see qsort_verts
+ */
+static void sort_vertices(triangulator_t* t, vertex_t** verts, unsigned n)
+{
+	uint64_t*	keys = scratch(t, SCRATCH_KEYS, sizeof(uint64_t) * n);
+	unsigned	i;
+
+	for (i = 0; i < n; ++i)
+		keys[i] = vec_sort_key(verts[i]->vec);
+	sort_scratch(t, (void**) verts, keys, n);
 }
 
 /* Get helper vertex of an edge
@@ -219,9 +345,9 @@ static void set_helper(edge_t* e, vertex_t* v)
 
 /* Create a new vertex
  */
-static vertex_t* new_vertex()
+static vertex_t* new_vertex(arena_t* arena)
 {
-	vertex_t*	obj = malloc(sizeof(vertex_t));
+	vertex_t*	obj = arena_alloc(arena, sizeof(vertex_t));
 	obj->vtype = UNCLASSIFIED_VERTEX;
 	obj->flags = 0;
 	obj->incident_edge = NULL;
@@ -230,9 +356,9 @@ static vertex_t* new_vertex()
 
 /* Create a new, empty edge
  */
-static edge_t* new_edge()
+static edge_t* new_edge(arena_t* arena)
 {
-	edge_t*	obj = malloc(sizeof(edge_t));
+	edge_t*	obj = arena_alloc(arena, sizeof(edge_t));
 	obj->origin = NULL;
 	obj->left_face = NULL;
 	obj->twin = NULL;
@@ -247,32 +373,63 @@ static edge_t* new_edge()
  */
 static face_t* new_face(edge_list_t* edge_list)
 {
-	face_t*	obj = malloc(sizeof(face_t));
+	face_t*	obj = arena_alloc(edge_list->arena, sizeof(face_t));
 	obj->inner_components = NULL;
 	obj->outer_component = NULL;
 	obj->is_inside = -1;
-	list_add(&edge_list->faces, obj);
+	arena_list_add(edge_list->arena, &edge_list->faces, obj);
 	return obj;
 }
 
-/* Angle of vector v1->v2
+/* Compares the counterclockwise angle from the direction o->a to the
+ * direction o->b with PI. The angle is in (0, 2*PI], equal directions
+ * make a full turn.
  *
- * ( 1, 0) => 0
- * ( 0, 1) => pi/2
- * (-1, 0) => pi
- * ( 0,-1) => pi*3/2
+ * Returns -1, 0 or 1 if the angle is less than, equal to or greater
+ * than PI.
+ */
+static int ccw_angle_cmp_pi(vector_t o, vector_t a, vector_t b)
+{
+	double	det = orient2d(o, a, b);
+
+	if (det > 0)
+		return -1;
+	else if (det < 0)
+		return 1;
+	else
+		return vec_same_dir(o, a, b) ? 1 : 0;
+}
+
+/* Returns 0 if the clockwise angle from the direction o->r to the
+ * direction o->a is in [0, PI), otherwise 1
  */
-static double angle(vector_t v1, vector_t v2)
+static int cw_half(vector_t o, vector_t r, vector_t a)
 {
-	double	phi = atan2(v2.y - v1.y, v2.x - v1.x);
-	return (phi >= 0) ? phi : phi + 2*PI;
+	double	det = orient2d(o, r, a);
+
+	if (det < 0)
+		return 0;
+	else if (det > 0)
+		return 1;
+	else
+		return vec_same_dir(o, r, a) ? 0 : 1;
 }
 
-/* Calculates angle difference between a1 and a2
+/* Returns 1 if the direction o->a comes strictly before o->b when
+ * turning clockwise from the direction o->r
+ *
+ * The directions are first split in two half turns and then ordered
+ * by the sign of a cross product, so no angle is computed and the
+ * order is exact.
  */
-static double angle_between(double a1, double a2)
+static int cw_before(vector_t o, vector_t r, vector_t a, vector_t b)
 {
-	return (a2>=a1) ? a1 + 2*PI - a2 : a1 - a2;
+	int	ha = cw_half(o, r, a);
+	int	hb = cw_half(o, r, b);
+
+	if (ha != hb)
+		return ha < hb;
+	return orient2d(o, a, b) < 0;
 }
 
 /* Set the incident face for a component
@@ -306,6 +463,20 @@ static void link_edges(vertex_t* v, edge_t* in, edge_t* out)
 	out->pred = in;
 }
 
+/* Exchange the predecessors of two edges leaving the same vertex. This
+ * splits a cycle through the vertex in two, or joins two cycles.
+ */
+static void swap_pred(edge_t* a, edge_t* b)
+{
+	edge_t*	a_pred = a->pred;
+	edge_t*	b_pred = b->pred;
+
+	a_pred->succ = b;
+	b->pred = a_pred;
+	b_pred->succ = a;
+	a->pred = b_pred;
+}
+
 /* Returns 1 if start is an edge of a new cycle
  * Returns 0 if start was not on a new cycle
  *
@@ -345,22 +516,59 @@ static edge_t* leftmost_edge(edge_t* start)
 	return left;
 }
 
-struct arc {
-	edge_t*	a;
-	edge_t*	b;
+/* The components bounding the same face are joined in a union-find
+ * forest over the cycle ids. The extra id ncycle stands for the
+ * unbounded face, which has no boundary cycle of its own.
+ */
+struct components {
+	unsigned	ncycle;
+	edge_t**	cycles;
+	int*		is_inner;	/* false for the unbounded id */
+	int*		parent;
+	int*		size;
+	int*		to_outer;	/* joined directly to an outer cycle */
+	int*		leftmost;	/* first cycle starting at a vertex */
+	int*		next;		/* next cycle starting at the same vertex */
+	int*		pinched;	/* joined through a shared vertex */
 };
 
-#ifdef USE_SHARED
-static struct arc* new_arc(edge_t* a, edge_t* b)
+static int find_component(struct components* c, int id)
+{
+	while (c->parent[id] != id) {
+		c->parent[id] = c->parent[c->parent[id]];
+		id = c->parent[id];
+	}
+	return id;
+}
+
+static void join_components(struct components* c, int a, int b)
 {
-	struct arc*	arc = malloc(sizeof(struct arc));
-	arc->a = a;
-	arc->b = b;
-	return arc;
+	int	ra;
+	int	rb;
+
+#ifdef BUILD_EDGELIST_DBG
+	printf("joined: %d, %d\n", a, b);
+#endif
+	if (!c->is_inner[b])
+		c->to_outer[a] = 1;
+	if (!c->is_inner[a])
+		c->to_outer[b] = 1;
+
+	ra = find_component(c, a);
+	rb = find_component(c, b);
+	if (ra == rb)
+		return;
+	if (c->size[ra] < c->size[rb]) {
+		int	tmp = ra;
+		ra = rb;
+		rb = tmp;
+	}
+	c->parent[rb] = ra;
+	c->size[ra] += c->size[rb];
 }
 
-static void connect_shared(list_t* out, edge_t** cycles,
-		int* is_inner, list_t** arcs)
+#ifdef USE_SHARED
+static void connect_shared(struct components* c, list_t* out)
 {
 	int	prev = -1;
 	edge_t*	prev_e = NULL;
@@ -375,75 +583,32 @@ static void connect_shared(list_t* out, edge_t** cycles,
 		e = p->data;
 
 		int	id = e->cycle;
-		if (is_inner[id] && prev_e != NULL) {
-			if (!is_inner[prev]) {
-				void*	arc = new_arc(cycles[id], cycles[prev]);
-				list_add(arcs, arc);
-#ifdef BUILD_EDGELIST_DBG
-				printf("joined: %d, %d\n", id, prev);
-#endif
-			} else if (id != prev) {
-				void*	arc = new_arc(cycles[id], cycles[prev]);
-				list_add(arcs, arc);
-#ifdef BUILD_EDGELIST_DBG
-				printf("joined: %d, %d\n", id, prev);
-#endif
-			}
+		if (c->is_inner[id] && prev_e != NULL) {
+			if (!c->is_inner[prev] || id != prev)
+				join_components(c, id, prev);
 		}
 	} while (p != out);
 }
 #endif
 
-static int is_outer(edge_t* cycle, int* is_inner)
-{
-	return cycle == NULL || !is_inner[cycle->cycle];
-}
-
-static int already_connected_to_outer(edge_t* cycle, int* is_inner,
-		list_t** arcs)
-{
-	list_t*	p = *arcs;
-	if (p) do {
-		struct arc*	arc = p->data;
-		if (arc->a == cycle && is_outer(arc->b, is_inner)) {
-			return 1;
-		} else if (arc->b == cycle && is_outer(arc->a, is_inner)) {
-			return 1;
-		}
-		p = p->succ;
-	} while (p != *arcs);
-	return 0;
-}
-
 /* Connect the components (if any) that vertex v is the leftmost vertex of
  * to the edge left_edge immediately to the left of v.
  */
-static void connect_leftmost(vertex_t* v, int ncycle, edge_t** cycles,
-		int* is_inner, edge_t* left_edge, list_t** arcs)
+static void connect_leftmost(struct components* c, vertex_t* v,
+		edge_t* left_edge)
 {
-	int i;
-	for (i = 0; i < ncycle; ++i) {
-		edge_t*	cycle = cycles[i];
-		struct arc*	arc;
+	int	left = left_edge ? left_edge->cycle : (int) c->ncycle;
+	int	i;
 
-		if (v != cycle->origin)
+	for (i = c->leftmost[v->id]; i != -1; i = c->next[i]) {
+		if (!c->is_inner[i] || c->pinched[i])
 			continue;
 
-		if (is_inner[i]) {
-			/* connect to left edge */
-			if (is_outer(left_edge, is_inner) &&
-					already_connected_to_outer(
-						cycle, is_inner, arcs))
-				continue;
+		/* connect to left edge */
+		if (!c->is_inner[left] && c->to_outer[i])
+			continue;
 
-			arc = malloc(sizeof(struct arc));
-			arc->a = cycle;
-			if (left_edge)
-				arc->b = cycles[left_edge->cycle];
-			else
-				arc->b = NULL;
-			list_add(arcs, arc);
-		}
+		join_components(c, i, left);
 	}
 }
 
@@ -474,6 +639,63 @@ static void align_face_vertices(face_t* face)
 	}
 }
 
+/* Add the vertices of a boundary cycle of a face to an array
+ */
+static void collect_vertices(edge_t* start, vertex_t** vertices, int* n)
+{
+	edge_t*	p;
+	p = start;
+	do {
+		/* a vertex visited more than once by the cycle
+		 * is taken at its incident edge only */
+		if (p->origin->incident_edge == p)
+			vertices[(*n)++] = p->origin;
+		p = p->succ;
+	} while (p != start);
+}
+
+/* Collect the vertices on the boundary of a face in sweep order, so
+ * that the monotone partition of a face only touches its own vertices.
+ * The vertices must be aligned to the face (see align_face_vertices).
+ *
+ * Returns the number of vertices, the array is a scratch array of the
+ * triangulator.
+ */
+static int face_vertices(triangulator_t* t, face_t* face,
+		vertex_t*** vertices)
+{
+	int	nedge = 0;
+	int	n = 0;
+	edge_t*	p;
+	list_t*	q;
+
+	if ((p = face->outer_component)) do {
+		nedge += 1;
+		p = p->succ;
+	} while (p != face->outer_component);
+	if ((q = face->inner_components)) do {
+		edge_t*	start = q->data;
+		p = start;
+		do {
+			nedge += 1;
+			p = p->succ;
+		} while (p != start);
+		q = q->succ;
+	} while (q != face->inner_components);
+
+	*vertices = scratch(t, SCRATCH_FACE_VERTICES,
+			sizeof(vertex_t*) * (nedge + 1));
+	if (face->outer_component)
+		collect_vertices(face->outer_component, *vertices, &n);
+	if ((q = face->inner_components)) do {
+		collect_vertices(q->data, *vertices, &n);
+		q = q->succ;
+	} while (q != face->inner_components);
+
+	sort_vertices(t, *vertices, n);
+	return n;
+}
+
 static void find_connecting_faces(list_t** faces, face_t* face,
 		edge_t* component)
 {
@@ -551,6 +773,50 @@ static void set_not_visited(edge_t* cycle)
 	} while (p != cycle);
 }
 
+/* Give a cycle its own copy of each vertex that was already visited,
+ * either earlier in the same walk or by another cycle of the face
+ */
+static void separate_cycle(edge_list_t* edge_list, edge_t* cycle)
+{
+	edge_t*	p = cycle;
+	do {
+		vertex_t*	v = p->origin;
+		if (v->flags & VERTEX_VISITED) {
+			vertex_t*	copy = new_vertex(edge_list->arena);
+			copy->vec = v->vec;
+			copy->id = v->id;
+			copy->incident_edge = p;
+			p->origin = copy;
+		} else {
+			v->flags |= VERTEX_VISITED;
+		}
+		p = p->succ;
+	} while (p != cycle);
+}
+
+/* Give every corner of a face its own vertex where its boundary visits
+ * a vertex more than once, so that the monotone partition sees simple
+ * cycles. The copies keep the position and id of the shared vertex.
+ */
+static void separate_corners(edge_list_t* edge_list, face_t* face)
+{
+	list_t*	q;
+
+	if (face->outer_component)
+		set_not_visited(face->outer_component);
+	if ((q = face->inner_components)) do {
+		set_not_visited(q->data);
+		q = q->succ;
+	} while (q != face->inner_components);
+
+	if (face->outer_component)
+		separate_cycle(edge_list, face->outer_component);
+	if ((q = face->inner_components)) do {
+		separate_cycle(edge_list, q->data);
+		q = q->succ;
+	} while (q != face->inner_components);
+}
+
 /* debug func */
 void print_vertex(vertex_t* v)
 {
@@ -571,7 +837,7 @@ void print_vertex(vertex_t* v)
  * so don't attempt to use a shape which describes a non-simple
  * polygon. Polygons with holes are permitted though.
  */
-void connect_components(edge_list_t* edge_list)
+static void connect_components_in(triangulator_t* t, edge_list_t* edge_list)
 {
 	unsigned		nvert = edge_list->nvert;
 	vertex_t**	vertices = edge_list->vertices;
@@ -580,11 +846,16 @@ void connect_components(edge_list_t* edge_list)
 	list_t*		split_cycles;
 	unsigned i;
 	unsigned ncycle;
+	unsigned nwalk;
+	unsigned nsplit;
+	edge_t** splits;
 	edge_t** cycles;
+	int* walk;
+	int* first;
 	int* is_inner;
 	bstree_t* status = NULL;
-	list_t* arcs = NULL;
-	list_t* connected = NULL;
+	struct components components;
+	face_t** faces;
 	face_t*	unbounded_face = NULL;
 
 	if (nvert < 3) {
@@ -592,7 +863,7 @@ void connect_components(edge_list_t* edge_list)
 		return;
 	}
 
-	incident_edges = malloc(sizeof(list_t*) * nvert);
+	incident_edges = scratch(t, SCRATCH_INCIDENT, sizeof(list_t*) * nvert);
 
 	/* Identify cycles */
 	full_cycles = NULL;
@@ -600,11 +871,11 @@ void connect_components(edge_list_t* edge_list)
 		vertex_t*	v = vertices[i];
 		edge_t*	p;
 
+		incident_edges[i] = NULL;
+
 		if (!v->incident_edge)
 			continue;/* ignore detached vertices */
 
-		incident_edges[i] = NULL;
-
 		p = v->incident_edge;
 		if (p) do {
 
@@ -623,12 +894,19 @@ void connect_components(edge_list_t* edge_list)
  	 * Add the final cycles with their leftmost edges into the edge list.
  	 */
 	split_cycles = NULL;
+	splits = NULL;
+	nwalk = 0;
+	nsplit = 0;
 	while (full_cycles) {
 		edge_t*	cycle = list_remove(&full_cycles);
 		edge_t*	p = cycle;
 
 		set_not_visited(cycle);
 
+		/* remember the walk in the split cycles */
+		set_cycle(cycle, -3 - (int) nwalk);
+		nwalk += 1;
+
 #ifdef BUILD_EDGELIST_DBG
 		printf("cycle: "); print_edge(cycle);
 #endif
@@ -659,9 +937,14 @@ void connect_components(edge_list_t* edge_list)
 				/* Add chain containing incident(origin(p))
 				 * to cycle list
 				 */
-#ifdef USE_SHARED
 				list_add(&split_cycles, in);
-#endif
+
+				/* the walk is joined again for the faces */
+				splits = scratch(t, SCRATCH_SPLITS,
+						sizeof(edge_t*) * 2 * (nsplit + 1));
+				splits[2*nsplit] = in;
+				splits[2*nsplit + 1] = p;
+				nsplit += 1;
 				cycle = p;
 				set_not_visited(cycle);
 			}
@@ -679,12 +962,15 @@ void connect_components(edge_list_t* edge_list)
 	printf("removing line segs\n");
 #endif
 	ncycle = 0;
+	walk = scratch(t, SCRATCH_WALK, sizeof(int) * (nwalk + nsplit));
 	while (split_cycles) {
 		edge_t*	cycle = list_remove(&split_cycles);
 
 		if (cycle->succ->succ != cycle) {
+			walk[ncycle] = -3 - cycle->cycle;
 			set_cycle(cycle, ncycle);
-			list_add(&edge_list->cycles, leftmost_edge(cycle));
+			arena_list_add(edge_list->arena, &edge_list->cycles,
+					leftmost_edge(cycle));
 			ncycle += 1;
 #ifdef BUILD_EDGELIST_DBG
 			print_cycle(cycle);
@@ -698,7 +984,7 @@ void connect_components(edge_list_t* edge_list)
 	printf("ncycle: %d\n", ncycle);
 #endif
 	/* Build cycle array */
-	cycles = malloc(sizeof(edge_t*) * ncycle);
+	cycles = scratch(t, SCRATCH_CYCLES, sizeof(edge_t*) * ncycle);
 	if (edge_list->cycles) {
 		list_t* p = edge_list->cycles;
 		for (i = 0; i < ncycle; ++i) {
@@ -712,7 +998,8 @@ void connect_components(edge_list_t* edge_list)
 		edge_t*	e = cycle;
 		do {
 			vertex_t*	v = e->origin;
-			list_add(&incident_edges[v->id], e);
+			arena_list_add(edge_list->arena,
+					&incident_edges[v->id], e);
 			e = e->succ;
 		} while (e != cycle);
 	}
@@ -720,7 +1007,8 @@ void connect_components(edge_list_t* edge_list)
 	/* Classify cycles as inner or outer components.
 	 * A cycle is an inner component if it's edges are clockwise oriented.
 	 */
-	is_inner = malloc(sizeof(int) * ncycle);
+	is_inner = scratch(t, SCRATCH_IS_INNER, sizeof(int) * (ncycle + 1));
+	is_inner[ncycle] = 0;
 	for (i = 0; i < ncycle; ++i) {
 		vector_t	u = cycles[i]->origin->vec;
 		vector_t	u1 = cycles[i]->pred->origin->vec;
@@ -731,10 +1019,7 @@ void connect_components(edge_list_t* edge_list)
 		 * the bounding edge of a hole. Otherwise  it is an outer
 		 * component
 		 */
-		
-		double a1 = angle(u, u1); 
-		double a2 = angle(u, u2); 
-		is_inner[i] = angle_between(a1, a2) > PI;
+		is_inner[i] = ccw_angle_cmp_pi(u, u2, u1) > 0;
 
 		/* debug */
 		/*printf("%d, %d, %d : %s\n",
@@ -744,8 +1029,62 @@ void connect_components(edge_list_t* edge_list)
 				is_inner[i] ? "true" : "false");*/
 	}
 
+	/* Each cycle starts at its leftmost vertex, chain the cycles
+	 * by that vertex so the sweep finds them without a search */
+	components.ncycle = ncycle;
+	components.cycles = cycles;
+	components.is_inner = is_inner;
+	components.parent = scratch(t, SCRATCH_PARENT,
+			sizeof(int) * (ncycle + 1));
+	components.size = scratch(t, SCRATCH_SIZE, sizeof(int) * (ncycle + 1));
+	components.to_outer = scratch(t, SCRATCH_TO_OUTER,
+			sizeof(int) * (ncycle + 1));
+	components.leftmost = scratch(t, SCRATCH_LEFTMOST, sizeof(int) * nvert);
+	components.next = scratch(t, SCRATCH_NEXT, sizeof(int) * (ncycle + 1));
+	memset(components.to_outer, 0, sizeof(int) * (ncycle + 1));
+	for (i = 0; i < nvert; ++i)
+		components.leftmost[i] = -1;
+	for (i = 0; i <= ncycle; ++i) {
+		components.parent[i] = i;
+		components.size[i] = 1;
+	}
+	for (i = ncycle; i-- > 0; ) {
+		int	id = cycles[i]->origin->id;
+		components.next[i] = components.leftmost[id];
+		components.leftmost[id] = i;
+	}
+
+	/* The cycles split from one boundary walk touch at shared vertices
+	 * and bound the same face. Only the one with the leftmost vertex is
+	 * connected to the edge left of it. */
+	components.pinched = scratch(t, SCRATCH_PINCHED,
+			sizeof(int) * (ncycle + 1));
+	memset(components.pinched, 0, sizeof(int) * (ncycle + 1));
+	first = scratch(t, SCRATCH_FIRST, sizeof(int) * (nwalk + 1));
+	for (i = 0; i < nwalk; ++i)
+		first[i] = -1;
+	for (i = 0; i < ncycle; ++i) {
+		int		j = first[walk[i]];
+		vector_t	v0;
+		vector_t	v1;
+
+		if (j == -1) {
+			first[walk[i]] = i;
+			continue;
+		}
+		v0 = cycles[j]->origin->vec;
+		v1 = cycles[i]->origin->vec;
+		if (v1.x < v0.x || (v1.x == v0.x && v1.y < v0.y)) {
+			components.pinched[j] = 1;
+			first[walk[i]] = i;
+		} else {
+			components.pinched[i] = 1;
+		}
+		join_components(&components, i, j);
+	}
+
 	/* Sort the vertices in order of decreasing Y-coordinate */
-	qsort_verts(vertices, nvert);
+	sort_vertices(t, vertices, nvert);
 
 	/* Note:
 	 * the half-edge going down is always the one on the right hand side
@@ -759,6 +1098,7 @@ void connect_components(edge_list_t* edge_list)
 	for (i = 0; i < nvert; ++i) {
 		vertex_t*	v = vertices[i];
 		edge_t*		left_edge = NULL;
+		list_t*		ending;
 		list_t*		out;
 		list_t*		p;
 
@@ -767,7 +1107,15 @@ void connect_components(edge_list_t* edge_list)
 		print_vertex(v);
 #endif
 
-		bstree_remove_if(&status, v, &edge_ends_at_vertex);
+		/* edges ending at v pass through v, so they are adjacent
+		 * in the status */
+		ending = NULL;
+		bstree_find_range(status, v, vertex_left_of_edge,
+				vertex_right_of_edge, edge_ends_at_vertex,
+				&ending);
+		while (ending)
+			bstree_remove(&status, list_remove(&ending),
+					edge_left_of_edge);
 
 		left_edge = bstree_find_left(status, v, vertex_left_of_edge);
 
@@ -797,7 +1145,7 @@ void connect_components(edge_list_t* edge_list)
 #endif
 
 #ifdef USE_SHARED
-		connect_shared(out, cycles, is_inner, &arcs);
+		connect_shared(&components, out);
 		int shared = 0;
 		if (left_edge != NULL) {
 			int	oc = left_edge->cycle;
@@ -812,8 +1160,7 @@ void connect_components(edge_list_t* edge_list)
 		}
 		if (!shared) {
 #endif
-			connect_leftmost(v, ncycle, cycles,
-				is_inner, left_edge, &arcs);
+			connect_leftmost(&components, v, left_edge);
 #ifdef USE_SHARED
 		}
 #endif
@@ -824,108 +1171,63 @@ void connect_components(edge_list_t* edge_list)
 #endif
 	}
 
-	for (i = 0; i < nvert; ++i) {
-		free_list(&incident_edges[i]);
-	}
-	free(incident_edges);
-
 	assert(status == NULL);
 
-	/* The arcs list contains the arcs between connected components.
-	 * Use the arcs to connect components to faces.
-	 */
-	while (arcs) {
-		struct arc*	arc = list_remove(&arcs);
-		edge_t*		a = arc->a;
-		edge_t*		b = arc->b;
-		set_t*		aset = NULL;
-		set_t*		bset = NULL;
-		list_t* p;
-
-#ifdef BUILD_EDGELIST_DBG
-		printf("arc: ");
-		if (a == NULL)
-			printf("unbounded, ");
-		else
-			printf("%d, ", a->cycle);
-		if (b == NULL)
-			printf("unbounded\n");
-		else
-			printf("%d\n", b->cycle);
-#endif
-
-		free(arc);
-
-		p = connected;
-		if (p) do {
-			set_t*	set = p->data;
-			if (set_contains(set, a))
-				aset = set;
-			else if (set_contains(set, b))
-				bset = set;
-			p = p->succ;
-		} while (p != connected);
-
-		if (aset == NULL && bset == NULL) {
-			set_t* nset = NULL;
-			set_add(&nset, a);
-			set_add(&nset, b);
-			list_add(&connected, nset);
-		} else if (aset != NULL && bset == NULL) {
-			set_add(&aset, b);
-		} else if (aset == NULL && bset != NULL) {
-			set_add(&bset, a);
-		} else {
-			list_remove_item(&connected, bset);
-			set_join(&aset, &bset);
-		}
+	/* Join the split walks again, so that each corner of a face is a
+	 * wedge without other edges in it */
+	for (i = nsplit; i-- > 0; ) {
+		edge_t*	a = splits[2*i];
+		edge_t*	b = splits[2*i + 1];
+		if (a->cycle >= 0 && b->cycle >= 0)
+			swap_pred(a, b);
 	}
 
-	while (connected) {
-		set_t*	set = list_remove(&connected);
-		face_t*	face = new_face(edge_list);
-
-#ifdef BUILD_EDGELIST_DBG
-		printf("connected:\n");
-#endif
-		while (set) {
-			edge_t*	e = set_remove(&set);
-			if (e != NULL) {
-#ifdef BUILD_EDGELIST_DBG
-				printf("  %d\n", e->cycle);
-#endif
-				e->left_face = face;
-				if (is_inner[e->cycle]) {
-					list_add(&face->inner_components, e);
-				} else {
-					face->outer_component = e;
-				}
-			} else {
-#ifdef BUILD_EDGELIST_DBG
-				printf("  unbounded\n");
-#endif
-				unbounded_face = face;
-			}
-		}
-	}
+	/* Each set of connected components bounds one face */
+	faces = scratch(t, SCRATCH_FACES, sizeof(face_t*) * (ncycle + 1));
+	memset(faces, 0, sizeof(face_t*) * (ncycle + 1));
+	for (i = 0; i < ncycle; ++i) {
+		int	root = find_component(&components, i);
+		int	inner = 1;
+		edge_t*	edge = cycles[i];
 
-	free(is_inner);/* no longer needed */
+		if (edge->left_face != NULL)
+			continue;/* joined to an earlier cycle */
 
-	assert(unbounded_face != NULL);
+		/* a joined walk is inner if all its cycles are */
+		do {
+			inner = inner && is_inner[edge->cycle];
+			edge = edge->succ;
+		} while (edge != cycles[i]);
 
-	/* Add unconnected faces */
-	for (i = 0; i < ncycle; ++i) {
-		edge_t* edge;
-		if (cycles[i]->left_face == NULL) {
-			cycles[i]->left_face = new_face(edge_list);
-			cycles[i]->left_face->outer_component = cycles[i];
+		if (faces[root] == NULL)
+			faces[root] = new_face(edge_list);
+		if (inner && components.size[root] > 1) {
+			arena_list_add(edge_list->arena,
+					&faces[root]->inner_components,
+					cycles[i]);
+		} else {
+			faces[root]->outer_component = cycles[i];
 		}
 		edge = cycles[i];
 		do {
-			edge->left_face = cycles[i]->left_face;
+			edge->left_face = faces[root];
 			edge = edge->succ;
 		} while (edge != cycles[i]);
 	}
+	i = find_component(&components, ncycle);
+	if (components.size[i] > 1)
+		unbounded_face = faces[i];
+
+	/* walks that were split visit some vertices more than once */
+	if (nsplit > 0) {
+		list_t*	p = edge_list->faces;
+		do {
+			separate_corners(edge_list, p->data);
+			p = p->succ;
+		} while (p != edge_list->faces);
+	}
+
+	assert(unbounded_face != NULL);
 
 	if (unbounded_face != NULL) {
 		/* Classify faces as inside/outside */
@@ -937,8 +1239,15 @@ void connect_components(edge_list_t* edge_list)
 				cycles[i]->left_face->is_inside = 0;
 		}
 	}
+}
 
-	free(cycles);/* no longer needed */
+void connect_components(edge_list_t* edge_list)
+{
+	triangulator_t	t;
+
+	init_triangulator(&t, edge_list->arena);
+	connect_components_in(&t, edge_list);
+	free_scratch(&t);
 }
 
 static void classify_component(edge_t* component)
@@ -952,9 +1261,7 @@ static void classify_component(edge_t* component)
 		vector_t	v;
 		vector_t	v_in;
 		vector_t	v_out;
-		double		angle;
-		double		phi;
-		double		theta;
+		int		reflex;
 		int		x;
 		int		y;
 
@@ -962,27 +1269,22 @@ static void classify_component(edge_t* component)
 		v_in = e->pred->origin->vec;
 		v_out = e->succ->origin->vec;
 
-		phi = atan2(v_out.y - v.y,
-				v_out.x - v.x);
-		theta = atan2(v_in.y - v.y,
-				v_in.x - v.x);
-		if (phi < theta)
-			angle = 2*PI + phi - theta;
-		else
-			angle = phi - theta;
+		/* the counterclockwise angle from v_in to v_out around v
+		 * is greater than PI */
+		reflex = orient2d(v, v_in, v_out) < 0;
 
 		x = vec_above(v, v_in);
 		y = vec_above(v, v_out);
 		if (x && y) {
 
-			if (angle > PI)
+			if (reflex)
 				e->origin->vtype = START_VERTEX;
 			else
 				e->origin->vtype = SPLIT_VERTEX;
 
 		} else if (!x && !y) {
 
-			if (angle > PI)
+			if (reflex)
 				e->origin->vtype = END_VERTEX;
 			else
 				e->origin->vtype = MERGE_VERTEX;
@@ -1023,17 +1325,15 @@ static void classify_face(face_t* face)
 	} while (p != face->inner_components);
 }
 
-static float cross2d(vector_t u, vector_t v)
-{
-	return u.x*v.y - u.y*v.x;
-}
-
 /*
  * a: p -> p+r
  * b: q -> q+s
  *
- * t = cross2d(q-p, s) / cross2d(r, s)
- * u = cross2d(q-p, r) / cross2d(r, s)
+ * t = cross(q-p, s) / cross(r, s)
+ *
+ * Whether the segments intersect is decided by the exact orientation
+ * signs (see predicates.h) so the decision does not depend on rounding.
+ * Only the intersection point itself is rounded.
  */
 static vector_t* seg_intersection(seg_t* a, seg_t* b)
 {
@@ -1041,48 +1341,38 @@ static vector_t* seg_intersection(seg_t* a, seg_t* b)
 	vector_t	p2 = a->end->vec;
 	vector_t	q = b->origin->vec;
 	vector_t	q2 = b->end->vec;
-	vector_t	r;
-	vector_t	s;
-	vector_t	q_p;
-	float		n1;
-	float		n2;
-	float		d;
-
-	r.x = p2.x - p.x;
-	r.y = p2.y - p.y;
-	s.x = q2.x - q.x;
-	s.y = q2.y - q.y;
-	q_p.x = q.x - p.x;
-	q_p.y = q.y - p.y;
-
-	n1 = cross2d(q_p, s);
-	n2 = cross2d(q_p, r);
-	d = cross2d(r, s);
+	double		rx, ry;
+	double		sx, sy;
+	double		d;
+	double		t;
+	vector_t*	vec;
 
-	if (d == 0) {
-		/* parallel */
+	if (!seg_cross(p, p2, q, q2))
 		return NULL;
-	} else {
-		float		t = n1 / d;
-		float		u = n2 / d;
-		vector_t*	vec;
 
-		if (t <= 0 || t >= 1 || u <= 0 || u >= 1)
-			return NULL;
-
-		vec = malloc(sizeof(vector_t));
-		vec->x = p.x + t*r.x;
-		vec->y = p.y + t*r.y;
-		return vec;
+	rx = (double) p2.x - p.x;
+	ry = (double) p2.y - p.y;
+	sx = (double) q2.x - q.x;
+	sy = (double) q2.y - q.y;
+	d = rx*sy - ry*sx;
+	if (d == 0) {
+		/* nearly parallel, the point is not representable */
+		return NULL;
 	}
+
+	t = (((double) q.x - p.x)*sy - ((double) q.y - p.y)*sx) / d;
+	vec = malloc(sizeof(vector_t));
+	vec->x = (float) (p.x + t*rx);
+	vec->y = (float) (p.y + t*ry);
+	return vec;
 }
 
-/* TODO: fix edge allocation */
-static struct event* new_event(vector_t* x, seg_t* in1, seg_t* in2)
+static struct event* new_event(arena_t* arena, vector_t* x,
+		seg_t* in1, seg_t* in2)
 {
-	struct event*	event = malloc(sizeof(struct event));
-	seg_t*		out1 = malloc(sizeof(seg_t));
-	seg_t*		out2 = malloc(sizeof(seg_t));
+	struct event*	event = arena_alloc(arena, sizeof(struct event));
+	seg_t*		out1 = arena_alloc(arena, sizeof(seg_t));
+	seg_t*		out2 = arena_alloc(arena, sizeof(seg_t));
 
 	event->vec = *x;
 	event->in = NULL;
@@ -1132,19 +1422,7 @@ static int event_left_of_seg(void* x, void* y)
 	seg_t*		s = y;
 	struct event*	e = x;
 
-	vector_t	s1 = s->origin->vec;
-	vector_t	s2 = s->end->vec;
-
-	float		xv = e->vec.x;
-	float		yv = e->vec.y;
-	float		xs1 = s1.x;
-	float		ys1 = s1.y;
-	float		xs2 = s2.x;
-	float		ys2 = s2.y;
-
-	float		t = xs1 + (xs2-xs1)*(yv-ys1)/(ys2-ys1);
-
-	return xv < t;
+	return vec_left_of(e->vec, s->origin->vec, s->end->vec);
 }
 
 static int event_right_of_seg(void* x, void* y)
@@ -1152,6 +1430,14 @@ static int event_right_of_seg(void* x, void* y)
 	return !event_left_of_seg(x, y);
 }
 
+static int event_strictly_right_of_seg(void* x, void* y)
+{
+	seg_t*		s = y;
+	struct event*	e = x;
+
+	return vec_right_of(e->vec, s->origin->vec, s->end->vec);
+}
+
 static int seg_left_of_seg(void* x, void* y)
 {
 	seg_t*		a = x;
@@ -1167,13 +1453,11 @@ static int seg_left_of_seg(void* x, void* y)
 /* debug func */
 void print_seg_tree(bstree_t* tree)
 {
-	if (!tree) return;
-	if (tree->left == NULL && tree->right == NULL) {
-		seg_t*	s = tree->value;
+	bstree_t*	p;
+
+	for (p = bstree_first(tree); p != NULL; p = bstree_next(p)) {
+		seg_t*	s = p->value;
 		printf("  %d, %d\n", s->origin->id, s->end->id);
-	} else {
-		print_seg_tree(tree->left);
-		print_seg_tree(tree->right);
 	}
 }
 
@@ -1209,6 +1493,27 @@ void print_seg_list(list_t* segs)
 
 #define EPSILON (1E-04f)
 
+/* Unit direction of a segment
+ */
+static vector_t seg_dir(seg_t* s)
+{
+	vector_t	d;
+	float		l;
+	d.x = s->end->vec.x - s->origin->vec.x;
+	d.y = s->end->vec.y - s->origin->vec.y;
+	l = (float) sqrt(d.x*d.x + d.y*d.y);
+	d.x /= l;
+	d.y /= l;
+	return d;
+}
+
+/* Returns 1 if the unit directions a and b are effectively identical
+ */
+static int dir_close(vector_t a, vector_t b)
+{
+	return fabsf(a.x-b.x) < EPSILON && fabsf(a.y-b.y) < EPSILON;
+}
+
 /* Removes extremities with area below a threshold
  */
 static void remove_zero_area(struct event* e)
@@ -1256,13 +1561,7 @@ static void remove_zero_area(struct event* e)
 	p = sorted;
 	do {
 		seg_t*		s = p->data;
-		vector_t	ds;
-		float ls;
-		ds.x = s->end->vec.x - s->origin->vec.x;
-		ds.y = s->end->vec.y - s->origin->vec.y;
-		ls = (float) sqrt(ds.x*ds.x + ds.y*ds.y);
-		ds.x /= ls;
-		ds.y /= ls;
+		vector_t	ds = seg_dir(s);
 		/* TODO: handle really short segments! (l ~= 0) */
 
 		/* for each successor segment that is close to parallel:
@@ -1274,16 +1573,9 @@ static void remove_zero_area(struct event* e)
 		q = p->succ;
 		while (q != p && q != sorted) {
 			seg_t*		t = q->data;
-			float	lt;
-			vector_t	dt;
-			dt.x = t->end->vec.x - t->origin->vec.x;
-			dt.y = t->end->vec.y - t->origin->vec.y;
-			lt = (float) sqrt(dt.x*dt.x + dt.y*dt.y);
-			dt.x /= lt;
-			dt.y /= lt;
+			vector_t	dt = seg_dir(t);
 
-			if (fabsf(dt.x-ds.x) < EPSILON &&
-					fabsf(dt.y-ds.y) < EPSILON) {
+			if (dir_close(ds, dt)) {
 
 				/* t and q are effectively identical */
 				if (s->end == t->end) {
@@ -1293,7 +1585,6 @@ static void remove_zero_area(struct event* e)
 #endif
 					list_remove_item(&t->end->in, t);
 					list_remove_item(&e->out, t);
-					free(t);
 					list_remove(&q);
 				} else if (vec_above(s->end->vec,
 							t->end->vec)) {
@@ -1337,14 +1628,14 @@ static void remove_zero_area(struct event* e)
 	free_list(&sorted);
 }
 
-void print_event_queue(list_t* eventq)
+void print_event_queue(bstree_t* eventq)
 {
-	list_t* p = eventq;
-	if (p) do {
-		struct event*	e = p->data;
+	bstree_t*	p;
+
+	for (p = bstree_first(eventq); p != NULL; p = bstree_next(p)) {
+		struct event*	e = p->value;
 		printf("  %d (%f, %f)\n", e->id, e->vec.x, e->vec.y);
-		p = p->succ;
-	} while (p != eventq);
+	}
 }
 
 static void remove_tail(struct event* e)
@@ -1366,54 +1657,432 @@ static void remove_tail(struct event* e)
 	}
 }
 
-static void insert_event(list_t* eventq, list_t* q, int* eventid,
+/* Event queue order: x is processed before y
+ */
+static int event_before(void* x, void* y)
+{
+	return vec_above(((struct event*)x)->vec, ((struct event*)y)->vec);
+}
+
+/* Add an intersection event for the segments inner and outer
+ *
+ * If an event at the same point is already queued the new event is
+ * merged into it, so that several segments crossing at one point
+ * give a single vertex.
+ */
+static void insert_event(arena_t* arena, bstree_t** eventq, int* eventid,
 		seg_t* inner, seg_t* outer)
 {
 	struct event*	ne;
-	list_t*		r;
+	struct event*	dup;
 
 	if (inner && outer && inner->end != outer->end) {
 		vector_t* x = seg_intersection(inner, outer);
 		if (x != NULL) {
-			ne = new_event(x, inner, outer);
-			ne->id = (*eventid)++;
+			ne = new_event(arena, x, inner, outer);
 			free(x);
-			/* insert new event in eventqueue */
-			r = q;
-			while (r != eventq) {
-				struct event*	ev;
-				r = r->succ;
-				ev = r->data;
-				if (vec_above(ne->vec, ev->vec)) {
-					list_add(&r, ne);
-					break;
-				}
+
+			/* the closest queued event not after ne */
+			dup = bstree_find_left(*eventq, ne, event_before);
+			if (dup != NULL && vec_eq(dup->vec, ne->vec)) {
+				remove_dup_event(dup, ne);
+			} else {
+				ne->id = (*eventid)++;
+				bstree_insert(eventq, ne, event_before);
 			}
 		}
 	}
 }
 
+/* Create the vertex for an event and the half-edges of the segments
+ * leaving it, and link them to the half-edges of the segments entering
+ * it. in and out list the segments in left to right order.
+ */
+static void add_event_vertex(arena_t* arena, struct event* e,
+		list_t* in, list_t* out, list_t** vertices,
+		list_t** half_edges)
+{
+	list_t*	p;
+
+	/* create vertex for this event */
+	e->vertex = new_vertex(arena);
+	e->vertex->vec = e->vec;
+	e->vertex->id = e->id;
+	arena_list_add(arena, vertices, e->vertex);
+
+	/* create outgoing edges with twins */
+	if ((p = out)) do {
+		seg_t*	s = p->data;
+		s->edge = new_edge(arena);
+		s->edge->twin = new_edge(arena);
+		s->edge->twin->twin = s->edge;
+		arena_list_add(arena, half_edges, s->edge);
+		arena_list_add(arena, half_edges, s->edge->twin);
+		p = p->succ;
+	} while (p != out);
+
+	/* Use incoming and outgoing lists to link half-edges */
+	if (in != NULL && out != NULL) {
+		seg_t*	upper_left = in->data;
+		seg_t*	upper_right = in->pred->data;
+		seg_t*	lower_left = out->data;
+		seg_t*	lower_right = out->pred->data;
+
+		edge_t*	u_down = upper_right->edge;
+		edge_t*	u_up = upper_left->edge->twin;
+		edge_t* l_down = lower_right->edge;
+		edge_t*	l_up = lower_left->edge->twin;
+
+		/* link outside edges */
+		link_edges(e->vertex, l_up, u_up);
+		link_edges(e->vertex, u_down, l_down);
+
+	} else if (in != NULL) {
+		seg_t*	upper_left = in->data;
+		seg_t*	upper_right = in->pred->data;
+
+		edge_t*	u_up = upper_left->edge->twin;
+		edge_t*	u_down = upper_right->edge;
+
+		/* link outside edges */
+		link_edges(e->vertex, u_down, u_up);
+
+	} else if (out != NULL) {
+		seg_t*	lower_left = out->data;
+		seg_t*	lower_right = out->pred->data;
+
+		edge_t*	l_down = lower_right->edge;
+		edge_t*	l_up = lower_left->edge->twin;
+
+		/* link outside edges */
+		link_edges(e->vertex, l_up, l_down);
+	}
+
+	/* Link inner edges */
+	if (in != NULL) {
+		p = in;
+		while (p->succ != in) {
+			seg_t*	s0 = p->data;
+			seg_t*	s1 = p->succ->data;
+			edge_t*	down = s0->edge;
+			edge_t*	up = s1->edge->twin;
+			link_edges(e->vertex, down, up);
+			p = p->succ;
+		}
+	}
+	if (out != NULL) {
+		p = out;
+		while (p->succ != out) {
+			seg_t*	s0 = p->data;
+			seg_t*	s1 = p->succ->data;
+			edge_t*	down = s0->edge;
+			edge_t*	up = s1->edge->twin;
+			link_edges(e->vertex, up, down);
+			p = p->succ;
+		}
+	}
+
+	if ((p = in)) do {
+		seg_t*	s = p->data;
+		edge_t*	edge = s->edge;
+		assert(edge->succ != NULL);
+		assert(edge->pred != NULL);
+		assert(edge->twin->succ != NULL);
+		assert(edge->twin->pred != NULL);
+		p = p->succ;
+	} while (p != in);
+
+	if ((p = out)) do {
+		seg_t*	s = p->data;
+		edge_t*	edge = s->edge;
+		assert(edge->pred != NULL);
+		assert(edge->twin->succ != NULL);
+		p = p->succ;
+	} while (p != out);
+}
+
+/* Build an edge list from the vertices and half-edges created for
+ * the events, in event order
+ */
+static edge_list_t* build_edgelist(triangulator_t* t, list_t* vertices,
+		list_t* half_edges)
+{
+	arena_t*	arena = t->arena;
+	edge_list_t*	edge_list;
+	int		nvert;
+
+	nvert = list_length(vertices);
+	edge_list = arena_alloc(arena, sizeof(edge_list_t));
+	edge_list->arena = arena;
+	edge_list->owns_arena = 0;
+	edge_list->nvert = 0;
+	edge_list->vertices = NULL;
+	edge_list->faces = NULL;
+	edge_list->etree = NULL;
+	edge_list->edges = NULL;
+	edge_list->cycles = NULL;
+
+	edge_list->nvert = nvert;
+	edge_list->vertices = arena_alloc(arena, sizeof(vertex_t*)*nvert);
+	edge_list->edges = half_edges;
+
+	/* TODO: try to preserve vertex IDs */
+	if (vertices) {
+		int	i = 0;
+		list_t*	p = vertices;
+		do {
+			vertex_t*	v = p->data;
+			v->id = i;
+			edge_list->vertices[i] = v;
+			i += 1;
+			p = p->succ;
+		} while (p != vertices);
+	}
+
+	if (half_edges) {
+		list_t*	p = half_edges;
+		do {
+			edge_t*	e = p->data;
+			e->origin->incident_edge = e;
+			assert(e->succ != NULL);
+			p = p->succ;
+		} while (p != half_edges);
+	}
+
+	/* sort vertices */
+	sort_vertices(t, edge_list->vertices, nvert);
+
+	return edge_list;
+}
+
+/* Returns 1 if the segments a and b have a point in common other than
+ * a shared endpoint
+ */
+static int segs_touch(seg_t* a, seg_t* b)
+{
+	return seg_touch(&a->origin->vec, &a->end->vec,
+			&b->origin->vec, &b->end->vec);
+}
+
+/* Put the one or two segments entering or leaving the event e
+ * in left to right order
+ */
+static void order_at_event(struct event* e, list_t* segs,
+		seg_t** left, seg_t** right)
+{
+	seg_t*		a = segs->data;
+	seg_t*		b = segs->pred->data;
+	vector_t	far = (a->origin == e) ? a->end->vec : a->origin->vec;
+
+	if (a == b || vec_left_of(far, b->origin->vec, b->end->vec)) {
+		*left = a;
+		*right = b;
+	} else {
+		*left = b;
+		*right = a;
+	}
+}
+
+/* Returns 1 if the shape is a set of simple closed contours which
+ * neither cross nor touch each other, and which make_planar would not
+ * modify. The events must be sorted.
+ *
+ * This is the Shamos-Hoey test: a sweep in which each segment is only
+ * tested against its neighbours in the status, without computing any
+ * intersections.
+ */
+static int is_simple(struct event** events, int nevent)
+{
+	bstree_t*	status = NULL;
+	int		simple = 1;
+	int		i;
+
+	for (i = 0; i < nevent-1; ++i) {
+		if (vec_close(events[i]->vec, events[i+1]->vec))
+			return 0;
+	}
+
+	for (i = 0; i < nevent && simple; ++i) {
+		struct event*	e = events[i];
+		int		nin = list_length(e->in);
+		int		nout = list_length(e->out);
+		list_t*		through = NULL;
+		list_t*		p;
+		seg_t*		left;
+		seg_t*		right;
+		seg_t*		lower_left;
+		seg_t*		lower_right;
+
+		if (nin + nout == 0)
+			continue;
+
+		if (nin + nout != 2) {
+			/* tail or vertex shared by several contours */
+			simple = 0;
+			break;
+		}
+
+		if (nout == 2 && dir_close(seg_dir(e->out->data),
+					seg_dir(e->out->succ->data))) {
+			/* would be removed by remove_zero_area */
+			simple = 0;
+			break;
+		}
+
+		/* only the segments ending at e may pass through e */
+		bstree_find_range(status, e, event_left_of_seg,
+				event_strictly_right_of_seg, NULL, &through);
+		if (list_length(through) != nin)
+			simple = 0;
+		if ((p = through)) do {
+			if (((seg_t*)p->data)->end != e)
+				simple = 0;
+			p = p->succ;
+		} while (p != through);
+		free_list(&through);
+		if (!simple)
+			break;
+
+		if ((p = e->in)) do {
+			bstree_remove(&status, p->data, seg_left_of_seg);
+			p = p->succ;
+		} while (p != e->in);
+
+		/* the neighbours of e in the status */
+		left = bstree_find_left(status, e, event_left_of_seg);
+		if (left && event_left_of_seg(e, left))
+			left = NULL;
+		right = bstree_find_right(status, e, event_right_of_seg);
+		if (right && !event_left_of_seg(e, right))
+			right = NULL;
+
+		if (nout == 0) {
+			if (left && right && segs_touch(left, right))
+				simple = 0;
+			continue;
+		}
+
+		order_at_event(e, e->out, &lower_left, &lower_right);
+		if ((left && segs_touch(left, lower_left)) ||
+				(right && segs_touch(lower_right, right))) {
+			simple = 0;
+			break;
+		}
+
+		p = e->out;
+		do {
+			bstree_insert(&status, p->data, seg_left_of_seg);
+			p = p->succ;
+		} while (p != e->out);
+	}
+
+	free_bstree(&status);
+	return simple;
+}
+
+/* Build the edge list of a shape that passed is_simple
+ *
+ * The half-edges are linked in the same order as in the sweep of
+ * make_planar, which would find no intersections.
+ */
+static edge_list_t* build_simple(triangulator_t* t, struct event** events,
+		int nevent)
+{
+	list_t*		vertices = NULL;
+	list_t*		half_edges = NULL;
+	int		i;
+
+	for (i = 0; i < nevent; ++i) {
+		struct event*	e = events[i];
+		list_t*		in = NULL;
+		list_t*		out = NULL;
+		seg_t*		left;
+		seg_t*		right;
+
+		if (e->in == NULL && e->out == NULL)
+			continue;
+
+		if (e->in != NULL) {
+			order_at_event(e, e->in, &left, &right);
+			list_add(&in, left);
+			if (right != left)
+				list_add(&in, right);
+		}
+		if (e->out != NULL) {
+			order_at_event(e, e->out, &left, &right);
+			list_add(&out, left);
+			if (right != left)
+				list_add(&out, right);
+		}
+
+		add_event_vertex(t->arena, e, in, out, &vertices,
+				&half_edges);
+
+		free_list(&in);
+		free_list(&out);
+		free_list(&e->in);
+		free_list(&e->out);
+	}
+
+	return build_edgelist(t, vertices, half_edges);
+}
+
 /* Build a planar graph from a shape and return a doubly connected
  * edge list representation of that planar graph.
+ *
+ * If the contours of the shape are already simple and disjoint the
+ * edge list is built directly from them, otherwise a sweep line pass
+ * splits the segments at their intersections.
  */
 edge_list_t* make_planar(shape_t* shape)
 {
+	edge_list_t*	edge_list = make_planar_arena(shape, new_arena());
+	edge_list->owns_arena = 1;
+	return edge_list;
+}
+
+/* Build the edge list for a shape in the given arena
+ */
+edge_list_t* make_planar_arena(shape_t* shape, arena_t* arena)
+{
+	triangulator_t	t;
+	edge_list_t*	edge_list;
+
+	init_triangulator(&t, arena);
+	edge_list = make_planar_in(&t, shape);
+	free_scratch(&t);
+	return edge_list;
+}
+
+static edge_list_t* make_planar_in(triangulator_t* t, shape_t* shape)
+{
+	arena_t*	arena = t->arena;
 	struct event**	events;
+	int*		weld;
+	int		nevent;
 	list_t*		vertices = NULL;
 	list_t*		half_edges = NULL;
 	int eventid = 0;
 	int i;
-	list_t*	eventq = NULL;/* TODO: use balanced binary search tree */
-	int		nvert = 0;
-	bstree_t*	status = NULL;/* TODO: use balanced tree? */
-	list_t*		q;
-	edge_list_t*	edge_list;
-	list_t*		segments = NULL;
+	bstree_t*	eventq = NULL;
+	list_t*		processed = NULL;
+	bstree_t*	status = NULL;
+	struct event*	e;
 	list_t*		p;
 
-	events = malloc(sizeof(struct event*) * shape->nvec);
+	/* nearly coincident points need not be neighbours in sweep order,
+	 * so they are merged up front: welded points share one event */
+	events = scratch(t, SCRATCH_EVENTS, sizeof(struct event*) * shape->nvec);
+	weld = scratch(t, SCRATCH_WELD, sizeof(int) * shape->nvec);
+	weld_points(shape->vec, shape->nvec, weld_tolerance(shape), weld);
 	for (i = 0; i < shape->nvec; ++i) {
-		events[i] = malloc(sizeof(struct event));
+		/* event ids stay the indices of the shape points */
+		if (weld[i] != i) {
+			events[i] = events[weld[i]];
+			eventid++;
+			continue;
+		}
+		events[i] = arena_alloc(arena, sizeof(struct event));
 		events[i]->vec = shape->vec[i];
 		events[i]->in = NULL;
 		events[i]->out = NULL;
@@ -1427,10 +2096,15 @@ edge_list_t* make_planar(shape_t* shape)
 	for (i = 0; i < shape->nseg; ++i) {
 		int		i1 = shape->seg[i*2];
 		int		i2 = shape->seg[i*2+1];
-		vector_t	v1 = shape->vec[i1];
-		vector_t	v2 = shape->vec[i2];
+		vector_t	v1 = events[i1]->vec;
+		vector_t	v2 = events[i2]->vec;
+		seg_t*		seg;
 
-		seg_t*	seg = malloc(sizeof(seg_t));
+		/* collapsed by welding */
+		if (events[i1] == events[i2])
+			continue;
+
+		seg = arena_alloc(arena, sizeof(seg_t));
 		if (vec_above(v1, v2)) {
 			seg->origin = events[i1];
 			seg->end = events[i2];
@@ -1439,8 +2113,6 @@ edge_list_t* make_planar(shape_t* shape)
 			seg->origin = events[i2];
 		}
 
-		list_add(&segments, seg);
-
 		list_add(&seg->end->in, seg);
 		list_add(&seg->origin->out, seg);
 
@@ -1450,18 +2122,29 @@ edge_list_t* make_planar(shape_t* shape)
 #endif
 	}
 
-	qsort(events, shape->nvec, sizeof(struct event*), event_above);
+	/* keep one event for each welded point */
+	nevent = 0;
+	for (i = 0; i < shape->nvec; ++i) {
+		if (weld[i] == i)
+			events[nevent++] = events[i];
+	}
+
+	sort_events(t, events, nevent);
 
 #ifdef MAKE_PLANAR_DBG
 	printf("sorted events:\n");
-	for (i = 0; i < shape->nvec; ++i) {
+	for (i = 0; i < nevent; ++i) {
 		struct event*	e = events[i];
 		printf("  %d (%f, %f)\n", e->id, e->vec.x, e->vec.y);
 	}
 #endif
 
+	if (is_simple(events, nevent)) {
+		return build_simple(t, events, nevent);
+	}
+
 	/* Remove duplicate events */
-	for (i = 0; i < shape->nvec-1; i += 1) {
+	for (i = 0; i < nevent-1; i += 1) {
 		struct event*	ei = events[i];
 
 		do {
@@ -1476,17 +2159,17 @@ edge_list_t* make_planar(shape_t* shape)
 			}
 
 			i = j;
-		} while (i < shape->nvec-1);
+		} while (i < nevent-1);
 	}
 
 	/* Remove tails */
-	for (i = 0; i < shape->nvec; ++i) {
+	for (i = 0; i < nevent; ++i) {
 		struct event*	e = events[i];
 
 		remove_tail(e);
 	}
 
-	for (i = 0; i < shape->nvec; ++i) {
+	for (i = 0; i < nevent; ++i) {
 		struct event*	e = events[i];
 
 		if (e == NULL)
@@ -1496,22 +2179,16 @@ edge_list_t* make_planar(shape_t* shape)
 		remove_zero_area(e);
 
 		if (e->in == NULL && e->out == NULL) {
-			free(e);
 			continue;
 		} else if (e->in == NULL && e->out == e->out->succ) {
 			seg_t*	s = list_remove(&e->out);
 			list_remove_item(&s->end->in, s);
-			free(s);
-			free(e);
 			continue;
 		}
 
-		list_add(&eventq, e);
+		bstree_insert(&eventq, e, event_before);
 	}
 
-	/* Event array no longer needed */
-	free(events);
-
 #ifdef MAKE_PLANAR_DBG
 	printf("eventq:\n");
 	print_event_queue(eventq);
@@ -1522,9 +2199,7 @@ edge_list_t* make_planar(shape_t* shape)
  	 *
  	 * Simultaneously we build the doubly connected edge list.
  	 */
-	q = eventq;
-	if (q) do {
-		struct event*	e = q->data;
+	while ((e = bstree_pop(&eventq))) {
 		seg_t*		inner_left = NULL;
 		seg_t*		inner_right = NULL;
 		seg_t*		outer_left = NULL;
@@ -1536,10 +2211,17 @@ edge_list_t* make_planar(shape_t* shape)
 		printf("e%d:\n", e->id);
 #endif
 
-		bstree_find_all(status, e, &seg_ends_at_event, &in);
+		/* segments ending at e pass through e, so they are
+		 * adjacent in the status */
+		bstree_find_range(status, e, event_left_of_seg,
+				event_strictly_right_of_seg, seg_ends_at_event,
+				&in);
 
 		/* remove edges ending at current event point from status */
-		bstree_remove_if(&status, e, &seg_ends_at_event);
+		if ((p = in)) do {
+			bstree_remove(&status, p->data, seg_left_of_seg);
+			p = p->succ;
+		} while (p != in);
 
 		outer_left = bstree_find_left(status, e, event_left_of_seg);
 		outer_right = bstree_find_right(status, e, event_right_of_seg);
@@ -1565,138 +2247,38 @@ edge_list_t* make_planar(shape_t* shape)
 			p = p->succ;
 		} while (p != e->out);
 
-		bstree_find_all(status, e, &seg_starts_at_event, &out);
-
-		/* create vertex for this event */
-		e->vertex = new_vertex();
-		e->vertex->vec = e->vec;
-		e->vertex->id = e->id;
-		list_add(&vertices, e->vertex);
-
-		/* create outgoing edges with twins */
-		if ((p = out)) do {
-			seg_t*	s = p->data;
-			s->edge = new_edge();
-			s->edge->twin = new_edge();
-			s->edge->twin->twin = s->edge;
-			list_add(&half_edges, s->edge);
-			list_add(&half_edges, s->edge->twin);
-			p = p->succ;
-		} while (p != out);
-
-		/* Use incoming and outgoing lists to link half-edges */
-		if (in != NULL && out != NULL) {
-			seg_t*	upper_left = in->data;
-			seg_t*	upper_right = in->pred->data;
-			seg_t*	lower_left = out->data;
-			seg_t*	lower_right = out->pred->data;
-
-			edge_t*	u_down = upper_right->edge;
-			edge_t*	u_up = upper_left->edge->twin;
-			edge_t* l_down = lower_right->edge;
-			edge_t*	l_up = lower_left->edge->twin;
-
-			/* link outside edges */
-			link_edges(e->vertex, l_up, u_up);
-			link_edges(e->vertex, u_down, l_down);
-
-		} else if (in != NULL) {
-			seg_t*	upper_left = in->data;
-			seg_t*	upper_right = in->pred->data;
-
-			edge_t*	u_up = upper_left->edge->twin;
-			edge_t*	u_down = upper_right->edge;
-
-			/* link outside edges */
-			link_edges(e->vertex, u_down, u_up);
-
-		} else if (out != NULL) {
-			seg_t*	lower_left = out->data;
-			seg_t*	lower_right = out->pred->data;
-
-			edge_t*	l_down = lower_right->edge;
-			edge_t*	l_up = lower_left->edge->twin;
-
-			/* link outside edges */
-			link_edges(e->vertex, l_up, l_down);
-		}
-
-		/* Link inner edges */
-		if (in != NULL) {
-			p = in;
-			while (p->succ != in) {
-				seg_t*	s0 = p->data;
-				seg_t*	s1 = p->succ->data;
-				edge_t*	down = s0->edge;
-				edge_t*	up = s1->edge->twin;
-				link_edges(e->vertex, down, up);
-				p = p->succ;
-			}
-		}
-		if (out != NULL) {
-			p = out;
-			while (p->succ != out) {
-				seg_t*	s0 = p->data;
-				seg_t*	s1 = p->succ->data;
-				edge_t*	down = s0->edge;
-				edge_t*	up = s1->edge->twin;
-				link_edges(e->vertex, up, down);
-				p = p->succ;
-			}
-		}
-
-		if ((p = in)) do {
-			seg_t*	s = p->data;
-			edge_t*	e = s->edge;
-			assert(e->succ != NULL);
-			assert(e->pred != NULL);
-			assert(e->twin->succ != NULL);
-			assert(e->twin->pred != NULL);
-			p = p->succ;
-		} while (p != in);
+		bstree_find_range(status, e, event_left_of_seg,
+				event_strictly_right_of_seg, seg_starts_at_event,
+				&out);
 
-		if ((p = out)) do {
-			seg_t*	s = p->data;
-			edge_t*	e = s->edge;
-			assert(e->pred != NULL);
-			assert(e->twin->succ != NULL);
-			p = p->succ;
-		} while (p != out);
+		add_event_vertex(arena, e, in, out, &vertices, &half_edges);
 
 		free_list(&in);
 		free_list(&out);
 
 		/* Add intersection vertices */
-		insert_event(eventq, q, &eventid, inner_left, outer_left);
-		insert_event(eventq, q, &eventid, inner_right, outer_right);
+		insert_event(arena, &eventq, &eventid, inner_left, outer_left);
+		insert_event(arena, &eventq, &eventid, inner_right,
+				outer_right);
+
+		list_add(&processed, e);
 
 #ifdef MAKE_PLANAR_DBG
 		print_seg_tree(status);
 #endif
+	}
 
-		q = q->succ;
-	} while (q != eventq);
-
-	/* Free event queue */
-	while (eventq) {
-		struct event*	event = list_remove(&eventq);
+	/* Free events */
+	while (processed) {
+		struct event*	event = list_remove(&processed);
 
 		if (event->in != NULL)
 			free_list(&event->in);
 
 		if (event->out != NULL)
 			free_list(&event->out);
-
-		free(event);
 	}
 
-	/* Free segments */
-	if ((p = segments)) do {
-		free(p->data);
-		p = p->succ;
-	} while (p != segments);
-	free_list(&segments);
-
 #ifdef MAKE_PLANAR_DBG
 	printf("remaining status size: %d\n", bstree_size(status));
 	print_seg_tree(status);
@@ -1707,48 +2289,7 @@ edge_list_t* make_planar(shape_t* shape)
 	/* Insert the half-edges and vertices created during the
  	 * line sweep pass into an edge list.
  	 */
-
-	nvert = list_length(vertices);
-	edge_list = malloc(sizeof(edge_list_t));
-	edge_list->nvert = 0;
-	edge_list->vertices = NULL;
-	edge_list->faces = NULL;
-	edge_list->etree = NULL;
-	edge_list->edges = NULL;
-	edge_list->cycles = NULL;
-
-	edge_list->nvert = nvert;
-	edge_list->vertices = malloc(sizeof(vertex_t*)*nvert);
-	edge_list->edges = half_edges;
-
-	/* TODO: try to preserve vertex IDs */
-	if (vertices) {
-		int	i = 0;
-		list_t*	p = vertices;
-		do {
-			vertex_t*	v = p->data;
-			v->id = i;
-			edge_list->vertices[i] = v;
-			i += 1;
-			p = p->succ;
-		} while (p != vertices);
-		free_list(&vertices);
-	}
-
-	if (half_edges) {
-		list_t*	p = half_edges;
-		do {
-			edge_t*	e = p->data;
-			e->origin->incident_edge = e;
-			assert(e->succ != NULL);
-			p = p->succ;
-		} while (p != half_edges);
-	}
-
-	/* sort vertices */
-	qsort(edge_list->vertices, nvert, sizeof(vertex_t*), vertex_above);
-
-	return edge_list;
+	return build_edgelist(t, vertices, half_edges);
 }
 
 /* If the vertices have been classified, the doubly
@@ -1761,14 +2302,198 @@ edge_list_t* make_planar(shape_t* shape)
  * Both steps work by inserting diagonals into the polygon.
  */
 edge_list_t* triangulate(shape_t* shape)
+{
+	edge_list_t*	edge_list = triangulate_arena(shape, new_arena());
+	edge_list->owns_arena = 1;
+	return edge_list;
+}
+
+/* Triangulate a shape and return the triangles as an indexed mesh
+ *
+ * Shapes of a few small contours without holes are triangulated
+ * directly (see earclip.h), other shapes with the monotone
+ * decomposition.
+ *
+ * The edge list is built in the scratch arena, which is reset before
+ * returning and so must not hold anything else. If scratch is NULL a
+ * temporary arena is used.
+ */
+mesh_t* triangulate_to_mesh(shape_t* shape, arena_t* scratch)
+{
+	triangulator_t	t;
+	edge_list_t*	edge_list;
+	mesh_t*		mesh;
+
+	if ((mesh = earclip_shape(shape)) != NULL)
+		return mesh;
+
+	init_triangulator(&t, scratch != NULL ? scratch : new_arena());
+	edge_list = triangulate_in(&t, shape, NULL);
+	mesh = edgelist_to_mesh_in(&t, edge_list);
+
+	free_edgelist(&edge_list);
+	if (scratch != NULL)
+		arena_reset(scratch);
+	else
+		free_arena(&t.arena);
+	free_scratch(&t);
+	return mesh;
+}
+
+triangulator_t* new_triangulator()
+{
+	triangulator_t*	t = malloc(sizeof(triangulator_t));
+
+	init_triangulator(t, new_arena());
+	return t;
+}
+
+void free_triangulator(triangulator_t** triangulator)
+{
+	triangulator_t*	t;
+
+	assert(triangulator != NULL);
+
+	t = *triangulator;
+	if (!t) return;
+
+	free_scratch(t);
+	free_arena(&t->arena);
+	free(t);
+	*triangulator = NULL;
+}
+
+/* Triangulate a shape in the arena of the triangulator, releasing the
+ * edge list of the previous call
+ */
+edge_list_t* triangulator_edges(triangulator_t* t, shape_t* shape)
+{
+	assert(t != NULL);
+
+	arena_reset(t->arena);
+	return triangulate_in(t, shape, NULL);
+}
+
+/* Triangulate a shape and return the triangles as an indexed mesh,
+ * see triangulate_to_mesh
+ */
+mesh_t* triangulator_mesh(triangulator_t* t, shape_t* shape)
+{
+	edge_list_t*	edge_list;
+	mesh_t*		mesh;
+
+	assert(t != NULL);
+
+	if ((mesh = earclip_shape(shape)) != NULL)
+		return mesh;
+
+	edge_list = triangulator_edges(t, shape);
+	mesh = edgelist_to_mesh_in(t, edge_list);
+
+	free_edgelist(&edge_list);
+	arena_reset(t->arena);
+	return mesh;
+}
+
+/* Returns 1 if face is a triangle inside the polygon
+ */
+static int is_inside_triangle(face_t* face)
+{
+	edge_t*	e = face->outer_component;
+	return face->is_inside && e != NULL && e->succ->succ->succ == e;
+}
+
+/* Collect the inside triangles of a triangulated edge list
+ *
+ * Only the vertices used by some triangle are stored in the mesh.
+ */
+mesh_t* edgelist_to_mesh(edge_list_t* edge_list)
+{
+	triangulator_t	t;
+	mesh_t*		mesh;
+
+	init_triangulator(&t, edge_list->arena);
+	mesh = edgelist_to_mesh_in(&t, edge_list);
+	free_scratch(&t);
+	return mesh;
+}
+
+static mesh_t* edgelist_to_mesh_in(triangulator_t* t, edge_list_t* edge_list)
+{
+	int*	map;/* vertex id to mesh index */
+	int	ntri = 0;
+	int	n = 0;
+	mesh_t*	mesh;
+	list_t*	p;
+	int	i;
+
+	p = edge_list->faces;
+	if (p) do {
+		if (is_inside_triangle(p->data))
+			ntri += 1;
+		p = p->succ;
+	} while (p != edge_list->faces);
+
+	mesh = new_mesh(edge_list->nvert, ntri);
+
+	/* vertex ids are a permutation of 0..nvert-1 */
+	map = scratch(t, SCRATCH_MAP, sizeof(int) * (edge_list->nvert + 1));
+	for (i = 0; i < edge_list->nvert; ++i)
+		map[i] = -1;
+
+	p = edge_list->faces;
+	if (p) do {
+		face_t*	face = p->data;
+		p = p->succ;
+
+		if (is_inside_triangle(face)) {
+			edge_t*	e = face->outer_component;
+			do {
+				vertex_t*	v = e->origin;
+				if (map[v->id] < 0) {
+					map[v->id] = mesh->nvec;
+					mesh->vecs[mesh->nvec++] = v->vec;
+				}
+				mesh_set_index(mesh, n++, map[v->id]);
+				e = e->succ;
+			} while (e != face->outer_component);
+		}
+	} while (p != edge_list->faces);
+
+	return mesh;
+}
+
+/* Triangulate a shape, allocating the edge list in the given arena
+ *
+ * The edge list stays valid until the arena is reset or freed, so a
+ * caller triangulating many shapes can reuse one arena.
+ */
+edge_list_t* triangulate_arena(shape_t* shape, arena_t* arena)
+{
+	return triangulate_pool(shape, arena, NULL);
+}
+
+edge_list_t* triangulate_pool(shape_t* shape, arena_t* arena, pool_t* pool)
+{
+	triangulator_t	t;
+	edge_list_t*	edge_list;
+
+	init_triangulator(&t, arena);
+	edge_list = triangulate_in(&t, shape, pool);
+	free_scratch(&t);
+	return edge_list;
+}
+
+static edge_list_t* triangulate_in(triangulator_t* t, shape_t* shape,
+		pool_t* pool)
 {
 	/* 1. Construct edge list for the planar graph */
-	edge_list_t*	edge_list = make_planar(shape);
+	edge_list_t*	edge_list = make_planar_in(t, shape);
 	list_t* faces = NULL;
 	list_t* p;
 
 	/* 2. Identify and connect the components in the edge list */
-	connect_components(edge_list);
+	connect_components_in(t, edge_list);
 
 	/* 3. For each face in the polygon, triangulate the face if
 	 * it is part of the inside of the polygon
@@ -1785,26 +2510,17 @@ edge_list_t* triangulate(shape_t* shape)
 	} while (p != edge_list->faces);
 
 	while (faces) {
-		list_t*	worklist;
+		vertex_t**	vertices;
 		face_t*	face = (face_t*)list_remove(&faces);
+		int nface;
 		int i;
 
 		classify_face(face);
 		align_face_vertices(face);
 
-		worklist = NULL;
-		for (i = 0; i < edge_list->nvert; ++i) {
-			vertex_t*	v = edge_list->vertices[i];
-
-			if (v->incident_edge != NULL &&
-					v->incident_edge->left_face == face) {
-
-				list_add(&worklist, v);
-			}
-		}
-
-		while (worklist) {
-			vertex_t*	v = list_remove(&worklist);
+		nface = face_vertices(t, face, &vertices);
+		for (i = 0; i < nface; ++i) {
+			vertex_t*	v = vertices[i];
 
 			switch (v->vtype) {
 			case START_VERTEX:
@@ -1831,69 +2547,132 @@ edge_list_t* triangulate(shape_t* shape)
 		}
 	}
 
-	/* 5. Triangulate each monotone polygon
-	 * remove hole faces and create worklist
-	 */
-	if (edge_list->faces) {
-		list_t*	p = edge_list->faces;
-		do {
-			face_t*	face = p->data;
-			if (face->is_inside) {
-				triangulate_face(edge_list, face);
-			}
-			p = p->succ;
-		} while (p != edge_list->faces);
-	}
+	/* 5. Triangulate each monotone polygon */
+	triangulate_monotone(t, edge_list, pool);
+
+	/* the edge tree is not allocated in the arena */
+	free_bstree(&edge_list->etree);
 
 	return edge_list;
 }
 
-/* Triangulate a monotone polygon given as a vertex chain
- * beginning at the 'start' edge.
+/* A vertex on the boundary of a monotone face */
+struct chain_vertex {
+	vertex_t*	v;
+	int		chain;/* VERTEX_DOWN, VERTEX_UP, or 0 for an end vertex */
+};
+
+/* The diagonals that triangulate a monotone face. They are found
+ * without modifying the edge list, so that several faces can be
+ * processed at once, and are added to the edge list afterwards.
+ */
+struct monotone {
+	int		ndiag;
+	int		size;
+	vertex_t**	diag;/* upper and lower vertex of each diagonal */
+};
+
+/* Classify the origin of e as a start, end or regular vertex of the
+ * monotone face to the left of e
+ */
+static vtype_t chain_vtype(edge_t* e)
+{
+	vector_t	v = e->origin->vec;
+	int		above1 = vec_above(v, e->pred->origin->vec);
+	int		above2 = vec_above(v, e->succ->origin->vec);
+
+	if (above1 && above2)
+		return START_VERTEX;
+	else if (!above1 && !above2)
+		return END_VERTEX;
+	else
+		return REGULAR_VERTEX;
+}
+
+static void push_diagonal(struct monotone* m, vertex_t* v1, vertex_t* v2)
+{
+	if (2 * (m->ndiag + 1) > m->size) {
+		m->size = m->size ? 2 * m->size : 16;
+		m->diag = realloc(m->diag, sizeof(vertex_t*) * m->size);
+	}
+	m->diag[2 * m->ndiag] = v1;
+	m->diag[2 * m->ndiag + 1] = v2;
+	m->ndiag += 1;
+}
+
+/* Merge the two chains of a monotone polygon into order of decreasing
+ * height. The chain array goes from the start vertex down to the end
+ * vertex, at index end, and then back up to the start vertex.
  *
- * If stepping is 1, the algorithm will wait for a pthread cond
- * before each iteration.
+ * Returns 0 if the result is not sorted, i.e., the polygon was
+ * not monotone after all.
  */
-void triangulate_face(edge_list_t* edge_list, face_t* face)
+static int merge_chains(struct chain_vertex* chain, int n, int end,
+		struct chain_vertex** out)
+{
+	int	i = 1;		/* next vertex going down the first chain */
+	int	j = n - 1;	/* next vertex going down the second chain */
+	int	k;
+
+	out[0] = &chain[0];
+	for (k = 1; k < n; ++k) {
+		if (j <= end || (i <= end &&
+				vec_above(chain[i].v->vec, chain[j].v->vec)))
+			out[k] = &chain[i++];
+		else
+			out[k] = &chain[j--];
+
+		if (!vec_above(out[k-1]->v->vec, out[k]->v->vec))
+			return 0;
+	}
+	return 1;
+}
+
+/* Sort the chain vertices in order of decreasing height
+ */
+static void sort_chain(triangulator_t* t, struct chain_vertex* chain, int n,
+		struct chain_vertex** out)
 {
-	stack_t*	stack = NULL;
+	uint64_t*	keys = scratch(t, SCRATCH_KEYS, sizeof(uint64_t) * n);
+	int		i;
+
+	for (i = 0; i < n; ++i) {
+		out[i] = &chain[i];
+		keys[i] = vec_sort_key(chain[i].v->vec);
+	}
+	sort_scratch(t, (void**) out, keys, n);
+}
+
+/* Find the diagonals that triangulate a monotone face
+ *
+ * The diagonal array of m is reused, it grows as needed.
+ */
+static void find_diagonals(triangulator_t* t, face_t* face,
+		struct monotone* m)
+{
+	struct chain_vertex*	chain;
+	struct chain_vertex**	vertices;
+	struct chain_vertex**	stack;
+	int		nstack;
 	int		nvert = 0;
 	int		last;
-	int		v_type;
-	vertex_t**	vertices;
+	int		end = -1;
+	int		side;
 	edge_t*		p;
 	edge_t*		start = NULL;
 	int i;
 
-	assert(face != NULL);
+	m->ndiag = 0;
 
 	if (face->outer_component == NULL)
 		return;
 
 	/* count vertices */
-
 	p = face->outer_component;
 	do {
-		vector_t	v = p->origin->vec;
-		vector_t	v_out = p->succ->origin->vec;
-		vector_t	v_in = p->pred->origin->vec;
-		int		above1 = vec_above(v, v_in);
-		int		above2 = vec_above(v, v_out);
-
 		nvert += 1;
-
-		p->origin->incident_edge = p;
-		p->origin->flags &= ~VERTEX_UP;
-		p->origin->flags &= ~VERTEX_DOWN;
-		if (above1 && above2) {
-			p->origin->vtype = START_VERTEX;
+		if (chain_vtype(p) == START_VERTEX)
 			start = p;
-		} else if (!above1 && !above2) {
-			p->origin->vtype = END_VERTEX;
-		} else {
-			p->origin->vtype = REGULAR_VERTEX;
-		}
-
 		p = p->succ;
 	} while (p != face->outer_component);
 
@@ -1904,38 +2683,40 @@ void triangulate_face(edge_list_t* edge_list, face_t* face)
 	assert(start != NULL);
 
 	/* create vertex array */
-	vertices = malloc(sizeof(vertex_t*)*nvert);
-	v_type = VERTEX_DOWN;
+	chain = scratch(t, SCRATCH_CHAIN, sizeof(struct chain_vertex)*nvert);
+	vertices = scratch(t, SCRATCH_ORDER, sizeof(struct chain_vertex*)*nvert);
+	stack = scratch(t, SCRATCH_STACK, sizeof(struct chain_vertex*)*nvert);
+	side = VERTEX_DOWN;
 	last = 0;
 	p = start;
 	do {
-		vertices[last++] = p->origin;
-		if (p->origin->vtype == END_VERTEX) {
-			v_type = VERTEX_UP;
+		struct chain_vertex*	c = &chain[last++];
+
+		c->v = p->origin;
+		if (chain_vtype(p) == END_VERTEX) {
+			if (end == -1)
+				end = last - 1;
+			side = VERTEX_UP;
+			c->chain = 0;
 		} else {
-			p->origin->flags |= v_type;
+			c->chain = side;
 		}
 		p = p->succ;
 	} while (p != start);
 
-	/* sort vertices */
-	qsort_verts(vertices, nvert);
+	/* sort vertices by merging the chains */
+	if (end == -1 || !merge_chains(chain, nvert, end, vertices))
+		sort_chain(t, chain, nvert, vertices);
 
 	/* triangulate the monotone face */
-	stack_push(&stack, vertices[0]);
-	stack_push(&stack, vertices[1]);
+	nstack = 0;
+	stack[nstack++] = vertices[0];
+	stack[nstack++] = vertices[1];
 	for (i = 2; i < nvert; ++i) {
-		vertex_t*	v;
-		vertex_t*	top;
-		int		flag1;
-		int		flag2;
-
-		v = vertices[i];
-		top = stack_peek(stack);
+		struct chain_vertex*	v = vertices[i];
+		struct chain_vertex*	top = stack[nstack-1];
 
-		flag1 = v->flags & (VERTEX_UP | VERTEX_DOWN);
-		flag2 = top->flags & (VERTEX_UP | VERTEX_DOWN);
-		if (flag1 != flag2) {
+		if (v->chain != top->chain) {
 
 			/* v and vertex on top of the stack
 			 * are not on the same chain
@@ -1944,17 +2725,17 @@ void triangulate_face(edge_list_t* edge_list, face_t* face)
 			 * each of them
 			 */
 
-			if (v->vtype == END_VERTEX)
-				stack_pop(&stack);
+			if (v->chain == 0)
+				nstack -= 1;
 
 			/* pop all except the last vertex */
-			while (stack->next != NULL) {
-				vertex_t*	this = stack_pop(&stack);
-				add_diagonal(edge_list, this, v);
+			while (nstack > 1) {
+				struct chain_vertex*	this = stack[--nstack];
+				push_diagonal(m, this->v, v->v);
 			}
-			stack_pop(&stack);
-			stack_push(&stack, vertices[i-1]);
-			stack_push(&stack, v);
+			nstack = 0;
+			stack[nstack++] = vertices[i-1];
+			stack[nstack++] = v;
 
 		} else {
 			/* v is on the same chain as the vertex
@@ -1964,35 +2745,167 @@ void triangulate_face(edge_list_t* edge_list, face_t* face)
 			 * between u_i->S_j and u_i->S_j-1 (must be >= 0)
 			 */
 			
-			int up = v->flags & VERTEX_UP;
-			while (stack != NULL) {
-				vertex_t*	prev;
-				vertex_t*	peek;
-				double phi;
-
-				prev = stack_pop(&stack);
-				if (stack == NULL) {
-					stack_push(&stack, prev);
+			int up = v->chain == VERTEX_UP;
+			while (nstack > 0) {
+				struct chain_vertex*	prev;
+				struct chain_vertex*	peek;
+				int		phi;
+
+				prev = stack[--nstack];
+				if (nstack == 0) {
+					stack[nstack++] = prev;
 					break;
 				}
-				peek = stack_peek(stack);
-				phi = angle_between(
-						angle(v->vec, peek->vec),
-						angle(v->vec, prev->vec));
-				if ((up && phi < PI) || (!up && phi > PI)) {
-					add_diagonal(edge_list, peek, v);
+				peek = stack[nstack-1];
+				phi = ccw_angle_cmp_pi(v->v->vec, prev->v->vec,
+						peek->v->vec);
+				/* prev on the diagonal is a full turn, but the
+				 * triangle would be empty */
+				if (phi > 0 && vec_same_dir(v->v->vec, prev->v->vec,
+							peek->v->vec))
+					phi = 0;
+				if ((up && phi < 0) || (!up && phi > 0)) {
+					push_diagonal(m, peek->v, v->v);
 				} else {
-					stack_push(&stack, prev);
+					stack[nstack++] = prev;
 					break;
 				}
 			}
-			stack_push(&stack, v);
+			stack[nstack++] = v;
 		}
 	}
+}
+
+/* Add the diagonals found for a monotone face to the edge list
+ */
+static void apply_diagonals(edge_list_t* edge_list, face_t* face,
+		struct monotone* m)
+{
+	edge_t*	p;
+	int	i;
 
-	/* free temporary data */
-	free_stack(&stack);
-	free(vertices);
+	if (face->outer_component == NULL)
+		return;
+
+	p = face->outer_component;
+	do {
+		p->origin->incident_edge = p;
+		p->origin->vtype = chain_vtype(p);
+		p = p->succ;
+	} while (p != face->outer_component);
+
+	for (i = 0; i < m->ndiag; ++i)
+		add_diagonal(edge_list, m->diag[2*i], m->diag[2*i+1]);
+}
+
+/* Triangulate a monotone polygon given as a vertex chain
+ * beginning at the 'start' edge.
+ */
+void triangulate_face(edge_list_t* edge_list, face_t* face)
+{
+	triangulator_t	t;
+	struct monotone	m;
+
+	assert(face != NULL);
+
+	init_triangulator(&t, edge_list->arena);
+	m.size = 0;
+	m.diag = NULL;
+	find_diagonals(&t, face, &m);
+	apply_diagonals(edge_list, face, &m);
+	free(m.diag);
+	free_scratch(&t);
+}
+
+struct face_job {
+	face_t**		faces;
+	struct monotone*	diagonals;
+	triangulator_t*		scratch;/* scratch arrays of each thread */
+};
+
+static void find_diagonals_job(void* arg, int index, int thread)
+{
+	struct face_job*	job = arg;
+
+	find_diagonals(&job->scratch[thread], job->faces[index],
+			&job->diagonals[index]);
+}
+
+/* Triangulate the inside faces, which are all monotone.
+ *
+ * With a pool the diagonals of the faces are found in parallel and then
+ * added in the order the serial loop adds them, so the result is the
+ * same. The faces split off by the diagonals are visited afterwards,
+ * they are triangles unless the decomposition was degenerate.
+ */
+static void triangulate_monotone(triangulator_t* t, edge_list_t* edge_list,
+		pool_t* pool)
+{
+	list_t*		head = edge_list->faces;
+	list_t*		p;
+	struct monotone	m;
+
+	if (head == NULL)
+		return;
+
+	p = head;
+	if (pool != NULL && pool_threads(pool) > 1 &&
+			edge_list->nvert >= PARALLEL_MIN_VERTS) {
+		struct face_job	job;
+		list_t*		last = head->pred;
+		int		nthreads = pool_threads(pool);
+		int		nface = 0;
+		int		i;
+
+		do {
+			nface += ((face_t*)p->data)->is_inside;
+			p = p->succ;
+		} while (p != head);
+
+		job.faces = malloc(sizeof(face_t*) * nface);
+		job.diagonals = calloc(nface, sizeof(struct monotone));
+		job.scratch = malloc(sizeof(triangulator_t) * nthreads);
+		for (i = 0; i < nthreads; ++i)
+			init_triangulator(&job.scratch[i], NULL);
+		i = 0;
+		do {
+			if (((face_t*)p->data)->is_inside)
+				job.faces[i++] = p->data;
+			p = p->succ;
+		} while (p != head);
+
+		pool_run(pool, find_diagonals_job, &job, nface);
+
+		for (i = 0; i < nface; ++i) {
+			apply_diagonals(edge_list, job.faces[i],
+					&job.diagonals[i]);
+			free(job.diagonals[i].diag);
+		}
+		for (i = 0; i < nthreads; ++i)
+			free_scratch(&job.scratch[i]);
+		free(job.faces);
+		free(job.diagonals);
+		free(job.scratch);
+
+		/* continue with the faces added by the diagonals */
+		p = last->succ;
+		if (p == head)
+			return;
+	}
+
+	/* the diagonal array is kept with the scratch arrays */
+	m.diag = t->scratch[SCRATCH_DIAG];
+	m.size = t->size[SCRATCH_DIAG] / sizeof(vertex_t*);
+	do {
+		face_t*	face = p->data;
+		if (face->is_inside) {
+			find_diagonals(t, face, &m);
+			apply_diagonals(edge_list, face, &m);
+		}
+		p = p->succ;
+	} while (p != head);
+	t->scratch[SCRATCH_DIAG] = m.diag;
+	t->size[SCRATCH_DIAG] = sizeof(vertex_t*) * m.size;
 }
 
 void handle_start_vertex(edge_list_t* edge_list, vertex_t* v)
@@ -2072,9 +2985,6 @@ void handle_regular_vertex(edge_list_t* edge_list, vertex_t* v)
  */
 static void add_diagonal(edge_list_t* edge_list, vertex_t* v1, vertex_t* v2)
 {
-	double	amin;
-	double	theta;
-	double	phi;
 	int	closed;
 	edge_t*	p;
 	edge_t*	h;
@@ -2088,67 +2998,48 @@ static void add_diagonal(edge_list_t* edge_list, vertex_t* v1, vertex_t* v2)
 
 	assert(vec_above(v1->vec, v2->vec));
 
-	/* the angle of vector v1->v2 */
-	phi = atan2(v2->vec.y - v1->vec.y,
-			v2->vec.x - v1->vec.x);
-
-	/* find edge which has least angle from v1->v2 at v1 */
-	amin = 2*PI+1;
+	/* find edge which has least angle from v1->v2 at v1,
+	 * i.e., the first edge clockwise from v1->v2 */
+	v1_out = NULL;
 	p = h = v1->incident_edge;
 	assert(p != NULL);
 	do {
-		double		angle;
 		edge_t*		e = p;
-		vector_t	vx = e->twin->origin->vec;
 		p = p->twin->succ;
 
-		/* angle vx.v1 */
-		theta = atan2(vx.y - v1->vec.y,
-				vx.x - v1->vec.x);
-		if (phi < theta)
-			angle = 2*PI + phi - theta;
-		else
-			angle = phi - theta;
-		
-		if (angle < amin) {
-			if (angle == 0) return;
-			amin = angle;
+		if (!v1_out || cw_before(v1->vec, v2->vec,
+					e->twin->origin->vec,
+					v1_out->twin->origin->vec)) {
 			v1_out = e;
 			v1_in = e->pred;
 		}
 
 	} while (p != h);
-	
-	/* the angle of vector v2->v1 */
-	phi = atan2(v1->vec.y - v2->vec.y,
-			v1->vec.x - v2->vec.x);
 
+	/* the diagonal already exists */
+	if (vec_same_dir(v1->vec, v2->vec, v1_out->twin->origin->vec))
+		return;
+	
 	/* find edge which has least angle from v2->v1 at v2 */
-	amin = 2*PI+1;
+	v2_out = NULL;
 	p = h = v2->incident_edge;
 	assert(p != NULL);
 	do {
-		double		angle;
 		edge_t*		e = p;
-		vector_t	vx = e->twin->origin->vec;
 		p = p->twin->succ;
 
-		theta = atan2(vx.y - v2->vec.y,
-				vx.x - v2->vec.x);
-		if (phi < theta)
-			angle = 2*PI + phi - theta;
-		else
-			angle = phi - theta;
-		
-		if (angle < amin) {
-			if (angle == 0) return;
-			amin = angle;
+		if (!v2_out || cw_before(v2->vec, v1->vec,
+					e->twin->origin->vec,
+					v2_out->twin->origin->vec)) {
 			v2_out = e;
 			v2_in = e->pred;
 		}
 
 	} while (p != h);
 
+	if (vec_same_dir(v2->vec, v1->vec, v2_out->twin->origin->vec))
+		return;
+
 	/* we now know the original bounded face */
 	face = v1_out->left_face;
 
@@ -2163,8 +3054,8 @@ static void add_diagonal(edge_list_t* edge_list, vertex_t* v1, vertex_t* v2)
 		p = p->succ;
 	} while (p != h);
 
-	up = new_edge();
-	list_add(&edge_list->edges, up);
+	up = new_edge(edge_list->arena);
+	arena_list_add(edge_list->arena, &edge_list->edges, up);
 	up->origin = v2;
 	up->left_face = face;
 	up->pred = v2_in;
@@ -2172,8 +3063,8 @@ static void add_diagonal(edge_list_t* edge_list, vertex_t* v1, vertex_t* v2)
 	up->succ = v1_out;
 	v1_out->pred = up;
 
-	down = new_edge();
-	list_add(&edge_list->edges, down);
+	down = new_edge(edge_list->arena);
+	arena_list_add(edge_list->arena, &edge_list->edges, down);
 	down->origin = v1;
 	down->left_face = face;
 	down->pred = v1_in;
@@ -2210,18 +3101,22 @@ static void add_diagonal(edge_list_t* edge_list, vertex_t* v1, vertex_t* v2)
  */
 static int vertex_left_of_edge(void* v, void* e)
 {
-	/* get the x-coordinate where e crosses the line y=v.y */
 	vector_t	a = ((vertex_t*)v)->vec;
 	vector_t	b1 = ((edge_t*)e)->origin->vec;
 	vector_t	b2 = ((edge_t*)e)->twin->origin->vec;
 
-	/* e is horizontal */
-	/*if (b2.y - b1.y == 0)
-		return 1;*/
+	return vec_left_of(a, b1, b2);
+}
 
-	float		x = b1.x + (b2.x-b1.x)*(a.y-b1.y)/(b2.y-b1.y);
+/* Returns 1 if v is strictly right of e
+ */
+static int vertex_right_of_edge(void* v, void* e)
+{
+	vector_t	a = ((vertex_t*)v)->vec;
+	vector_t	b1 = ((edge_t*)e)->origin->vec;
+	vector_t	b2 = ((edge_t*)e)->twin->origin->vec;
 
-	return a.x < x;
+	return vec_right_of(a, b1, b2);
 }
 
 /* Returns 1 if a is left of b:
@@ -29,6 +29,9 @@
 #include "shape.h"
 #include "list.h"
 #include "bstree.h"
+#include "arena.h"
+#include "mesh.h"
+#include "pool.h"
 
 typedef struct edge		edge_t;
 typedef struct vertex		vertex_t;
@@ -36,8 +39,31 @@ typedef struct face		face_t;
 typedef struct edge_list	edge_list_t;
 typedef struct segment		seg_t;
 typedef struct segment_tree	stree_t;
+typedef struct triangulator	triangulator_t;
 
 edge_list_t* triangulate(shape_t* shape);
+edge_list_t* triangulate_arena(shape_t* shape, arena_t* arena);
+mesh_t* triangulate_to_mesh(shape_t* shape, arena_t* scratch);
+mesh_t* edgelist_to_mesh(edge_list_t* edge_list);
+
+/* Triangulate in the arena, using the pool (if not NULL) to
+ * triangulate the monotone pieces of large shapes in parallel */
+edge_list_t* triangulate_pool(shape_t* shape, arena_t* arena, pool_t* pool);
+
+/* A triangulator keeps the memory of the edge list and the temporary
+ * arrays of the triangulation passes between calls, at the size of the
+ * largest shape so far, so triangulating many shapes with one
+ * triangulator does not go back to the system allocator for each.
+ *
+ * A triangulator must only be used by one thread at a time, a pool job
+ * keeps one for each thread.
+ */
+triangulator_t* new_triangulator();
+void free_triangulator(triangulator_t** triangulator);
+
+/* The edge list is valid until the next call with the same triangulator */
+edge_list_t* triangulator_edges(triangulator_t* triangulator, shape_t* shape);
+mesh_t* triangulator_mesh(triangulator_t* triangulator, shape_t* shape);
 
 void free_edgelist(edge_list_t** edge_list);
 
@@ -45,6 +71,7 @@ void free_edgelist(edge_list_t** edge_list);
 int vec_above(vector_t v1, vector_t v2);
 
 edge_list_t* make_planar(shape_t* shape);
+edge_list_t* make_planar_arena(shape_t* shape, arena_t* arena);
 void connect_components(edge_list_t* edge_list);
 void triangulate_face(edge_list_t* edge_list, face_t* face);
 
@@ -103,8 +130,12 @@ struct edge_list {
 	list_t*		cycles;
 	bstree_t*	etree;
 
-	/* for convenience - makes freeing memory easier */
+	/* all half-edges */
 	list_t*		edges;
+
+	/* owner of the vertices, edges, faces and the list nodes above */
+	arena_t*	arena;
+	int		owns_arena;
 };
 
 /* Sweep line event points */
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/**
+ * tribench - end-to-end triangulation benchmark for a Latin charset
+ *
+ * Triangulates the printable ASCII and Latin-1 glyphs of a font both
+ * with the monotone decomposition alone and through
+ * triangulate_to_mesh, which sends small contours to earclip_shape,
+ * and then through triangulator_mesh, which also keeps the temporary
+ * arrays of the passes between glyphs. The total triangle area of the
+ * meshes is printed as a sanity check.
+ *
+ * The second table gives the average cache miss ratio (misses per
+ * triangle) of the meshes in FIFO vertex caches of a few sizes, as
+ * they come from the triangulator and after optimize_vertex_cache,
+ * and the number of indices when they are drawn as triangle strips.
+ *
+ * Characters in the optional SKIP argument are left out, e.g. glyphs
+ * the sweep can not handle yet. Its bytes are taken as Latin-1 codes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ttf.h"
+#include "shape.h"
+#include "mesh.h"
+#include "earclip.h"
+#include "triangulate.h"
+#include "vcache.h"
+
+#define DEFAULT_IPL	(3)
+#define DEFAULT_REPEAT	(200)
+
+static double elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Twice the total area of the triangles of a mesh
+ */
+static double mesh_area(mesh_t* mesh)
+{
+	double	area = 0;
+	int	i;
+
+	for (i = 0; i < mesh->ntri; ++i) {
+		vector_t	a = mesh->vecs[mesh_index(mesh, 3*i)];
+		vector_t	b = mesh->vecs[mesh_index(mesh, 3*i+1)];
+		vector_t	c = mesh->vecs[mesh_index(mesh, 3*i+2)];
+		double		d = ((double) b.x - a.x) * ((double) c.y - a.y) -
+			((double) b.y - a.y) * ((double) c.x - a.x);
+		area += d < 0 ? -d : d;
+	}
+	return area;
+}
+
+/* Print the ACMR of the meshes of all glyphs before and after
+ * reordering, and the index counts of lists and strips
+ */
+static void bench_vcache(shape_t** shapes, int nshape, arena_t* arena)
+{
+	static const int	sizes[] = { 8, 16, 32 };
+	mesh_t**		meshes = malloc(sizeof(mesh_t*) * nshape);
+	double			misses[3][2] = { { 0 } };
+	long			ntri = 0;
+	long			nstrip = 0;
+	clock_t			start;
+	double			t;
+	int			i;
+	int			j;
+
+	for (i = 0; i < nshape; ++i) {
+		meshes[i] = triangulate_to_mesh(shapes[i], arena);
+		ntri += meshes[i]->ntri;
+		for (j = 0; j < 3; ++j)
+			misses[j][0] += mesh_acmr(meshes[i], sizes[j]) *
+				meshes[i]->ntri;
+	}
+
+	start = clock();
+	for (i = 0; i < nshape; ++i)
+		optimize_vertex_cache(meshes[i]);
+	t = elapsed(start);
+
+	for (i = 0; i < nshape; ++i) {
+		uint32_t*	strips;
+		int		n;
+
+		for (j = 0; j < 3; ++j)
+			misses[j][1] += mesh_acmr(meshes[i], sizes[j]) *
+				meshes[i]->ntri;
+		strips = mesh_strips(meshes[i], &n);
+		nstrip += n;
+		free(strips);
+		free_mesh(&meshes[i]);
+	}
+	free(meshes);
+
+	printf("%-12s %12s %14s\n", "fifo cache", "acmr", "optimized");
+	for (j = 0; j < 3; ++j)
+		printf("%-12d %12.3f %14.3f\n", sizes[j],
+				misses[j][0] / ntri, misses[j][1] / ntri);
+	printf("%ld triangles reordered in %.4f seconds, "
+			"%ld list indices, %ld strip indices\n",
+			ntri, t, 3 * ntri, nstrip);
+}
+
+static mesh_t* monotone_mesh(shape_t* shape, arena_t* arena)
+{
+	edge_list_t*	edge_list = triangulate_arena(shape, arena);
+	mesh_t*		mesh = edgelist_to_mesh(edge_list);
+
+	free_edgelist(&edge_list);
+	arena_reset(arena);
+	return mesh;
+}
+
+int main(int argc, char** argv)
+{
+	FILE*		fp;
+	ttf_t*		ttf;
+	shape_t*	shapes[0x100];
+	arena_t*	arena = new_arena();
+	triangulator_t*	triangulator = new_triangulator();
+	const char*	skip = "";
+	int		ipl = DEFAULT_IPL;
+	int		repeat = DEFAULT_REPEAT;
+	int		nshape = 0;
+	int		nsmall = 0;
+	double		area[3] = { 0, 0, 0 };
+	double		t[3];
+	clock_t		start;
+	int		chr;
+	int		i;
+	int		r;
+
+	if (argc < 2 || !strcmp(argv[1], "-h")) {
+		printf("usage: tribench FONT [IPL] [REPEAT] [SKIP]\n");
+		return argc < 2;
+	}
+	if (argc > 2)
+		ipl = atoi(argv[2]);
+	if (argc > 3)
+		repeat = atoi(argv[3]);
+	if (argc > 4)
+		skip = argv[4];
+
+	if (!(fp = fopen(argv[1], "rb"))) {
+		fprintf(stderr, "could not open %s\n", argv[1]);
+		return 1;
+	}
+	ttf = ttf_load(fp);
+	fclose(fp);
+	if (!ttf) {
+		fprintf(stderr, "%s\n", ttf_strerror());
+		return 1;
+	}
+	ttf->interpolation_level = ipl;
+
+	for (chr = 0x21; chr <= 0xFF; ++chr) {
+		shape_t*	shape;
+		mesh_t*		mesh;
+
+		if ((chr >= 0x7F && chr <= 0xA0) || strchr(skip, chr))
+			continue;
+		shape = ttf_export_chr_shape(ttf, chr);
+		if (!shape || shape->nseg == 0) {
+			free_shape(&shape);
+			continue;
+		}
+		shapes[nshape++] = shape;
+
+		if ((mesh = earclip_shape(shape)) != NULL)
+			nsmall += 1;
+		free_mesh(&mesh);
+	}
+
+	start = clock();
+	for (r = 0; r < repeat; ++r) {
+		for (i = 0; i < nshape; ++i) {
+			mesh_t*	mesh = monotone_mesh(shapes[i], arena);
+			if (r == 0)
+				area[0] += mesh_area(mesh);
+			free_mesh(&mesh);
+		}
+	}
+	t[0] = elapsed(start);
+
+	start = clock();
+	for (r = 0; r < repeat; ++r) {
+		for (i = 0; i < nshape; ++i) {
+			mesh_t*	mesh = triangulate_to_mesh(shapes[i], arena);
+			if (r == 0)
+				area[1] += mesh_area(mesh);
+			free_mesh(&mesh);
+		}
+	}
+	t[1] = elapsed(start);
+
+	start = clock();
+	for (r = 0; r < repeat; ++r) {
+		for (i = 0; i < nshape; ++i) {
+			mesh_t*	mesh = triangulator_mesh(triangulator,
+					shapes[i]);
+			if (r == 0)
+				area[2] += mesh_area(mesh);
+			free_mesh(&mesh);
+		}
+	}
+	t[2] = elapsed(start);
+
+	printf("%d glyphs, %d handled by earclip_shape\n", nshape, nsmall);
+	printf("%-12s %12s %14s %14s\n", "path", "seconds", "us/glyph",
+			"area");
+	printf("%-12s %12.4f %14.3f %14.6f\n", "monotone", t[0],
+			t[0] * 1e6 / ((double) repeat * nshape), area[0]);
+	printf("%-12s %12.4f %14.3f %14.6f\n", "dispatch", t[1],
+			t[1] * 1e6 / ((double) repeat * nshape), area[1]);
+	printf("%-12s %12.4f %14.3f %14.6f\n", "reused", t[2],
+			t[2] * 1e6 / ((double) repeat * nshape), area[2]);
+
+	bench_vcache(shapes, nshape, arena);
+
+	for (i = 0; i < nshape; ++i)
+		free_shape(&shapes[i]);
+	free_arena(&arena);
+	free_triangulator(&triangulator);
+	free_ttf(&ttf);
+	return 0;
+}
@@ -18,7 +18,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 /*
- * cTTF can load OpenType fonts with TrueType font outlines.
+ * cTTF can load OpenType fonts with TrueType font outlines
+ * or CFF font outlines (see cff.c).
  * There are various limitations to cTTF which restrict the
  * kinds of fonts it will successfully load.
  *
@@ -55,8 +56,12 @@
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 
 #include "ttf.h"
+#include "cff.h"
+#include "var.h"
+#include "hint.h"
 #include "list.h"
 
 /* All values in an OpenType file are encoded in
@@ -103,6 +108,13 @@ static char	ttf_err_buf[1024] = { '\0' };
 #define TTF_HMTX_TAG	(0x686D7478)
 #define TTF_LOCA_TAG	(0x6C6F6361)
 #define TTF_MAXP_TAG	(0x6D617870)
+#define TTF_CFF_TAG	(0x43464620)
+#define TTF_FVAR_TAG	(0x66766172)
+#define TTF_GVAR_TAG	(0x67766172)
+#define TTF_AVAR_TAG	(0x61766172)
+#define TTF_FPGM_TAG	(0x6670676D)
+#define TTF_PREP_TAG	(0x70726570)
+#define TTF_CVT_TAG	(0x63767420)
 
 /* control points */
 #define TTF_ON_CURVE (0x01)
@@ -112,20 +124,12 @@ static char	ttf_err_buf[1024] = { '\0' };
 #define TTF_XREPEAT (0x10)
 #define TTF_YREPEAT (0x20)
 
-#define TTF_WORD_ARGUMENTS (0x0001)
-#define TTF_ARGUMENTS_ARE_XY (0x0002)
-#define TTF_ROUND_XY_TO_GRID (0x0004)
-#define TTF_SCALE (0x0008)
-#define TTF_RESERVED (0x0010)
-#define TTF_MORE_COMPONENTS (0x0020)
-#define TTF_XY_SCALE (0x0040)
-#define TTF_MATRIX2 (0x0080)
-#define TTF_INSTRUCTIONS (0x0100)
-#define TTF_USE_THESE_METRICS (0x0200)
-
 #define TTF_GLYPH_TBL_SIZE (256)
 
 static int ttf_read_gh(FILE* file, ttf_glyph_header_t* gh);
+static int ttf_read_component(FILE* file, ttf_component_t* c);
+static int ttf_read_f2dot14(FILE* file, float* v);
+static ttf_glyph_data_t* ttf_chr_glyph(ttf_t* ttf, uint16_t chr);
 static int ttf_seek_header(FILE* file, ttf_table_header_t* table);
 static int ttf_load_headers(FILE* file,
 		ttf_t* ttf, const ttf_tbl_directory_t* td);
@@ -141,11 +145,21 @@ static int ttf_load_loca(FILE* file, ttf_t* ttf);
 static int ttf_load_maxp(FILE* file, ttf_t* ttf);
 static uint16_t ttf_interpolate_chr(
 		ttf_t*		ttf,
-		uint16_t	chr,
+		ttf_glyph_data_t*	glyph,
 		vector_t*	cpoints,
 		vector_t*	points,
 		uint16_t*	cpind,
 		uint16_t	e);
+static uint16_t ttf_interpolate_chr_fixed(
+		ttf_t*		ttf,
+		ttf_glyph_data_t*	glyph,
+		ttf_point_t*	out,
+		ttf_point_t*	in,
+		uint16_t*	outind,
+		uint16_t	e);
+static ttf_glyph_data_t* ttf_chr_glyph(ttf_t* ttf, uint16_t chr);
+static ttf_hinted_t* ttf_chr_hinted(ttf_t* ttf, uint16_t chr,
+		ttf_glyph_data_t* glyph, ttf_glyph_data_t* hinted_glyph);
 
 /* Returns the last error string
  */
@@ -164,6 +178,8 @@ ttf_t* new_ttf()
 	obj->plhmtx = NULL;
 	obj->plsb = NULL;
 	obj->interpolation_level = 1;
+	obj->fixed_point = 0;
+	obj->hinting = 0;
 	obj->ppem = 12;
 	obj->resolution = 96;/* Screen resolution DPI */
 
@@ -178,6 +194,15 @@ ttf_t* new_ttf()
 	obj->hmtx = NULL;
 	obj->loca = NULL;
 	obj->maxp = NULL;
+	obj->cff = NULL;
+	obj->fvar = NULL;
+	obj->gvar = NULL;
+	obj->avar = NULL;
+	obj->fpgm = NULL;
+	obj->prep = NULL;
+	obj->cvt = NULL;
+	obj->var = NULL;
+	obj->hint = NULL;
 	return obj;
 }
 
@@ -202,6 +227,8 @@ void free_ttf(ttf_t** obj)
 			free(p->glyph_data[i].px);
 			free(p->glyph_data[i].py);
 			free(p->glyph_data[i].state);
+			free(p->glyph_data[i].components);
+			free(p->glyph_data[i].instructions);
 		}
 		free(p->glyph_data);
 	}
@@ -227,6 +254,16 @@ void free_ttf(ttf_t** obj)
 	if (p->hmtx) free(p->hmtx);
 	if (p->loca) free(p->loca);
 	if (p->maxp) free(p->maxp);
+	if (p->cff) free(p->cff);
+	if (p->fvar) free(p->fvar);
+	if (p->gvar) free(p->gvar);
+	if (p->avar) free(p->avar);
+	if (p->fpgm) free(p->fpgm);
+	if (p->prep) free(p->prep);
+	if (p->cvt) free(p->cvt);
+
+	free_ttf_var(&p->var);
+	free_ttf_hint(&p->hint);
 
 	free(p);
 	*obj = NULL;
@@ -241,6 +278,11 @@ ttf_glyph_data_t* ttf_new_glyph_data()
 	obj->state = NULL;
 	obj->px = NULL;
 	obj->py = NULL;
+	obj->composite = 0;
+	obj->components = NULL;
+	obj->ncomponents = 0;
+	obj->instructions = NULL;
+	obj->ninstructions = 0;
 	return obj;
 }
 
@@ -277,6 +319,91 @@ int ttf_read_gh(FILE* file, ttf_glyph_header_t* gh)
 	return 0;
 }
 
+/* Read a component record of a composite glyph
+ *
+ * Returns 1 on error
+ */
+int ttf_read_component(FILE* file, ttf_component_t* c)
+{
+	uint16_t	w[2];
+
+	if (1 != fread(w, sizeof(w), 1, file)) {
+		ttf_err("Read error in file: %s",
+				strerror(errno));
+		return 1;
+	}
+	c->flags = TTF_ENDIAN_WORD(w[0]);
+	c->glyph = TTF_ENDIAN_WORD(w[1]);
+
+	if (c->flags & TTF_WORD_ARGUMENTS) {
+		if (1 != fread(w, sizeof(w), 1, file)) {
+			ttf_err("Read error in file: %s",
+					strerror(errno));
+			return 1;
+		}
+		w[0] = TTF_ENDIAN_WORD(w[0]);
+		w[1] = TTF_ENDIAN_WORD(w[1]);
+		if (c->flags & TTF_ARGUMENTS_ARE_XY) {
+			c->dx = (int16_t) w[0];
+			c->dy = (int16_t) w[1];
+		} else {
+			c->dx = w[0];
+			c->dy = w[1];
+		}
+	} else {
+		uint8_t	b[2];
+
+		if (1 != fread(b, sizeof(b), 1, file)) {
+			ttf_err("Read error in file: %s",
+					strerror(errno));
+			return 1;
+		}
+		if (c->flags & TTF_ARGUMENTS_ARE_XY) {
+			c->dx = (int8_t) b[0];
+			c->dy = (int8_t) b[1];
+		} else {
+			c->dx = b[0];
+			c->dy = b[1];
+		}
+	}
+
+	c->xx = c->yy = 1;
+	c->xy = c->yx = 0;
+	if (c->flags & TTF_SCALE) {
+		if (ttf_read_f2dot14(file, &c->xx))
+			return 1;
+		c->yy = c->xx;
+	} else if (c->flags & TTF_XY_SCALE) {
+		if (ttf_read_f2dot14(file, &c->xx) ||
+				ttf_read_f2dot14(file, &c->yy))
+			return 1;
+	} else if (c->flags & TTF_MATRIX2) {
+		if (ttf_read_f2dot14(file, &c->xx) ||
+				ttf_read_f2dot14(file, &c->xy) ||
+				ttf_read_f2dot14(file, &c->yx) ||
+				ttf_read_f2dot14(file, &c->yy))
+			return 1;
+	}
+	return 0;
+}
+
+/* Read a 2.14 fixed point number
+ *
+ * Returns 1 on error
+ */
+int ttf_read_f2dot14(FILE* file, float* v)
+{
+	uint16_t	w;
+
+	if (1 != fread(&w, sizeof(w), 1, file)) {
+		ttf_err("Read error in file: %s",
+				strerror(errno));
+		return 1;
+	}
+	*v = (int16_t) TTF_ENDIAN_WORD(w) / 16384.f;
+	return 0;
+}
+
 /* load the required TTF headers
  *
  * Returns 1 on error
@@ -328,6 +455,34 @@ int ttf_load_headers(FILE* file, ttf_t* ttf, const ttf_tbl_directory_t* td)
 				ttf_dbg_print("found 'maxp' table\n");
 				ttf->maxp = header;
 				break;
+			case TTF_CFF_TAG:
+				ttf_dbg_print("found 'CFF ' table\n");
+				ttf->cff = header;
+				break;
+			case TTF_FVAR_TAG:
+				ttf_dbg_print("found 'fvar' table\n");
+				ttf->fvar = header;
+				break;
+			case TTF_GVAR_TAG:
+				ttf_dbg_print("found 'gvar' table\n");
+				ttf->gvar = header;
+				break;
+			case TTF_AVAR_TAG:
+				ttf_dbg_print("found 'avar' table\n");
+				ttf->avar = header;
+				break;
+			case TTF_FPGM_TAG:
+				ttf_dbg_print("found 'fpgm' table\n");
+				ttf->fpgm = header;
+				break;
+			case TTF_PREP_TAG:
+				ttf_dbg_print("found 'prep' table\n");
+				ttf->prep = header;
+				break;
+			case TTF_CVT_TAG:
+				ttf_dbg_print("found 'cvt ' table\n");
+				ttf->cvt = header;
+				break;
 			default:
 				free(header);
 		}
@@ -338,7 +493,8 @@ int ttf_load_headers(FILE* file, ttf_t* ttf, const ttf_tbl_directory_t* td)
 		ttf_err("'cmap' table is missing in font file");
 		return 1;
 	}
-	if (!ttf->glyf) {
+	/* 'glyf' and 'loca' are only needed for TrueType outlines */
+	if (!ttf->glyf && !ttf->cff) {
 		ttf_err("'glyf' table is missing in font file");
 		return 1;
 	}
@@ -354,7 +510,7 @@ int ttf_load_headers(FILE* file, ttf_t* ttf, const ttf_tbl_directory_t* td)
 		ttf_err("'hmtx' table is missing in font file");
 		return 1;
 	}
-	if (!ttf->loca) {
+	if (!ttf->loca && !ttf->cff) {
 		ttf_err("'loca' table is missing in font file");
 		return 1;
 	}
@@ -595,6 +751,11 @@ int ttf_load_glyf(FILE* file, ttf_t* ttf)
 			ttf->glyph_data[i].px = NULL;
 			ttf->glyph_data[i].py = NULL;
 			ttf->glyph_data[i].state = NULL;
+			ttf->glyph_data[i].composite = 0;
+			ttf->glyph_data[i].components = NULL;
+			ttf->glyph_data[i].ncomponents = 0;
+			ttf->glyph_data[i].instructions = NULL;
+			ttf->glyph_data[i].ninstructions = 0;
 			ttf_set_ls_aw(ttf, &gh, &ttf->glyph_data[i], i);
 			continue;
 		}
@@ -742,7 +903,11 @@ int ttf_load_maxp(FILE* file, ttf_t* ttf)
 	if (ttf_seek_header(file, ttf->maxp))
 		return 1;
 
-	if (1 != fread(&mpth, sizeof(mpth), 1, file)) {
+	/* version 0.5 of the table (used with CFF outlines) only
+	 * has the version and numGlyphs fields */
+	if (1 != fread(&mpth.version, sizeof(mpth.version), 1, file) ||
+			1 != fread(&mpth.numGlyphs,
+				sizeof(mpth.numGlyphs), 1, file)) {
 		ttf_err("Read error in file: %s",
 				strerror(errno));
 		return 1;
@@ -793,8 +958,18 @@ ttf_t* ttf_load(FILE* file)
 	if (ttf_load_hhea(file, ttf)) goto err;
 	if (ttf_load_hmtx(file, ttf)) goto err;
 	if (ttf_load_cmap(file, ttf)) goto err;
-	if (ttf_load_loca(file, ttf)) goto err;
-	if (ttf_load_glyf(file, ttf)) goto err;
+	if (ttf->cff) {
+		if (cff_load(file, ttf)) goto err;
+	} else {
+		if (ttf_load_loca(file, ttf)) goto err;
+		if (ttf_load_glyf(file, ttf)) goto err;
+		if (ttf->fvar && ttf->gvar && ttf_var_load(file, ttf))
+			ttf_warn("Warning: invalid font variation "
+					"tables ignored\n");
+		if (ttf_hint_load(file, ttf))
+			ttf_warn("Warning: could not load the "
+					"instruction tables\n");
+	}
 
 	ttf_dbg_print("TrueType font loaded successfully\n");
 
@@ -841,209 +1016,82 @@ int ttf_read_glyph(ttf_t*		ttf,
 	int is_prev = 0;
 	int16_t last_point = 0;
 	if (gh->number_of_contours < 0) {
-		// load composite glyph
-		uint16_t		contour;
-		uint16_t		flags;
-		uint16_t		glyph_index;
-		uint16_t		xoff;
-		uint16_t		yoff;
-		uint16_t		npoints = 0;
-		uint16_t		ncontours = 0;
-		uint32_t		readpos;
-		ttf_glyph_data_t* 	component;
-		list_t*			components = NULL;
-		int			norigmtx = 0;
-		uint16_t*	endpoints;
-		int*		state;
-		int16_t*	px;
-		int16_t*	py;
-		uint16_t	point_off = 0;
-		uint16_t	contour_off = 0;
-		uint16_t	currentPoint;
-		int		ccoff;
-		int		coff;
-		int		olim;
-		int		firstrun;
-		list_t* p;
-		list_t* h;
-		int i = 0;
-		
+		/* composite glyph: the component records are kept so that
+		 * font variations can move the components, and the outlines
+		 * of the components are merged */
+		ttf_glyph_header_t	cgh = *gh;
+		ttf_glyph_data_t	component;
+		ttf_component_t*	c;
+		int			metrics = 0;
+		long			readpos;
+
+		gd->npoints = 0;
+		gd->ncontours = 0;
+		gd->px = NULL;
+		gd->py = NULL;
+		gd->state = NULL;
+		gd->endpoints = NULL;
+		gd->composite = 1;
+		gd->components = NULL;
+		gd->ncomponents = 0;
+		gd->instructions = NULL;
+		gd->ninstructions = 0;
+
 		do {
-			fread(&flags, sizeof(flags), 1, file);
-			flags = TTF_ENDIAN_WORD(flags);
-			fread(&glyph_index, sizeof(glyph_index), 1, file);
-			glyph_index = TTF_ENDIAN_WORD(glyph_index);
-
-			//Load subglyph{
-				readpos = ftell(file);
-				fseek(file, glyf->offset + ttf->idx2loc[glyph_index], SEEK_SET);
-				if (ttf_read_gh(file, gh)) return 1;
-				component = malloc(sizeof(*component));
-				ttf_read_glyph(ttf, file, gh, component,
-						glyf, glyph_index);
-				list_add(&components, component);
-				fseek(file, readpos, SEEK_SET);
-			//}
-			
-			// flag out of range check
-			assert(flags < 0x800);
-
-			if (flags & TTF_WORD_ARGUMENTS) {
-				fread(&xoff, sizeof(xoff), 1, file);
-				xoff = TTF_ENDIAN_WORD(xoff);
-				fread(&yoff, sizeof(yoff), 1, file);
-				yoff = TTF_ENDIAN_WORD(yoff);
+			gd->components = realloc(gd->components,
+				sizeof(ttf_component_t) * (gd->ncomponents + 1));
+			c = &gd->components[gd->ncomponents];
+			if (ttf_read_component(file, c) ||
+					c->glyph >= ttf->nglyphs)
+				return 1;
+			gd->ncomponents += 1;
+
+			readpos = ftell(file);
+			if (ttf->idx2loc[c->glyph] == ttf->idx2loc[c->glyph+1]) {
+				gh->xmin = gh->xmax = 0;
+				ttf_set_ls_aw(ttf, gh, &component, c->glyph);
 			} else {
-				uint16_t tmp;
-				fread(&tmp, sizeof(tmp), 1, file);
-				yoff = 0xFF & tmp;
-				xoff = tmp >> 8;
-			}
-			if (flags & TTF_ARGUMENTS_ARE_XY) {
-				for (contour = 0; contour < component->npoints; contour++) {
-					component->px[contour] += xoff;
-					component->py[contour] += yoff;
-				}
-			}
-			if (flags & TTF_SCALE) {
-				float		scale;
-				uint16_t	f2dot14;
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				scale = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				scale += ((float) f2dot14) / 16383.f; //16383 == 0x3FFF
-				for (contour = 0; contour < component->npoints; contour++) {
-					component->px[contour] = (int16_t)(component->px[contour] * scale);
-					component->py[contour] = (int16_t)(component->py[contour] * scale);
-				}
-			} else if (flags & TTF_XY_SCALE) {
-				float		xScale;
-				float		yScale;
-				uint16_t	f2dot14;
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				xScale = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				xScale += ((float) f2dot14) / 16383.f; //16383 == 0x3FFF
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				yScale = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				yScale += ((float) f2dot14) / 16383.f;
-				for (contour = 0; contour < component->npoints; contour++)
-				{
-					component->px[contour] = (int16_t)(component->px[contour] * xScale);
-					component->py[contour] = (int16_t)(component->py[contour] * yScale);
-				}
-			} else if (flags & TTF_MATRIX2) {
-				float	transform_11;
-				float	transform_12;
-				float	transform_21;
-				float	transform_22;
-
-				uint16_t f2dot14;
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				transform_11 = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				transform_11 += ((float) f2dot14) / 16383.f; //16383 == 0x3FFF
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				transform_12 = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				transform_12 += ((float) f2dot14) / 16383.f;
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				transform_21 = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				transform_21 += ((float) f2dot14) / 16383.f;
-				fread(&f2dot14, sizeof(f2dot14), 1, file);
-				f2dot14 = TTF_ENDIAN_WORD(f2dot14);
-				//convert f2dot14 to float
-				transform_22 = (float) ((0xC000 & f2dot14) >> 14);
-				f2dot14 &= 0x3FFF;
-				transform_22 += ((float) f2dot14) / 16383.f;
-				for (contour = 0; contour < component->npoints; contour++) {
-					component->px[contour] = (int16_t)(component->px[contour] * transform_11 + component->py[contour] * transform_21);
-					component->py[contour] = (int16_t)(component->py[contour] * transform_12 + component->px[contour] * transform_22);
-				}
+				fseek(file, glyf->offset + ttf->idx2loc[c->glyph],
+						SEEK_SET);
+				if (ttf_read_gh(file, gh) ||
+						ttf_read_glyph(ttf, file, gh,
+							&component, glyf,
+							c->glyph))
+					return 1;
+				ttf_add_component(gd, c, &component);
+				free(component.endpoints);
+				free(component.state);
+				free(component.px);
+				free(component.py);
+				free(component.components);
+				free(component.instructions);
 			}
+			fseek(file, readpos, SEEK_SET);
 
-			if (flags & TTF_USE_THESE_METRICS) {
-				norigmtx = 1;
-				ttf_set_ls_aw(ttf, gh, gd, glyph_index);
+			if (c->flags & TTF_USE_THESE_METRICS) {
+				metrics = 1;
+				gd->aw = component.aw;
+				gd->lsb = component.lsb;
 			}
-			npoints += component->npoints;
-			ncontours += component->ncontours;
-		} while (flags & TTF_MORE_COMPONENTS);
-		gd->npoints = npoints;
-		gd->ncontours = ncontours;
-
-		//use the components list to create a composite glyph
-		endpoints = malloc(sizeof(uint16_t)*ncontours);
-		state = malloc(sizeof(int)*npoints);
-		px = malloc(sizeof(int16_t)*npoints);
-		py = malloc(sizeof(int16_t)*npoints);
-		point_off = 0;
-		contour_off = 0;
-
-		memset(endpoints, 0, ncontours << 1);
-
-		p = h = components;
-		do {
-			component = p->data;
-			olim = component->ncontours - 1;
-			firstrun = 1;
-			for (ccoff = contour_off, coff = 0; ccoff < ncontours; ccoff++) {
-				if (coff < olim) {
-					endpoints[ccoff] += component->endpoints[coff++];
-				} else {
-					if (firstrun) {
-						endpoints[ccoff] += component->endpoints[coff];
-						firstrun = 0;
-					} else {
-						endpoints[ccoff] += component->endpoints[coff] + 1;
-					}
-				}
-			}
-			currentPoint = component->npoints << 1;
-			memcpy(&px[point_off], component->px,
-				currentPoint);
-			memcpy(&py[point_off], component->py,
-				currentPoint);
-			memcpy(&state[point_off], component->state,
-				currentPoint >> 1);
-			point_off += component->npoints;
-			contour_off += component->ncontours;
-
-			++i;
-			p = p->succ;
-		} while (p != h);
-
-		while (components) {
-			ttf_glyph_data_t*	gd;
-			gd = components->data;
-			free(gd->endpoints);
-			free(gd->state);
-			free(gd->px);
-			free(gd->py);
-			free(gd);
-			list_remove(&components);
+		} while (c->flags & TTF_MORE_COMPONENTS);
+
+		/* the program of the composite follows the last
+		 * component and runs on the hinted components */
+		if (c->flags & TTF_INSTRUCTIONS) {
+			uint16_t	len;
+			if (1 != fread(&len, sizeof(len), 1, file))
+				return 1;
+			gd->ninstructions = TTF_ENDIAN_WORD(len);
+			gd->instructions = malloc(sizeof(uint8_t) *
+					(gd->ninstructions + 1));
+			if (gd->ninstructions != fread(gd->instructions,
+						sizeof(uint8_t),
+						gd->ninstructions, file))
+				return 1;
 		}
 
-		gd->px = px;
-		gd->py = py;
-		gd->state = state;
-		gd->endpoints = endpoints;
-		if (norigmtx) return 0;
-		ttf_set_ls_aw(ttf, gh, gd, i);
+		if (!metrics)
+			ttf_set_ls_aw(ttf, &cgh, gd, i);
 		return 0;
 	}
 
@@ -1176,9 +1224,13 @@ int ttf_read_glyph(ttf_t*		ttf,
 	gd->px = px;
 	gd->py = py;
 	gd->state = state;
+	gd->composite = 0;
+	gd->components = NULL;
+	gd->ncomponents = 0;
+	gd->instructions = simple.instructions;
+	gd->ninstructions = simple.instruction_length;
 	ttf_set_ls_aw(ttf, gh, gd, i);
 	free(simple.flags);
-	free(simple.instructions);
 	return 0;
 }
 
@@ -1188,7 +1240,7 @@ int ttf_read_glyph(ttf_t*		ttf,
 float ttf_char_width(ttf_t* ttf, uint16_t chr)
 {
 	assert(ttf != NULL);
-	return (float)(ttf->glyph_data[ttf->glyph_table[chr]].aw) / ttf->upem;
+	return (float)(ttf_chr_glyph(ttf, chr)->aw) / ttf->upem;
 }
 
 float ttf_line_width(ttf_t* type, const char* line)
@@ -1234,8 +1286,29 @@ shape_t* ttf_export_chr_shape(ttf_t* ttf, uint16_t chr)
 		//uint16_t	p2 = 0;
 		uint16_t	origin;
 
-		ttf_interpolate(ttf, chr, &points, &endpoints,
-				1.0/ttf->upem);
+		if (ttf->fixed_point) {
+			ttf_point_t*	fpoints;
+			uint32_t	npoints = 0;
+			uint32_t	i;
+
+			ttf_interpolate_fixed(ttf, chr, &fpoints, &endpoints);
+
+			/* only the flattening is integer, the shape and
+			 * everything after it are floating point */
+			for (e = 0; e < ttf->glyph_data[ttf->glyph_table[chr]].ncontours; e++)
+				npoints += endpoints[e];
+			points = malloc(sizeof(vector_t) * (npoints ? npoints : 1));
+			for (i = 0; i < npoints; i++) {
+				points[i].x = (float) fpoints[i].x /
+					(float) (ttf->upem << TTF_FIXED_SHIFT);
+				points[i].y = (float) fpoints[i].y /
+					(float) (ttf->upem << TTF_FIXED_SHIFT);
+			}
+			free(fpoints);
+		} else {
+			ttf_interpolate(ttf, chr, &points, &endpoints,
+					1.0/ttf->upem);
+		}
 
 		for (e = 0; e < ttf->glyph_data[ttf->glyph_table[chr]].ncontours; e++) {
 			lim += endpoints[e];
@@ -1259,7 +1332,7 @@ shape_t* ttf_export_chr_shape(ttf_t* ttf, uint16_t chr)
 
 uint16_t ttf_interpolate_chr(
 		ttf_t*		ttf,
-		uint16_t	chr,
+		ttf_glyph_data_t*	glyph,
 		vector_t*	cpoints,
 		vector_t*	points,
 		uint16_t*	cpind,
@@ -1271,7 +1344,7 @@ uint16_t ttf_interpolate_chr(
  	 * curve so that the actual interpolation goes faster.
  	 */
 	
-	int*		states = ttf->glyph_data[ttf->glyph_table[chr]].state;
+	int*		states = glyph->state;
 	uint16_t	pind;
 	uint16_t firstpoint;
 	uint16_t lastpoint;
@@ -1294,11 +1367,11 @@ uint16_t ttf_interpolate_chr(
 	int cont;
 
 	if (e)
-		pind = ttf->glyph_data[ttf->glyph_table[chr]].endpoints[e - 1] + 1;
+		pind = glyph->endpoints[e - 1] + 1;
 	else
 		pind = 0;
 	firstpoint = pind;
-	lastpoint = ttf->glyph_data[ttf->glyph_table[chr]].endpoints[e];
+	lastpoint = glyph->endpoints[e];
 
 	// if any state is true that means that the current point is on the curve
 	ls = states[lastpoint];
@@ -1328,7 +1401,42 @@ uint16_t ttf_interpolate_chr(
 			ns = states[pind];
 			np = points[pind];
 		}
-		if (!ls) {
+		if (cs == TTF_CUBIC) {
+			if (ls != TTF_CUBIC) {
+				//		on-cubic-cubic-on
+				uint16_t	eind;
+				vector_t	ep;
+				float		ax, ay, bx, by;
+				float		dddx, dddy;
+				float		mmm = mm * m;
+
+				eind = cont ? pind : firstpoint;
+				eind = (eind == lastpoint) ? firstpoint : eind + 1;
+				ep = points[eind];
+				ax = -lp.x + 3.f*cp.x - 3.f*np.x + ep.x;
+				ay = -lp.y + 3.f*cp.y - 3.f*np.y + ep.y;
+				bx = 3.f*lp.x - 6.f*cp.x + 3.f*np.x;
+				by = 3.f*lp.y - 6.f*cp.y + 3.f*np.y;
+				dx = ax*mmm + bx*mm + 3.f*(cp.x - lp.x)*m;
+				dy = ay*mmm + by*mm + 3.f*(cp.y - lp.y)*m;
+				ddx = 6.f*ax*mmm + 2.f*bx*mm;
+				ddy = 6.f*ay*mmm + 2.f*by*mm;
+				dddx = 6.f*ax*mmm;
+				dddy = 6.f*ay*mmm;
+				cx = lp.x;
+				cy = lp.y;
+				for (c = 0; c < ttf->interpolation_level; c++) {
+					cpoints[*cpind].x = cx;
+					cpoints[(*cpind)++].y = cy;
+					cx += dx;
+					cy += dy;
+					dx += ddx;
+					dy += ddy;
+					ddx += dddx;
+					ddy += dddy;
+				}
+			}
+		} else if (!ls) {
 			if (!cs) {
 				if (!ns) {
 					//		off-off-off
@@ -1370,7 +1478,7 @@ uint16_t ttf_interpolate_chr(
 					}
 				}
 			} else {
-				if (ns) {
+				if (ns == 1) {
 					cpoints[(*cpind)++] = cp;
 				}
 			}
@@ -1413,7 +1521,7 @@ uint16_t ttf_interpolate_chr(
 				}
 					
 			} else {
-				if (ns) {
+				if (ns == 1) {
 					cpoints[(*cpind)++] = cp;
 				}
 			}
@@ -1424,10 +1532,240 @@ uint16_t ttf_interpolate_chr(
 	return *cpind - addon;
 }
 
+/* Divide and round half away from zero
+ */
+static ttf_fixed_t ttf_fixed_div(int64_t num, int64_t den)
+{
+	if (num >= 0)
+		return (ttf_fixed_t) ((num + den/2) / den);
+	else
+		return (ttf_fixed_t) -((-num + den/2) / den);
+}
+
+/* Flatten a quadric Bezier curve with integer forward differencing.
+ *
+ * The start, control and end points are given at twice their actual
+ * value so that implied on-curve points (midpoints between two off-curve
+ * points) are exact. The curve is evaluated at t = c/n for c = 0..n-1
+ * using the numerator
+ *
+ * 	N(c) = n^2 s + 2nc (k - s) + c^2 (s - 2k + e)
+ *
+ * which is divided by 2n^2 and rounded for each output point. Since no
+ * rounding error accumulates the result is bit-identical on all
+ * platforms.
+ */
+static void ttf_flatten_fixed(
+		ttf_point_t*	out,
+		uint16_t*	outind,
+		ttf_point_t	s,
+		ttf_point_t	k,
+		ttf_point_t	e,
+		int		n)
+{
+	int64_t		nx = (int64_t) n * n * s.x;
+	int64_t		ny = (int64_t) n * n * s.y;
+	int64_t		ddx = 2 * ((int64_t) s.x - 2*k.x + e.x);
+	int64_t		ddy = 2 * ((int64_t) s.y - 2*k.y + e.y);
+	int64_t		dx = 2 * (int64_t) n * (k.x - s.x) + ddx/2;
+	int64_t		dy = 2 * (int64_t) n * (k.y - s.y) + ddy/2;
+	int64_t		den = 2 * (int64_t) n * n;
+	int		c;
+
+	for (c = 0; c < n; c++) {
+		out[*outind].x = ttf_fixed_div(nx, den);
+		out[(*outind)++].y = ttf_fixed_div(ny, den);
+		nx += dx;
+		ny += dy;
+		dx += ddx;
+		dy += ddy;
+	}
+}
+
+/* Flatten a cubic Bezier curve with integer forward differencing.
+ *
+ * The curve is evaluated at t = c/n for c = 0..n-1 using the numerator
+ *
+ * 	N(c) = a c^3 + n b c^2 + n^2 d c + n^3 s
+ *
+ * where a = -s + 3k1 - 3k2 + e, b = 3(s - 2k1 + k2) and d = 3(k1 - s),
+ * which is divided by n^3 and rounded for each output point.
+ */
+static void ttf_flatten_fixed_cubic(
+		ttf_point_t*	out,
+		uint16_t*	outind,
+		ttf_point_t	s,
+		ttf_point_t	k1,
+		ttf_point_t	k2,
+		ttf_point_t	e,
+		int		n)
+{
+	int64_t		n2 = (int64_t) n * n;
+	int64_t		ax = -(int64_t) s.x + 3*(int64_t) k1.x - 3*(int64_t) k2.x + e.x;
+	int64_t		ay = -(int64_t) s.y + 3*(int64_t) k1.y - 3*(int64_t) k2.y + e.y;
+	int64_t		bx = 3 * n * ((int64_t) s.x - 2*(int64_t) k1.x + k2.x);
+	int64_t		by = 3 * n * ((int64_t) s.y - 2*(int64_t) k1.y + k2.y);
+	int64_t		nx = n2 * n * s.x;
+	int64_t		ny = n2 * n * s.y;
+	int64_t		dx = ax + bx + 3 * n2 * ((int64_t) k1.x - s.x);
+	int64_t		dy = ay + by + 3 * n2 * ((int64_t) k1.y - s.y);
+	int64_t		ddx = 6*ax + 2*bx;
+	int64_t		ddy = 6*ay + 2*by;
+	int64_t		dddx = 6*ax;
+	int64_t		dddy = 6*ay;
+	int64_t		den = n2 * n;
+	int		c;
+
+	for (c = 0; c < n; c++) {
+		out[*outind].x = ttf_fixed_div(nx, den);
+		out[(*outind)++].y = ttf_fixed_div(ny, den);
+		nx += dx;
+		ny += dy;
+		dx += ddx;
+		dy += ddy;
+		ddx += dddx;
+		ddy += dddy;
+	}
+}
+
+/* Fixed point version of ttf_interpolate_chr.
+ */
+uint16_t ttf_interpolate_chr_fixed(
+		ttf_t*		ttf,
+		ttf_glyph_data_t*	glyph,
+		ttf_point_t*	out,
+		ttf_point_t*	in,
+		uint16_t*	outind,
+		uint16_t	e)
+{
+	int*		states = glyph->state;
+	uint16_t	pind;
+	uint16_t	firstpoint;
+	uint16_t	lastpoint;
+	int		ls, cs, ns;
+	ttf_point_t	lp;
+	ttf_point_t	cp;
+	ttf_point_t	np;
+	uint16_t	addon;
+	int		cont;
+
+	if (e)
+		pind = glyph->endpoints[e - 1] + 1;
+	else
+		pind = 0;
+	firstpoint = pind;
+	lastpoint = glyph->endpoints[e];
+
+	ls = states[lastpoint];
+	ns = states[firstpoint];
+	lp = in[lastpoint];
+	np = in[firstpoint];
+
+	addon = *outind;
+	cont = 1;
+	do {
+		cs = ns;
+		cp = np;
+		pind++;
+		if (pind > lastpoint) {
+			ns = states[firstpoint];
+			np = in[firstpoint];
+			cont = 0;
+		} else {
+			ns = states[pind];
+			np = in[pind];
+		}
+		if (cs == TTF_CUBIC) {
+			if (ls != TTF_CUBIC) {
+				/* first control point of a cubic curve */
+				uint16_t	eind;
+
+				eind = cont ? pind : firstpoint;
+				eind = (eind == lastpoint) ? firstpoint : eind + 1;
+				ttf_flatten_fixed_cubic(out, outind, lp, cp, np,
+						in[eind], ttf->interpolation_level);
+			}
+		} else if (!cs) {
+			/* curve segment; points are doubled */
+			ttf_point_t	s2;
+			ttf_point_t	k2;
+			ttf_point_t	e2;
+
+			s2.x = ls ? 2*lp.x : lp.x + cp.x;
+			s2.y = ls ? 2*lp.y : lp.y + cp.y;
+			k2.x = 2*cp.x;
+			k2.y = 2*cp.y;
+			e2.x = ns ? 2*np.x : cp.x + np.x;
+			e2.y = ns ? 2*np.y : cp.y + np.y;
+			ttf_flatten_fixed(out, outind, s2, k2, e2,
+					ttf->interpolation_level);
+		} else if (ns == 1) {
+			out[(*outind)++] = cp;
+		}
+		ls = cs;
+		lp = cp;
+	} while (cont);
+	return *outind - addon;
+}
+
 /*
  * LSB == Left Side Bound
  * AW == Advance Width
  */
+void ttf_add_component(ttf_glyph_data_t* gd, const ttf_component_t* c,
+		const ttf_glyph_data_t* outline)
+{
+	int	n = gd->npoints;
+	float	dx = 0;
+	float	dy = 0;
+	int16_t	ox;
+	int16_t	oy;
+	int	j;
+
+	if (outline->npoints == 0)
+		return;
+
+	gd->px = realloc(gd->px, sizeof(int16_t) * (n + outline->npoints));
+	gd->py = realloc(gd->py, sizeof(int16_t) * (n + outline->npoints));
+	gd->state = realloc(gd->state, sizeof(int) * (n + outline->npoints));
+	gd->endpoints = realloc(gd->endpoints, sizeof(uint16_t) *
+			(gd->ncontours + outline->ncontours));
+
+	for (j = 0; j < outline->npoints; ++j) {
+		float	x = outline->px[j];
+		float	y = outline->py[j];
+		gd->px[n+j] = (int16_t) floor(c->xx * x + c->yx * y + .5f);
+		gd->py[n+j] = (int16_t) floor(c->xy * x + c->yy * y + .5f);
+	}
+
+	if (c->flags & TTF_ARGUMENTS_ARE_XY) {
+		dx = c->dx;
+		dy = c->dy;
+		if ((c->flags & TTF_SCALED_COMPONENT_OFFSET) &&
+				!(c->flags & TTF_UNSCALED_COMPONENT_OFFSET)) {
+			dx = c->xx * c->dx + c->yx * c->dy;
+			dy = c->xy * c->dx + c->yy * c->dy;
+		}
+	} else if (c->dx < n && c->dy < outline->npoints) {
+		/* move the component so that its point dy
+		 * lands on the point dx of the glyph */
+		dx = gd->px[c->dx] - gd->px[n + c->dy];
+		dy = gd->py[c->dx] - gd->py[n + c->dy];
+	}
+	ox = (int16_t) floor(dx + .5f);
+	oy = (int16_t) floor(dy + .5f);
+	for (j = 0; j < outline->npoints; ++j) {
+		gd->px[n+j] += ox;
+		gd->py[n+j] += oy;
+	}
+
+	memcpy(gd->state + n, outline->state, sizeof(int) * outline->npoints);
+	for (j = 0; j < outline->ncontours; ++j)
+		gd->endpoints[gd->ncontours + j] = outline->endpoints[j] + n;
+	gd->npoints += outline->npoints;
+	gd->ncontours += outline->ncontours;
+}
+
 void ttf_set_ls_aw(ttf_t* ttf,
 		ttf_glyph_header_t* gh,
 		ttf_glyph_data_t* gd,
@@ -1460,6 +1798,36 @@ void ttf_set_ls_aw(ttf_t* ttf,
 	gd->aw = TTF_ENDIAN_WORD(ttf->plhmtx[ttf->nhmtx-1].aw);
 }
 
+/* Returns the glyph data of a character at the current
+ * variation instance
+ */
+static ttf_glyph_data_t* ttf_chr_glyph(ttf_t* ttf, uint16_t chr)
+{
+	if (ttf->var)
+		return ttf_var_glyph(ttf, ttf->glyph_table[chr]);
+	return &ttf->glyph_data[ttf->glyph_table[chr]];
+}
+
+/* Returns the outline of a character grid-fitted at ttf->ppem, or NULL
+ * if hinting is off. The hinted glyph is a copy of glyph with the point
+ * states left by the glyph program.
+ */
+static ttf_hinted_t* ttf_chr_hinted(ttf_t* ttf, uint16_t chr,
+		ttf_glyph_data_t* glyph, ttf_glyph_data_t* hinted_glyph)
+{
+	ttf_hinted_t*	hinted;
+
+	if (!ttf->hinting || !ttf->hint)
+		return NULL;
+
+	hinted = ttf_hint_glyph(ttf, ttf->glyph_table[chr], ttf->ppem);
+	if (hinted) {
+		*hinted_glyph = *glyph;
+		hinted_glyph->state = hinted->state;
+	}
+	return hinted;
+}
+
 /*
  * Transform the interpolated coordinates to the correct unit.
  */
@@ -1476,20 +1844,85 @@ void ttf_interpolate(
 
 	vector_t*		cpoints;
 	ttf_glyph_data_t*	glyph;
+	ttf_glyph_data_t	hinted_glyph;
+	ttf_hinted_t*		hinted;
 
-	glyph = &(ttf->glyph_data[ttf->glyph_table[chr]]);
+	glyph = ttf_chr_glyph(ttf, chr);
+	hinted = ttf_chr_hinted(ttf, chr, glyph, &hinted_glyph);
+	if (hinted) glyph = &hinted_glyph;
 	cpoints = malloc(sizeof(vector_t) * glyph->npoints);
 	*points = malloc(sizeof(vector_t) * glyph->npoints * ttf->interpolation_level);
 	*endpoints = malloc(sizeof(uint16_t) * glyph->ncontours);
 
 	for (contour = 0, point = 0; contour < glyph->ncontours; contour++) {
 		for (; point <= glyph->endpoints[contour]; point++) {
+			if (hinted) {
+				/* back from pixels to font units */
+				cpoints[point].x = scale * ttf->upem *
+					(hinted->points[point].x - hinted->points[
+					 hinted->npoints - 4].x) /
+					(64.f * ttf->ppem);
+				cpoints[point].y = scale * ttf->upem *
+					hinted->points[point].y /
+					(64.f * ttf->ppem);
+				continue;
+			}
 			cpoints[point].x = scale * (glyph->px[point] - glyph->lsb);
 			cpoints[point].y = scale * glyph->py[point];
 		}
 		(*endpoints)[contour] = ttf_interpolate_chr(
-				ttf, chr, *points,
+				ttf, glyph, *points,
 				cpoints, &cpind, contour);
 	}
 	free(cpoints);
 }
+
+/*
+ * Integer version of ttf_interpolate. The flattened outline is given
+ * in 26.6 fixed point font units.
+ */
+void ttf_interpolate_fixed(
+		ttf_t*		ttf,
+		uint16_t	chr,
+		ttf_point_t**	points,
+		uint16_t**	endpoints)
+{
+	uint16_t	contour;
+	uint16_t	point;
+	uint16_t	outind = 0;
+
+	ttf_point_t*		in;
+	ttf_glyph_data_t*	glyph;
+	ttf_glyph_data_t	hinted_glyph;
+	ttf_hinted_t*		hinted;
+
+	glyph = ttf_chr_glyph(ttf, chr);
+	hinted = ttf_chr_hinted(ttf, chr, glyph, &hinted_glyph);
+	if (hinted) glyph = &hinted_glyph;
+	in = malloc(sizeof(ttf_point_t) * glyph->npoints);
+	*points = malloc(sizeof(ttf_point_t) * glyph->npoints * ttf->interpolation_level);
+	*endpoints = malloc(sizeof(uint16_t) * glyph->ncontours);
+
+	for (contour = 0, point = 0; contour < glyph->ncontours; contour++) {
+		for (; point <= glyph->endpoints[contour]; point++) {
+			if (hinted) {
+				/* back from pixels to font units */
+				in[point].x = ttf_fixed_div((int64_t)
+						(hinted->points[point].x -
+						 hinted->points[hinted->npoints
+						 - 4].x) * ttf->upem, ttf->ppem);
+				in[point].y = ttf_fixed_div((int64_t)
+						hinted->points[point].y *
+						ttf->upem, ttf->ppem);
+				continue;
+			}
+			in[point].x = (glyph->px[point] - glyph->lsb) *
+				TTF_FIXED_ONE;
+			in[point].y = glyph->py[point] * TTF_FIXED_ONE;
+		}
+		(*endpoints)[contour] = ttf_interpolate_chr_fixed(
+				ttf, glyph, *points,
+				in, &outind, contour);
+	}
+	free(in);
+}
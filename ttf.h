@@ -34,6 +34,20 @@ typedef struct ttf		ttf_t;
 typedef struct ttf_glyph_header	ttf_glyph_header_t;
 typedef struct ttf_glyph_data	ttf_glyph_data_t;
 typedef struct ttf_table_header	ttf_table_header_t;
+typedef struct ttf_point		ttf_point_t;
+typedef struct ttf_component		ttf_component_t;
+typedef struct ttf_var			ttf_var_t;
+typedef struct ttf_hint			ttf_hint_t;
+
+/* 26.6 fixed point number */
+typedef int32_t				ttf_fixed_t;
+
+#define TTF_FIXED_SHIFT	(6)
+#define TTF_FIXED_ONE	(1 << TTF_FIXED_SHIFT)
+
+/* glyph point state of cubic control points (CFF outlines)
+ * on-curve points have state 1 and quadratic control points state 0 */
+#define TTF_CUBIC	(2)
 
 /* begin API */
 ttf_t* new_ttf();
@@ -57,6 +71,17 @@ void ttf_interpolate(
 		vector_t**		points,
 		uint16_t**		endpoints,
 		float			scale);
+void ttf_interpolate_fixed(
+		ttf_t*			ttfobj,
+		uint16_t		chr,
+		ttf_point_t**		points,
+		uint16_t**		endpoints);
+
+/* Append the outline of a component to the composite glyph gd. gd
+ * starts out without points, and the component is placed as the
+ * record c says. */
+void ttf_add_component(ttf_glyph_data_t* gd, const ttf_component_t* c,
+		const ttf_glyph_data_t* outline);
 
 /* get width of a glyph */
 float ttf_char_width(ttf_t* ttfobj, uint16_t chr);
@@ -253,6 +278,41 @@ typedef struct ttf_long_hmetrics
 	int16_t		lsb;
 } ttf_lhmetrics_t;
 
+/* outline point in 26.6 fixed point font units */
+struct ttf_point
+{
+	ttf_fixed_t	x;
+	ttf_fixed_t	y;
+};
+
+/* composite glyph component flags */
+#define TTF_WORD_ARGUMENTS (0x0001)
+#define TTF_ARGUMENTS_ARE_XY (0x0002)
+#define TTF_ROUND_XY_TO_GRID (0x0004)
+#define TTF_SCALE (0x0008)
+#define TTF_RESERVED (0x0010)
+#define TTF_MORE_COMPONENTS (0x0020)
+#define TTF_XY_SCALE (0x0040)
+#define TTF_MATRIX2 (0x0080)
+#define TTF_INSTRUCTIONS (0x0100)
+#define TTF_USE_THESE_METRICS (0x0200)
+#define TTF_OVERLAP_COMPOUND (0x0400)
+#define TTF_SCALED_COMPONENT_OFFSET (0x0800)
+#define TTF_UNSCALED_COMPONENT_OFFSET (0x1000)
+
+/* component of a composite glyph */
+struct ttf_component
+{
+	uint16_t	glyph;
+	uint16_t	flags;
+	int32_t		dx;/* offset, or the matched points if the */
+	int32_t		dy;/* arguments are not x and y */
+	float		xx;/* transform, x' = xx*x + yx*y */
+	float		xy;/* and y' = xy*x + yy*y */
+	float		yx;
+	float		yy;
+};
+
 struct ttf_glyph_data
 {
 	int16_t*	px;
@@ -264,6 +324,11 @@ struct ttf_glyph_data
 	uint16_t	aw;
 	int16_t		lsb;
 	uint16_t	maxwidth;
+	uint8_t		composite;/* merged from component glyphs */
+	ttf_component_t*	components;/* of a composite glyph */
+	uint16_t	ncomponents;
+	uint8_t*	instructions;/* glyph program */
+	uint16_t	ninstructions;
 };
 
 struct ttf {
@@ -274,6 +339,8 @@ struct ttf {
 	uint16_t		ppem;
 	uint16_t		resolution;
 	uint8_t			interpolation_level;
+	int			fixed_point;/* flatten with integers, triangulate in float */
+	int			hinting;/* grid-fit outlines at ppem */
 	int				zerobase;
 	int				zerolsb;
 	uint32_t		nhmtx;
@@ -295,6 +362,18 @@ struct ttf {
 	ttf_table_header_t*	hmtx;
 	ttf_table_header_t*	loca;
 	ttf_table_header_t*	maxp;
+	ttf_table_header_t*	cff;
+	ttf_table_header_t*	fvar;
+	ttf_table_header_t*	gvar;
+	ttf_table_header_t*	avar;
+	ttf_table_header_t*	fpgm;
+	ttf_table_header_t*	prep;
+	ttf_table_header_t*	cvt;
+
+	/* font variations, NULL if the font is not variable */
+	ttf_var_t*		var;
+	/* instruction interpreter, NULL for CFF fonts */
+	ttf_hint_t*		hint;
 };
 
 #endif
@@ -0,0 +1,944 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * OpenType font variations: 'fvar', 'avar' and 'gvar' tables.
+ *
+ * The variation data of a composite glyph moves its components rather
+ * than points, so composites are merged again from their instanced
+ * components. Phantom point deltas vary the advance width and the
+ * origin of a glyph; the vertical phantom points are not used.
+ *
+ * Limitations: components matched by point numbers are placed by the
+ * instanced points, but their variation deltas are ignored.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "var.h"
+
+#define var_warn(...) fprintf(stderr, __VA_ARGS__)
+
+/* tuple variation flags */
+#define TTF_SHARED_POINT_NUMBERS	(0x8000)
+#define TTF_TUPLE_COUNT_MASK		(0x0FFF)
+#define TTF_EMBEDDED_PEAK_TUPLE		(0x8000)
+#define TTF_INTERMEDIATE_REGION		(0x4000)
+#define TTF_PRIVATE_POINT_NUMBERS	(0x2000)
+#define TTF_TUPLE_INDEX_MASK		(0x0FFF)
+
+/* packed point numbers and deltas */
+#define TTF_POINTS_ARE_WORDS		(0x80)
+#define TTF_POINT_RUN_COUNT_MASK	(0x7F)
+#define TTF_DELTAS_ARE_ZERO		(0x80)
+#define TTF_DELTAS_ARE_WORDS		(0x40)
+#define TTF_DELTA_RUN_COUNT_MASK	(0x3F)
+
+/* number of phantom points after the outline points */
+#define TTF_PHANTOM_POINTS		(4)
+
+static uint8_t* var_read_table(FILE* file, ttf_table_header_t* table);
+static uint16_t var_rd16(const uint8_t* p);
+static uint32_t var_rd32(const uint8_t* p);
+static float var_f2dot14(const uint8_t* p);
+static int var_load_avar(FILE* file, ttf_t* ttf, ttf_var_t* var);
+static int var_load_gvar(FILE* file, ttf_t* ttf, ttf_var_t* var);
+static float var_normalize(ttf_var_t* var, int axis, float v);
+static float var_tuple_scalar(ttf_var_t* var, const float* peak,
+		const uint8_t* start, const uint8_t* end);
+static const uint8_t* var_unpack_points(const uint8_t* p,
+		const uint8_t* end, uint16_t** points, int* npoints);
+static const uint8_t* var_unpack_deltas(const uint8_t* p,
+		const uint8_t* end, float* deltas, int count);
+static void var_iup(ttf_glyph_data_t* glyph, const uint8_t* touched,
+		float* dx, float* dy);
+static float var_infer(float x, float x1, float x2, float d1, float d2);
+static void var_accumulate(float* restrict accx, float* restrict accy,
+		const float* restrict dx, const float* restrict dy,
+		float scalar, int n);
+static int var_deltas(ttf_var_t* var, ttf_glyph_data_t* glyph, int n,
+		const uint8_t* data, uint32_t len, float* accx, float* accy);
+static void var_compose(ttf_t* ttf, ttf_glyph_data_t* base,
+		const float* accx, const float* accy, ttf_glyph_data_t* out);
+static void var_free_entry(ttf_var_entry_t* entry);
+static int16_t var_round(float v);
+
+int ttf_var_load(FILE* file, ttf_t* ttf)
+{
+	ttf_var_t*	var;
+	uint8_t*	fvar;
+	uint32_t	len = ttf->fvar->length;
+	uint16_t	axes_offset;
+	uint16_t	axis_size;
+	uint16_t	instance_size;
+	int		i;
+	int		j;
+
+	fvar = var_read_table(file, ttf->fvar);
+	if (!fvar)
+		return 1;
+
+	if (len < 16) {
+		free(fvar);
+		return 1;
+	}
+
+	var = calloc(1, sizeof(ttf_var_t));
+	axes_offset = var_rd16(fvar+4);
+	var->naxes = var_rd16(fvar+8);
+	axis_size = var_rd16(fvar+10);
+	var->nnamed = var_rd16(fvar+12);
+	instance_size = var_rd16(fvar+14);
+
+	if (var->naxes == 0 || axis_size < 20 ||
+			axes_offset + var->naxes * axis_size > len) {
+		free(fvar);
+		free_ttf_var(&var);
+		return 1;
+	}
+
+	var->axes = malloc(sizeof(ttf_var_axis_t) * var->naxes);
+	for (i = 0; i < var->naxes; ++i) {
+		const uint8_t*	axis = fvar + axes_offset + i * axis_size;
+		var->axes[i].tag = var_rd32(axis);
+		var->axes[i].min = (int32_t) var_rd32(axis+4) / 65536.f;
+		var->axes[i].def = (int32_t) var_rd32(axis+8) / 65536.f;
+		var->axes[i].max = (int32_t) var_rd32(axis+12) / 65536.f;
+	}
+
+	/* named instances follow the axis records */
+	if (instance_size < 4 + 4 * var->naxes ||
+			axes_offset + var->naxes * axis_size +
+			var->nnamed * instance_size > len)
+		var->nnamed = 0;
+	var->named = malloc(sizeof(float) * (var->nnamed * var->naxes + 1));
+	for (i = 0; i < var->nnamed; ++i) {
+		const uint8_t*	inst = fvar + axes_offset +
+			var->naxes * axis_size + i * instance_size + 4;
+		for (j = 0; j < var->naxes; ++j)
+			var->named[i * var->naxes + j] =
+				(int32_t) var_rd32(inst + j*4) / 65536.f;
+	}
+	free(fvar);
+
+	if (ttf->avar && var_load_avar(file, ttf, var))
+		var_warn("Warning: invalid 'avar' table ignored\n");
+
+	if (var_load_gvar(file, ttf, var)) {
+		free_ttf_var(&var);
+		return 1;
+	}
+
+	var->coords = calloc(var->naxes, sizeof(float));
+	var->icoords = calloc(var->naxes * TTF_VAR_MAX_INSTANCES,
+			sizeof(float));
+	var->instance = 0;
+	var->next_id = 1;
+
+	ttf->var = var;
+	return 0;
+}
+
+void free_ttf_var(ttf_var_t** var)
+{
+	ttf_var_t*	p;
+	int		i;
+
+	assert(var != NULL);
+
+	p = *var;
+	if (!p) return;
+
+	for (i = 0; i < TTF_VAR_CACHE_SIZE; ++i)
+		var_free_entry(&p->cache[i]);
+	if (p->maps) {
+		for (i = 0; i < p->naxes; ++i)
+			free(p->maps[i]);
+		free(p->maps);
+		free(p->nmaps);
+	}
+	free(p->axes);
+	free(p->named);
+	free(p->gvar);
+	free(p->shared);
+	free(p->offsets);
+	free(p->coords);
+	free(p->icoords);
+	free(p);
+	*var = NULL;
+}
+
+int ttf_var_axis_count(ttf_t* ttf)
+{
+	return ttf->var ? ttf->var->naxes : 0;
+}
+
+const ttf_var_axis_t* ttf_var_axis(ttf_t* ttf, int axis)
+{
+	if (!ttf->var || axis < 0 || axis >= ttf->var->naxes)
+		return NULL;
+	return &ttf->var->axes[axis];
+}
+
+void ttf_set_variation(ttf_t* ttf, const float* coords)
+{
+	ttf_var_t*	var = ttf->var;
+	int		is_default = 1;
+	int		slot;
+	int		i;
+
+	if (!var)
+		return;
+
+	for (i = 0; i < var->naxes; ++i) {
+		var->coords[i] = coords ? var_normalize(var, i, coords[i]) : 0;
+		if (var->coords[i] != 0)
+			is_default = 0;
+	}
+
+	if (is_default) {
+		var->instance = 0;
+		return;
+	}
+
+	/* reuse the id of a recent instance at the same location
+	 * so that its cached glyphs are found again */
+	for (i = 0; i < TTF_VAR_MAX_INSTANCES; ++i) {
+		if (var->ids[i] && !memcmp(var->icoords + i * var->naxes,
+					var->coords,
+					sizeof(float) * var->naxes)) {
+			var->instance = var->ids[i];
+			return;
+		}
+	}
+
+	slot = var->next_id % TTF_VAR_MAX_INSTANCES;
+	var->ids[slot] = var->next_id;
+	memcpy(var->icoords + slot * var->naxes, var->coords,
+			sizeof(float) * var->naxes);
+	var->instance = var->next_id++;
+}
+
+int ttf_set_named_instance(ttf_t* ttf, int instance)
+{
+	if (!ttf->var || instance < 0 || instance >= ttf->var->nnamed)
+		return 1;
+
+	ttf_set_variation(ttf, ttf->var->named +
+			instance * ttf->var->naxes);
+	return 0;
+}
+
+ttf_glyph_data_t* ttf_var_glyph(ttf_t* ttf, uint16_t i)
+{
+	ttf_var_t*		var = ttf->var;
+	ttf_glyph_data_t*	base = &ttf->glyph_data[i];
+	ttf_glyph_data_t	data;
+	ttf_var_entry_t*	entry;
+	uint32_t		offset;
+	uint32_t		len;
+	float*			accx;
+	float*			accy;
+	int			n;
+	int			j;
+
+	if (!var || !var->instance || base->npoints == 0 ||
+			i >= var->glyph_count)
+		return base;
+
+	/* a composite moves with its components even if
+	 * it has no variation data of its own */
+	offset = var->offsets[i];
+	len = var->offsets[i+1] - offset;
+	if (len == 0 && !base->composite)
+		return base;
+
+	entry = &var->cache[(i + var->instance * 17) &
+		(TTF_VAR_CACHE_SIZE - 1)];
+	if (entry->instance == var->instance && entry->glyph == i)
+		return &entry->data;
+
+	n = base->composite ? base->ncomponents : base->npoints;
+	accx = calloc(n + TTF_PHANTOM_POINTS, sizeof(float));
+	accy = calloc(n + TTF_PHANTOM_POINTS, sizeof(float));
+	if (len && var_deltas(var, base, n, var->gvar + offset, len,
+				accx, accy)) {
+		var_warn("Warning: invalid variation data for glyph %d\n", i);
+		memset(accx, 0, sizeof(float) * (n + TTF_PHANTOM_POINTS));
+		memset(accy, 0, sizeof(float) * (n + TTF_PHANTOM_POINTS));
+	}
+
+	/* the origin and the advance are the first two phantom points */
+	data = *base;
+	data.lsb = var_round(base->lsb + accx[n]);
+	data.aw = var_round(base->lsb + base->aw + accx[n+1]) - data.lsb;
+	if (base->composite) {
+		/* requesting the components may replace any cache
+		 * entry, so the entry is only filled once they
+		 * are merged */
+		var_compose(ttf, base, accx, accy, &data);
+	} else {
+		data.px = malloc(sizeof(int16_t) * n);
+		data.py = malloc(sizeof(int16_t) * n);
+		for (j = 0; j < n; ++j) {
+			data.px[j] = var_round(base->px[j] + accx[j]);
+			data.py[j] = var_round(base->py[j] + accy[j]);
+		}
+	}
+	free(accx);
+	free(accy);
+
+	var_free_entry(entry);
+	entry->data = data;
+	entry->glyph = i;
+	entry->instance = var->instance;
+	return &entry->data;
+}
+
+/* Merge the instanced components of a composite glyph into out, with
+ * the component offsets moved by the deltas in accx and accy, and keep
+ * the moved component records for the hinter
+ */
+static void var_compose(ttf_t* ttf, ttf_glyph_data_t* base,
+		const float* accx, const float* accy, ttf_glyph_data_t* out)
+{
+	int	k;
+
+	out->components = malloc(sizeof(ttf_component_t) *
+			base->ncomponents);
+	out->npoints = 0;
+	out->ncontours = 0;
+	out->px = NULL;
+	out->py = NULL;
+	out->state = NULL;
+	out->endpoints = NULL;
+
+	for (k = 0; k < base->ncomponents; ++k) {
+		ttf_component_t		c = base->components[k];
+		ttf_glyph_data_t*	outline;
+
+		if (c.flags & TTF_ARGUMENTS_ARE_XY) {
+			c.dx = var_round(c.dx + accx[k]);
+			c.dy = var_round(c.dy + accy[k]);
+		}
+		out->components[k] = c;
+		/* the outline stays valid until the next glyph is
+		 * requested, so it is merged right away */
+		outline = ttf_var_glyph(ttf, c.glyph);
+		ttf_add_component(out, &c, outline);
+		if (c.flags & TTF_USE_THESE_METRICS) {
+			out->aw = outline->aw;
+			out->lsb = outline->lsb;
+		}
+	}
+}
+
+/* Free the outline of a cache entry, a composite entry also owns its
+ * contours and component records
+ */
+static void var_free_entry(ttf_var_entry_t* entry)
+{
+	free(entry->data.px);
+	free(entry->data.py);
+	if (entry->data.composite) {
+		free(entry->data.state);
+		free(entry->data.endpoints);
+		free(entry->data.components);
+	}
+	entry->data.px = NULL;
+	entry->data.py = NULL;
+	entry->data.composite = 0;
+	entry->instance = 0;
+}
+
+static uint8_t* var_read_table(FILE* file, ttf_table_header_t* table)
+{
+	uint8_t*	buf;
+
+	if (-1 == fseek(file, table->offset, SEEK_SET))
+		return NULL;
+
+	buf = malloc(table->length ? table->length : 1);
+	if (table->length && 1 != fread(buf, table->length, 1, file)) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static uint16_t var_rd16(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t var_rd32(const uint8_t* p)
+{
+	return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static float var_f2dot14(const uint8_t* p)
+{
+	return (int16_t) var_rd16(p) / 16384.f;
+}
+
+/* Load 'avar' table - axis variations
+ *
+ * Returns 1 on error
+ */
+static int var_load_avar(FILE* file, ttf_t* ttf, ttf_var_t* var)
+{
+	uint8_t*	avar;
+	uint32_t	len = ttf->avar->length;
+	uint32_t	pos = 8;
+	int		i;
+	int		j;
+
+	avar = var_read_table(file, ttf->avar);
+	if (!avar)
+		return 1;
+
+	if (len < 8 || var_rd16(avar+6) != var->naxes) {
+		free(avar);
+		return 1;
+	}
+
+	var->nmaps = calloc(var->naxes, sizeof(int));
+	var->maps = calloc(var->naxes, sizeof(float*));
+	for (i = 0; i < var->naxes; ++i) {
+		int	n;
+
+		if (pos + 2 > len)
+			break;
+		n = var_rd16(avar+pos);
+		pos += 2;
+		if (pos + n*4 > len)
+			break;
+
+		var->nmaps[i] = n;
+		var->maps[i] = malloc(sizeof(float) * 2 * (n + 1));
+		for (j = 0; j < n; ++j) {
+			var->maps[i][j*2] = var_f2dot14(avar+pos);
+			var->maps[i][j*2+1] = var_f2dot14(avar+pos+2);
+			pos += 4;
+		}
+	}
+	free(avar);
+
+	if (i < var->naxes) {
+		for (i = 0; i < var->naxes; ++i)
+			free(var->maps[i]);
+		free(var->maps);
+		free(var->nmaps);
+		var->maps = NULL;
+		var->nmaps = NULL;
+		return 1;
+	}
+	return 0;
+}
+
+/* Load 'gvar' table - glyph variations
+ *
+ * The table is kept in memory, the variation data of a glyph is
+ * decoded when the glyph is first requested at an instance.
+ *
+ * Returns 1 on error
+ */
+static int var_load_gvar(FILE* file, ttf_t* ttf, ttf_var_t* var)
+{
+	uint8_t*	gvar;
+	uint32_t	len = ttf->gvar->length;
+	uint32_t	shared_offset;
+	uint32_t	data_offset;
+	int		long_offsets;
+	int		i;
+
+	gvar = var_read_table(file, ttf->gvar);
+	if (!gvar)
+		return 1;
+
+	var->gvar = gvar;
+	var->gvar_len = len;
+	if (len < 20 || var_rd16(gvar+4) != var->naxes)
+		return 1;
+
+	var->nshared = var_rd16(gvar+6);
+	shared_offset = var_rd32(gvar+8);
+	var->glyph_count = var_rd16(gvar+12);
+	long_offsets = var_rd16(gvar+14) & 1;
+	data_offset = var_rd32(gvar+16);
+
+	if (var->glyph_count > ttf->nglyphs)
+		var->glyph_count = ttf->nglyphs;
+
+	if (shared_offset > len || var->nshared * var->naxes * 2 >
+			len - shared_offset)
+		return 1;
+	if (20 + (var->glyph_count + 1) * (long_offsets ? 4 : 2) > len)
+		return 1;
+
+	var->shared = malloc(sizeof(float) *
+			(var->nshared * var->naxes + 1));
+	for (i = 0; i < var->nshared * var->naxes; ++i)
+		var->shared[i] = var_f2dot14(gvar + shared_offset + i*2);
+
+	var->offsets = malloc(sizeof(uint32_t) * (var->glyph_count + 1));
+	for (i = 0; i <= var->glyph_count; ++i) {
+		uint32_t	offset;
+
+		if (long_offsets)
+			offset = var_rd32(gvar + 20 + i*4);
+		else
+			offset = var_rd16(gvar + 20 + i*2) * 2;
+		var->offsets[i] = data_offset + offset;
+
+		if (var->offsets[i] > len ||
+				(i && var->offsets[i] < var->offsets[i-1]))
+			return 1;
+	}
+	return 0;
+}
+
+/* Map a user coordinate to the normalized range [-1, 1]
+ */
+static float var_normalize(ttf_var_t* var, int axis, float v)
+{
+	ttf_var_axis_t*	a = &var->axes[axis];
+	float		n = 0;
+
+	if (v < a->min) v = a->min;
+	if (v > a->max) v = a->max;
+
+	if (v < a->def && a->def > a->min)
+		n = (v - a->def) / (a->def - a->min);
+	else if (v > a->def && a->max > a->def)
+		n = (v - a->def) / (a->max - a->def);
+
+	if (var->maps && var->nmaps[axis] > 1) {
+		float*	map = var->maps[axis];
+		int	k;
+
+		for (k = 1; k < var->nmaps[axis]; ++k) {
+			float	x1 = map[(k-1)*2];
+			float	x2 = map[k*2];
+
+			if (n <= x2) {
+				if (x2 > x1)
+					n = map[(k-1)*2+1] + (n - x1) *
+						(map[k*2+1] - map[(k-1)*2+1]) /
+						(x2 - x1);
+				else
+					n = map[k*2+1];
+				break;
+			}
+		}
+	}
+
+	/* round to F2DOT14 precision */
+	return var_round(n * 16384.f) / 16384.f;
+}
+
+/* Returns the scalar for a tuple variation at the current instance
+ */
+static float var_tuple_scalar(ttf_var_t* var, const float* peak,
+		const uint8_t* start, const uint8_t* end)
+{
+	float	scalar = 1;
+	int	i;
+
+	for (i = 0; i < var->naxes; ++i) {
+		float	p = peak[i];
+		float	v = var->coords[i];
+
+		if (p == 0)
+			continue;
+		if (v == 0)
+			return 0;
+
+		if (start) {
+			float	s = var_f2dot14(start + i*2);
+			float	e = var_f2dot14(end + i*2);
+
+			if (s > p || p > e || (s < 0 && e > 0))
+				continue;
+			if (v < s || v > e)
+				return 0;
+			if (v < p)
+				scalar *= (v - s) / (p - s);
+			else if (v > p)
+				scalar *= (e - v) / (e - p);
+		} else {
+			if ((p < 0 && (v < p || v > 0)) ||
+					(p > 0 && (v > p || v < 0)))
+				return 0;
+			scalar *= v / p;
+		}
+	}
+	return scalar;
+}
+
+/* Unpack a set of point numbers. npoints is set to -1 if
+ * all points are referenced.
+ *
+ * Returns the position after the point numbers, or NULL on error
+ */
+static const uint8_t* var_unpack_points(const uint8_t* p,
+		const uint8_t* end, uint16_t** points, int* npoints)
+{
+	uint16_t	last = 0;
+	int		count;
+	int		i = 0;
+
+	if (p >= end)
+		return NULL;
+
+	count = *p++;
+	if (count & 0x80) {
+		if (p >= end)
+			return NULL;
+		count = ((count & 0x7F) << 8) | *p++;
+	}
+
+	if (count == 0) {
+		*npoints = -1;
+		return p;
+	}
+
+	*points = realloc(*points, sizeof(uint16_t) * count);
+	while (i < count) {
+		int	words;
+		int	run;
+		int	j;
+
+		if (p >= end)
+			return NULL;
+		words = *p & TTF_POINTS_ARE_WORDS;
+		run = (*p++ & TTF_POINT_RUN_COUNT_MASK) + 1;
+		if (end - p < run * (words ? 2 : 1))
+			return NULL;
+
+		for (j = 0; j < run && i < count; ++j) {
+			if (words) {
+				last += var_rd16(p);
+				p += 2;
+			} else {
+				last += *p++;
+			}
+			(*points)[i++] = last;
+		}
+	}
+	*npoints = count;
+	return p;
+}
+
+/* Unpack count packed deltas
+ *
+ * Returns the position after the deltas, or NULL on error
+ */
+static const uint8_t* var_unpack_deltas(const uint8_t* p,
+		const uint8_t* end, float* deltas, int count)
+{
+	int	i = 0;
+
+	while (i < count) {
+		int	ctrl;
+		int	run;
+		int	j;
+
+		if (p >= end)
+			return NULL;
+		ctrl = *p++;
+		run = (ctrl & TTF_DELTA_RUN_COUNT_MASK) + 1;
+		if (i + run > count)
+			return NULL;
+
+		if (ctrl & TTF_DELTAS_ARE_ZERO) {
+			for (j = 0; j < run; ++j)
+				deltas[i++] = 0;
+		} else if (ctrl & TTF_DELTAS_ARE_WORDS) {
+			if (end - p < run*2)
+				return NULL;
+			for (j = 0; j < run; ++j, p += 2)
+				deltas[i++] = (int16_t) var_rd16(p);
+		} else {
+			if (end - p < run)
+				return NULL;
+			for (j = 0; j < run; ++j)
+				deltas[i++] = (int8_t) *p++;
+		}
+	}
+	return p;
+}
+
+/* Interpolate the deltas of untouched points from the touched
+ * points before and after them on the same contour
+ */
+static void var_iup(ttf_glyph_data_t* glyph, const uint8_t* touched,
+		float* dx, float* dy)
+{
+	int	start = 0;
+	int	c;
+
+	for (c = 0; c < glyph->ncontours; ++c) {
+		int	end = glyph->endpoints[c];
+		int	first = -1;
+		int	t1;
+
+		for (t1 = start; t1 <= end; ++t1) {
+			if (touched[t1]) {
+				first = t1;
+				break;
+			}
+		}
+
+		if (first != -1) {
+			t1 = first;
+			do {
+				int	t2 = t1;
+				int	j;
+
+				/* find the next touched point */
+				do {
+					t2 = (t2 == end) ? start : t2 + 1;
+				} while (!touched[t2]);
+
+				for (j = (t1 == end) ? start : t1 + 1; j != t2;
+						j = (j == end) ? start : j + 1) {
+					dx[j] = var_infer(glyph->px[j],
+							glyph->px[t1],
+							glyph->px[t2],
+							dx[t1], dx[t2]);
+					dy[j] = var_infer(glyph->py[j],
+							glyph->py[t1],
+							glyph->py[t2],
+							dy[t1], dy[t2]);
+				}
+				t1 = t2;
+			} while (t1 != first);
+		}
+		start = end + 1;
+	}
+}
+
+/* Infer the delta of a point at x from two touched points
+ */
+static float var_infer(float x, float x1, float x2, float d1, float d2)
+{
+	if (x1 == x2)
+		return (d1 == d2) ? d1 : 0;
+
+	if (x1 > x2) {
+		float	t;
+		t = x1; x1 = x2; x2 = t;
+		t = d1; d1 = d2; d2 = t;
+	}
+
+	if (x <= x1)
+		return d1;
+	else if (x >= x2)
+		return d2;
+	else
+		return d1 + (x - x1) * (d2 - d1) / (x2 - x1);
+}
+
+/* Add the scaled deltas of one tuple variation to the accumulated deltas
+ *
+ * This is the innermost loop of instancing: it runs for every point of
+ * every applicable region. It is kept free of branches and aliasing so
+ * that the compiler can vectorize it.
+ */
+static void var_accumulate(float* restrict accx, float* restrict accy,
+		const float* restrict dx, const float* restrict dy,
+		float scalar, int n)
+{
+	int	i;
+
+	for (i = 0; i < n; ++i) {
+		accx[i] += scalar * dx[i];
+		accy[i] += scalar * dy[i];
+	}
+}
+
+/* Add up the deltas of the glyph variation data at the current
+ * instance. The n points are the outline points of a simple glyph or
+ * the component offsets of a composite, and the phantom points follow
+ * them in accx and accy.
+ *
+ * Returns 1 on error
+ */
+static int var_deltas(ttf_var_t* var, ttf_glyph_data_t* glyph, int n,
+		const uint8_t* data, uint32_t len, float* accx, float* accy)
+{
+	const uint8_t*	end = data + len;
+	const uint8_t*	header;
+	const uint8_t*	serialized;
+	int		ntotal = n + TTF_PHANTOM_POINTS;
+	float*		dx;
+	float*		dy;
+	float*		tx = NULL;
+	float*		ty = NULL;
+	float*		embedded;
+	int		size = 0;
+	uint8_t*	touched;
+	uint16_t*	shared_points = NULL;
+	uint16_t*	points = NULL;
+	int		nshared_points = -1;
+	int		ntuples;
+	int		err = 1;
+	int		i;
+	int		t;
+
+	if (len < 4)
+		return 1;
+
+	ntuples = var_rd16(data) & TTF_TUPLE_COUNT_MASK;
+	header = data + 4;
+	serialized = data + var_rd16(data+2);
+	if (serialized > end)
+		return 1;
+
+	dx = malloc(sizeof(float) * ntotal);
+	dy = malloc(sizeof(float) * ntotal);
+	embedded = malloc(sizeof(float) * var->naxes);
+	touched = malloc(ntotal);
+
+	if (var_rd16(data) & TTF_SHARED_POINT_NUMBERS) {
+		serialized = var_unpack_points(serialized, end,
+				&shared_points, &nshared_points);
+		if (!serialized)
+			goto done;
+	}
+
+	for (t = 0; t < ntuples; ++t) {
+		const uint8_t*	next;
+		const uint8_t*	p;
+		const uint8_t*	start = NULL;
+		const uint8_t*	stop = NULL;
+		const float*	peak;
+		uint16_t	index;
+		uint16_t*	tpoints;
+		int		npoints;
+		int		count;
+		float		scalar;
+
+		if (end - header < 4)
+			goto done;
+		next = serialized + var_rd16(header);
+		index = var_rd16(header+2);
+		header += 4;
+		if (next > end)
+			goto done;
+
+		if (index & TTF_EMBEDDED_PEAK_TUPLE) {
+			if (end - header < var->naxes*2)
+				goto done;
+			for (i = 0; i < var->naxes; ++i)
+				embedded[i] = var_f2dot14(header + i*2);
+			header += var->naxes*2;
+			peak = embedded;
+		} else {
+			if ((index & TTF_TUPLE_INDEX_MASK) >= var->nshared)
+				goto done;
+			peak = var->shared + (index & TTF_TUPLE_INDEX_MASK) *
+				var->naxes;
+		}
+		if (index & TTF_INTERMEDIATE_REGION) {
+			if (end - header < var->naxes*4)
+				goto done;
+			start = header;
+			stop = header + var->naxes*2;
+			header += var->naxes*4;
+		}
+
+		scalar = var_tuple_scalar(var, peak, start, stop);
+		if (scalar == 0) {
+			serialized = next;
+			continue;
+		}
+
+		p = serialized;
+		if (index & TTF_PRIVATE_POINT_NUMBERS) {
+			p = var_unpack_points(p, next, &points, &npoints);
+			if (!p)
+				goto done;
+			tpoints = points;
+		} else {
+			npoints = nshared_points;
+			tpoints = shared_points;
+		}
+
+		count = (npoints == -1) ? ntotal : npoints;
+		if (count > size) {
+			size = count;
+			tx = realloc(tx, sizeof(float) * size);
+			ty = realloc(ty, sizeof(float) * size);
+		}
+		p = var_unpack_deltas(p, next, tx, count);
+		if (!p || !var_unpack_deltas(p, next, ty, count))
+			goto done;
+
+		if (npoints == -1) {
+			memcpy(dx, tx, sizeof(float) * ntotal);
+			memcpy(dy, ty, sizeof(float) * ntotal);
+		} else {
+			memset(touched, 0, ntotal);
+			for (i = 0; i < ntotal; ++i)
+				dx[i] = dy[i] = 0;
+			for (i = 0; i < npoints; ++i) {
+				if (tpoints[i] < ntotal) {
+					dx[tpoints[i]] = tx[i];
+					dy[tpoints[i]] = ty[i];
+					touched[tpoints[i]] = 1;
+				}
+			}
+			/* the deltas of untouched components and
+			 * phantom points are zero */
+			if (!glyph->composite)
+				var_iup(glyph, touched, dx, dy);
+		}
+
+		var_accumulate(accx, accy, dx, dy, scalar, ntotal);
+		serialized = next;
+	}
+	err = 0;
+
+done:
+	free(dx);
+	free(dy);
+	free(tx);
+	free(ty);
+	free(embedded);
+	free(touched);
+	free(shared_points);
+	free(points);
+	return err;
+}
+
+/* Round half up
+ */
+static int16_t var_round(float v)
+{
+	int	r = (int) v;
+
+	if (r > v)
+		r -= 1;
+	if (v - r >= .5f)
+		r += 1;
+	return (int16_t) r;
+}
+
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2011 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CTTF_VAR_H
+#define CTTF_VAR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ttf.h"
+
+/* number of cached glyph instances (must be a power of two) */
+#define TTF_VAR_CACHE_SIZE	(64)
+/* number of remembered instance locations */
+#define TTF_VAR_MAX_INSTANCES	(8)
+
+typedef struct ttf_var_axis	ttf_var_axis_t;
+typedef struct ttf_var_entry	ttf_var_entry_t;
+
+/* variation axis from the 'fvar' table, in user coordinates */
+struct ttf_var_axis {
+	uint32_t	tag;
+	float		min;
+	float		def;
+	float		max;
+};
+
+/* a glyph outline instantiated at some location in the design space */
+struct ttf_var_entry {
+	uint16_t		glyph;
+	uint32_t		instance;
+	ttf_glyph_data_t	data;
+};
+
+struct ttf_var {
+	ttf_var_axis_t*	axes;
+	int		naxes;
+
+	/* 'avar' segment maps, NULL if there is no 'avar' table */
+	int*		nmaps;
+	float**		maps;
+
+	/* named instances (user coordinates) */
+	float*		named;
+	int		nnamed;
+
+	/* the 'gvar' table */
+	uint8_t*	gvar;
+	uint32_t	gvar_len;
+	float*		shared;/* shared peak tuples */
+	int		nshared;
+	uint32_t*	offsets;/* glyph variation data offsets */
+	uint16_t	glyph_count;
+
+	/* the current instance in normalized coordinates */
+	float*		coords;
+	uint32_t	instance;/* 0 is the default instance */
+
+	/* recently selected instances */
+	float*		icoords;
+	uint32_t	ids[TTF_VAR_MAX_INSTANCES];
+	uint32_t	next_id;
+
+	ttf_var_entry_t	cache[TTF_VAR_CACHE_SIZE];
+};
+
+/* Load the 'fvar', 'avar' and 'gvar' tables
+ *
+ * Returns 1 on error
+ */
+int ttf_var_load(FILE* file, ttf_t* ttf);
+void free_ttf_var(ttf_var_t** var);
+
+/* Returns the number of variation axes (0 if the font is not variable)
+ */
+int ttf_var_axis_count(ttf_t* ttf);
+const ttf_var_axis_t* ttf_var_axis(ttf_t* ttf, int axis);
+
+/* Select the instance at the given user coordinates, one per axis.
+ * A NULL coordinate array selects the default instance.
+ */
+void ttf_set_variation(ttf_t* ttf, const float* coords);
+
+/* Select one of the named instances from the 'fvar' table
+ *
+ * Returns 1 if there is no such instance
+ */
+int ttf_set_named_instance(ttf_t* ttf, int instance);
+
+/* Returns the glyph data of glyph i at the current instance
+ *
+ * The points and the metrics differ from ttf->glyph_data[i], and a
+ * composite glyph also has its own contours. The returned glyph is
+ * cached per (glyph, instance) and stays valid until another glyph is
+ * requested.
+ */
+ttf_glyph_data_t* ttf_var_glyph(ttf_t* ttf, uint16_t i);
+
+#endif
+
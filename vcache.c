@@ -0,0 +1,324 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Vertex cache optimization
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcache.h"
+
+/* the scoring parameters suggested by Forsyth */
+#define CACHE_DECAY_POWER	(1.5f)
+#define LAST_TRI_SCORE		(0.75f)
+#define VALENCE_BOOST_SCALE	(2.0f)
+#define VALENCE_BOOST_POWER	(0.5f)
+
+/* Build the lists of triangles around each vertex. The triangles of
+ * vertex v are tris[offset[v]] to tris[offset[v+1]-1], offset has
+ * nvec+1 entries and tris has 3*ntri.
+ */
+static void build_adjacency(mesh_t* mesh, int* offset, int* tris)
+{
+	int*	fill;
+	int	i;
+
+	memset(offset, 0, sizeof(int) * (mesh->nvec + 1));
+	for (i = 0; i < 3 * mesh->ntri; ++i)
+		offset[mesh_index(mesh, i) + 1] += 1;
+	for (i = 0; i < mesh->nvec; ++i)
+		offset[i+1] += offset[i];
+
+	fill = malloc(sizeof(int) * (mesh->nvec + 1));
+	memcpy(fill, offset, sizeof(int) * (mesh->nvec + 1));
+	for (i = 0; i < 3 * mesh->ntri; ++i)
+		tris[fill[mesh_index(mesh, i)]++] = i / 3;
+	free(fill);
+}
+
+/* Score of a vertex at cache_pos (-1 if not cached) that is used by
+ * remaining triangles not yet added
+ */
+static float vertex_score(int cache_pos, int remaining)
+{
+	float	score = 0;
+
+	if (remaining == 0)
+		return -1;
+	if (cache_pos >= 0) {
+		if (cache_pos < 3) {
+			/* the vertices of the last triangle */
+			score = LAST_TRI_SCORE;
+		} else {
+			float	scale = 1.0f / (VCACHE_SIZE - 3);
+			score = powf(1 - (cache_pos - 3) * scale,
+					CACHE_DECAY_POWER);
+		}
+	}
+	return score + VALENCE_BOOST_SCALE *
+		powf((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+void optimize_vertex_cache(mesh_t* mesh)
+{
+	int*		offset;
+	int*		tris;
+	int*		remaining;/* triangles of each vertex not yet added */
+	int*		cache_pos;
+	float*		vscore;
+	float*		tscore;
+	char*		added;
+	uint32_t*	order;
+	int		cache[VCACHE_SIZE + 3];
+	int		ncache = 0;
+	int		cursor = 0;
+	int		best = 0;
+	int		i;
+	int		k;
+
+	assert(mesh != NULL);
+	if (mesh->ntri < 2)
+		return;
+
+	offset = malloc(sizeof(int) * (mesh->nvec + 1));
+	tris = malloc(sizeof(int) * 3 * mesh->ntri);
+	remaining = malloc(sizeof(int) * mesh->nvec);
+	cache_pos = malloc(sizeof(int) * mesh->nvec);
+	vscore = malloc(sizeof(float) * mesh->nvec);
+	tscore = malloc(sizeof(float) * mesh->ntri);
+	added = calloc(mesh->ntri, 1);
+	order = malloc(sizeof(uint32_t) * 3 * mesh->ntri);
+
+	build_adjacency(mesh, offset, tris);
+	for (i = 0; i < mesh->nvec; ++i) {
+		remaining[i] = offset[i+1] - offset[i];
+		cache_pos[i] = -1;
+		vscore[i] = vertex_score(-1, remaining[i]);
+	}
+	for (i = 0; i < mesh->ntri; ++i) {
+		tscore[i] = vscore[mesh_index(mesh, 3*i)] +
+			vscore[mesh_index(mesh, 3*i+1)] +
+			vscore[mesh_index(mesh, 3*i+2)];
+		if (tscore[i] > tscore[best])
+			best = i;
+	}
+
+	for (k = 0; k < mesh->ntri; ++k) {
+		int	next[VCACHE_SIZE + 3];
+		int	nnext = 0;
+		float	best_score = -1;
+
+		if (best < 0) {
+			/* no cached vertex has triangles left, take the
+			 * first triangle that is not added yet */
+			while (added[cursor])
+				cursor += 1;
+			best = cursor;
+		}
+		added[best] = 1;
+
+		/* add the triangle and remove it from the lists of its
+		 * vertices, which keep the remaining triangles first */
+		for (i = 0; i < 3; ++i) {
+			int	v = mesh_index(mesh, 3*best + i);
+			int*	list = &tris[offset[v]];
+			int	j = 0;
+
+			order[3*k + i] = v;
+			while (list[j] != best)
+				j += 1;
+			list[j] = list[remaining[v] - 1];
+			list[remaining[v] - 1] = best;
+			remaining[v] -= 1;
+			next[nnext++] = v;
+		}
+
+		/* move the vertices of the triangle to the front of the
+		 * cache, vertices pushed past the end are evicted */
+		for (i = 0; i < ncache; ++i) {
+			int	v = cache[i];
+			if (v != next[0] && v != next[1] && v != next[2])
+				next[nnext++] = v;
+		}
+		for (i = 0; i < nnext; ++i) {
+			int	v = next[i];
+			cache_pos[v] = i < VCACHE_SIZE ? i : -1;
+			vscore[v] = vertex_score(cache_pos[v], remaining[v]);
+		}
+		ncache = nnext < VCACHE_SIZE ? nnext : VCACHE_SIZE;
+		memcpy(cache, next, sizeof(int) * ncache);
+
+		/* rescore the remaining triangles of the touched vertices
+		 * and pick the best one */
+		best = -1;
+		for (i = 0; i < nnext; ++i) {
+			int	v = next[i];
+			int	j;
+
+			for (j = 0; j < remaining[v]; ++j) {
+				int	t = tris[offset[v] + j];
+				tscore[t] = vscore[mesh_index(mesh, 3*t)] +
+					vscore[mesh_index(mesh, 3*t+1)] +
+					vscore[mesh_index(mesh, 3*t+2)];
+				if (tscore[t] > best_score) {
+					best_score = tscore[t];
+					best = t;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < 3 * mesh->ntri; ++i)
+		mesh_set_index(mesh, i, order[i]);
+
+	free(offset);
+	free(tris);
+	free(remaining);
+	free(cache_pos);
+	free(vscore);
+	free(tscore);
+	free(added);
+	free(order);
+}
+
+float mesh_acmr(mesh_t* mesh, int cache_size)
+{
+	int*	stamp;/* number of misses when each vertex was loaded */
+	int	misses = 0;
+	int	i;
+
+	assert(mesh != NULL);
+	if (mesh->ntri == 0)
+		return 0;
+
+	stamp = malloc(sizeof(int) * (mesh->nvec > 0 ? mesh->nvec : 1));
+	for (i = 0; i < mesh->nvec; ++i)
+		stamp[i] = -cache_size - 1;
+	for (i = 0; i < 3 * mesh->ntri; ++i) {
+		uint32_t	v = mesh_index(mesh, i);
+		if (misses - stamp[v] > cache_size) {
+			stamp[v] = misses;
+			misses += 1;
+		}
+	}
+	free(stamp);
+	return (float)misses / mesh->ntri;
+}
+
+/* Find a triangle not yet used with the directed edge from-to, stores
+ * its third vertex in third. Returns -1 if there is none.
+ */
+static int find_edge(mesh_t* mesh, int* offset, int* tris,
+		const char* used, uint32_t from, uint32_t to,
+		uint32_t* third)
+{
+	int	j;
+
+	for (j = offset[from]; j < offset[from+1]; ++j) {
+		int	t = tris[j];
+		int	i;
+
+		if (used[t])
+			continue;
+		for (i = 0; i < 3; ++i) {
+			if (mesh_index(mesh, 3*t + i) == from &&
+				mesh_index(mesh, 3*t + (i+1)%3) == to) {
+				*third = mesh_index(mesh, 3*t + (i+2)%3);
+				return t;
+			}
+		}
+	}
+	return -1;
+}
+
+uint32_t* mesh_strips(mesh_t* mesh, int* nidx)
+{
+	uint32_t*	strips;
+	int*		offset;
+	int*		tris;
+	char*		used;
+	int		n = 0;
+	int		t;
+
+	assert(mesh != NULL);
+	assert(nidx != NULL);
+
+	/* at worst every strip is a single triangle */
+	strips = malloc(sizeof(uint32_t) * (4 * mesh->ntri + 1));
+	offset = malloc(sizeof(int) * (mesh->nvec + 1));
+	tris = malloc(sizeof(int) * (3 * mesh->ntri + 1));
+	used = calloc(mesh->ntri + 1, 1);
+	build_adjacency(mesh, offset, tris);
+
+	for (t = 0; t < mesh->ntri; ++t) {
+		uint32_t	v[3];
+		uint32_t	third;
+		int		start = 0;
+		int		odd = 1;
+		int		i;
+
+		if (used[t])
+			continue;
+		used[t] = 1;
+
+		/* start with the rotation that lets the strip go on */
+		for (i = 0; i < 3; ++i)
+			v[i] = mesh_index(mesh, 3*t + i);
+		for (i = 0; i < 3; ++i) {
+			if (find_edge(mesh, offset, tris, used, v[(i+2)%3],
+						v[(i+1)%3], &third) >= 0) {
+				start = i;
+				break;
+			}
+		}
+
+		if (n > 0)
+			strips[n++] = STRIP_RESTART;
+		for (i = 0; i < 3; ++i)
+			strips[n++] = v[(start+i)%3];
+
+		/* triangle j of a strip is s[j], s[j+1], s[j+2] with the
+		 * first two swapped for odd j */
+		for (;;) {
+			uint32_t	a = strips[n-2];
+			uint32_t	b = strips[n-1];
+			int		next;
+
+			if (odd)
+				next = find_edge(mesh, offset, tris, used,
+						b, a, &third);
+			else
+				next = find_edge(mesh, offset, tris, used,
+						a, b, &third);
+			if (next < 0)
+				break;
+			used[next] = 1;
+			strips[n++] = third;
+			odd = !odd;
+		}
+	}
+
+	free(offset);
+	free(tris);
+	free(used);
+	*nidx = n;
+	return strips;
+}
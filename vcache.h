@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Vertex cache optimization
+ *
+ * Post-passes over an indexed mesh for renderers that keep recently
+ * transformed vertices in a small cache: reordering the triangles so
+ * that they reuse cached vertices, and packing the triangles into
+ * strips.
+ */
+#ifndef CTTF_VCACHE_H
+#define CTTF_VCACHE_H
+
+#include <stdint.h>
+#include "mesh.h"
+
+/* the LRU cache size the triangle order is optimized for */
+#define VCACHE_SIZE	(32)
+
+/* separates the strips of mesh_strips */
+#define STRIP_RESTART	(0xFFFFFFFF)
+
+/* Reorder the triangles of a mesh for vertex cache locality, using the
+ * greedy scoring of Tom Forsyth's "Linear-Speed Vertex Cache
+ * Optimisation". The vertices and the winding of the triangles are
+ * not changed.
+ */
+void optimize_vertex_cache(mesh_t* mesh);
+
+/* Returns the average number of cache misses per triangle when the
+ * mesh is drawn through a FIFO vertex cache of cache_size entries
+ */
+float mesh_acmr(mesh_t* mesh, int cache_size);
+
+/* Pack the triangles of a mesh into triangle strips, taken greedily in
+ * the order of the triangles. The winding of each triangle is kept.
+ *
+ * Returns the strip indices, with STRIP_RESTART between the strips,
+ * and stores their number in nidx. The array is freed by the caller.
+ */
+uint32_t* mesh_strips(mesh_t* mesh, int* nidx);
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Vertex welding
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "weld.h"
+
+struct cell {
+	int64_t		x;
+	int64_t		y;
+	int		first;/* first point of the cell, -1 if empty */
+};
+
+/* Returns the hash table slot of a grid cell */
+static unsigned cell_hash(int64_t x, int64_t y, unsigned mask)
+{
+	uint64_t	h = (uint64_t)x * 0x9E3779B97F4A7C15ULL ^
+		(uint64_t)y * 0xC2B2AE3D27D4EB4FULL;
+	return (unsigned)(h ^ (h >> 32)) & mask;
+}
+
+/* Returns the slot of a cell, which is empty if the cell has no points
+ */
+static struct cell* find_cell(struct cell* table, unsigned mask,
+		int64_t x, int64_t y)
+{
+	unsigned	i = cell_hash(x, y, mask);
+
+	while (table[i].first >= 0 &&
+			(table[i].x != x || table[i].y != y))
+		i = (i + 1) & mask;
+	return &table[i];
+}
+
+int weld_points(const vector_t* vec, int n, float eps, int* map)
+{
+	struct cell*	table;
+	int*		next;/* next point in the same cell */
+	unsigned	size = 1;
+	double		x0;
+	double		y0;
+	int		count = 0;
+	int		i;
+
+	assert(vec != NULL || n == 0);
+	assert(map != NULL || n == 0);
+	assert(eps > 0);
+
+	if (n == 0)
+		return 0;
+
+	/* at most half full */
+	while (size < 2 * (unsigned)n)
+		size <<= 1;
+	table = malloc(sizeof(struct cell) * size);
+	next = malloc(sizeof(int) * n);
+	for (i = 0; i < (int)size; ++i)
+		table[i].first = -1;
+
+	x0 = y0 = 0;
+	for (i = 0; i < n; ++i) {
+		if (i == 0 || vec[i].x < x0) x0 = vec[i].x;
+		if (i == 0 || vec[i].y < y0) y0 = vec[i].y;
+	}
+
+	for (i = 0; i < n; ++i) {
+		int64_t		cx = (int64_t)floor((vec[i].x - x0) / eps);
+		int64_t		cy = (int64_t)floor((vec[i].y - y0) / eps);
+		struct cell*	cell;
+		int		dx;
+		int		dy;
+
+		/* a point within eps is at most one cell away, and the
+		 * earliest match is kept so the result does not depend
+		 * on the order of the cells */
+		map[i] = i;
+		for (dy = -1; dy <= 1; ++dy) {
+			for (dx = -1; dx <= 1; ++dx) {
+				int	j;
+
+				cell = find_cell(table, size - 1,
+						cx + dx, cy + dy);
+				for (j = cell->first; j >= 0; j = next[j]) {
+					if (j < map[i] &&
+						fabsf(vec[i].x - vec[j].x) < eps &&
+						fabsf(vec[i].y - vec[j].y) < eps)
+						map[i] = j;
+				}
+			}
+		}
+		if (map[i] != i)
+			continue;
+
+		cell = find_cell(table, size - 1, cx, cy);
+		if (cell->first < 0) {
+			cell->x = cx;
+			cell->y = cy;
+			next[i] = -1;
+		} else {
+			next[i] = cell->first;
+		}
+		cell->first = i;
+		count += 1;
+	}
+
+	free(table);
+	free(next);
+	return count;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2012 Jesper Öqvist <jesper@llbit.se>
+ *
+ * This file is part of cTTF.
+ *
+ * cTTF is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * cTTF is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with cTTF; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+/*
+ * Vertex welding
+ *
+ * Merges points that lie within a tolerance of each other, using a
+ * hash of a uniform grid with cells the size of the tolerance so that
+ * each point is only compared with the points in the neighbouring
+ * cells.
+ */
+#ifndef CTTF_WELD_H
+#define CTTF_WELD_H
+
+#include "vector.h"
+
+/* Map each of the n points in vec to the first earlier point that maps
+ * to itself and is within eps of it in both coordinates, or to itself
+ * if there is none. Points are only welded to points that map to
+ * themselves, so chains of close points do not drift.
+ *
+ * map must have room for n entries, map[i] <= i on return. Returns the
+ * number of points that map to themselves.
+ */
+int weld_points(const vector_t* vec, int n, float eps, int* map);
+
+#endif